@@ -0,0 +1,653 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "PortableCRT.h"
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <regex>
+#include <sstream>
+#include "XUSGObjLoader.h"
+#include "ParallelFor.h"
+#include "CPUClipmapVoxelizer.h"
+#include "CPUDistanceField.h"
+#include "CPUDynamicVoxelizer.h"
+#include "CPUIncrementalVoxelizer.h"
+#include "CPURayCaster.h"
+#include "CPUSceneVoxelizer.h"
+#include "VoxelColumns.h"
+
+using namespace std;
+
+//--------------------------------------------------------------------------------------
+// Benchmarks of the CPU engine in the manner of Google Benchmark: each case is an asset,
+// a resolution, a mode and a thread count, run for a number of repetitions, and named
+// Voxelize/<asset>/<resolution>/<mode>/threads:<n> for filtering and for tracking in the
+// JSON output. Peak memory is the high-water mark of the heap during the case, counted
+// by the global allocation functions of this program, so it includes the grid and all
+// the scratch memory of the engine, but not the mesh, which is loaded beforehand.
+// The moving modes animate the mesh, scaled down to a quarter, along a circle in the
+// grid, and time each frame after the first by a full voxelization (moving_full), or by
+// CPUIncrementalVoxelizer (moving_incremental). The deforming modes swing the part of
+// the mesh beyond half the bound radius along +X, as a limb, and time each frame by a
+// full voxelization (deforming_full), or by CPUDynamicVoxelizer (deforming_dynamic).
+// The scene modes voxelize a lattice of 4x4x4 instances of the mesh, scaled down to a
+// quarter, filling the grid, and as many outside of it, by a voxelization per instance
+// (scene_per_instance), or by a batched pass of CPUSceneVoxelizer (scene_batched).
+// The clipmap modes move the focus of a CPUClipmapVoxelizer of 3 levels of half the
+// resolution, the finest at twice the resolution, along a circle in the grid, and time
+// each frame by a full update, which also bins the triangles again (clipmap_full), or by
+// the toroidal one (clipmap_toroidal). The solid_columns mode builds the solid as the
+// run-length columns of VoxelColumns, without a dense grid, for comparing its time and
+// peak memory with those of the solid mode. The ray casting modes render an image of
+// 256x256 pixels of the solid by CPURayCaster from the view of VoxelizerX, and time the
+// rendering alone, with the in-scattering by the secondary light march (ray_cast_march),
+// or by the light transmittance volume, including its computation (ray_cast_volume).
+// The sdf mode times the signed distance field of the solid by CPUDistanceField, with a
+// band of a voxel, where the solid itself is built outside of the timing.
+//--------------------------------------------------------------------------------------
+enum Mode : uint8_t
+{
+	MODE_SURFACE,
+	MODE_SOLID,
+	MODE_SOLID_COLUMNS,
+	MODE_MOVING_FULL,
+	MODE_MOVING_INCREMENTAL,
+	MODE_DEFORMING_FULL,
+	MODE_DEFORMING_DYNAMIC,
+	MODE_SCENE_PER_INSTANCE,
+	MODE_SCENE_BATCHED,
+	MODE_CLIPMAP_FULL,
+	MODE_CLIPMAP_TOROIDAL,
+	MODE_RAY_CAST_MARCH,
+	MODE_RAY_CAST_VOLUME,
+	MODE_SDF,
+
+	NUM_MODE
+};
+
+const char* g_modeNames[] = { "surface", "solid", "solid_columns", "moving_full", "moving_incremental", "deforming_full", "deforming_dynamic",
+	"scene_per_instance", "scene_batched", "clipmap_full", "clipmap_toroidal", "ray_cast_march", "ray_cast_volume", "sdf" };
+
+const uint32_t g_numAnimationFrames = 16;
+const uint32_t g_sceneLatticeSize = 4;
+const uint32_t g_numSceneInstances = 2 * g_sceneLatticeSize * g_sceneLatticeSize * g_sceneLatticeSize;
+const uint32_t g_renderSize = 256;
+
+struct Options
+{
+	vector<string> MeshFileNames;
+	vector<uint32_t> Resolutions;
+	vector<uint32_t> ThreadCounts;
+	vector<Mode> Modes;
+	string Filter;
+	string JSONFileName;
+	uint32_t NumRepetitions;
+};
+
+struct Case
+{
+	string Name;
+	string Asset;
+	uint32_t Resolution;
+	Mode VoxMode;
+	uint32_t NumThreads;
+	uint32_t NumTriangles;
+	size_t NumOccupied;
+	double MinTime;			// In milliseconds, of voxelization and fill, or of an animation frame
+	double MeanTime;		// In milliseconds, of voxelization and fill, or of an animation frame
+	double MaxTime;			// In milliseconds, of voxelization and fill, or of an animation frame
+	double MeanFillTime;	// In milliseconds
+	double Speedup;			// Over the single-thread run of the same case, if any
+	size_t PeakMemory;		// In bytes
+};
+
+//--------------------------------------------------------------------------------------
+// Heap tracking
+//--------------------------------------------------------------------------------------
+namespace
+{
+	atomic<size_t> g_allocated(0);
+	atomic<size_t> g_peakAllocated(0);
+
+	void* allocate(size_t size)
+	{
+		// Keep the size in front of the block for the deallocation
+		const auto p = static_cast<size_t*>(malloc(size + sizeof(max_align_t)));
+		if (!p) throw bad_alloc();
+		*p = size;
+
+		const auto allocated = g_allocated += size;
+		auto peak = g_peakAllocated.load(memory_order_relaxed);
+		while (allocated > peak && !g_peakAllocated.compare_exchange_weak(peak, allocated, memory_order_relaxed));
+
+		return reinterpret_cast<uint8_t*>(p) + sizeof(max_align_t);
+	}
+
+	void deallocate(void* ptr)
+	{
+		if (!ptr) return;
+
+		const auto p = reinterpret_cast<size_t*>(static_cast<uint8_t*>(ptr) - sizeof(max_align_t));
+		g_allocated -= *p;
+		free(p);
+	}
+
+	size_t resetPeakMemory()
+	{
+		const auto allocated = g_allocated.load();
+		g_peakAllocated = allocated;
+
+		return allocated;
+	}
+}
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void operator delete(void* ptr) noexcept { deallocate(ptr); }
+void operator delete[](void* ptr) noexcept { deallocate(ptr); }
+void operator delete(void* ptr, size_t) noexcept { deallocate(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { deallocate(ptr); }
+
+namespace
+{
+	string getAssetName(const string& meshFileName)
+	{
+		const auto slash = meshFileName.find_last_of("/\\");
+		auto name = slash == string::npos ? meshFileName : meshFileName.substr(slash + 1);
+		const auto dot = name.find_last_of('.');
+		if (dot != string::npos) name.resize(dot);
+
+		return name;
+	}
+
+	vector<uint32_t> parseList(const string& str)
+	{
+		vector<uint32_t> values;
+		stringstream ss(str);
+		for (string value; getline(ss, value, ',');) values.emplace_back(stoul(value));
+
+		return values;
+	}
+
+	// Scaled to a quarter about the center of the bound, spun about Y, and moved along a
+	// circle of half the bound radius, by 1/256 of a turn per frame
+	void getMovingTransform(uint32_t frame, const float bound[4], float transform[3][4])
+	{
+		const auto angle = 2.0f * 3.14159265f * frame / 256.0f;
+		const auto s = 0.25f * sin(angle);
+		const auto c = 0.25f * cos(angle);
+		const float rotation[3][3] = { { c, 0.0f, s }, { 0.0f, 0.25f, 0.0f }, { -s, 0.0f, c } };
+		const float offset[] = { 0.5f * bound[3] * cos(angle), 0.0f, 0.5f * bound[3] * sin(angle) };
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			transform[i][3] = bound[i] + offset[i];
+			for (uint8_t j = 0; j < 3; ++j)
+			{
+				transform[i][j] = rotation[i][j];
+				transform[i][3] -= rotation[i][j] * bound[j];
+			}
+		}
+	}
+
+	// Along a circle of half the bound radius, by 1/64 of a turn per frame
+	void getClipmapFocus(uint32_t frame, const float bound[4], float focus[3])
+	{
+		const auto angle = 2.0f * 3.14159265f * frame / 64.0f;
+		focus[0] = bound[0] + 0.5f * bound[3] * cos(angle);
+		focus[1] = bound[1];
+		focus[2] = bound[2] + 0.5f * bound[3] * sin(angle);
+	}
+
+	void deformVertices(uint32_t frame, const XUSG::ObjLoader& objLoader, const float bound[4], vector<uint8_t>& vertices)
+	{
+		const auto stride = objLoader.GetVertexStride();
+		const auto pVertices = objLoader.GetVertices();
+		vertices.assign(pVertices, pVertices + static_cast<size_t>(objLoader.GetNumVertices()) * stride);
+		for (auto i = 0u; i < objLoader.GetNumVertices(); ++i)
+		{
+			float p[3];
+			const auto pVertex = &vertices[static_cast<size_t>(i) * stride];
+			memcpy(p, pVertex, sizeof(p));
+
+			const auto d = p[0] - bound[0] - 0.5f * bound[3];
+			if (d <= 0.0f) continue;
+
+			p[1] += 0.5f * d * sin(0.4f * frame + 4.0f * d / bound[3]);
+			memcpy(pVertex, p, sizeof(p));
+		}
+	}
+
+	// Instance i of the scene lattice, scaled to a quarter, where the second half is moved
+	// out of the bound along X
+	void getSceneTransform(uint32_t i, const float bound[4], float transform[3][4])
+	{
+		const auto n = g_sceneLatticeSize;
+		const auto scale = 1.0f / n;
+		const uint32_t cell[] = { i % n, i / n % n, i / (n * n) % n };
+		for (uint8_t j = 0; j < 3; ++j)
+		{
+			const auto offset = ((cell[j] + 0.5f) * scale * 2.0f - 1.0f + (j == 0 && i >= n * n * n ? 4.0f : 0.0f)) * bound[3];
+			transform[j][0] = transform[j][1] = transform[j][2] = 0.0f;
+			transform[j][j] = scale;
+			transform[j][3] = bound[j] + offset - scale * bound[j];
+		}
+	}
+
+	string escapeJSON(const string& str)
+	{
+		string escaped;
+		for (const auto& c : str)
+		{
+			if (c == '"' || c == '\\') escaped += '\\';
+			escaped += c;
+		}
+
+		return escaped;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Run a case on a fresh grid, which is cleared outside of the timing between repetitions,
+// except for the full voxelization of each animation frame
+//--------------------------------------------------------------------------------------
+bool RunCase(const Options& options, const XUSG::ObjLoader& objLoader, const float bound[4], Case& result)
+{
+	const auto baseMemory = resetPeakMemory();
+
+	const auto clipmap = result.VoxMode == MODE_CLIPMAP_FULL || result.VoxMode == MODE_CLIPMAP_TOROIDAL;
+	const auto columns = result.VoxMode == MODE_SOLID_COLUMNS;
+	const auto rayCast = result.VoxMode == MODE_RAY_CAST_MARCH || result.VoxMode == MODE_RAY_CAST_VOLUME;
+	const auto sdf = result.VoxMode == MODE_SDF;
+	VoxelGrid grid;
+	VoxelColumns solidColumns;
+	CPUClipmapVoxelizer clipmapVoxelizer;
+	try
+	{
+		if (!columns && !grid.Create(result.Resolution)) return false;
+		if (clipmap && !clipmapVoxelizer.Create((max)(result.Resolution / 2, 1u), 3, 2 * result.Resolution, bound)) return false;
+	}
+	catch (const bad_alloc&)
+	{
+		return false;
+	}
+
+	CPUIncrementalVoxelizer voxelizer;
+	CPUDynamicVoxelizer dynamicVoxelizer;
+	CPUSceneVoxelizer sceneVoxelizer;
+	const auto sceneMesh = sceneVoxelizer.AddMesh(objLoader.GetVertices(), objLoader.GetVertexStride(),
+		objLoader.GetNumVertices(), objLoader.GetIndices(), objLoader.GetNumIndices());
+	for (auto i = 0u; i < g_numSceneInstances; ++i)
+	{
+		float transform[3][4];
+		getSceneTransform(i, bound, transform);
+		sceneVoxelizer.AddInstance(sceneMesh, transform, i + 1);
+	}
+
+	// View of VoxelizerX, with the grid scaled to a half extent of 4 at its focus
+	CPURayCaster rayCaster;
+	CPUDistanceField distanceField;
+	vector<uint8_t> pixels(rayCast ? 4 * g_renderSize * g_renderSize : 0);
+	if (rayCast)
+	{
+		const auto scale = 4.0f / bound[3];
+		const float posScale[] = { -bound[0] * scale, 4.0f - bound[1] * scale, -bound[2] * scale, scale };
+		const float eyePt[] = { 8.0f, 12.0f, -14.0f };
+		const float focusPt[] = { 0.0f, 4.0f, 0.0f };
+		rayCaster.SetView(bound, posScale, eyePt, focusPt, g_renderSize, g_renderSize);
+		rayCaster.SetLightVolume(result.VoxMode == MODE_RAY_CAST_VOLUME);
+	}
+
+	const auto moving = result.VoxMode == MODE_MOVING_FULL || result.VoxMode == MODE_MOVING_INCREMENTAL;
+	const auto deforming = result.VoxMode == MODE_DEFORMING_FULL || result.VoxMode == MODE_DEFORMING_DYNAMIC;
+	const auto numFrames = moving || deforming || clipmap ? g_numAnimationFrames : 1;
+	vector<uint8_t> vertices;
+	result.MinTime = DBL_MAX;
+	result.MeanTime = result.MaxTime = result.MeanFillTime = 0.0;
+	for (auto i = 0u; i < options.NumRepetitions; ++i)
+	{
+		if (i > 0 && !columns) grid.Clear();
+
+		// The first frame is a full voxelization for both
+		if (moving)
+		{
+			float transform[3][4];
+			getMovingTransform(0, bound, transform);
+			voxelizer.SetMesh(objLoader.GetVertices(), objLoader.GetVertexStride(), objLoader.GetNumVertices(),
+				objLoader.GetIndices(), objLoader.GetNumIndices(), bound);
+			voxelizer.Update(grid, transform, result.NumThreads);
+		}
+		else if (deforming)
+		{
+			deformVertices(0, objLoader, bound, vertices);
+			dynamicVoxelizer.SetMesh(objLoader.GetVertexStride(), objLoader.GetNumVertices(),
+				objLoader.GetIndices(), objLoader.GetNumIndices(), bound);
+			dynamicVoxelizer.Update(grid, vertices.data(), result.NumThreads);
+		}
+		else if (clipmap)
+		{
+			float focus[3];
+			getClipmapFocus(0, bound, focus);
+			clipmapVoxelizer.SetMesh(objLoader.GetVertices(), objLoader.GetVertexStride(),
+				objLoader.GetIndices(), objLoader.GetNumIndices());
+			clipmapVoxelizer.Update(focus, result.NumThreads);
+		}
+		else if (rayCast || sdf)
+		{
+			voxelizer.Voxelize(grid, objLoader.GetVertices(), objLoader.GetVertexStride(),
+				objLoader.GetIndices(), objLoader.GetNumIndices(), bound, result.NumThreads);
+			voxelizer.FillSolid(grid, result.NumThreads);
+		}
+
+		for (auto frame = 1u; frame <= numFrames; ++frame)
+		{
+			float transform[3][4], focus[3];
+			if (moving) getMovingTransform(frame, bound, transform);
+			if (clipmap) getClipmapFocus(frame, bound, focus);
+			if (deforming) deformVertices(frame, objLoader, bound, vertices);
+
+			const auto start = chrono::steady_clock::now();
+			switch (result.VoxMode)
+			{
+			case MODE_MOVING_FULL:
+				grid.Clear();
+				voxelizer.Voxelize(grid, objLoader.GetVertices(), objLoader.GetVertexStride(),
+					objLoader.GetIndices(), objLoader.GetNumIndices(), bound, transform, result.NumThreads);
+				break;
+			case MODE_MOVING_INCREMENTAL:
+				voxelizer.Update(grid, transform, result.NumThreads);
+				break;
+			case MODE_DEFORMING_FULL:
+				grid.Clear();
+				voxelizer.Voxelize(grid, vertices.data(), objLoader.GetVertexStride(),
+					objLoader.GetIndices(), objLoader.GetNumIndices(), bound, result.NumThreads);
+				break;
+			case MODE_DEFORMING_DYNAMIC:
+				dynamicVoxelizer.Update(grid, vertices.data(), result.NumThreads);
+				break;
+			case MODE_SCENE_PER_INSTANCE:
+				for (auto j = 0u; j < g_numSceneInstances; ++j)
+				{
+					getSceneTransform(j, bound, transform);
+					voxelizer.Voxelize(grid, objLoader.GetVertices(), objLoader.GetVertexStride(),
+						objLoader.GetIndices(), objLoader.GetNumIndices(), bound, transform, result.NumThreads);
+				}
+				break;
+			case MODE_SCENE_BATCHED:
+				sceneVoxelizer.VoxelizeScene(grid, bound, result.NumThreads);
+				break;
+			case MODE_CLIPMAP_FULL:
+				clipmapVoxelizer.Invalidate();
+				clipmapVoxelizer.Update(focus, result.NumThreads);
+				break;
+			case MODE_CLIPMAP_TOROIDAL:
+				clipmapVoxelizer.Update(focus, result.NumThreads);
+				break;
+			case MODE_RAY_CAST_MARCH:
+			case MODE_RAY_CAST_VOLUME:
+				rayCaster.Render(grid, g_renderSize, g_renderSize, pixels.data(), 0, true, nullptr, result.NumThreads);
+				break;
+			case MODE_SDF:
+				distanceField.Generate(grid, objLoader.GetVertices(), objLoader.GetVertexStride(),
+					objLoader.GetIndices(), objLoader.GetNumIndices(), bound, 1.0f, nullptr, result.NumThreads);
+				break;
+			case MODE_SOLID_COLUMNS:
+				solidColumns.Build(result.Resolution, objLoader.GetVertices(), objLoader.GetVertexStride(),
+					objLoader.GetIndices(), objLoader.GetNumIndices(), bound, result.NumThreads);
+				break;
+			default:
+				voxelizer.Voxelize(grid, objLoader.GetVertices(), objLoader.GetVertexStride(),
+					objLoader.GetIndices(), objLoader.GetNumIndices(), bound, result.NumThreads);
+			}
+			const auto voxelized = chrono::steady_clock::now();
+			if (result.VoxMode == MODE_SOLID) voxelizer.FillSolid(grid, result.NumThreads);
+			const auto end = chrono::steady_clock::now();
+
+			const auto time = chrono::duration<double, milli>(end - start).count();
+			result.MinTime = (min)(result.MinTime, time);
+			result.MaxTime = (max)(result.MaxTime, time);
+			result.MeanTime += time;
+			result.MeanFillTime += chrono::duration<double, milli>(end - voxelized).count();
+		}
+	}
+
+	result.MeanTime /= options.NumRepetitions * numFrames;
+	result.MeanFillTime /= options.NumRepetitions * numFrames;
+	if (clipmap) result.NumOccupied = clipmapVoxelizer.GetLevel(0).GetNumOccupied();
+	else result.NumOccupied = columns ? static_cast<size_t>(solidColumns.GetNumVoxels()) : grid.GetNumOccupied();
+	result.PeakMemory = g_peakAllocated - baseMemory;
+
+	return true;
+}
+
+bool WriteJSON(const Options& options, const vector<Case>& cases, const char* fileName)
+{
+	ofstream file(fileName);
+	if (!file) return false;
+
+	const auto now = time(nullptr);
+	char date[32];
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+	file << "{\n  \"context\": {\n"
+		<< "    \"date\": \"" << date << "\",\n"
+		<< "    \"num_cpus\": " << GetNumWorkerThreads() << ",\n"
+		<< "    \"repetitions\": " << options.NumRepetitions << ",\n"
+#ifdef NDEBUG
+		<< "    \"library_build_type\": \"release\"\n"
+#else
+		<< "    \"library_build_type\": \"debug\"\n"
+#endif
+		<< "  },\n  \"benchmarks\": [";
+
+	file << setprecision(9);
+	for (size_t i = 0; i < cases.size(); ++i)
+	{
+		const auto& c = cases[i];
+		const auto seconds = c.MeanTime / 1000.0;
+		file << (i ? ",\n" : "\n") << "    {\n"
+			<< "      \"name\": \"" << escapeJSON(c.Name) << "\",\n"
+			<< "      \"asset\": \"" << escapeJSON(c.Asset) << "\",\n"
+			<< "      \"resolution\": " << c.Resolution << ",\n"
+			<< "      \"mode\": \"" << g_modeNames[c.VoxMode] << "\",\n"
+			<< "      \"threads\": " << c.NumThreads << ",\n"
+			<< "      \"repetitions\": " << options.NumRepetitions << ",\n"
+			<< "      \"real_time\": " << c.MeanTime << ",\n"
+			<< "      \"min_time\": " << c.MinTime << ",\n"
+			<< "      \"max_time\": " << c.MaxTime << ",\n"
+			<< "      \"fill_time\": " << c.MeanFillTime << ",\n"
+			<< "      \"time_unit\": \"ms\",\n"
+			<< "      \"triangles\": " << c.NumTriangles << ",\n"
+			<< "      \"voxels\": " << c.NumOccupied << ",\n"
+			<< "      \"triangles_per_second\": " << c.NumTriangles / seconds << ",\n"
+			<< "      \"voxels_per_second\": " << c.NumOccupied / seconds << ",\n"
+			<< "      \"speedup\": " << c.Speedup << ",\n"
+			<< "      \"peak_memory_bytes\": " << c.PeakMemory << "\n"
+			<< "    }";
+	}
+	file << "\n  ]\n}\n";
+
+	return static_cast<bool>(file);
+}
+
+void PrintUsage(const char* appName)
+{
+	cout << "Usage: " << appName << " [options] [mesh.obj ...]\n"
+		"  -res <list>      grid resolutions (default 64,128,256,512,1024)\n"
+		"  -threads <list>  thread counts (default 1, 2, 4, ... up to all the hardware threads)\n"
+		"  -mode <name>     surface | solid | moving | deforming | scene | clipmap | ray_cast | sdf | all\n"
+		"                   (default all)\n"
+		"  -reps <n>        repetitions per case (default 3)\n"
+		"  -filter <regex>  run only the cases whose names match\n"
+		"  -json <file>     write the results as JSON\n"
+		"Meshes default to the bunny, dragon and TuringBowl in Assets.\n";
+}
+
+bool ParseCommandLineArgs(Options& options, char* argv[], int argc)
+{
+	const auto str_tolower = [](string s)
+	{
+		transform(s.begin(), s.end(), s.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+
+		return s;
+	};
+
+	const auto isArgMatched = [&argv, &str_tolower](int i, const char* paramName)
+	{
+		const auto& arg = argv[i];
+
+		return (arg[0] == '-' || arg[0] == '/') && str_tolower(&arg[1]) == str_tolower(paramName);
+	};
+
+	const auto hasNextArgValue = [&argv, &argc](int i)
+	{
+		return i + 1 < argc && argv[i + 1][0] != '-';
+	};
+
+	options.Resolutions = { 64, 128, 256, 512, 1024 };
+	options.Modes = { MODE_SURFACE, MODE_SOLID, MODE_SOLID_COLUMNS, MODE_MOVING_FULL, MODE_MOVING_INCREMENTAL,
+		MODE_DEFORMING_FULL, MODE_DEFORMING_DYNAMIC, MODE_SCENE_PER_INSTANCE, MODE_SCENE_BATCHED,
+		MODE_CLIPMAP_FULL, MODE_CLIPMAP_TOROIDAL, MODE_RAY_CAST_MARCH, MODE_RAY_CAST_VOLUME, MODE_SDF };
+	options.NumRepetitions = 3;
+
+	for (auto i = 1; i < argc; ++i)
+	{
+		if (isArgMatched(i, "res") && hasNextArgValue(i)) options.Resolutions = parseList(argv[++i]);
+		else if (isArgMatched(i, "threads") && hasNextArgValue(i)) options.ThreadCounts = parseList(argv[++i]);
+		else if (isArgMatched(i, "reps") && hasNextArgValue(i)) options.NumRepetitions = stoul(argv[++i]);
+		else if (isArgMatched(i, "filter") && hasNextArgValue(i)) options.Filter = argv[++i];
+		else if (isArgMatched(i, "json") && hasNextArgValue(i)) options.JSONFileName = argv[++i];
+		else if (isArgMatched(i, "mode") && hasNextArgValue(i))
+		{
+			const auto mode = str_tolower(argv[++i]);
+			if (mode == "surface") options.Modes = { MODE_SURFACE };
+			else if (mode == "solid") options.Modes = { MODE_SOLID, MODE_SOLID_COLUMNS };
+			else if (mode == "moving") options.Modes = { MODE_MOVING_FULL, MODE_MOVING_INCREMENTAL };
+			else if (mode == "deforming") options.Modes = { MODE_DEFORMING_FULL, MODE_DEFORMING_DYNAMIC };
+			else if (mode == "scene") options.Modes = { MODE_SCENE_PER_INSTANCE, MODE_SCENE_BATCHED };
+			else if (mode == "clipmap") options.Modes = { MODE_CLIPMAP_FULL, MODE_CLIPMAP_TOROIDAL };
+			else if (mode == "ray_cast") options.Modes = { MODE_RAY_CAST_MARCH, MODE_RAY_CAST_VOLUME };
+			else if (mode == "sdf") options.Modes = { MODE_SDF };
+			else if (mode != "all") return false;
+		}
+		else if (argv[i][0] == '-') return false;
+		else options.MeshFileNames.emplace_back(argv[i]);
+	}
+
+	if (options.MeshFileNames.empty())
+		options.MeshFileNames = { "Assets/bunny.obj", "Assets/dragon.obj", "Assets/TuringBowl.obj" };
+
+	if (options.ThreadCounts.empty())
+	{
+		const auto numThreads = GetNumWorkerThreads();
+		for (auto n = 1u; n < numThreads; n <<= 1) options.ThreadCounts.emplace_back(n);
+		options.ThreadCounts.emplace_back(numThreads);
+	}
+
+	const auto isZero = [](uint32_t n) { return n == 0; };
+	if (options.Resolutions.empty() || any_of(options.Resolutions.cbegin(), options.Resolutions.cend(), isZero)) return false;
+	if (any_of(options.ThreadCounts.cbegin(), options.ThreadCounts.cend(), isZero)) return false;
+
+	return options.NumRepetitions > 0;
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	regex filter;
+	try
+	{
+		if (!ParseCommandLineArgs(options, argv, argc))
+		{
+			PrintUsage(argv[0]);
+
+			return 1;
+		}
+		filter = regex(options.Filter);
+	}
+	catch (const exception&)
+	{
+		PrintUsage(argv[0]);
+
+		return 1;
+	}
+
+	cout << left << setw(56) << "Benchmark" << right << setw(12) << "Time(ms)" << setw(12) << "Min(ms)"
+		<< setw(12) << "MTri/s" << setw(12) << "MVox/s" << setw(10) << "Speedup" << setw(12) << "Peak(MB)" << endl;
+	cout << string(126, '-') << endl;
+
+	vector<Case> cases;
+	auto numFailed = 0u;
+	for (const auto& meshFileName : options.MeshFileNames)
+	{
+		XUSG::ObjLoader objLoader;
+		if (!objLoader.Import(meshFileName.c_str(), true, true))
+		{
+			cerr << meshFileName << ": error: failed to load" << endl;
+			++numFailed;
+			continue;
+		}
+
+		// Same bound as Voxelizer::Init
+		const auto& aabb = objLoader.GetAABB();
+		const float lo[] = { aabb.Min.x, aabb.Min.y, aabb.Min.z };
+		const float hi[] = { aabb.Max.x, aabb.Max.y, aabb.Max.z };
+		float bound[4];
+		CPUVoxelizer::GetBound(bound, lo, hi);
+
+		Case c = {};
+		c.Asset = getAssetName(meshFileName);
+		for (const auto& resolution : options.Resolutions)
+		{
+			for (const auto& mode : options.Modes)
+			{
+				// Of all the instances, including the culled ones, for the scene modes
+				const auto scene = mode == MODE_SCENE_PER_INSTANCE || mode == MODE_SCENE_BATCHED;
+				c.NumTriangles = objLoader.GetNumIndices() / 3 * (scene ? g_numSceneInstances : 1);
+				auto singleThreadTime = 0.0;
+				for (const auto& numThreads : options.ThreadCounts)
+				{
+					c.Resolution = resolution;
+					c.VoxMode = mode;
+					c.NumThreads = numThreads;
+					c.Name = "Voxelize/" + c.Asset + "/" + to_string(resolution) + "/" +
+						g_modeNames[mode] + "/threads:" + to_string(numThreads);
+					if (!regex_search(c.Name, filter)) continue;
+
+					if (!RunCase(options, objLoader, bound, c))
+					{
+						cerr << c.Name << ": error: out of memory" << endl;
+						++numFailed;
+						continue;
+					}
+
+					if (numThreads == 1) singleThreadTime = c.MeanTime;
+					c.Speedup = singleThreadTime > 0.0 ? singleThreadTime / c.MeanTime : 0.0;
+					cases.emplace_back(c);
+
+					cout << left << setw(56) << c.Name << right << fixed << setprecision(2)
+						<< setw(12) << c.MeanTime << setw(12) << c.MinTime
+						<< setw(12) << c.NumTriangles / c.MeanTime / 1000.0
+						<< setw(12) << c.NumOccupied / c.MeanTime / 1000.0
+						<< setw(10) << c.Speedup << setw(12) << c.PeakMemory / 1048576.0 << endl;
+				}
+			}
+		}
+	}
+
+	if (!options.JSONFileName.empty() && !WriteJSON(options, cases, options.JSONFileName.c_str()))
+	{
+		cerr << "error: failed to write " << options.JSONFileName << endl;
+		++numFailed;
+	}
+
+	return numFailed ? 2 : 0;
+}
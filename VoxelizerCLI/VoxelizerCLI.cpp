@@ -0,0 +1,515 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include "XUSGObjLoader.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "CPUVoxelizer.h"
+#include "CPUTiledVoxelizer.h"
+#include "CPUGreedyMesher.h"
+#include "CPUMarchingCubes.h"
+#include "CPUDistanceField.h"
+#include "CPURayCaster.h"
+#include "VoxelExporter.h"
+
+using namespace std;
+
+//--------------------------------------------------------------------------------------
+// Headless batch voxelization on the CPU engine. The methods of the app map to the
+// exact triangle-box overlap of CPUVoxelizer, which covers every voxel that any of the
+// GPU rasterization paths may produce, and solid adds the Z parity fill of CSFillSolid.
+//--------------------------------------------------------------------------------------
+enum Method : uint8_t
+{
+	TRI_PROJ,
+	TRI_PROJ_TESS,
+	TRI_PROJ_UNION,
+
+	NUM_METHOD
+};
+
+enum Format : uint8_t
+{
+	FORMAT_NONE,
+	FORMAT_RAW,
+	FORMAT_GREEDY_OBJ,
+	FORMAT_GREEDY_BIN,
+	FORMAT_MARCHING_CUBES,
+	FORMAT_SDF,
+	FORMAT_CHUNKED,
+	FORMAT_NRRD,
+	FORMAT_VOX,
+	FORMAT_TREE,
+
+	NUM_FORMAT
+};
+
+const char* g_methodNames[] = { "tri_proj", "tess", "union" };
+const char* g_formatNames[] = { "none", "raw", "obj", "mesh", "mc", "sdf", "chunked", "nrrd", "vox", "tree" };
+const char* g_formatExts[] = { "", ".vxg", ".obj", ".vxm", "_mc.obj", ".vxsd", ".vxgc", ".nrrd", ".vox", ".vxtr" };
+
+// Of the chunked files, of which the resolution and the tiles must be multiples
+const uint32_t g_chunkSize = 32;
+
+// Largest resolutions of the grid in memory, at 4 bytes per voxel and up to as many for
+// the IDs, and of the tiles streamed to the disk with -tile
+const uint32_t g_maxResolution = 1024;
+const uint32_t g_maxTiledResolution = 8192;
+
+struct Options
+{
+	vector<string> MeshFileNames;
+	string OutputDir;
+	string TraceFileName;
+	uint32_t Resolution;
+	uint32_t TileSize;		// Out of core, if not 0
+	size_t MemoryBudget;	// In bytes, out of core
+	uint8_t IDBits;			// Of the ID channel, if not 0
+	uint32_t RenderSize;	// Of the PNG by the CPU ray caster, if not 0
+	Method VoxMethod;
+	Format OutputFormat;
+	bool Solid;
+	uint32_t NumJobs;
+	uint32_t NumThreads;	// Per job
+};
+
+struct Result
+{
+	bool Succeeded;
+	string Error;
+	uint32_t NumTriangles;
+	size_t NumOccupied;
+	double LoadTime;		// In milliseconds
+	double VoxelizeTime;	// In milliseconds
+	double FillTime;		// In milliseconds
+	double RenderTime;		// In milliseconds
+	double ExportTime;		// In milliseconds
+	RayCastStats RenderStats;
+};
+
+namespace
+{
+	double elapsed(chrono::steady_clock::time_point& start)
+	{
+		const auto now = chrono::steady_clock::now();
+		const auto ms = chrono::duration<double, milli>(now - start).count();
+		start = now;
+
+		return ms;
+	}
+
+	string getOutputFileName(const Options& options, const string& meshFileName, const char* ext)
+	{
+		const auto slash = meshFileName.find_last_of("/\\");
+		auto name = slash == string::npos ? meshFileName : meshFileName.substr(slash + 1);
+		const auto dot = name.find_last_of('.');
+		if (dot != string::npos) name.resize(dot);
+
+		auto dir = options.OutputDir;
+		if (!dir.empty() && dir.back() != '/' && dir.back() != '\\') dir += '/';
+
+		return dir + name + ext;
+	}
+
+	// Formats streamed from the bricks of a grid or a chunked file
+	bool isStreamedFormat(Format format)
+	{
+		return format == FORMAT_NRRD || format == FORMAT_VOX || format == FORMAT_TREE;
+	}
+
+	bool exportStreamed(Format format, const string& fileName, const VoxelBrickSource& source, const float bound[4])
+	{
+		VoxelExporter exporter;
+		switch (format)
+		{
+		case FORMAT_NRRD:
+			return exporter.WriteNRRD(fileName.c_str(), source, bound);
+		case FORMAT_VOX:
+			return exporter.WriteVOX(fileName.c_str(), source);
+		case FORMAT_TREE:
+			return exporter.WriteTree(fileName.c_str(), source);
+		default:
+			return false;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Load, voxelize, fill, and export a single mesh with the threads of its job, where the
+// object ID is written into the ID channel of the grid, if any
+//--------------------------------------------------------------------------------------
+Result ProcessMesh(const Options& options, const string& meshFileName, uint32_t objectID)
+{
+	PROFILE_SCOPE("ProcessMesh");
+	Result result = {};
+	auto start = chrono::steady_clock::now();
+
+	XUSG::ObjLoader objLoader;
+	if (!objLoader.Import(meshFileName.c_str(), true, true))
+	{
+		result.Error = "failed to load";
+
+		return result;
+	}
+
+	// Same bound as Voxelizer::Init
+	const auto& aabb = objLoader.GetAABB();
+	const float lo[] = { aabb.Min.x, aabb.Min.y, aabb.Min.z };
+	const float hi[] = { aabb.Max.x, aabb.Max.y, aabb.Max.z };
+	float bound[4];
+	CPUVoxelizer::GetBound(bound, lo, hi);
+	result.NumTriangles = objLoader.GetNumIndices() / 3;
+	result.LoadTime = elapsed(start);
+
+	// Out of core, straight into the chunked file, so the voxelization includes the export.
+	// The other formats are streamed from a temporary chunked file next to the output.
+	if (options.TileSize)
+	{
+		const auto fileName = getOutputFileName(options, meshFileName, g_formatExts[options.OutputFormat]);
+		const auto chunkFileName = options.OutputFormat == FORMAT_CHUNKED ? fileName : fileName + ".vxgc";
+		VoxelChunkWriter writer;
+		CPUTiledVoxelizer voxelizer;
+		voxelizer.SetTileSize(options.TileSize);
+		auto written = writer.Create(chunkFileName.c_str(), options.Resolution, g_chunkSize) &&
+			voxelizer.Voxelize(writer, objLoader.GetVertices(), objLoader.GetVertexStride(),
+				objLoader.GetIndices(), objLoader.GetNumIndices(), bound, (fileName + ".bucket").c_str(),
+				options.MemoryBudget, options.NumThreads);
+		written = writer.Close() && written;
+		result.VoxelizeTime = elapsed(start);
+		result.NumOccupied = voxelizer.GetNumOccupied();
+
+		if (written && isStreamedFormat(options.OutputFormat))
+		{
+			VoxelChunkReader reader;
+			written = reader.Open(chunkFileName.c_str()) &&
+				exportStreamed(options.OutputFormat, fileName, VoxelChunkSource(reader), bound);
+			reader.Close();
+			remove(chunkFileName.c_str());
+			result.ExportTime = elapsed(start);
+		}
+
+		if (!written) result.Error = "failed to write " + fileName;
+		result.Succeeded = written;
+
+		return result;
+	}
+
+	VoxelGrid grid;
+	if (!grid.Create(options.Resolution, 1, options.IDBits))
+	{
+		result.Error = "failed to create the grid";
+
+		return result;
+	}
+
+	CPUVoxelizer voxelizer;
+	voxelizer.SetObjectID(objectID);
+	voxelizer.Voxelize(grid, objLoader.GetVertices(), objLoader.GetVertexStride(),
+		objLoader.GetIndices(), objLoader.GetNumIndices(), bound, options.NumThreads);
+	result.VoxelizeTime = elapsed(start);
+
+	if (options.Solid)
+	{
+		voxelizer.FillSolid(grid, options.NumThreads);
+		result.FillTime = elapsed(start);
+	}
+
+	result.NumOccupied = grid.GetNumOccupied();
+
+	// Ray cast from the view of VoxelizerX, with the grid scaled to a half extent of 4 at its focus
+	if (options.RenderSize)
+	{
+		const auto scale = 4.0f / bound[3];
+		const float posScale[] = { -bound[0] * scale, 4.0f - bound[1] * scale, -bound[2] * scale, scale };
+		const float eyePt[] = { 8.0f, 12.0f, -14.0f };
+		const float focusPt[] = { 0.0f, 4.0f, 0.0f };
+		const auto size = options.RenderSize;
+		vector<uint8_t> pixels(4ull * size * size);
+		CPURayCaster rayCaster;
+		rayCaster.SetView(bound, posScale, eyePt, focusPt, size, size);
+		rayCaster.Render(grid, size, size, pixels.data(), 0, true, &result.RenderStats, options.NumThreads);
+
+		const auto pngFileName = getOutputFileName(options, meshFileName, ".png");
+		if (!CPURayCaster::WritePNG(pngFileName.c_str(), size, size, pixels.data()))
+		{
+			result.Error = "failed to write " + pngFileName;
+
+			return result;
+		}
+		result.RenderTime = elapsed(start);
+	}
+
+	// Export
+	const auto fileName = getOutputFileName(options, meshFileName, g_formatExts[options.OutputFormat]);
+	auto written = true;
+	switch (options.OutputFormat)
+	{
+	case FORMAT_RAW:
+		written = grid.WriteRaw(fileName.c_str());
+		break;
+	case FORMAT_GREEDY_OBJ:
+	case FORMAT_GREEDY_BIN:
+	{
+		CPUGreedyMesher mesher;
+		mesher.Mesh(grid, bound, 0, nullptr, options.NumThreads);
+		written = options.OutputFormat == FORMAT_GREEDY_OBJ ?
+			mesher.WriteOBJ(fileName.c_str()) : mesher.WriteBinary(fileName.c_str());
+		break;
+	}
+	case FORMAT_MARCHING_CUBES:
+	{
+		CPUMarchingCubes marchingCubes;
+		marchingCubes.Extract(grid, bound, 0, 0.5f, nullptr, options.NumThreads);
+		written = marchingCubes.WriteOBJ(fileName.c_str());
+		break;
+	}
+	case FORMAT_SDF:
+	{
+		CPUDistanceField distanceField;
+		distanceField.Generate(grid, objLoader.GetVertices(), objLoader.GetVertexStride(),
+			objLoader.GetIndices(), objLoader.GetNumIndices(), bound, 1.0f, nullptr, options.NumThreads);
+		written = distanceField.WriteRaw(fileName.c_str());
+		break;
+	}
+	case FORMAT_CHUNKED:
+	{
+		VoxelChunkWriter writer;
+		written = writer.Create(fileName.c_str(), options.Resolution, g_chunkSize, true, options.IDBits) &&
+			writer.WriteGrid(grid, nullptr, options.NumThreads);
+		written = writer.Close() && written;
+		break;
+	}
+	case FORMAT_NRRD:
+	case FORMAT_VOX:
+	case FORMAT_TREE:
+		written = exportStreamed(options.OutputFormat, fileName, VoxelGridSource(grid), bound);
+		break;
+	default:
+		break;
+	}
+
+	result.ExportTime = elapsed(start);
+	if (!written) result.Error = "failed to write " + fileName;
+	result.Succeeded = written;
+
+	return result;
+}
+
+void PrintUsage(const char* appName)
+{
+	cout << "Usage: " << appName << " [options] mesh.obj [mesh.obj ...]\n"
+		"  -res <n>        grid resolution (default 128), a power of 2 up to 1024, or 8192 with\n"
+		"                  -tile, and at least 32 for chunked and -tile\n"
+		"  -method <name>  tri_proj | tess | union (default tri_proj)\n"
+		"  -solid          solid voxelization by ray parity along Z\n"
+		"  -render <n>     n x n PNG by the CPU ray caster from the view of the app, with its stats\n"
+		"  -ids <bits>     16 | 32, ID channel with the index of each mesh, kept by raw, chunked,\n"
+		"                  and tree, but not by -tile, which has no ID channel\n"
+		"  -format <name>  none | raw | obj | mesh | mc | sdf | chunked | nrrd | vox | tree (default raw)\n"
+		"  -tile <n>       out of core in tiles of n^3 voxels, n a multiple of 32, for chunked,\n"
+		"                  nrrd, vox, and tree\n"
+		"  -budget <MB>    memory budget of the tiles in flight (default 1024)\n"
+		"  -out <dir>      output directory (default .)\n"
+		"  -jobs <n>       meshes voxelized concurrently (default 1)\n"
+		"  -threads <n>    worker threads per job (default all the hardware threads / jobs)\n"
+		"  -trace <file>   profile the passes, and write a Chrome trace (chrome://tracing)\n";
+}
+
+bool ParseCommandLineArgs(Options& options, char* argv[], int argc)
+{
+	const auto str_tolower = [](string s)
+	{
+		transform(s.begin(), s.end(), s.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+
+		return s;
+	};
+
+	const auto isArgMatched = [&argv, &str_tolower](int i, const char* paramName)
+	{
+		const auto& arg = argv[i];
+
+		return (arg[0] == '-' || arg[0] == '/') && str_tolower(&arg[1]) == str_tolower(paramName);
+	};
+
+	const auto hasNextArgValue = [&argv, &argc](int i)
+	{
+		return i + 1 < argc && argv[i + 1][0] != '-';
+	};
+
+	const auto findName = [&str_tolower](const char* const* names, uint8_t numNames, const char* name)
+	{
+		uint8_t i = 0;
+		while (i < numNames && str_tolower(name) != names[i]) ++i;
+
+		return i;
+	};
+
+	options.OutputDir = ".";
+	options.Resolution = 128;
+	options.TileSize = 0;
+	options.MemoryBudget = 1024ull << 20;
+	options.IDBits = 0;
+	options.RenderSize = 0;
+	options.VoxMethod = TRI_PROJ;
+	options.OutputFormat = FORMAT_RAW;
+	options.Solid = false;
+	options.NumJobs = 1;
+	options.NumThreads = 0;
+
+	for (auto i = 1; i < argc; ++i)
+	{
+		if (isArgMatched(i, "solid")) options.Solid = true;
+		else if (isArgMatched(i, "res") && hasNextArgValue(i)) options.Resolution = stoul(argv[++i]);
+		else if (isArgMatched(i, "tile") && hasNextArgValue(i)) options.TileSize = stoul(argv[++i]);
+		else if (isArgMatched(i, "render") && hasNextArgValue(i)) options.RenderSize = stoul(argv[++i]);
+		else if (isArgMatched(i, "budget") && hasNextArgValue(i)) options.MemoryBudget = stoull(argv[++i]) << 20;
+		else if (isArgMatched(i, "ids") && hasNextArgValue(i))
+		{
+			const auto idBits = stoul(argv[++i]);
+			if (idBits != 16 && idBits != 32) return false;
+			options.IDBits = static_cast<uint8_t>(idBits);
+		}
+		else if (isArgMatched(i, "jobs") && hasNextArgValue(i)) options.NumJobs = (max)(stoul(argv[++i]), 1ul);
+		else if (isArgMatched(i, "threads") && hasNextArgValue(i)) options.NumThreads = stoul(argv[++i]);
+		else if (isArgMatched(i, "out") && hasNextArgValue(i)) options.OutputDir = argv[++i];
+		else if (isArgMatched(i, "trace") && hasNextArgValue(i)) options.TraceFileName = argv[++i];
+		else if (isArgMatched(i, "method") && hasNextArgValue(i))
+		{
+			options.VoxMethod = static_cast<Method>(findName(g_methodNames, NUM_METHOD, argv[++i]));
+			if (options.VoxMethod >= NUM_METHOD) return false;
+		}
+		else if (isArgMatched(i, "format") && hasNextArgValue(i))
+		{
+			options.OutputFormat = static_cast<Format>(findName(g_formatNames, NUM_FORMAT, argv[++i]));
+			if (options.OutputFormat >= NUM_FORMAT) return false;
+		}
+		else if (argv[i][0] == '-') return false;
+		else options.MeshFileNames.emplace_back(argv[i]);
+	}
+
+	if (options.MeshFileNames.empty()) return false;
+
+	const auto maxResolution = options.TileSize ? g_maxTiledResolution : g_maxResolution;
+	if (options.Resolution == 0 || (options.Resolution & (options.Resolution - 1)) || options.Resolution > maxResolution)
+	{
+		cerr << "error: -res must be a power of 2 up to " << g_maxResolution << ", or " <<
+			g_maxTiledResolution << " with -tile" << endl;
+
+		return false;
+	}
+
+	// The chunked file, which the tiles are written into, holds whole chunks
+	if ((options.OutputFormat == FORMAT_CHUNKED || options.TileSize) &&
+		(options.Resolution % g_chunkSize || options.TileSize % g_chunkSize))
+	{
+		cerr << "error: -res and -tile must be multiples of " << g_chunkSize << " for chunked and -tile" << endl;
+
+		return false;
+	}
+
+	// The tiles hold level 0 only, without the fill or the IDs, and are never in memory as a whole
+	if (options.TileSize && ((options.OutputFormat != FORMAT_CHUNKED && !isStreamedFormat(options.OutputFormat)) ||
+		options.Solid || options.IDBits || options.RenderSize)) return false;
+	if (options.NumThreads == 0) options.NumThreads = (max)(GetNumWorkerThreads() / options.NumJobs, 1u);
+
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	try
+	{
+		if (!ParseCommandLineArgs(options, argv, argc))
+		{
+			PrintUsage(argv[0]);
+
+			return 1;
+		}
+	}
+	catch (const exception&)
+	{
+		PrintUsage(argv[0]);
+
+		return 1;
+	}
+
+	cout << "Voxelizing " << options.MeshFileNames.size() << " mesh(es) at " << options.Resolution << "^3, "
+		<< g_methodNames[options.VoxMethod] << (options.Solid ? ", solid" : ", surface") << ", "
+		<< options.NumJobs << " job(s) x " << options.NumThreads << " thread(s)" << endl;
+
+	auto& profiler = Profiler::GetDefault();
+	profiler.SetEnabled(!options.TraceFileName.empty());
+
+	// Bounded worker pool of the jobs, each running the CPU engine with its own threads
+	const auto numMeshes = static_cast<uint32_t>(options.MeshFileNames.size());
+	vector<Result> results(numMeshes);
+	mutex outputMutex;
+	const auto start = chrono::steady_clock::now();
+	ParallelFor(0, numMeshes, [&](uint32_t i)
+	{
+		// A job running out of memory fails alone, and the others go on
+		try
+		{
+			results[i] = ProcessMesh(options, options.MeshFileNames[i], i);
+		}
+		catch (const bad_alloc&)
+		{
+			results[i] = Result();
+			results[i].Error = "out of memory at " + to_string(options.Resolution) + "^3";
+		}
+
+		const auto& result = results[i];
+		const auto totalTime = result.LoadTime + result.VoxelizeTime + result.FillTime + result.RenderTime + result.ExportTime;
+		stringstream line;
+		line << fixed << setprecision(2) << options.MeshFileNames[i] << ": ";
+		if (result.Succeeded)
+		{
+			line << result.NumTriangles << " triangles, " << result.NumOccupied << " voxels | load "
+				<< result.LoadTime << " ms, voxelize " << result.VoxelizeTime << " ms, fill "
+				<< result.FillTime << " ms, render " << result.RenderTime << " ms, export "
+				<< result.ExportTime << " ms, total " << totalTime << " ms";
+			const auto& stats = result.RenderStats;
+			if (options.RenderSize)
+				line << "\n  ray cast: " << stats.NumRays << " rays, " << stats.NumSteps << " steps, "
+					<< stats.NumSamples << " samples, " << stats.NumLightSteps << " light steps, "
+					<< stats.NumLightSamples << " light samples, " << stats.NumSkips << " skips";
+		}
+		else line << "error: " << result.Error;
+
+		lock_guard<mutex> lock(outputMutex);
+		cout << line.str() << endl;
+	}, options.NumJobs);
+
+	const auto wallTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	const auto numFailed = count_if(results.cbegin(), results.cend(), [](const Result& r) { return !r.Succeeded; });
+	cout << fixed << setprecision(2) << numMeshes - numFailed << " succeeded, " << numFailed
+		<< " failed, wall time " << wallTime << " ms" << endl;
+
+	if (profiler.IsEnabled())
+	{
+		ProfileStats stats;
+		for (const auto& name : profiler.GetScopeNames())
+			if (profiler.GetStats(name.c_str(), stats))
+				cout << name << ": " << stats.NumSamples << " sample(s), min " << stats.Min << " ms, avg "
+					<< stats.Avg << " ms, p99 " << stats.P99 << " ms" << endl;
+
+		if (!profiler.WriteChromeTrace(options.TraceFileName.c_str()))
+		{
+			cerr << "error: failed to write " << options.TraceFileName << endl;
+
+			return 2;
+		}
+	}
+
+	return numFailed ? 2 : 0;
+}
@@ -0,0 +1,9 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+// stdafx.h : the portable counterpart of the app's precompiled header.
+
+#pragma once
+
+#include "PortableCRT.h"
@@ -0,0 +1,1613 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "PortableCRT.h"
+#include <array>
+#include <bitset>
+#include <cfloat>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include "XUSGObjLoader.h"
+#include "ParallelFor.h"
+#include "CPUBoxList.h"
+#include "CPUClipmapVoxelizer.h"
+#include "CPUDistanceField.h"
+#include "CPUDynamicVoxelizer.h"
+#include "CPUGreedyMesher.h"
+#include "CPUIncrementalVoxelizer.h"
+#include "CPUMarchingCubes.h"
+#include "CPURayCaster.h"
+#include "CPUSceneVoxelizer.h"
+#include "CPUTiledVoxelizer.h"
+#include "VoxelBits.h"
+#include "VoxelColumns.h"
+#include "VoxelExporter.h"
+
+using namespace std;
+
+//--------------------------------------------------------------------------------------
+// Correctness and accuracy of the voxelization methods against the exact CPU SAT
+// reference (CPUVoxelizer on a single thread). Each case is a function of the fixture of
+// a mesh at a resolution, i.e. the reference and the exact inside of level 0 by the ray
+// parity along Z through the voxel centers, which builds its own inputs, and returns its
+// surface, optionally its solid, and whether any of its exact checks failed. The driver
+// scores the outcome of each case against the fixture: normals are compared after the
+// R10G10B10A2 decode, in the voxels set by both. A case scores a subset of the metrics,
+// and the others read as 0, where only the cases of a solid fill score the fill metrics,
+// with the solid defaulting to the normal rule of CSFillSolid (CPUVoxelizer::FillSolid)
+// applied to the surface. Metrics are checked against a
+// baseline file, and a case fails when a metric is worse than its baseline by more than
+// the tolerance, or when an exact check fails, regardless of the baseline.
+//--------------------------------------------------------------------------------------
+enum Metric : uint8_t
+{
+	METRIC_MISSED,			// % of the reference surface voxels
+	METRIC_EXTRA,			// % of the reference surface voxels
+	METRIC_NORMAL_MEAN,		// Degrees
+	METRIC_NORMAL_P99,		// Degrees
+	METRIC_FILL_MISSED,		// % of the exact inside voxels
+	METRIC_FILL_EXTRA,		// % of the exact inside voxels
+
+	NUM_METRIC
+};
+
+const char* g_metricNames[] = { "missed%", "extra%", "nrm_mean", "nrm_p99", "fill_missed%", "fill_extra%" };
+
+const uint8_t g_allMetrics = (1 << NUM_METRIC) - 1;
+const uint8_t g_normalMetrics = (1 << METRIC_NORMAL_MEAN) | (1 << METRIC_NORMAL_P99);
+const uint8_t g_fillMetrics = (1 << METRIC_FILL_MISSED) | (1 << METRIC_FILL_EXTRA);
+
+struct Options
+{
+	vector<string> MeshFileNames;
+	vector<uint32_t> Resolutions;
+	string BaselineFileName;
+	float Tolerance;		// Relative to the baseline value
+	float AbsTolerance;
+	bool UpdateBaseline;
+};
+
+struct Mesh
+{
+	string Name;
+	const uint8_t* pVertices;
+	const uint32_t* pIndices;
+	uint32_t Stride;
+	uint32_t NumVertices;
+	uint32_t NumIndices;
+	float Bound[4];
+};
+
+//--------------------------------------------------------------------------------------
+// Inputs shared by the cases of a mesh at a resolution
+//--------------------------------------------------------------------------------------
+struct Fixture
+{
+	const Mesh* pMesh;
+	uint32_t Resolution;
+	VoxelGrid Reference;
+	vector<uint8_t> Inside;
+};
+
+//--------------------------------------------------------------------------------------
+// Output of a case: the surface and the solid of level 0 at the resolution of the
+// fixture, scored by the metrics of the mask, which has no fill metrics by default. With
+// them, the solid is left empty for the fill of the surface by the driver.
+//--------------------------------------------------------------------------------------
+struct Outcome
+{
+	VoxelGrid Surface;
+	VoxelGrid Solid;
+	uint8_t MetricMask;
+	bool Mismatched;
+};
+
+using Baseline = map<string, array<double, NUM_METRIC>>;
+
+namespace
+{
+	const double g_pi = 3.14159265358979323846;
+
+	bool isOccupied(uint32_t voxel)
+	{
+		return (voxel & VoxelGrid::CoverageMask) != 0;
+	}
+
+	void writeVoxel(VoxelGrid& grid, int x, int y, int z, uint32_t voxel)
+	{
+		const auto size = static_cast<int>(grid.GetSize());
+		if (x < 0 || y < 0 || z < 0 || x >= size || y >= size || z >= size) return;	// Discarded UAV writes
+
+		auto& dst = grid.GetData()[(static_cast<size_t>(z) * size + y) * size + x];
+		dst = (max)(dst, voxel);
+	}
+
+	void normalize(float v[3])
+	{
+		const auto len = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		if (len > 0.0f) for (uint8_t i = 0; i < 3; ++i) v[i] /= len;
+	}
+
+	//----------------------------------------------------------------------------------
+	// Signed volume enclosed by the triangles of the mesh, which is positive for outward
+	// triangles, their total area, and the number of them facing away from their vertex
+	// normals, all in model space
+	//----------------------------------------------------------------------------------
+	void measureMesh(const VoxelMesh& mesh, double& volume, double& area, size_t& numFlipped)
+	{
+		const auto& vertices = mesh.GetVertices();
+		const auto& indices = mesh.GetIndices();
+		volume = area = 0.0;
+		numFlipped = 0;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			const VoxelMesh::Vertex* v[] = { &vertices[indices[i]], &vertices[indices[i + 1]], &vertices[indices[i + 2]] };
+			double e[2][3], c[3];
+			for (uint8_t j = 0; j < 3; ++j)
+			{
+				e[0][j] = static_cast<double>(v[1]->Pos[j]) - v[0]->Pos[j];
+				e[1][j] = static_cast<double>(v[2]->Pos[j]) - v[0]->Pos[j];
+			}
+			for (uint8_t j = 0; j < 3; ++j) c[j] = e[0][(j + 1) % 3] * e[1][(j + 2) % 3] - e[0][(j + 2) % 3] * e[1][(j + 1) % 3];
+
+			auto nDotC = 0.0;
+			for (uint8_t j = 0; j < 3; ++j)
+			{
+				volume += v[0]->Pos[j] * c[j] / 6.0;
+				nDotC += (v[0]->Nrm[j] + v[1]->Nrm[j] + v[2]->Nrm[j]) * c[j];
+			}
+			area += sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]) / 2.0;
+			if (nDotC < 0.0) ++numFlipped;
+		}
+	}
+
+	//----------------------------------------------------------------------------------
+	// Unsigned distance from p to the triangle, to its plane where p projects inside it,
+	// and to the closest of its edges otherwise
+	//----------------------------------------------------------------------------------
+	double distanceToTriangle(const double p[3], const double v[3][3])
+	{
+		const auto dot = [](const double a[3], const double b[3]) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; };
+		const auto cross = [](double r[3], const double a[3], const double b[3])
+		{
+			for (uint8_t i = 0; i < 3; ++i) r[i] = a[(i + 1) % 3] * b[(i + 2) % 3] - a[(i + 2) % 3] * b[(i + 1) % 3];
+		};
+
+		double e[3][3], d[3][3], n[3], c[3];
+		for (uint8_t i = 0; i < 3; ++i)
+			for (uint8_t j = 0; j < 3; ++j)
+			{
+				e[i][j] = v[(i + 1) % 3][j] - v[i][j];
+				d[i][j] = p[j] - v[i][j];
+			}
+		cross(n, e[0], e[1]);
+
+		auto isInside = dot(n, n) > 0.0;
+		for (uint8_t i = 0; i < 3 && isInside; ++i)
+		{
+			cross(c, e[i], d[i]);
+			isInside = dot(c, n) >= 0.0;
+		}
+		if (isInside) return abs(dot(d[0], n)) / sqrt(dot(n, n));
+
+		auto distSq = DBL_MAX;
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			const auto len = dot(e[i], e[i]);
+			const auto t = len > 0.0 ? (min)((max)(dot(d[i], e[i]) / len, 0.0), 1.0) : 0.0;
+			for (uint8_t j = 0; j < 3; ++j) c[j] = d[i][j] - t * e[i][j];
+			distSq = (min)(distSq, dot(c, c));
+		}
+
+		return sqrt(distSq);
+	}
+
+	//----------------------------------------------------------------------------------
+	// Rasterize a projected triangle at the pixel centers of an N x N viewport, where q
+	// are the clip-space positions of the view, and t and n the TexLoc and the normal
+	// at the vertices. Pixels pass the inclusive edge test, and the attributes are
+	// interpolated linearly, as w is 1.
+	//----------------------------------------------------------------------------------
+	template<typename Func>
+	void rasterize(uint32_t size, const float q[3][2], const float t[3][3], const float n[3][3], const Func& write)
+	{
+		const auto fSize = static_cast<float>(size);
+		float s[3][2];
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			s[i][0] = (q[i][0] * 0.5f + 0.5f) * fSize;
+			s[i][1] = (0.5f - q[i][1] * 0.5f) * fSize;
+		}
+
+		const auto area = (s[1][0] - s[0][0]) * (s[2][1] - s[0][1]) - (s[2][0] - s[0][0]) * (s[1][1] - s[0][1]);
+		if (area == 0.0f || !isfinite(area)) return;
+
+		const auto x0 = (max)(static_cast<int>(floor((min)(s[0][0], (min)(s[1][0], s[2][0])) - 0.5f)), 0);
+		const auto x1 = (min)(static_cast<int>(ceil((max)(s[0][0], (max)(s[1][0], s[2][0])) - 0.5f)), static_cast<int>(size) - 1);
+		const auto y0 = (max)(static_cast<int>(floor((min)(s[0][1], (min)(s[1][1], s[2][1])) - 0.5f)), 0);
+		const auto y1 = (min)(static_cast<int>(ceil((max)(s[0][1], (max)(s[1][1], s[2][1])) - 0.5f)), static_cast<int>(size) - 1);
+
+		for (auto y = y0; y <= y1; ++y)
+		{
+			for (auto x = x0; x <= x1; ++x)
+			{
+				const float p[] = { x + 0.5f, y + 0.5f };
+				float w[3];
+				for (uint8_t i = 0; i < 3; ++i)
+				{
+					const auto& a = s[(i + 1) % 3];
+					const auto& b = s[(i + 2) % 3];
+					w[i] = ((b[0] - a[0]) * (p[1] - a[1]) - (p[0] - a[0]) * (b[1] - a[1])) / area;
+				}
+				if (w[0] < 0.0f || w[1] < 0.0f || w[2] < 0.0f) continue;
+
+				float texLoc[3], nrm[3];
+				for (uint8_t i = 0; i < 3; ++i)
+				{
+					texLoc[i] = w[0] * t[0][i] + w[1] * t[1][i] + w[2] * t[2][i];
+					nrm[i] = w[0] * n[0][i] + w[1] * n[1][i] + w[2] * n[2][i];
+				}
+
+				write(p, texLoc, nrm);
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Software model of the GPU surface voxelization
+//--------------------------------------------------------------------------------------
+void VoxelizeGPUModel(VoxelGrid& grid, const Mesh& mesh, bool isUnion)
+{
+	const auto size = grid.GetSize();
+	const auto fSize = static_cast<float>(size);
+	const auto& bound = mesh.Bound;
+
+	const auto writeTexLoc = [&](const float texLoc[3], float nrm[3])
+	{
+		// uint3(TexLoc * g_gridSize) truncates toward zero
+		normalize(nrm);
+		writeVoxel(grid, static_cast<int>(texLoc[0] * fSize), static_cast<int>(texLoc[1] * fSize),
+			static_cast<int>(texLoc[2] * fSize), VoxelGrid::Pack(nrm[0], nrm[1], nrm[2]));
+	};
+
+	const auto numTriangles = mesh.NumIndices / 3;
+	for (auto t = 0u; t < numTriangles; ++t)
+	{
+		float pos[3][3], nrm[3][3], texLoc[3][3];
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			float attribs[6];
+			memcpy(attribs, &mesh.pVertices[static_cast<size_t>(mesh.pIndices[t * 3 + i]) * mesh.Stride], sizeof(attribs));
+			for (uint8_t j = 0; j < 3; ++j)
+			{
+				pos[i][j] = (attribs[j] - bound[j]) / bound[3];
+				nrm[i][j] = attribs[3 + j];
+				texLoc[i][j] = pos[i][j] * 0.5f + 0.5f;
+			}
+			texLoc[i][1] = 1.0f - texLoc[i][1];
+		}
+
+		// Views xy, yz and zx
+		const uint8_t views[3][2] = { { 0, 1 }, { 1, 2 }, { 2, 0 } };
+		if (isUnion)
+		{
+			for (const auto& view : views)
+			{
+				const float q[3][2] = { { pos[0][view[0]], pos[0][view[1]] },
+					{ pos[1][view[0]], pos[1][view[1]] }, { pos[2][view[0]], pos[2][view[1]] } };
+				rasterize(size, q, texLoc, nrm, [&](const float*, const float* tl, const float* n)
+				{
+					float nn[] = { n[0], n[1], n[2] };
+					writeTexLoc(tl, nn);
+				});
+			}
+
+			continue;
+		}
+
+		// PrimSize and Project of HSTriProj
+		float e1[3], e2[3];
+		for (uint8_t j = 0; j < 3; ++j)
+		{
+			e1[j] = pos[1][j] - pos[0][j];
+			e2[j] = pos[2][j] - pos[1][j];
+		}
+		const auto sizeXY = fabs(e1[0] * e2[1] - e1[1] * e2[0]);
+		const auto sizeYZ = fabs(e1[1] * e2[2] - e1[2] * e2[1]);
+		const auto sizeZX = fabs(e1[2] * e2[0] - e1[0] * e2[2]);
+		const auto& view = sizeXY > sizeYZ ? (sizeXY > sizeZX ? views[0] : views[2]) :
+			(sizeYZ > sizeZX ? views[1] : views[2]);
+
+		float q[3][2];
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			q[i][0] = pos[i][view[0]];
+			q[i][1] = pos[i][view[1]];
+		}
+
+		// Extrapolation of DSMain, by CONSERVATION_AMT pixels away from the centroid
+		const auto amount = (1.0f / 3.0f) / (0.5f * fSize);
+		const float centroid[] = { (q[0][0] + q[1][0] + q[2][0]) / 3.0f, (q[0][1] + q[1][1] + q[2][1]) / 3.0f };
+		float qx[3][2], tx[3][3], nx[3][3];
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			const auto dist = hypot(q[i][0] - centroid[0], q[i][1] - centroid[1]);
+			float domain[3];
+			for (uint8_t j = 0; j < 3; ++j) domain[j] = (i == j ? 1.0f : 0.0f) + amount * ((i == j ? 1.0f : 0.0f) - 1.0f / 3.0f) / dist;
+
+			for (uint8_t j = 0; j < 2; ++j) qx[i][j] = domain[0] * q[0][j] + domain[1] * q[1][j] + domain[2] * q[2][j];
+			for (uint8_t j = 0; j < 3; ++j)
+			{
+				tx[i][j] = domain[0] * texLoc[0][j] + domain[1] * texLoc[1][j] + domain[2] * texLoc[2][j];
+				nx[i][j] = domain[0] * nrm[0][j] + domain[1] * nrm[1][j] + domain[2] * nrm[2][j];
+			}
+		}
+
+		// Projected AABB of the original triangle in pixels, with Y flipped
+		const auto minX = (min)(q[0][0], (min)(q[1][0], q[2][0]));
+		const auto maxX = (max)(q[0][0], (max)(q[1][0], q[2][0]));
+		const auto minY = (min)(q[0][1], (min)(q[1][1], q[2][1]));
+		const auto maxY = (max)(q[0][1], (max)(q[1][1], q[2][1]));
+		const float aabb[] =
+		{
+			(minX * 0.5f + 0.5f) * fSize,
+			(1.0f - (maxY * 0.5f + 0.5f)) * fSize,
+			(maxX * 0.5f + 0.5f) * fSize,
+			(1.0f - (minY * 0.5f + 0.5f)) * fSize
+		};
+
+		rasterize(size, qx, tx, nx, [&](const float* p, const float* tl, const float* n)
+		{
+			if (p[0] + 1.0f > aabb[0] && p[1] + 1.0f > aabb[1] && p[0] < aabb[2] + 1.0f && p[1] < aabb[3] + 1.0f)
+			{
+				float nn[] = { n[0], n[1], n[2] };
+				writeTexLoc(tl, nn);
+			}
+		});
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Vertices of the mesh with the part beyond half the bound radius along +X swinging
+// along Y by a wave of the frame, as a limb of a character, where frame 0 is the rest
+//--------------------------------------------------------------------------------------
+void DeformMesh(const Mesh& mesh, uint32_t frame, vector<uint8_t>& vertices)
+{
+	vertices.assign(mesh.pVertices, mesh.pVertices + static_cast<size_t>(mesh.NumVertices) * mesh.Stride);
+	if (frame == 0) return;
+
+	const auto r = mesh.Bound[3];
+	for (auto i = 0u; i < mesh.NumVertices; ++i)
+	{
+		float p[3];
+		const auto pVertex = &vertices[static_cast<size_t>(i) * mesh.Stride];
+		memcpy(p, pVertex, sizeof(p));
+
+		const auto d = p[0] - mesh.Bound[0] - 0.5f * r;
+		if (d <= 0.0f) continue;
+
+		p[1] += 0.5f * d * sin(0.4f * frame + 4.0f * d / r);
+		memcpy(pVertex, p, sizeof(p));
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Exact inside of level 0 by the parity of the crossings of the surface along Z through
+// the voxel centers, slightly offset off the voxel centers to stay clear of the edges
+//--------------------------------------------------------------------------------------
+vector<uint8_t> ComputeInside(const Mesh& mesh, uint32_t size)
+{
+	const auto scale = 0.5f * size / mesh.Bound[3];
+	const double offset[] = { 1.234567e-4, 2.345678e-4 };
+	vector<vector<float>> columns(static_cast<size_t>(size) * size);
+
+	const auto numTriangles = mesh.NumIndices / 3;
+	for (auto t = 0u; t < numTriangles; ++t)
+	{
+		double v[3][3];
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			float p[3];
+			memcpy(p, &mesh.pVertices[static_cast<size_t>(mesh.pIndices[t * 3 + i]) * mesh.Stride], sizeof(p));
+			v[i][0] = (p[0] - mesh.Bound[0]) * scale + 0.5 * size;
+			v[i][1] = (mesh.Bound[1] - p[1]) * scale + 0.5 * size;
+			v[i][2] = (p[2] - mesh.Bound[2]) * scale + 0.5 * size;
+		}
+
+		const auto area = (v[1][0] - v[0][0]) * (v[2][1] - v[0][1]) - (v[2][0] - v[0][0]) * (v[1][1] - v[0][1]);
+		if (area == 0.0) continue;
+
+		const auto x0 = (max)(static_cast<int>(floor((min)(v[0][0], (min)(v[1][0], v[2][0])) - 0.5)), 0);
+		const auto x1 = (min)(static_cast<int>(ceil((max)(v[0][0], (max)(v[1][0], v[2][0])))), static_cast<int>(size) - 1);
+		const auto y0 = (max)(static_cast<int>(floor((min)(v[0][1], (min)(v[1][1], v[2][1])) - 0.5)), 0);
+		const auto y1 = (min)(static_cast<int>(ceil((max)(v[0][1], (max)(v[1][1], v[2][1])))), static_cast<int>(size) - 1);
+		for (auto y = y0; y <= y1; ++y)
+		{
+			for (auto x = x0; x <= x1; ++x)
+			{
+				const double p[] = { x + 0.5 + offset[0], y + 0.5 + offset[1] };
+				double w[3];
+				for (uint8_t i = 0; i < 3; ++i)
+				{
+					const auto& a = v[(i + 1) % 3];
+					const auto& b = v[(i + 2) % 3];
+					w[i] = ((b[0] - a[0]) * (p[1] - a[1]) - (p[0] - a[0]) * (b[1] - a[1])) / area;
+				}
+				if (w[0] < 0.0 || w[1] < 0.0 || w[2] < 0.0) continue;
+
+				columns[static_cast<size_t>(y) * size + x].emplace_back(static_cast<float>(w[0] * v[0][2] + w[1] * v[1][2] + w[2] * v[2][2]));
+			}
+		}
+	}
+
+	vector<uint8_t> inside(static_cast<size_t>(size) * size * size, 0);
+	for (auto y = 0u; y < size; ++y)
+	{
+		for (auto x = 0u; x < size; ++x)
+		{
+			auto& column = columns[static_cast<size_t>(y) * size + x];
+			sort(column.begin(), column.end());
+			for (size_t i = 0; i + 1 < column.size(); i += 2)
+			{
+				const auto z0 = (max)(static_cast<int>(ceil(column[i] - 0.5f)), 0);
+				const auto z1 = (min)(static_cast<int>(floor(column[i + 1] - 0.5f)), static_cast<int>(size) - 1);
+				for (auto z = z0; z <= z1; ++z) inside[(static_cast<size_t>(z) * size + y) * size + x] = 1;
+			}
+		}
+	}
+
+	return inside;
+}
+
+//--------------------------------------------------------------------------------------
+// Metrics of a surface grid and its solid fill against the reference
+//--------------------------------------------------------------------------------------
+array<double, NUM_METRIC> Compare(const VoxelGrid& grid, const VoxelGrid& solid,
+	const VoxelGrid& reference, const vector<uint8_t>& inside)
+{
+	const auto numVoxels = reference.GetNumVoxels();
+	const auto pData = grid.GetData();
+	const auto pSolid = solid.GetData();
+	const auto pRef = reference.GetData();
+
+	size_t numRef = 0, numMissed = 0, numExtra = 0, numInside = 0, numFillMissed = 0, numFillExtra = 0;
+	vector<float> angles;
+	for (size_t i = 0; i < numVoxels; ++i)
+	{
+		const auto occupied = isOccupied(pData[i]);
+		const auto refOccupied = isOccupied(pRef[i]);
+		numRef += refOccupied ? 1 : 0;
+		numMissed += refOccupied && !occupied ? 1 : 0;
+		numExtra += occupied && !refOccupied ? 1 : 0;
+
+		if (occupied && refOccupied && pData[i] == pRef[i]) angles.emplace_back(0.0f);
+		else if (occupied && refOccupied)
+		{
+			float n[3], r[3], coverage;
+			VoxelGrid::Unpack(pData[i], n[0], n[1], n[2], coverage);
+			VoxelGrid::Unpack(pRef[i], r[0], r[1], r[2], coverage);
+			normalize(n);
+			normalize(r);
+			const auto cosAngle = (max)(-1.0f, (min)(n[0] * r[0] + n[1] * r[1] + n[2] * r[2], 1.0f));
+			angles.emplace_back(static_cast<float>(acos(cosAngle) * 180.0 / g_pi));
+		}
+
+		// Fill: the inside voxels left empty, and the voxels filled outside of the surface
+		if (inside[i] && !refOccupied)
+		{
+			++numInside;
+			numFillMissed += isOccupied(pSolid[i]) ? 0 : 1;
+		}
+		else if (!inside[i] && !refOccupied && !occupied && isOccupied(pSolid[i])) ++numFillExtra;
+	}
+
+	array<double, NUM_METRIC> metrics = {};
+	metrics[METRIC_MISSED] = numRef ? 100.0 * numMissed / numRef : 0.0;
+	metrics[METRIC_EXTRA] = numRef ? 100.0 * numExtra / numRef : 0.0;
+	metrics[METRIC_FILL_MISSED] = numInside ? 100.0 * numFillMissed / numInside : 0.0;
+	metrics[METRIC_FILL_EXTRA] = numInside ? 100.0 * numFillExtra / numInside : 0.0;
+	if (!angles.empty())
+	{
+		double sum = 0.0;
+		for (const auto& angle : angles) sum += angle;
+		metrics[METRIC_NORMAL_MEAN] = sum / angles.size();
+
+		const auto rank = (angles.size() * 99 + 99) / 100 - 1;
+		nth_element(angles.begin(), angles.begin() + rank, angles.end());
+		metrics[METRIC_NORMAL_P99] = angles[rank];
+	}
+
+	return metrics;
+}
+
+bool LoadBaseline(const string& fileName, Baseline& baseline)
+{
+	ifstream file(fileName);
+	if (!file) return false;
+
+	for (string line; getline(file, line);)
+	{
+		if (line.empty() || line[0] == '#') continue;
+
+		stringstream ss(line);
+		string name;
+		array<double, NUM_METRIC> metrics;
+		ss >> name;
+		for (auto& metric : metrics) ss >> metric;
+		if (ss) baseline[name] = metrics;
+	}
+
+	return true;
+}
+
+bool WriteBaseline(const string& fileName, const Baseline& baseline)
+{
+	ofstream file(fileName);
+	if (!file) return false;
+
+	file << "# case";
+	for (const auto& name : g_metricNames) file << " " << name;
+	file << "\n" << fixed << setprecision(4);
+	for (const auto& entry : baseline)
+	{
+		file << entry.first;
+		for (const auto& metric : entry.second) file << " " << metric;
+		file << "\n";
+	}
+
+	return file.good();
+}
+
+void PrintUsage(const char* appName)
+{
+	cout << "Usage: " << appName << " [options] [mesh.obj ...]\n"
+		"  -res <list>        grid resolutions (default 64,128)\n"
+		"  -baseline <file>   metrics to check against\n"
+		"  -update            write the metrics to the baseline file instead of checking\n"
+		"  -tolerance <r>     allowed relative regression over the baseline (default 0.05)\n"
+		"  -abstolerance <a>  allowed absolute regression over the baseline (default 0.05)\n"
+		"Meshes default to the bunny, dragon and TuringBowl in Assets.\n";
+}
+
+bool ParseCommandLineArgs(Options& options, char* argv[], int argc)
+{
+	const auto str_tolower = [](string s)
+	{
+		transform(s.begin(), s.end(), s.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+
+		return s;
+	};
+
+	const auto isArgMatched = [&argv, &str_tolower](int i, const char* paramName)
+	{
+		const auto& arg = argv[i];
+
+		return (arg[0] == '-' || arg[0] == '/') && str_tolower(&arg[1]) == str_tolower(paramName);
+	};
+
+	const auto hasNextArgValue = [&argv, &argc](int i)
+	{
+		return i + 1 < argc && argv[i + 1][0] != '-';
+	};
+
+	options.Resolutions = { 64, 128 };
+	options.Tolerance = 0.05f;
+	options.AbsTolerance = 0.05f;
+	options.UpdateBaseline = false;
+
+	for (auto i = 1; i < argc; ++i)
+	{
+		if (isArgMatched(i, "update")) options.UpdateBaseline = true;
+		else if (isArgMatched(i, "baseline") && hasNextArgValue(i)) options.BaselineFileName = argv[++i];
+		else if (isArgMatched(i, "tolerance") && hasNextArgValue(i)) options.Tolerance = stof(argv[++i]);
+		else if (isArgMatched(i, "abstolerance") && hasNextArgValue(i)) options.AbsTolerance = stof(argv[++i]);
+		else if (isArgMatched(i, "res") && hasNextArgValue(i))
+		{
+			options.Resolutions.clear();
+			stringstream ss(argv[++i]);
+			for (string value; getline(ss, value, ',');) options.Resolutions.emplace_back(stoul(value));
+		}
+		else if (argv[i][0] == '-') return false;
+		else options.MeshFileNames.emplace_back(argv[i]);
+	}
+
+	if (options.MeshFileNames.empty())
+		options.MeshFileNames = { "Assets/bunny.obj", "Assets/dragon.obj", "Assets/TuringBowl.obj" };
+
+	if (options.UpdateBaseline && options.BaselineFileName.empty()) return false;
+
+	return !options.Resolutions.empty() && none_of(options.Resolutions.cbegin(),
+		options.Resolutions.cend(), [](uint32_t n) { return n == 0; });
+}
+
+//--------------------------------------------------------------------------------------
+// VSTriProj/PSTriProj: the view of max projected area, with the vertices pushed 1/3 pixel
+// away from the centroid as DSTriProj, and the writes clipped to the projected AABB
+// widened by a pixel. The tessellation path (tess) runs the same math through the HS/DS
+// stages, so it shares this model.
+//--------------------------------------------------------------------------------------
+void TestTriProj(const Fixture& fixture, Outcome& outcome)
+{
+	outcome.Surface.Create(fixture.Resolution);
+	VoxelizeGPUModel(outcome.Surface, *fixture.pMesh, false);
+	outcome.MetricMask = g_allMetrics;	// The solid mode fills it by CSFillSolid
+}
+
+//--------------------------------------------------------------------------------------
+// VSTriProjUnion/PSTriProjUnion: all the 3 axis views, not conservative
+//--------------------------------------------------------------------------------------
+void TestUnion(const Fixture& fixture, Outcome& outcome)
+{
+	outcome.Surface.Create(fixture.Resolution);
+	VoxelizeGPUModel(outcome.Surface, *fixture.pMesh, true);
+	outcome.MetricMask = g_allMetrics;
+}
+
+//--------------------------------------------------------------------------------------
+// CPUVoxelizer on several threads, which must match the reference exactly
+//--------------------------------------------------------------------------------------
+void TestCPUMT(const Fixture& fixture, Outcome& outcome)
+{
+	const auto& mesh = *fixture.pMesh;
+	CPUVoxelizer voxelizer;
+	auto& grid = outcome.Surface;
+	grid.Create(fixture.Resolution);
+	voxelizer.Voxelize(grid, mesh.pVertices, mesh.Stride, mesh.pIndices, mesh.NumIndices, mesh.Bound, 4);
+	outcome.Mismatched = memcmp(grid.GetData(), fixture.Reference.GetData(), sizeof(uint32_t) * grid.GetNumVoxels()) != 0;
+}
+
+//--------------------------------------------------------------------------------------
+// The normal rule of CSFillSolid along Z on the exact surface, as VoxelizerCLI -solid
+//--------------------------------------------------------------------------------------
+void TestFillParity(const Fixture& fixture, Outcome& outcome)
+{
+	const auto& mesh = *fixture.pMesh;
+	CPUVoxelizer voxelizer;
+	outcome.Surface.Create(fixture.Resolution);
+	voxelizer.Voxelize(outcome.Surface, mesh.pVertices, mesh.Stride, mesh.pIndices, mesh.NumIndices, mesh.Bound, 4);
+	outcome.MetricMask = g_fillMetrics;
+}
+
+//--------------------------------------------------------------------------------------
+// The majority vote of the parities along X, Y, and Z (CSFillSolidVote) on the exact
+// surface, whose fill must have no more extra voxels than the Z parity alone, where a
+// single leak along Z floods the rest of its column
+//--------------------------------------------------------------------------------------
+void TestFillVote(const Fixture& fixture, Outcome& outcome)
+{
+	const auto& mesh = *fixture.pMesh;
+	CPUVoxelizer voxelizer;
+	VoxelGrid parityZ;
+	outcome.Surface.Create(fixture.Resolution);
+	outcome.Solid.Create(fixture.Resolution);
+	parityZ.Create(fixture.Resolution);
+	voxelizer.Voxelize(outcome.Surface, mesh.pVertices, mesh.Stride, mesh.pIndices, mesh.NumIndices, mesh.Bound, 4);
+	memcpy(outcome.Solid.GetData(), outcome.Surface.GetData(), sizeof(uint32_t) * outcome.Solid.GetNumVoxels());
+	memcpy(parityZ.GetData(), outcome.Surface.GetData(), sizeof(uint32_t) * parityZ.GetNumVoxels());
+	voxelizer.FillSolid(outcome.Solid, 4, CPUVoxelizer::FILL_VOTE_XYZ);
+	voxelizer.FillSolid(parityZ, 4);
+
+	const auto& inside = fixture.Inside;
+	outcome.Mismatched = Compare(outcome.Surface, outcome.Solid, fixture.Reference, inside)[METRIC_FILL_EXTRA] >
+		Compare(outcome.Surface, parityZ, fixture.Reference, inside)[METRIC_FILL_EXTRA];
+	outcome.MetricMask = g_fillMetrics;
+}
+
+//--------------------------------------------------------------------------------------
+// The pyramid written directly by CPUVoxelizer, which must match the coverage of
+// VoxelGrid::GenerateMips on level 0 exactly. The interior of the solid fill has no
+// normal, so the normals of level 1 must not change by filling level 0 before reducing.
+//--------------------------------------------------------------------------------------
+void TestMips(const Fixture& fixture, Outcome& outcome)
+{
+	const auto& mesh = *fixture.pMesh;
+	CPUVoxelizer voxelizer;
+	VoxelGrid reduced;
+	auto& grid = outcome.Surface;
+	grid.Create(fixture.Resolution, 0);
+	reduced.Create(fixture.Resolution, 0);
+	voxelizer.Voxelize(grid, mesh.pVertices, mesh.Stride, mesh.pIndices, mesh.NumIndices, mesh.Bound, 4);
+	memcpy(reduced.GetData(), grid.GetData(), sizeof(uint32_t) * grid.GetNumVoxels());
+	reduced.GenerateMips(4);
+	for (uint8_t i = 1; i < grid.GetNumLevels() && !outcome.Mismatched; ++i)
+		for (size_t j = 0; j < grid.GetNumVoxels(i) && !outcome.Mismatched; ++j)
+			outcome.Mismatched = isOccupied(grid.GetData(i)[j]) != isOccupied(reduced.GetData(i)[j]);
+
+	VoxelGrid filled;
+	filled.Create(fixture.Resolution, 2);
+	memcpy(filled.GetData(), grid.GetData(), sizeof(uint32_t) * grid.GetNumVoxels());
+	voxelizer.FillSolid(filled, 4);
+	filled.GenerateMips(4);
+	for (size_t j = 0; j < filled.GetNumVoxels(1) && !outcome.Mismatched; ++j)
+		outcome.Mismatched = ((filled.GetData(1)[j] ^ reduced.GetData(1)[j]) & ~VoxelGrid::CoverageMask) != 0;
+}
+
+//--------------------------------------------------------------------------------------
+// The same at an odd size that is not a power of 2, where the last voxel along each axis
+// of the odd levels covers 3 children, both for the surface and after the solid fill.
+// Not scored, as the size differs from the reference.
+//--------------------------------------------------------------------------------------
+void TestMipsNPOT(const Fixture& fixture, Outcome& outcome)
+{
+	const auto& mesh = *fixture.pMesh;
+	const auto resolution = fixture.Resolution * 3 / 4 + 3;
+	CPUVoxelizer voxelizer;
+	VoxelGrid grid, reduced;
+	grid.Create(resolution, 0);
+	reduced.Create(resolution, 0);
+	voxelizer.Voxelize(grid, mesh.pVertices, mesh.Stride, mesh.pIndices, mesh.NumIndices, mesh.Bound, 4);
+	for (uint8_t pass = 0; pass < 2 && !outcome.Mismatched; ++pass)
+	{
+		if (pass > 0) voxelizer.FillSolid(grid, 4);
+		memcpy(reduced.GetData(), grid.GetData(), sizeof(uint32_t) * grid.GetNumVoxels());
+		reduced.GenerateMips(4);
+		for (uint8_t i = 1; i < grid.GetNumLevels() && !outcome.Mismatched; ++i)
+			for (size_t j = 0; j < grid.GetNumVoxels(i) && !outcome.Mismatched; ++j)
+				outcome.Mismatched = isOccupied(grid.GetData(i)[j]) != isOccupied(reduced.GetData(i)[j]);
+	}
+
+	outcome.MetricMask = 0;
+}
+
+//--------------------------------------------------------------------------------------
+// CPUIncrementalVoxelizer, after moving the mesh partly out of the grid and back, which
+// must match a full voxelization on all the levels exactly, with its object ID in
+// exactly the occupied voxels of a 32-bit ID channel
+//--------------------------------------------------------------------------------------
+void TestIncremental(const Fixture& fixture, Outcome& outcome)
+{
+	// Moved and turned, unchanged, which must be skipped, moved again, then back
+	const auto& mesh = *fixture.pMesh;
+	const auto& b = mesh.Bound;
+	const auto c = cos(0.3f), s = sin(0.3f);
+	const float transforms[][3][4] =
+	{
+		{ { c, 0.0f, s, b[0] * (1.0f - c) - b[2] * s + 0.2f * b[3] }, { 0.0f, 1.0f, 0.0f, 0.1f * b[3] },
+			{ -s, 0.0f, c, b[0] * s + b[2] * (1.0f - c) } },
+		{ { c, 0.0f, s, b[0] * (1.0f - c) - b[2] * s + 0.2f * b[3] }, { 0.0f, 1.0f, 0.0f, 0.1f * b[3] },
+			{ -s, 0.0f, c, b[0] * s + b[2] * (1.0f - c) } },
+		{ { 1.0f, 0.0f, 0.0f, -0.3f * b[3] }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.05f * b[3] } },
+		{ { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f } }
+	};
+
+	const auto resolution = fixture.Resolution;
+	CPUVoxelizer voxelizer;
+	CPUIncrementalVoxelizer incremental;
+	VoxelGrid full;
+	auto& grid = outcome.Surface;
+	auto& mismatched = outcome.Mismatched;
+	grid.Create(resolution, 0, 32);
+	full.Create(resolution, 0);
+	incremental.SetObjectID(7);
+	incremental.SetMesh(mesh.pVertices, mesh.Stride, mesh.NumVertices,
+		mesh.pIndices, mesh.NumIndices, mesh.Bound);
+	for (size_t i = 0; i < size(transforms); ++i)
+		mismatched = incremental.Update(grid, transforms[i], 4) == (i == 1) || mismatched;
+	voxelizer.Voxelize(full, mesh.pVertices, mesh.Stride, mesh.pIndices, mesh.NumIndices, mesh.Bound, 4);
+	for (uint8_t i = 0; i < grid.GetNumLevels() && !mismatched; ++i)
+		mismatched = memcmp(grid.GetData(i), full.GetData(i), sizeof(uint32_t) * grid.GetNumVoxels(i)) != 0;
+	for (auto z = 0u; z < resolution && !mismatched; ++z)
+		for (auto y = 0u; y < resolution && !mismatched; ++y)
+			for (auto x = 0u; x < resolution && !mismatched; ++x)
+				mismatched = grid.GetID(x, y, z) != (grid.IsOccupied(x, y, z) ? 7 : VoxelGrid::EmptyID);
+}
+
+//--------------------------------------------------------------------------------------
+// CPUDynamicVoxelizer, after deforming a part of the mesh over a few frames, which must
+// match a full voxelization on all the levels exactly
+//--------------------------------------------------------------------------------------
+void TestDynamic(const Fixture& fixture, Outcome& outcome)
+{
+	// Deformed over a few frames, unchanged, which must be skipped, then back
+	const auto& mesh = *fixture.pMesh;
+	CPUVoxelizer voxelizer;
+	CPUDynamicVoxelizer dynamic;
+	VoxelGrid full;
+	auto& grid = outcome.Surface;
+	auto& mismatched = outcome.Mismatched;
+	grid.Create(fixture.Resolution, 0);
+	full.Create(fixture.Resolution, 0);
+	dynamic.SetMesh(mesh.Stride, mesh.NumVertices, mesh.pIndices, mesh.NumIndices, mesh.Bound);
+	const uint32_t frames[] = { 0, 3, 7, 7, 0 };
+	vector<uint8_t> vertices;
+	for (size_t i = 0; i < size(frames); ++i)
+	{
+		DeformMesh(mesh, frames[i], vertices);
+		mismatched = dynamic.Update(grid, vertices.data(), 4) == (i == 3) || mismatched;
+	}
+	voxelizer.Voxelize(full, mesh.pVertices, mesh.Stride, mesh.pIndices, mesh.NumIndices, mesh.Bound, 4);
+	for (uint8_t i = 0; i < grid.GetNumLevels() && !mismatched; ++i)
+		mismatched = memcmp(grid.GetData(i), full.GetData(i), sizeof(uint32_t) * grid.GetNumVoxels(i)) != 0;
+}
+
+//--------------------------------------------------------------------------------------
+// CPUSceneVoxelizer, with the two halves of the triangles as two objects and a third
+// instance out of the grid, which must be culled. The grid must match a full
+// voxelization on all the levels, and each ID of a 16-bit ID channel the lowest of the
+// halves hitting the voxel, exactly.
+//--------------------------------------------------------------------------------------
+void TestScene(const Fixture& fixture, Outcome& outcome)
+{
+	// Halves of the triangles as objects 1 and 2, and the whole mesh moved away as 0
+	const auto& mesh = *fixture.pMesh;
+	const auto numIndices0 = mesh.NumIndices / 6 * 3;
+	const auto numIndices1 = mesh.NumIndices - numIndices0;
+	const auto& b = mesh.Bound;
+	const float identity[3][4] = { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f } };
+	const float away[3][4] = { { 1.0f, 0.0f, 0.0f, 2.5f * b[3] }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f } };
+
+	CPUSceneVoxelizer scene;
+	const auto half0 = scene.AddMesh(mesh.pVertices, mesh.Stride, mesh.NumVertices, mesh.pIndices, numIndices0);
+	const auto half1 = scene.AddMesh(mesh.pVertices, mesh.Stride, mesh.NumVertices, &mesh.pIndices[numIndices0], numIndices1);
+	scene.AddInstance(half0, identity, 1);
+	scene.AddInstance(half1, identity, 2);
+	scene.AddInstance(scene.AddMesh(mesh.pVertices, mesh.Stride, mesh.NumVertices, mesh.pIndices, mesh.NumIndices), away, 0);
+
+	const auto resolution = fixture.Resolution;
+	CPUVoxelizer voxelizer;
+	VoxelGrid full, grid0, grid1;
+	auto& grid = outcome.Surface;
+	auto& mismatched = outcome.Mismatched;
+	grid.Create(resolution, 0, 16);
+	full.Create(resolution, 0);
+	grid0.Create(resolution);
+	grid1.Create(resolution);
+	scene.VoxelizeScene(grid, mesh.Bound, 4);
+	voxelizer.Voxelize(full, mesh.pVertices, mesh.Stride, mesh.pIndices, mesh.NumIndices, mesh.Bound, 4);
+	voxelizer.Voxelize(grid0, mesh.pVertices, mesh.Stride, mesh.pIndices, numIndices0, mesh.Bound, 4);
+	voxelizer.Voxelize(grid1, mesh.pVertices, mesh.Stride, &mesh.pIndices[numIndices0], numIndices1, mesh.Bound, 4);
+	mismatched = scene.GetNumVisibleInstances() != 2;
+	for (uint8_t i = 0; i < grid.GetNumLevels() && !mismatched; ++i)
+		mismatched = memcmp(grid.GetData(i), full.GetData(i), sizeof(uint32_t) * grid.GetNumVoxels(i)) != 0;
+	for (auto z = 0u; z < resolution && !mismatched; ++z)
+		for (auto y = 0u; y < resolution && !mismatched; ++y)
+			for (auto x = 0u; x < resolution && !mismatched; ++x)
+				mismatched = grid.GetID(x, y, z) != (grid0.IsOccupied(x, y, z) ? 1 :
+					(grid1.IsOccupied(x, y, z) ? 2 : VoxelGrid::EmptyID));
+}
+
+//--------------------------------------------------------------------------------------
+// CPUClipmapVoxelizer of 2 levels over the bound, after moving the focus by small steps
+// and a jump, where level 1 is the whole grid. Level 0 must match a full voxelization at
+// twice the resolution in its window, and level 1 the reference, with its object ID in
+// exactly the occupied voxels, exactly.
+//--------------------------------------------------------------------------------------
+void TestClipmap(const Fixture& fixture, Outcome& outcome)
+{
+	// Small steps, unchanged, which must be skipped, a jump, then a step back
+	const auto& mesh = *fixture.pMesh;
+	const auto& b = mesh.Bound;
+	const float offsets[][3] =
+	{
+		{ 0.0f, 0.0f, 0.0f }, { 0.1f, -0.05f, 0.2f }, { 0.1f, -0.05f, 0.2f },
+		{ -0.7f, 0.3f, -0.4f }, { 0.9f, 0.1f, 0.6f }, { 0.25f, 0.1f, -0.15f }
+	};
+
+	const auto resolution = fixture.Resolution;
+	CPUVoxelizer voxelizer;
+	CPUClipmapVoxelizer clipmap;
+	VoxelGrid fine;
+	auto& mismatched = outcome.Mismatched;
+	clipmap.Create(resolution, 2, 2 * resolution, b, 32);
+	fine.Create(2 * resolution);
+	clipmap.SetObjectID(3);
+	clipmap.SetMesh(mesh.pVertices, mesh.Stride, mesh.pIndices, mesh.NumIndices);
+	for (size_t i = 0; i < size(offsets); ++i)
+	{
+		const float focus[] = { b[0] + offsets[i][0] * b[3], b[1] + offsets[i][1] * b[3], b[2] + offsets[i][2] * b[3] };
+		mismatched = clipmap.Update(focus, 4) == (i == 2) || mismatched;
+
+		// Only the slabs of level 0 for a small step
+		if (i == 1) mismatched = clipmap.GetNumUpdatedVoxels() >= clipmap.GetLevel(0).GetNumVoxels() || mismatched;
+	}
+	voxelizer.Voxelize(fine, mesh.pVertices, mesh.Stride, mesh.pIndices, mesh.NumIndices, b, 4);
+
+	const auto& window = clipmap.GetWindow(0);
+	for (auto z = window.Min[2]; z < window.Max[2] && !mismatched; ++z)
+		for (auto y = window.Min[1]; y < window.Max[1] && !mismatched; ++y)
+			for (auto x = window.Min[0]; x < window.Max[0] && !mismatched; ++x)
+				mismatched = clipmap.Get(0, x, y, z) != fine.Get(x, y, z);
+
+	auto& grid = outcome.Surface;
+	grid = clipmap.GetLevel(1);
+	mismatched = memcmp(grid.GetData(), fixture.Reference.GetData(), sizeof(uint32_t) * grid.GetNumVoxels()) != 0 || mismatched;
+	for (auto z = 0u; z < resolution && !mismatched; ++z)
+		for (auto y = 0u; y < resolution && !mismatched; ++y)
+			for (auto x = 0u; x < resolution && !mismatched; ++x)
+				mismatched = grid.GetID(x, y, z) != (grid.IsOccupied(x, y, z) ? 3 : VoxelGrid::EmptyID);
+}
+
+//--------------------------------------------------------------------------------------
+// CPUTiledVoxelizer in tiles of a quarter of the grid, with a memory budget of 2 tiles,
+// into a compressed chunked file, which must read back as the reference exactly through
+// the memory-mapped reader
+//--------------------------------------------------------------------------------------
+void TestTiled(const Fixture& fixture, Outcome& outcome)
+{
+	// Written to and read back from the working directory
+	const auto& mesh = *fixture.pMesh;
+	const auto resolution = fixture.Resolution;
+	const auto tileSize = (max)(resolution / 4, 16u);
+	const auto fileName = "VoxelizerTest_" + mesh.Name + ".vxgc";
+	const auto bucketFileName = "VoxelizerTest_" + mesh.Name + ".bucket";
+
+	CPUTiledVoxelizer tiled;
+	VoxelChunkWriter writer;
+	VoxelChunkReader reader;
+	auto& grid = outcome.Surface;
+	auto& mismatched = outcome.Mismatched;
+	tiled.SetTileSize(tileSize);
+	grid.Create(resolution);
+	mismatched = !writer.Create(fileName.c_str(), resolution, 16) ||
+		!tiled.Voxelize(writer, mesh.pVertices, mesh.Stride, mesh.pIndices, mesh.NumIndices, mesh.Bound,
+			bucketFileName.c_str(), 2 * sizeof(uint32_t) * tileSize * tileSize * tileSize, 4) ||
+		!writer.Close() || !reader.Open(fileName.c_str()) || !reader.ReadGrid(grid, 4);
+
+	// The surface chunks must compress
+	auto numCompressed = 0u;
+	const auto numChunks = reader.GetNumChunks();
+	for (auto i = 0u; i < numChunks * numChunks * numChunks; ++i)
+		if (reader.GetEntry(i % numChunks, i / numChunks % numChunks, i / (numChunks * numChunks)).Codec == CODEC_RLE)
+			++numCompressed;
+	mismatched = mismatched || numCompressed == 0;
+	reader.Close();
+	remove(fileName.c_str());
+
+	mismatched = mismatched || tiled.GetNumConcurrentTiles() > 2 || tiled.GetNumOccupied() != grid.GetNumOccupied() ||
+		memcmp(grid.GetData(), fixture.Reference.GetData(), sizeof(uint32_t) * grid.GetNumVoxels()) != 0;
+}
+
+//--------------------------------------------------------------------------------------
+// The two halves of the triangles voxelized as objects 1 and 2 into a 16-bit ID channel,
+// written to compressed chunked files with 16-bit IDs, with 32-bit IDs, and without, and
+// read back into grids of each width. The voxels must match the reference and the IDs
+// the grid exactly, or be empty without the IDs in the file.
+//--------------------------------------------------------------------------------------
+void TestChunkedIDs(const Fixture& fixture, Outcome& outcome)
+{
+	// Written to and read back from the working directory
+	const auto& mesh = *fixture.pMesh;
+	const auto resolution = fixture.Resolution;
+	const auto numIndices0 = mesh.NumIndices / 6 * 3;
+	const auto fileName = "VoxelizerTest_" + mesh.Name + "_ids.vxgc";
+
+	CPUVoxelizer voxelizer;
+	VoxelGrid grid;
+	grid.Create(resolution, 1, 16);
+	voxelizer.SetObjectID(1);
+	voxelizer.Voxelize(grid, mesh.pVertices, mesh.Stride, mesh.pIndices, numIndices0, mesh.Bound, 4);
+	voxelizer.SetObjectID(2);
+	voxelizer.Voxelize(grid, mesh.pVertices, mesh.Stride, &mesh.pIndices[numIndices0], mesh.NumIndices - numIndices0, mesh.Bound, 4);
+
+	auto& mismatched = outcome.Mismatched;
+	mismatched = memcmp(grid.GetData(), fixture.Reference.GetData(), sizeof(uint32_t) * grid.GetNumVoxels()) != 0;
+	const uint8_t fileIDBits[] = { 16, 32, 0 };
+	for (const auto idBits : fileIDBits)
+	{
+		for (const uint8_t gridIDBits : { 16, 32 })
+		{
+			VoxelChunkWriter writer;
+			VoxelChunkReader reader;
+			auto& readBack = outcome.Surface;
+			readBack.Create(resolution, 1, gridIDBits);
+			mismatched = mismatched || !writer.Create(fileName.c_str(), resolution, 16, true, idBits) ||
+				!writer.WriteGrid(grid, nullptr, 4) || !writer.Close() || !reader.Open(fileName.c_str()) ||
+				reader.GetIDBits() != idBits || !reader.ReadGrid(readBack, 4);
+			reader.Close();
+			remove(fileName.c_str());
+
+			mismatched = mismatched || memcmp(readBack.GetData(), grid.GetData(), sizeof(uint32_t) * grid.GetNumVoxels()) != 0;
+			for (auto z = 0u; z < resolution && !mismatched; ++z)
+				for (auto y = 0u; y < resolution && !mismatched; ++y)
+					for (auto x = 0u; x < resolution && !mismatched; ++x)
+						mismatched = readBack.GetID(x, y, z) != (idBits ? grid.GetID(x, y, z) : VoxelGrid::EmptyID);
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// VoxelExporter of the solid with a 16-bit ID channel from a grid in bricks of 32, and
+// from a chunked file of it in chunks of 16, where both trees must be the same bytes. The
+// grid is rebuilt from the masks, the values, and the IDs of the tree, and must match the
+// solid and its IDs exactly, with the counts of the header. The NRRD volume must be the
+// header and a byte per voxel, which is the coverage of the solid, exactly. Not scored.
+//--------------------------------------------------------------------------------------
+void TestExport(const Fixture& fixture, Outcome& outcome)
+{
+	// Written to and read back from the working directory
+	const auto& mesh = *fixture.pMesh;
+	const auto resolution = fixture.Resolution;
+	const auto baseName = "VoxelizerTest_" + mesh.Name;
+	const auto readFile = [](const string& fileName)
+	{
+		ifstream file(fileName, ios::binary);
+		vector<uint8_t> content((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+		remove(fileName.c_str());
+
+		return content;
+	};
+
+	CPUVoxelizer voxelizer;
+	VoxelGrid grid;
+	grid.Create(resolution, 1, 16);
+	voxelizer.SetObjectID(5);
+	voxelizer.Voxelize(grid, mesh.pVertices, mesh.Stride, mesh.pIndices, mesh.NumIndices, mesh.Bound, 4);
+	voxelizer.FillSolid(grid, 4);
+
+	VoxelExporter exporter;
+	VoxelChunkWriter writer;
+	VoxelChunkReader reader;
+	auto& mismatched = outcome.Mismatched;
+	const auto chunkFileName = baseName + ".vxgc";
+	mismatched = !exporter.WriteTree((baseName + ".vxtr").c_str(), VoxelGridSource(grid, 32)) ||
+		!writer.Create(chunkFileName.c_str(), resolution, 16, true, 16) || !writer.WriteGrid(grid, nullptr, 4) ||
+		!writer.Close() || !reader.Open(chunkFileName.c_str()) ||
+		!exporter.WriteTree((baseName + "_chunked.vxtr").c_str(), VoxelChunkSource(reader));
+	reader.Close();
+	remove(chunkFileName.c_str());
+
+	const auto tree = readFile(baseName + ".vxtr");
+	mismatched = mismatched || tree != readFile(baseName + "_chunked.vxtr");
+
+	// Rebuild by walking the nodes in the order of their masks
+	VoxelGrid rebuilt;
+	rebuilt.Create(resolution, 1, 16);
+	uint32_t header[6];
+	uint64_t counts[2], numLeaves = 0, numActive = 0;
+	size_t offset = 0;
+	const auto read = [&](void* pDst, size_t size)
+	{
+		mismatched = mismatched || tree.size() - offset < size;
+		if (!mismatched) memcpy(pDst, &tree[offset], size);
+		offset += size;
+	};
+	read(header, sizeof(header));
+	read(counts, sizeof(counts));
+	mismatched = mismatched || header[0] != 0x52545856 || header[1] != 2 || header[2] != resolution || header[3] != (3 | 4 << 8 | 5 << 16);
+	uint32_t idBits = 0;
+	read(&idBits, sizeof(idBits));
+	mismatched = mismatched || idBits != 16;
+	for (auto u = 0u; u < header[4] && !mismatched; ++u)
+	{
+		uint32_t origin[3];
+		uint64_t upperMask[512];
+		read(origin, sizeof(origin));
+		read(upperMask, sizeof(upperMask));
+		for (auto i = 0u; i < 32768 && !mismatched; ++i)
+		{
+			if ((upperMask[i / 64] >> (i % 64) & 1) == 0) continue;
+
+			uint64_t lowerMask[64];
+			read(lowerMask, sizeof(lowerMask));
+			for (auto l = 0u; l < 4096 && !mismatched; ++l)
+			{
+				if ((lowerMask[l / 64] >> (l % 64) & 1) == 0) continue;
+
+				uint64_t valueMask[8];
+				read(valueMask, sizeof(valueMask));
+				auto numValues = 0u;
+				for (const auto& word : valueMask) numValues += static_cast<uint32_t>(bitset<64>(word).count());
+				vector<uint32_t> values(numValues);
+				vector<uint16_t> ids(numValues);
+				read(values.data(), sizeof(uint32_t) * numValues);
+				read(ids.data(), sizeof(uint16_t) * numValues);
+				++numLeaves;
+
+				const uint32_t leafOrigin[] =
+				{
+					origin[0] + i % 32 * 128 + l % 16 * 8,
+					origin[1] + i / 32 % 32 * 128 + l / 16 % 16 * 8,
+					origin[2] + i / 1024 * 128 + l / 256 * 8
+				};
+				for (auto bit = 0u, j = 0u; bit < 512 && !mismatched; ++bit)
+				{
+					if ((valueMask[bit / 64] >> (bit % 64) & 1) == 0) continue;
+
+					const uint32_t x = leafOrigin[0] + bit % 8, y = leafOrigin[1] + bit / 8 % 8, z = leafOrigin[2] + bit / 64;
+					mismatched = x >= resolution || y >= resolution || z >= resolution || values[j] == 0 || rebuilt.Get(x, y, z) != 0;
+					if (mismatched) break;
+					rebuilt.Set(x, y, z, values[j]);
+					rebuilt.SetID(x, y, z, ids[j++]);
+					++numActive;
+				}
+			}
+		}
+	}
+
+	mismatched = mismatched || offset != tree.size() || numLeaves != counts[0] || numActive != counts[1] ||
+		memcmp(rebuilt.GetData(), grid.GetData(), sizeof(uint32_t) * grid.GetNumVoxels()) != 0;
+	for (auto z = 0u; z < resolution && !mismatched; ++z)
+		for (auto y = 0u; y < resolution && !mismatched; ++y)
+			for (auto x = 0u; x < resolution && !mismatched; ++x)
+				mismatched = grid.Get(x, y, z) && rebuilt.GetID(x, y, z) != grid.GetID(x, y, z);
+
+	// The raw data follows the blank line ending the header
+	mismatched = mismatched || !exporter.WriteNRRD((baseName + ".nrrd").c_str(), VoxelGridSource(grid, 32), mesh.Bound);
+	const auto nrrd = readFile(baseName + ".nrrd");
+	const char blankLine[] = "\n\n";
+	const auto dataStart = search(nrrd.cbegin(), nrrd.cend(), blankLine, blankLine + 2) - nrrd.cbegin() + 2;
+	const auto numVoxels = grid.GetNumVoxels();
+	mismatched = mismatched || nrrd.size() < 2 || static_cast<size_t>(nrrd.size() - dataStart) != numVoxels ||
+		exporter.GetNumExported() != numActive;
+	for (size_t i = 0; i < numVoxels && !mismatched; ++i)
+		mismatched = nrrd[dataStart + i] != (grid.GetData()[i] >> 30) * 85;
+
+	outcome.MetricMask = 0;
+}
+
+//--------------------------------------------------------------------------------------
+// VoxelColumns of the inside of the mesh, as the solid of the reference, and of the
+// reference, which must match it exactly. Their union, intersection, and difference must
+// match the voxelwise operations exactly, by point queries and written to a grid.
+//--------------------------------------------------------------------------------------
+void TestColumns(const Fixture& fixture, Outcome& outcome)
+{
+	const auto& mesh = *fixture.pMesh;
+	const auto& reference = fixture.Reference;
+	const auto resolution = fixture.Resolution;
+	VoxelColumns columns, surface, combined;
+	auto& grid = outcome.Surface;
+	auto& mismatched = outcome.Mismatched;
+	grid = reference;
+	columns.Build(resolution, mesh.pVertices, mesh.Stride, mesh.pIndices, mesh.NumIndices, mesh.Bound, 4);
+	surface.Build(reference, 4);
+	vector<uint8_t> isInside(grid.GetNumVoxels());
+	for (size_t i = 0; i < grid.GetNumVoxels(); ++i)
+	{
+		const auto x = static_cast<uint32_t>(i % resolution), y = static_cast<uint32_t>(i / resolution % resolution);
+		isInside[i] = columns.IsInside(x, y, static_cast<uint32_t>(i / resolution / resolution));
+		mismatched = mismatched || surface.IsInside(x, y, static_cast<uint32_t>(i / resolution / resolution)) != isOccupied(reference.GetData()[i]);
+	}
+
+	for (uint8_t op = 0; op < VoxelColumns::NUM_OPERATION && !mismatched; ++op)
+	{
+		VoxelGrid written;
+		written.Create(resolution);
+		combined.Combine(columns, surface, static_cast<VoxelColumns::Operation>(op), 4);
+		combined.Write(written, VoxelGrid::CoverageMask, 4);
+		for (size_t i = 0; i < written.GetNumVoxels() && !mismatched; ++i)
+		{
+			const bool a = isInside[i] != 0, b = isOccupied(reference.GetData()[i]);
+			const auto expected = op == VoxelColumns::UNION ? a || b : (op == VoxelColumns::INTERSECTION ? a && b : a && !b);
+			const auto x = static_cast<uint32_t>(i % resolution), y = static_cast<uint32_t>(i / resolution % resolution);
+			mismatched = isOccupied(written.GetData()[i]) != expected ||
+				combined.IsInside(x, y, static_cast<uint32_t>(i / resolution / resolution)) != expected;
+		}
+	}
+
+	outcome.Solid = grid;
+	columns.Write(outcome.Solid);
+}
+
+//--------------------------------------------------------------------------------------
+// VoxelBits of the operands of the columns case, whose operations must match those of
+// the columns exactly, also in place. The surface is the boundary of their union, which
+// must be exactly the occupied voxels with an empty face neighbor, with all the normals
+// from the gradient of the occupancy. Written over the reference, each voxel must keep
+// its normal or get the same one. As the boundary is only the outer layer of the
+// reference, the missed and extra voxels are not scored, but the gradient normals are,
+// in the voxels where the reference has a normal, and so is the fill by them.
+//--------------------------------------------------------------------------------------
+void TestCSG(const Fixture& fixture, Outcome& outcome)
+{
+	const auto& mesh = *fixture.pMesh;
+	const auto& reference = fixture.Reference;
+	const auto resolution = fixture.Resolution;
+	VoxelColumns columns, surface, combined;
+	VoxelBits a, b, bits, expected;
+	auto& mismatched = outcome.Mismatched;
+	columns.Build(resolution, mesh.pVertices, mesh.Stride, mesh.pIndices, mesh.NumIndices, mesh.Bound, 4);
+	surface.Build(reference, 4);
+	a.Build(columns, 4);
+	b.Build(reference, 4);
+	for (uint8_t op = 0; op < VoxelColumns::NUM_OPERATION && !mismatched; ++op)
+	{
+		const auto operation = static_cast<VoxelColumns::Operation>(op);
+		VoxelGrid written;
+		written.Create(resolution);
+		combined.Combine(columns, surface, operation, 4);
+		combined.Write(written, VoxelGrid::CoverageMask, 4);
+		expected.Build(written, 4);
+		bits.Combine(a, b, operation, 4);
+		mismatched = bits.GetNumVoxels() != combined.GetNumVoxels() ||
+			memcmp(bits.GetData(), expected.GetData(), bits.GetMemorySize()) != 0;
+
+		bits = a;
+		bits.Combine(bits, b, operation, 4);
+		mismatched = mismatched || memcmp(bits.GetData(), expected.GetData(), bits.GetMemorySize()) != 0;
+	}
+
+	auto& grid = outcome.Surface;
+	bits.Combine(a, b, VoxelColumns::UNION, 4);
+	grid.Create(resolution);
+	bits.WriteSurface(grid, 4);
+	const auto last = resolution - 1;
+	for (size_t i = 0; i < grid.GetNumVoxels() && !mismatched; ++i)
+	{
+		const auto x = static_cast<uint32_t>(i % resolution), y = static_cast<uint32_t>(i / resolution % resolution);
+		const auto z = static_cast<uint32_t>(i / resolution / resolution);
+		const auto isBoundary = bits.IsInside(x, y, z) && (x == 0 || y == 0 || z == 0 || x == last || y == last || z == last ||
+			!bits.IsInside(x - 1, y, z) || !bits.IsInside(x + 1, y, z) || !bits.IsInside(x, y - 1, z) ||
+			!bits.IsInside(x, y + 1, z) || !bits.IsInside(x, y, z - 1) || !bits.IsInside(x, y, z + 1));
+		mismatched = isOccupied(grid.GetData()[i]) != isBoundary || bits.IsBoundary(x, y, z) != isBoundary;
+	}
+
+	// Over the reference, each voxel is either kept or recomputed
+	auto kept = reference;
+	bits.WriteSurface(kept, 4);
+	for (size_t i = 0; i < kept.GetNumVoxels() && !mismatched; ++i)
+		mismatched = kept.GetData()[i] != grid.GetData()[i] && kept.GetData()[i] != reference.GetData()[i];
+
+	outcome.MetricMask = g_normalMetrics | g_fillMetrics;
+}
+
+//--------------------------------------------------------------------------------------
+// CPURayCaster on the solid pyramid, where the 2x2 ray packets must render the same
+// pixels with the same counters as the scalar rays, with the light volume and empty-space
+// skipping at level 0, and with the secondary light march and no skipping at level 1.
+// The image is not a multiple of the tiles, so their edges are covered. Not scored.
+//--------------------------------------------------------------------------------------
+void TestRayCast(const Fixture& fixture, Outcome& outcome)
+{
+	const auto& mesh = *fixture.pMesh;
+	const auto& b = mesh.Bound;
+	CPUVoxelizer voxelizer;
+	VoxelGrid grid;
+	grid.Create(fixture.Resolution, 0);
+	voxelizer.Voxelize(grid, mesh.pVertices, mesh.Stride, mesh.pIndices, mesh.NumIndices, b, 4);
+	voxelizer.FillSolid(grid, 4);
+
+	// View of VoxelizerX, with the grid scaled to a half extent of 4 at its focus
+	const auto scale = 4.0f / b[3];
+	const float posScale[] = { -b[0] * scale, 4.0f - b[1] * scale, -b[2] * scale, scale };
+	const float eyePt[] = { 8.0f, 12.0f, -14.0f };
+	const float focusPt[] = { 0.0f, 4.0f, 0.0f };
+	const uint32_t width = 60, height = 44;
+	CPURayCaster rayCaster;
+	rayCaster.SetView(b, posScale, eyePt, focusPt, width, height);
+	for (uint8_t level = 0; level < 2 && !outcome.Mismatched; ++level)
+	{
+		vector<uint8_t> pixels[2];
+		RayCastStats stats[2];
+		rayCaster.SetLightVolume(level == 0);
+		for (uint8_t i = 0; i < 2; ++i)
+		{
+			pixels[i].resize(4 * width * height);
+			rayCaster.SetPacketTraversal(i == 0);
+			rayCaster.Render(grid, width, height, pixels[i].data(), level, level == 0, &stats[i], 4);
+		}
+		outcome.Mismatched = pixels[0] != pixels[1] || memcmp(&stats[0], &stats[1], sizeof(RayCastStats)) != 0 ||
+			stats[0].NumSamples == 0;
+	}
+
+	outcome.MetricMask = 0;
+}
+
+//--------------------------------------------------------------------------------------
+// CPUGreedyMesher on the solid, where the quads must cover exactly the exposed faces of
+// CPUBoxList, as many before merging and the same total area, with outward triangles
+// along their normals, and enclose exactly the volume of the occupied voxels, which any
+// face left out, doubled, or flipped would change. Not scored.
+//--------------------------------------------------------------------------------------
+void TestGreedyMesh(const Fixture& fixture, Outcome& outcome)
+{
+	const auto& mesh = *fixture.pMesh;
+	const auto& b = mesh.Bound;
+	CPUVoxelizer voxelizer;
+	VoxelGrid grid;
+	grid.Create(fixture.Resolution);
+	voxelizer.Voxelize(grid, mesh.pVertices, mesh.Stride, mesh.pIndices, mesh.NumIndices, b, 4);
+	voxelizer.FillSolid(grid, 4);
+
+	CPUGreedyMesher mesher;
+	CPUBoxList boxList;
+	MeshStats stats;
+	mesher.Mesh(grid, b, 0, &stats, 4);
+	boxList.Compact(grid, 0, 4);
+
+	double volume, area;
+	size_t numFlipped;
+	measureMesh(mesher, volume, area, numFlipped);
+	const auto voxelSize = 2.0 * b[3] / fixture.Resolution;
+	const auto numFaces = static_cast<double>(boxList.GetNumFaces());
+	const auto numVoxels = static_cast<double>(grid.GetNumOccupied());
+	outcome.Mismatched = stats.NumFaces != boxList.GetNumFaces() || numFlipped > 0 ||
+		fabs(area / (voxelSize * voxelSize) - numFaces) > 1.0e-4 * numFaces ||
+		fabs(volume / (voxelSize * voxelSize * voxelSize) - numVoxels) > 1.0e-4 * numVoxels;
+
+	outcome.MetricMask = 0;
+}
+
+//--------------------------------------------------------------------------------------
+// CPUMarchingCubes on the solid, where the mesh must be closed and consistently wound
+// without duplicated vertices, i.e. each directed edge has exactly one opposite, and as
+// the isosurface at 0.5 of the binary coverage passes through the exposed voxel faces and
+// cuts their corners, enclose at most the volume of the occupied voxels, and at least
+// that less half a voxel per exposed face. Not scored.
+//--------------------------------------------------------------------------------------
+void TestMarchingCubes(const Fixture& fixture, Outcome& outcome)
+{
+	const auto& mesh = *fixture.pMesh;
+	const auto& b = mesh.Bound;
+	CPUVoxelizer voxelizer;
+	VoxelGrid grid;
+	grid.Create(fixture.Resolution);
+	voxelizer.Voxelize(grid, mesh.pVertices, mesh.Stride, mesh.pIndices, mesh.NumIndices, b, 4);
+	voxelizer.FillSolid(grid, 4);
+
+	CPUMarchingCubes marchingCubes;
+	MeshStats stats;
+	marchingCubes.Extract(grid, b, 0, 0.5f, &stats, 4);
+
+	const auto& indices = marchingCubes.GetIndices();
+	const auto numVertices = marchingCubes.GetVertices().size();
+	vector<uint64_t> edges, reversed;
+	edges.reserve(indices.size());
+	reversed.reserve(indices.size());
+	auto& mismatched = outcome.Mismatched;
+	mismatched = stats.NumVertices != numVertices || stats.NumTriangles * 3 != indices.size();
+	for (size_t i = 0; i < indices.size() && !mismatched; ++i)
+	{
+		const uint64_t v0 = indices[i], v1 = indices[i % 3 == 2 ? i - 2 : i + 1];
+		mismatched = v0 >= numVertices || v0 == v1;
+		edges.emplace_back(v0 << 32 | v1);
+		reversed.emplace_back(v1 << 32 | v0);
+	}
+	sort(edges.begin(), edges.end());
+	sort(reversed.begin(), reversed.end());
+	mismatched = mismatched || adjacent_find(edges.cbegin(), edges.cend()) != edges.cend() || edges != reversed;
+
+	double volume, area;
+	size_t numFlipped;
+	CPUBoxList boxList;
+	boxList.Compact(grid, 0, 4);
+	measureMesh(marchingCubes, volume, area, numFlipped);
+	const auto voxelSize = 2.0 * b[3] / fixture.Resolution;
+	const auto numVoxels = static_cast<double>(grid.GetNumOccupied());
+	const auto numFaces = static_cast<double>(boxList.GetNumFaces());
+	volume /= voxelSize * voxelSize * voxelSize;
+	mismatched = mismatched || volume > numVoxels * (1.0 + 1.0e-6) || volume < (numVoxels - 0.5 * numFaces) * (1.0 - 1.0e-6);
+
+	outcome.MetricMask = 0;
+}
+
+//--------------------------------------------------------------------------------------
+// CPUDistanceField on the solid, which must be negative at the interior voxels of the
+// fill and positive at the empty voxels, within half a voxel diagonal of the surface at
+// the surface voxels, and no closer than the brute-force distance to the triangles, nor
+// farther by more than a voxel, at a fixed sample of the voxels. Not scored.
+//--------------------------------------------------------------------------------------
+void TestDistanceField(const Fixture& fixture, Outcome& outcome)
+{
+	const auto& mesh = *fixture.pMesh;
+	const auto& b = mesh.Bound;
+	CPUVoxelizer voxelizer;
+	VoxelGrid grid;
+	grid.Create(fixture.Resolution);
+	voxelizer.Voxelize(grid, mesh.pVertices, mesh.Stride, mesh.pIndices, mesh.NumIndices, b, 4);
+	voxelizer.FillSolid(grid, 4);
+
+	CPUDistanceField distanceField;
+	distanceField.Generate(grid, mesh.pVertices, mesh.Stride, mesh.pIndices, mesh.NumIndices, b, 1.0f, nullptr, 4);
+
+	const auto& distances = distanceField.GetDistances();
+	const auto pVoxels = grid.GetData();
+	const auto numVoxels = grid.GetNumVoxels();
+	const auto voxelSize = 2.0 * b[3] / fixture.Resolution;
+	const auto maxSurfaceDist = sqrt(3.0) / 2.0 * voxelSize * (1.0 + 1.0e-4);
+	auto& mismatched = outcome.Mismatched;
+	mismatched = distances.size() != numVoxels;
+	for (size_t i = 0; i < numVoxels && !mismatched; ++i)
+	{
+		const auto voxel = pVoxels[i];
+		const auto d = distances[i];
+		if (voxel & ~VoxelGrid::CoverageMask) mismatched = !(abs(d) <= maxSurfaceDist);
+		else mismatched = isOccupied(voxel) ? !(d < 0.0f) : !(d > 0.0f);
+	}
+
+	const auto size = fixture.Resolution;
+	const auto numTriangles = mesh.NumIndices / 3;
+	const auto halfSize = 0.5 * size;
+	const uint32_t numSamples = 64;
+	for (auto s = 0u; s < numSamples && !mismatched; ++s)
+	{
+		const auto i = static_cast<size_t>(s) * 2654435761u % numVoxels;
+		const auto x = i % size, y = i / size % size, z = i / size / size;
+		const double p[] =
+		{
+			b[0] + (x + 0.5 - halfSize) * voxelSize,
+			b[1] - (y + 0.5 - halfSize) * voxelSize,
+			b[2] + (z + 0.5 - halfSize) * voxelSize
+		};
+
+		auto dist = DBL_MAX;
+		for (auto t = 0u; t < numTriangles; ++t)
+		{
+			double v[3][3];
+			for (uint8_t j = 0; j < 3; ++j)
+			{
+				float pos[3];
+				memcpy(pos, &mesh.pVertices[static_cast<size_t>(mesh.pIndices[t * 3 + j]) * mesh.Stride], sizeof(pos));
+				for (uint8_t k = 0; k < 3; ++k) v[j][k] = pos[k];
+			}
+			dist = (min)(dist, distanceToTriangle(p, v));
+		}
+
+		const auto d = abs(distances[i]);
+		mismatched = d < dist - 1.0e-4 * voxelSize || d > dist + voxelSize;
+	}
+
+	outcome.MetricMask = 0;
+}
+
+struct TestCase
+{
+	const char* Name;
+	void (*Run)(const Fixture& fixture, Outcome& outcome);
+};
+
+const TestCase g_testCases[] =
+{
+	{ "tri_proj", TestTriProj },
+	{ "union", TestUnion },
+	{ "cpu_mt", TestCPUMT },
+	{ "fill_parity", TestFillParity },
+	{ "fill_vote", TestFillVote },
+	{ "mips", TestMips },
+	{ "mips_npot", TestMipsNPOT },
+	{ "incremental", TestIncremental },
+	{ "dynamic", TestDynamic },
+	{ "scene", TestScene },
+	{ "clipmap", TestClipmap },
+	{ "tiled", TestTiled },
+	{ "chunked_ids", TestChunkedIDs },
+	{ "export", TestExport },
+	{ "columns", TestColumns },
+	{ "csg", TestCSG },
+	{ "ray_cast", TestRayCast },
+	{ "greedy_mesh", TestGreedyMesh },
+	{ "marching_cubes", TestMarchingCubes },
+	{ "distance_field", TestDistanceField }
+};
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	try
+	{
+		if (!ParseCommandLineArgs(options, argv, argc))
+		{
+			PrintUsage(argv[0]);
+
+			return 1;
+		}
+	}
+	catch (const exception&)
+	{
+		PrintUsage(argv[0]);
+
+		return 1;
+	}
+
+	Baseline baseline, results;
+	if (!options.BaselineFileName.empty() && !options.UpdateBaseline && !LoadBaseline(options.BaselineFileName, baseline))
+	{
+		cerr << "error: failed to load " << options.BaselineFileName << endl;
+
+		return 2;
+	}
+
+	cout << left << setw(32) << "Case" << right;
+	for (const auto& name : g_metricNames) cout << setw(14) << name;
+	cout << endl << string(32 + 14 * NUM_METRIC, '-') << endl;
+
+	auto numFailed = 0u;
+	for (const auto& meshFileName : options.MeshFileNames)
+	{
+		XUSG::ObjLoader objLoader;
+		if (!objLoader.Import(meshFileName.c_str(), true, true))
+		{
+			cerr << meshFileName << ": error: failed to load" << endl;
+			++numFailed;
+			continue;
+		}
+
+		// Same bound as Voxelizer::Init
+		const auto& aabb = objLoader.GetAABB();
+		const float lo[] = { aabb.Min.x, aabb.Min.y, aabb.Min.z };
+		const float hi[] = { aabb.Max.x, aabb.Max.y, aabb.Max.z };
+		Mesh mesh;
+		const auto slash = meshFileName.find_last_of("/\\");
+		mesh.Name = meshFileName.substr(slash == string::npos ? 0 : slash + 1);
+		mesh.Name.resize(mesh.Name.find_last_of('.') == string::npos ? mesh.Name.size() : mesh.Name.find_last_of('.'));
+		mesh.pVertices = objLoader.GetVertices();
+		mesh.pIndices = objLoader.GetIndices();
+		mesh.Stride = objLoader.GetVertexStride();
+		mesh.NumVertices = objLoader.GetNumVertices();
+		mesh.NumIndices = objLoader.GetNumIndices();
+		CPUVoxelizer::GetBound(mesh.Bound, lo, hi);
+
+		for (const auto& resolution : options.Resolutions)
+		{
+			CPUVoxelizer voxelizer;
+			Fixture fixture;
+			fixture.pMesh = &mesh;
+			fixture.Resolution = resolution;
+			fixture.Reference.Create(resolution);
+			voxelizer.Voxelize(fixture.Reference, mesh.pVertices, mesh.Stride, mesh.pIndices, mesh.NumIndices, mesh.Bound, 1);
+			fixture.Inside = ComputeInside(mesh, resolution);
+
+			for (const auto& testCase : g_testCases)
+			{
+				Outcome outcome;
+				outcome.MetricMask = g_allMetrics & ~g_fillMetrics;
+				outcome.Mismatched = false;
+				testCase.Run(fixture, outcome);
+
+				array<double, NUM_METRIC> metrics = {};
+				if (outcome.MetricMask)
+				{
+					const auto fill = (outcome.MetricMask & g_fillMetrics) != 0;
+					if (fill && !outcome.Solid.GetNumLevels())
+					{
+						outcome.Solid.Create(resolution);
+						memcpy(outcome.Solid.GetData(), outcome.Surface.GetData(), sizeof(uint32_t) * outcome.Solid.GetNumVoxels());
+						voxelizer.FillSolid(outcome.Solid, 1);
+					}
+					metrics = Compare(outcome.Surface, fill ? outcome.Solid : outcome.Surface, fixture.Reference, fixture.Inside);
+					for (uint8_t i = 0; i < NUM_METRIC; ++i) if (!(outcome.MetricMask >> i & 1)) metrics[i] = 0.0;
+				}
+
+				const auto name = mesh.Name + "/" + to_string(resolution) + "/" + testCase.Name;
+				results[name] = metrics;
+
+				// Exact methods must match regardless of the baseline
+				string failure = outcome.Mismatched ? "mismatch" : "";
+				const auto it = baseline.find(name);
+				if (!options.UpdateBaseline && it != baseline.cend())
+				{
+					for (uint8_t i = 0; i < NUM_METRIC; ++i)
+					{
+						const auto limit = it->second[i] * (1.0 + options.Tolerance) + options.AbsTolerance;
+						if (metrics[i] > limit) failure += string(failure.empty() ? "" : ", ") + g_metricNames[i] + " regressed";
+					}
+				}
+				else if (!options.UpdateBaseline && !options.BaselineFileName.empty())
+					failure += string(failure.empty() ? "" : ", ") + "no baseline";
+
+				cout << left << setw(32) << name << right << fixed << setprecision(3);
+				for (uint8_t i = 0; i < NUM_METRIC; ++i)
+				{
+					if (outcome.MetricMask >> i & 1) cout << setw(14) << metrics[i];
+					else cout << setw(14) << "-";
+				}
+				if (!failure.empty())
+				{
+					cout << "  FAILED: " << failure;
+					++numFailed;
+				}
+				cout << endl;
+			}
+		}
+	}
+
+	if (options.UpdateBaseline)
+	{
+		if (!WriteBaseline(options.BaselineFileName, results))
+		{
+			cerr << "error: failed to write " << options.BaselineFileName << endl;
+
+			return 2;
+		}
+		cout << "Baseline written to " << options.BaselineFileName << endl;
+	}
+
+	cout << (numFailed ? to_string(numFailed) + " failed" : string("All passed")) << endl;
+
+	return numFailed ? 2 : 0;
+}
@@ -0,0 +1,117 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "CPUBoxList.h"
+
+using namespace std;
+
+namespace
+{
+	// Neighbor of each plane, in voxels with Y down
+	const int g_neighbors[][3] =
+	{
+		{ 0, 0, 1 },	// back plane
+		{ -1, 0, 0 },	// left plane
+		{ 0, 0, -1 },	// front plane
+		{ 1, 0, 0 },	// right plane
+		{ 0, -1, 0 },	// top plane
+		{ 0, 1, 0 }		// bottom plane
+	};
+}
+
+const uint32_t CPUBoxList::MaxSize;
+
+CPUBoxList::CPUBoxList()
+{
+}
+
+CPUBoxList::~CPUBoxList()
+{
+}
+
+//--------------------------------------------------------------------------------------
+// Two passes over the Z slices in parallel: count the faces of each slice, and then
+// write them at the prefix sums of the counts, so the order is deterministic.
+//--------------------------------------------------------------------------------------
+void CPUBoxList::Compact(const VoxelGrid& grid, uint8_t level, uint32_t numThreads)
+{
+	PROFILE_SCOPE("CPUBoxList::Compact");
+
+	const auto size = grid.GetSize(level);
+	if (size > MaxSize)
+	{
+		m_faces.clear();
+
+		return;
+	}
+
+	vector<size_t> offsets(size + 1, 0);
+
+	ParallelFor(0, size, [&](uint32_t z)
+	{
+		size_t numFaces = 0;
+		for (auto y = 0u; y < size; ++y)
+			for (auto x = 0u; x < size; ++x)
+				for (auto mask = getFaceMask(grid, level, x, y, z); mask; mask &= mask - 1) ++numFaces;
+		offsets[z + 1] = numFaces;
+	}, numThreads);
+
+	for (auto z = 0u; z < size; ++z) offsets[z + 1] += offsets[z];
+	m_faces.resize(offsets[size]);
+
+	ParallelFor(0, size, [&](uint32_t z)
+	{
+		auto pFace = &m_faces[offsets[z]];
+		for (auto y = 0u; y < size; ++y)
+		{
+			for (auto x = 0u; x < size; ++x)
+			{
+				const auto mask = getFaceMask(grid, level, x, y, z);
+				for (uint8_t i = 0; i < NUM_PLANE; ++i)
+					if (mask & (1 << i)) *pFace++ = PackFace(x, y, z, static_cast<Plane>(i));
+			}
+		}
+	}, numThreads);
+}
+
+const vector<uint32_t>& CPUBoxList::GetFaces() const
+{
+	return m_faces;
+}
+
+size_t CPUBoxList::GetNumFaces() const
+{
+	return m_faces.size();
+}
+
+uint32_t CPUBoxList::PackFace(uint32_t x, uint32_t y, uint32_t z, Plane plane)
+{
+	return x | (y << 9) | (z << 18) | (static_cast<uint32_t>(plane) << 27);
+}
+
+void CPUBoxList::UnpackFace(uint32_t face, uint32_t& x, uint32_t& y, uint32_t& z, Plane& plane)
+{
+	x = face & 0x1ff;
+	y = (face >> 9) & 0x1ff;
+	z = (face >> 18) & 0x1ff;
+	plane = static_cast<Plane>(face >> 27);
+}
+
+uint8_t CPUBoxList::getFaceMask(const VoxelGrid& grid, uint8_t level, uint32_t x, uint32_t y, uint32_t z) const
+{
+	if (!grid.IsOccupied(x, y, z, level)) return 0;
+
+	const auto size = static_cast<int>(grid.GetSize(level));
+	uint8_t mask = 0;
+	for (uint8_t i = 0; i < NUM_PLANE; ++i)
+	{
+		const int loc[] = { static_cast<int>(x) + g_neighbors[i][0], static_cast<int>(y) + g_neighbors[i][1], static_cast<int>(z) + g_neighbors[i][2] };
+		if (loc[0] < 0 || loc[1] < 0 || loc[2] < 0 || loc[0] >= size || loc[1] >= size || loc[2] >= size) mask |= 1 << i;
+		else if (!grid.IsOccupied(loc[0], loc[1], loc[2], level)) mask |= 1 << i;
+	}
+
+	return mask;
+}
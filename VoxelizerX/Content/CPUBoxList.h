@@ -0,0 +1,48 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "VoxelGrid.h"
+
+//--------------------------------------------------------------------------------------
+// CPU counterpart of CSCompactBoxes: the exposed faces of the occupied voxels, whose
+// neighbors on the face are empty or outside the grid, packed in the same format as
+// the GPU face list and ordered by voxels. The planes are those of VSBoxArray.
+//--------------------------------------------------------------------------------------
+class CPUBoxList
+{
+public:
+	enum Plane : uint8_t
+	{
+		PLANE_BACK,
+		PLANE_LEFT,
+		PLANE_FRONT,
+		PLANE_RIGHT,
+		PLANE_TOP,
+		PLANE_BOTTOM,
+
+		NUM_PLANE
+	};
+
+	CPUBoxList();
+	virtual ~CPUBoxList();
+
+	// Leaves no faces for levels larger than MaxSize, which the packing cannot address
+	void Compact(const VoxelGrid& grid, uint8_t level = 0, uint32_t numThreads = 0);
+
+	const std::vector<uint32_t>& GetFaces() const;
+	size_t GetNumFaces() const;
+
+	// Faces are packed as x | y << 9 | z << 18 | plane << 27
+	static uint32_t PackFace(uint32_t x, uint32_t y, uint32_t z, Plane plane);
+	static void UnpackFace(uint32_t face, uint32_t& x, uint32_t& y, uint32_t& z, Plane& plane);
+
+	static const uint32_t MaxSize = 512;
+
+protected:
+	uint8_t getFaceMask(const VoxelGrid& grid, uint8_t level, uint32_t x, uint32_t y, uint32_t z) const;
+
+	std::vector<uint32_t> m_faces;
+};
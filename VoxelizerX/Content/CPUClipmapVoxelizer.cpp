@@ -0,0 +1,339 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "CPUClipmapVoxelizer.h"
+
+using namespace std;
+
+namespace
+{
+	const uint32_t g_trianglesPerTask = 256;
+	const uint32_t g_maxBinsPerAxis = 64;
+}
+
+CPUClipmapVoxelizer::CPUClipmapVoxelizer() :
+	m_binSize(0),
+	m_numBins(0),
+	m_pVertices(nullptr),
+	m_pIndices(nullptr),
+	m_stride(0),
+	m_numIndices(0),
+	m_size(0),
+	m_finestSize(0),
+	m_bound(),
+	m_numUpdatedVoxels(0),
+	m_valid(false)
+{
+}
+
+CPUClipmapVoxelizer::~CPUClipmapVoxelizer()
+{
+}
+
+bool CPUClipmapVoxelizer::Create(uint32_t size, uint8_t numLevels, uint32_t finestSize, const float bound[4], uint8_t idBits)
+{
+	if (size == 0 || numLevels == 0 || numLevels > 32) return false;
+	if (finestSize % (1ull << (numLevels - 1)) != 0 || (finestSize >> (numLevels - 1)) < size) return false;
+
+	m_levels.resize(numLevels);
+	for (auto& level : m_levels)
+		if (!level.Create(size, 1, idBits)) return false;
+	m_windows.assign(numLevels, VoxelRegion());
+	m_pieces.assign(numLevels, vector<Piece>());
+
+	m_size = size;
+	m_finestSize = finestSize;
+	memcpy(m_bound, bound, sizeof(m_bound));
+	m_valid = false;
+
+	return true;
+}
+
+void CPUClipmapVoxelizer::SetMesh(const uint8_t* pVertices, uint32_t stride, const uint32_t* pIndices, uint32_t numIndices)
+{
+	m_pVertices = pVertices;
+	m_pIndices = pIndices;
+	m_stride = stride;
+	m_numIndices = numIndices;
+	m_valid = false;
+}
+
+void CPUClipmapVoxelizer::Invalidate()
+{
+	m_valid = false;
+}
+
+//--------------------------------------------------------------------------------------
+// The exposed slabs of a window are taken axis by axis, each from the part of the window
+// that the previous axes have kept, so they are disjoint. A window that moves by its size
+// or more is voxelized whole. The triangles in the bins of the pieces are mapped to the
+// virtual grid of each level exactly as by a full voxelization, and written into the
+// pieces of the slabs at their toroidal offsets.
+//--------------------------------------------------------------------------------------
+bool CPUClipmapVoxelizer::Update(const float focus[3], uint32_t numThreads)
+{
+	if (!m_valid) buildBins();
+
+	const auto numLevels = GetNumLevels();
+	m_numUpdatedVoxels = 0;
+	auto numPieces = 0u;
+	for (uint8_t i = 0; i < numLevels; ++i)
+	{
+		// Window of the snapped focus, clamped to the virtual grid
+		const auto virtualSize = m_finestSize >> i;
+		const auto scale = 0.5f * virtualSize / m_bound[3];
+		const float f[] =
+		{
+			(focus[0] - m_bound[0]) * scale,
+			(m_bound[1] - focus[1]) * scale,
+			(focus[2] - m_bound[2]) * scale
+		};
+
+		VoxelRegion window;
+		for (uint8_t j = 0; j < 3; ++j)
+		{
+			const auto lo = floor(f[j] + 0.5f * virtualSize) - static_cast<float>(m_size / 2);
+			window.Min[j] = static_cast<uint32_t>((min)((max)(lo, 0.0f), static_cast<float>(virtualSize - m_size)));
+			window.Max[j] = window.Min[j] + m_size;
+		}
+
+		m_pieces[i].clear();
+		const auto& prevWindow = m_windows[i];
+		auto full = !m_valid;
+		for (uint8_t j = 0; j < 3; ++j)
+			full = full || (max)(window.Min[j], prevWindow.Min[j]) - (min)(window.Min[j], prevWindow.Min[j]) >= m_size;
+
+		if (full) addSlab(i, window);
+		else
+		{
+			auto kept = window;
+			for (uint8_t j = 0; j < 3; ++j)
+			{
+				if (window.Min[j] == prevWindow.Min[j]) continue;
+
+				auto slab = kept;
+				if (window.Min[j] > prevWindow.Min[j])
+				{
+					slab.Min[j] = prevWindow.Max[j];
+					kept.Max[j] = prevWindow.Max[j];
+				}
+				else
+				{
+					slab.Max[j] = prevWindow.Min[j];
+					kept.Min[j] = prevWindow.Min[j];
+				}
+				addSlab(i, slab);
+			}
+		}
+
+		m_windows[i] = window;
+		numPieces += static_cast<uint32_t>(m_pieces[i].size());
+	}
+	m_valid = true;
+
+	if (numPieces == 0) return false;
+
+	PROFILE_SCOPE("CPUClipmapVoxelizer::Update");
+
+	gatherTriangles();
+	const auto numTriangles = static_cast<uint32_t>(m_triangles.size());
+	const auto numTasks = (numTriangles + g_trianglesPerTask - 1) / g_trianglesPerTask;
+	ParallelFor(0, numTasks, [&](uint32_t task)
+	{
+		const auto end = (min)((task + 1) * g_trianglesPerTask, numTriangles);
+		for (auto j = task * g_trianglesPerTask; j < end; ++j)
+		{
+			const auto t = m_triangles[j];
+			for (uint8_t i = 0; i < numLevels; ++i)
+			{
+				if (m_pieces[i].empty()) continue;
+
+				float v[3][3], n[3];
+				loadTriangle(v, n, m_pVertices, m_stride, &m_pIndices[t * 3], m_bound, nullptr, static_cast<float>(m_finestSize >> i));
+				for (const auto& piece : m_pieces[i])
+					voxelizeTriangle(m_levels[i], v, n, piece.Region, 1, m_objectID, piece.Offset);
+			}
+		}
+	}, numThreads);
+
+	return true;
+}
+
+const VoxelGrid& CPUClipmapVoxelizer::GetLevel(uint8_t level) const
+{
+	return m_levels[level];
+}
+
+uint8_t CPUClipmapVoxelizer::GetNumLevels() const
+{
+	return static_cast<uint8_t>(m_levels.size());
+}
+
+const VoxelRegion& CPUClipmapVoxelizer::GetWindow(uint8_t level) const
+{
+	return m_windows[level];
+}
+
+void CPUClipmapVoxelizer::GetWindowBound(uint8_t level, float bound[4]) const
+{
+	const auto virtualSize = static_cast<float>(m_finestSize >> level);
+	const auto voxelSize = 2.0f * m_bound[3] / virtualSize;
+	const auto& window = m_windows[level];
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		const auto offset = (window.Min[i] + 0.5f * m_size - 0.5f * virtualSize) * voxelSize;
+		bound[i] = i == 1 ? m_bound[i] - offset : m_bound[i] + offset;
+	}
+	bound[3] = 0.5f * m_size * voxelSize;
+}
+
+uint32_t CPUClipmapVoxelizer::Get(uint8_t level, uint32_t x, uint32_t y, uint32_t z) const
+{
+	return m_levels[level].Get(x % m_size, y % m_size, z % m_size);
+}
+
+size_t CPUClipmapVoxelizer::GetNumUpdatedVoxels() const
+{
+	return m_numUpdatedVoxels;
+}
+
+//--------------------------------------------------------------------------------------
+// Split the slab at the multiples of the size along each axis, which gives at most 2x2x2
+// pieces of constant offsets, as the slab is no larger than the window, and clear them
+//--------------------------------------------------------------------------------------
+void CPUClipmapVoxelizer::addSlab(uint8_t level, const VoxelRegion& slab)
+{
+	uint32_t bounds[3][3];
+	uint8_t numSegments[3];
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		if (slab.Min[i] >= slab.Max[i]) return;
+
+		const auto wrap = (slab.Min[i] / m_size + 1) * m_size;
+		bounds[i][0] = slab.Min[i];
+		bounds[i][1] = (min)(wrap, slab.Max[i]);
+		bounds[i][2] = slab.Max[i];
+		numSegments[i] = wrap < slab.Max[i] ? 2 : 1;
+	}
+
+	for (uint8_t z = 0; z < numSegments[2]; ++z)
+	{
+		for (uint8_t y = 0; y < numSegments[1]; ++y)
+		{
+			for (uint8_t x = 0; x < numSegments[0]; ++x)
+			{
+				const uint8_t segments[] = { x, y, z };
+				Piece piece;
+				VoxelRegion region;
+				for (uint8_t i = 0; i < 3; ++i)
+				{
+					piece.Region.Min[i] = bounds[i][segments[i]];
+					piece.Region.Max[i] = bounds[i][segments[i] + 1];
+					piece.Offset[i] = -static_cast<int>(piece.Region.Min[i] / m_size * m_size);
+					region.Min[i] = piece.Region.Min[i] + piece.Offset[i];
+					region.Max[i] = piece.Region.Max[i] + piece.Offset[i];
+				}
+
+				m_levels[level].Clear(region);
+				m_pieces[level].emplace_back(piece);
+			}
+		}
+	}
+
+	m_numUpdatedVoxels += static_cast<size_t>(slab.Max[0] - slab.Min[0]) *
+		(slab.Max[1] - slab.Min[1]) * (slab.Max[2] - slab.Min[2]);
+}
+
+//--------------------------------------------------------------------------------------
+// Each triangle is listed in the bins overlapped by its voxel bound in the finest virtual
+// grid, padded by a voxel against the rounding of the mappings of the coarser levels
+//--------------------------------------------------------------------------------------
+void CPUClipmapVoxelizer::buildBins()
+{
+	m_binSize = (m_finestSize + g_maxBinsPerAxis - 1) / g_maxBinsPerAxis;
+	m_numBins = (m_finestSize + m_binSize - 1) / m_binSize;
+
+	const auto numTriangles = m_numIndices / 3;
+	const auto gridSize = static_cast<float>(m_finestSize);
+	const auto maxBin = static_cast<int>(m_numBins) - 1;
+	vector<int> ranges(static_cast<size_t>(numTriangles) * 6);
+	for (auto t = 0u; t < numTriangles; ++t)
+	{
+		float v[3][3], n[3];
+		loadTriangle(v, n, m_pVertices, m_stride, &m_pIndices[t * 3], m_bound, nullptr, gridSize);
+
+		const auto pRange = &ranges[static_cast<size_t>(t) * 6];
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			const auto minV = floor((min)(v[0][i], (min)(v[1][i], v[2][i]))) - 1.0f;
+			const auto maxV = floor((max)(v[0][i], (max)(v[1][i], v[2][i]))) + 1.0f;
+			pRange[i] = (min)((max)(static_cast<int>(floor(minV / m_binSize)), 0), maxBin + 1);
+			pRange[i + 3] = (max)((min)(static_cast<int>(floor(maxV / m_binSize)), maxBin), pRange[i] - 1);
+		}
+	}
+
+	// Counts, prefix sums, then the lists
+	const auto forEachBin = [&](uint32_t t, const function<void(size_t)>& func)
+	{
+		const auto pRange = &ranges[static_cast<size_t>(t) * 6];
+		for (auto z = pRange[2]; z <= pRange[5]; ++z)
+			for (auto y = pRange[1]; y <= pRange[4]; ++y)
+				for (auto x = pRange[0]; x <= pRange[3]; ++x)
+					func((static_cast<size_t>(z) * m_numBins + y) * m_numBins + x);
+	};
+
+	m_binOffsets.assign(static_cast<size_t>(m_numBins) * m_numBins * m_numBins + 1, 0);
+	for (auto t = 0u; t < numTriangles; ++t) forEachBin(t, [&](size_t bin) { ++m_binOffsets[bin + 1]; });
+	for (size_t i = 1; i < m_binOffsets.size(); ++i) m_binOffsets[i] += m_binOffsets[i - 1];
+
+	vector<uint32_t> cursors(m_binOffsets.cbegin(), m_binOffsets.cend() - 1);
+	m_binTriangles.resize(m_binOffsets.back());
+	for (auto t = 0u; t < numTriangles; ++t) forEachBin(t, [&](size_t bin) { m_binTriangles[cursors[bin]++] = t; });
+
+	m_gathered.assign(numTriangles, 0);
+}
+
+//--------------------------------------------------------------------------------------
+// Triangles of the bins covering the pieces of all the levels, once each, in the order
+// of the triangles for the locality of the vertices
+//--------------------------------------------------------------------------------------
+void CPUClipmapVoxelizer::gatherTriangles()
+{
+	m_triangles.clear();
+	for (uint8_t i = 0; i < GetNumLevels(); ++i)
+	{
+		for (const auto& piece : m_pieces[i])
+		{
+			uint32_t lo[3], hi[3];
+			for (uint8_t j = 0; j < 3; ++j)
+			{
+				lo[j] = (piece.Region.Min[j] << i) / m_binSize;
+				hi[j] = (min)(((piece.Region.Max[j] << i) - 1) / m_binSize, m_numBins - 1);
+			}
+
+			for (auto z = lo[2]; z <= hi[2]; ++z)
+				for (auto y = lo[1]; y <= hi[1]; ++y)
+					for (auto x = lo[0]; x <= hi[0]; ++x)
+					{
+						const auto bin = (static_cast<size_t>(z) * m_numBins + y) * m_numBins + x;
+						for (auto j = m_binOffsets[bin]; j < m_binOffsets[bin + 1]; ++j)
+						{
+							const auto t = m_binTriangles[j];
+							if (m_gathered[t]) continue;
+							m_gathered[t] = 1;
+							m_triangles.emplace_back(t);
+						}
+					}
+		}
+	}
+
+	for (const auto& t : m_triangles) m_gathered[t] = 0;
+	sort(m_triangles.begin(), m_triangles.end());
+}
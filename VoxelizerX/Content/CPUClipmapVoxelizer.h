@@ -0,0 +1,89 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CPUVoxelizer.h"
+
+//--------------------------------------------------------------------------------------
+// Surface voxelizer of a static mesh into a clipmap around a moving focus point. Level L
+// is a window of size^3 voxels onto the virtual grid of the world bound at the finest
+// size >> L, so the levels have the same resolution and doubling extents, and the last
+// one usually covers the whole bound. Each window is centered on the focus, snapped to
+// its voxels and clamped to the bound, and stored toroidally: the voxel (x, y, z) of the
+// virtual grid lives at (x % size, y % size, z % size) of the level grid. When the focus
+// moves, only the slabs newly exposed by each window are cleared and voxelized, in a
+// single pass for all the levels over the triangles binned near them. The result is the
+// same as a full voxelization of the virtual grids, cropped to the windows.
+//--------------------------------------------------------------------------------------
+class CPUClipmapVoxelizer :
+	public CPUVoxelizer
+{
+public:
+	CPUClipmapVoxelizer();
+	virtual ~CPUClipmapVoxelizer();
+
+	// The finest size must be divisible by 2^(numLevels - 1), and the coarsest size, which
+	// is the finest size >> (numLevels - 1), at least the size. idBits is as in
+	// VoxelGrid::Create.
+	bool Create(uint32_t size, uint8_t numLevels, uint32_t finestSize, const float bound[4], uint8_t idBits = 0);
+
+	// The mesh is referenced rather than copied, so it must outlive the updates. Setting
+	// it, or changing its data afterward and calling Invalidate, forces a full update.
+	void SetMesh(const uint8_t* pVertices, uint32_t stride, const uint32_t* pIndices, uint32_t numIndices);
+	void Invalidate();
+
+	// Returns false if no window has moved
+	bool Update(const float focus[3], uint32_t numThreads = 0);
+
+	const VoxelGrid& GetLevel(uint8_t level) const;
+	uint8_t GetNumLevels() const;
+
+	// Window of the level in the voxels of its virtual grid, with Y flipped as the grids
+	const VoxelRegion& GetWindow(uint8_t level) const;
+
+	// Bound (center, radius) of the window of the level in world space
+	void GetWindowBound(uint8_t level, float bound[4]) const;
+
+	// Voxel of the level at the coordinates of its virtual grid, which must be in the window
+	uint32_t Get(uint8_t level, uint32_t x, uint32_t y, uint32_t z) const;
+
+	// Voxels of all the levels written by the last update
+	size_t GetNumUpdatedVoxels() const;
+
+protected:
+	// Box of a window with a constant toroidal offset to the level grid
+	struct Piece
+	{
+		VoxelRegion	Region;
+		int			Offset[3];
+	};
+
+	void addSlab(uint8_t level, const VoxelRegion& slab);
+	void buildBins();
+	void gatherTriangles();
+
+	std::vector<VoxelGrid>			m_levels;
+	std::vector<VoxelRegion>		m_windows;
+	std::vector<std::vector<Piece>>	m_pieces;	// Of the last update, per level
+
+	// Triangles overlapping each bin of the finest virtual grid, in offsets and lists
+	std::vector<uint32_t>	m_binOffsets;
+	std::vector<uint32_t>	m_binTriangles;
+	std::vector<uint32_t>	m_triangles;	// Near the pieces of the last update
+	std::vector<uint8_t>	m_gathered;
+	uint32_t		m_binSize;		// In voxels of the finest virtual grid
+	uint32_t		m_numBins;		// Per axis
+
+	const uint8_t*	m_pVertices;
+	const uint32_t*	m_pIndices;
+	uint32_t		m_stride;
+	uint32_t		m_numIndices;
+	uint32_t		m_size;
+	uint32_t		m_finestSize;
+	float			m_bound[4];
+
+	size_t			m_numUpdatedVoxels;
+	bool			m_valid;
+};
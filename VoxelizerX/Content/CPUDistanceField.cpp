@@ -0,0 +1,344 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "CPUDistanceField.h"
+
+using namespace std;
+
+namespace
+{
+	const uint32_t g_invalidTri = UINT32_MAX;
+	const uint8_t g_numSweepRounds = 3;
+
+	float dot(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	void sub(float r[3], const float a[3], const float b[3])
+	{
+		r[0] = a[0] - b[0];
+		r[1] = a[1] - b[1];
+		r[2] = a[2] - b[2];
+	}
+
+	void cross(float r[3], const float a[3], const float b[3])
+	{
+		r[0] = a[1] * b[2] - a[2] * b[1];
+		r[1] = a[2] * b[0] - a[0] * b[2];
+		r[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	void mad(float r[3], const float a[3], float s, const float b[3], float t, const float c[3])
+	{
+		for (uint8_t i = 0; i < 3; ++i) r[i] = a[i] + s * b[i] + t * c[i];
+	}
+
+	//----------------------------------------------------------------------------------
+	// Closest point on the triangle to p by its Voronoi regions (Ericson, Real-Time
+	// Collision Detection 5.1.5)
+	//----------------------------------------------------------------------------------
+	void closestPointOnTriangle(float r[3], const float p[3], const float v[3][3])
+	{
+		float ab[3], ac[3], ap[3];
+		sub(ab, v[1], v[0]);
+		sub(ac, v[2], v[0]);
+		sub(ap, p, v[0]);
+		const auto d1 = dot(ab, ap);
+		const auto d2 = dot(ac, ap);
+		if (d1 <= 0.0f && d2 <= 0.0f) return (void)memcpy(r, v[0], sizeof(float[3]));
+
+		float bp[3];
+		sub(bp, p, v[1]);
+		const auto d3 = dot(ab, bp);
+		const auto d4 = dot(ac, bp);
+		if (d3 >= 0.0f && d4 <= d3) return (void)memcpy(r, v[1], sizeof(float[3]));
+
+		const auto vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+			return mad(r, v[0], d1 / (d1 - d3), ab, 0.0f, ac);
+
+		float cp[3];
+		sub(cp, p, v[2]);
+		const auto d5 = dot(ab, cp);
+		const auto d6 = dot(ac, cp);
+		if (d6 >= 0.0f && d5 <= d6) return (void)memcpy(r, v[2], sizeof(float[3]));
+
+		const auto vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+			return mad(r, v[0], 0.0f, ab, d2 / (d2 - d6), ac);
+
+		const auto va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+		{
+			float bc[3];
+			sub(bc, v[2], v[1]);
+			return mad(r, v[1], (d4 - d3) / ((d4 - d3) + (d5 - d6)), bc, 0.0f, bc);
+		}
+
+		const auto denom = 1.0f / (va + vb + vc);
+		mad(r, v[0], vb * denom, ab, vc * denom, ac);
+	}
+}
+
+CPUDistanceField::CPUDistanceField() :
+	m_size(0),
+	m_voxelSize(0.0f)
+{
+}
+
+CPUDistanceField::~CPUDistanceField()
+{
+}
+
+void CPUDistanceField::Generate(const VoxelGrid& grid, const uint8_t* pVertices, uint32_t stride,
+	const uint32_t* pIndices, uint32_t numIndices, const float bound[4],
+	float bandWidth, DistanceFieldStats* pStats, uint32_t numThreads)
+{
+	PROFILE_SCOPE("CPUDistanceField::Generate");
+
+	const auto start = chrono::steady_clock::now();
+	m_size = grid.GetSize();
+	m_voxelSize = 2.0f * bound[3] / m_size;
+
+	// Triangles in voxels, as CPUVoxelizer, with Y flipped
+	const auto gridSize = static_cast<float>(m_size);
+	const auto scale = 0.5f * gridSize / bound[3];
+	const auto numTriangles = numIndices / 3;
+	vector<Triangle> triangles(numTriangles);
+	ParallelFor(0, numTriangles, [&](uint32_t t)
+	{
+		auto& triangle = triangles[t];
+		memset(triangle.N, 0, sizeof(triangle.N));
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			float attribs[6];
+			memcpy(attribs, &pVertices[static_cast<size_t>(pIndices[t * 3 + i]) * stride], sizeof(attribs));
+			triangle.V[i][0] = (attribs[0] - bound[0]) * scale + 0.5f * gridSize;
+			triangle.V[i][1] = (bound[1] - attribs[1]) * scale + 0.5f * gridSize;
+			triangle.V[i][2] = (attribs[2] - bound[2]) * scale + 0.5f * gridSize;
+
+			triangle.N[0] += attribs[3];
+			triangle.N[1] -= attribs[4];
+			triangle.N[2] += attribs[5];
+		}
+	}, numThreads);
+
+	// Bin the triangles to the Z slices of the voxels within the band
+	const auto maxCoord = static_cast<int>(m_size) - 1;
+	vector<vector<uint32_t>> slices(m_size);
+	for (auto t = 0u; t < numTriangles; ++t)
+	{
+		const auto& v = triangles[t].V;
+		const auto minZ = (min)(v[0][2], (min)(v[1][2], v[2][2]));
+		const auto maxZ = (max)(v[0][2], (max)(v[1][2], v[2][2]));
+		const auto lo = (max)(static_cast<int>(ceil(minZ - 0.5f - bandWidth)), 0);
+		const auto hi = (min)(static_cast<int>(floor(maxZ - 0.5f + bandWidth)), maxCoord);
+		for (auto z = lo; z <= hi; ++z) slices[z].emplace_back(t);
+	}
+
+	// Exact distances within the band, where the slices are independent. The distances
+	// are squared until the end.
+	const auto numVoxels = grid.GetNumVoxels();
+	const auto pVoxels = grid.GetData();
+	m_distances.assign(numVoxels, FLT_MAX);
+	vector<float> closestPoints(numVoxels * 3, FLT_MAX);
+	vector<uint8_t> isInside(numVoxels);
+	vector<uint64_t> numSeeds(m_size, 0);
+	ParallelFor(0, m_size, [&](uint32_t z)
+	{
+		seedSlice(z, triangles, slices[z], pVoxels, bandWidth, closestPoints, isInside, numSeeds[z]);
+	}, numThreads);
+
+	const auto seeded = chrono::steady_clock::now();
+
+	// Propagate the closest points
+	for (uint8_t i = 0; i < g_numSweepRounds; ++i)
+		for (uint8_t axis = 0; axis < 3; ++axis) sweep(axis, closestPoints, numThreads);
+
+	// Signed distances in the model space
+	ParallelFor(0, m_size, [&](uint32_t z)
+	{
+		const auto sliceSize = static_cast<size_t>(m_size) * m_size;
+		for (auto i = z * sliceSize; i < (z + 1) * sliceSize; ++i)
+			if (m_distances[i] < FLT_MAX)
+				m_distances[i] = sqrt(m_distances[i]) * (isInside[i] ? -m_voxelSize : m_voxelSize);
+	}, numThreads);
+
+	if (pStats)
+	{
+		pStats->NumSeeds = 0;
+		for (const auto& n : numSeeds) pStats->NumSeeds += n;
+		pStats->SeedingTime = chrono::duration<double, milli>(seeded - start).count();
+		pStats->SweepingTime = chrono::duration<double, milli>(chrono::steady_clock::now() - seeded).count();
+	}
+}
+
+const vector<float>& CPUDistanceField::GetDistances() const
+{
+	return m_distances;
+}
+
+uint32_t CPUDistanceField::GetSize() const
+{
+	return m_size;
+}
+
+bool CPUDistanceField::WriteRaw(const char* fileName) const
+{
+	ofstream file(fileName, ios::binary);
+	if (!file) return false;
+
+	const uint32_t header[] = { 0x44535856, 1, m_size };
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(&m_voxelSize), sizeof(float));
+	file.write(reinterpret_cast<const char*>(m_distances.data()), sizeof(float) * m_distances.size());
+
+	return file.good();
+}
+
+//--------------------------------------------------------------------------------------
+// Exact closest points of the voxels of the slice within the band of the triangles, and
+// the signs of all the voxels of the slice: the surface voxels, with normals, are signed
+// by the normal of the closest triangle, and the others by the coverage of the fill.
+//--------------------------------------------------------------------------------------
+void CPUDistanceField::seedSlice(uint32_t z, const vector<Triangle>& triangles, const vector<uint32_t>& slice,
+	const uint32_t* pVoxels, float bandWidth, vector<float>& closestPoints, vector<uint8_t>& isInside,
+	uint64_t& numSeeds)
+{
+	const auto sliceSize = static_cast<size_t>(m_size) * m_size;
+	const auto sliceOffset = z * sliceSize;
+	const auto maxCoord = static_cast<int>(m_size) - 1;
+	vector<uint32_t> closestTris(sliceSize, g_invalidTri);
+
+	for (const auto& t : slice)
+	{
+		const auto& v = triangles[t].V;
+		float e[2][3], plane[3];
+		sub(e[0], v[1], v[0]);
+		sub(e[1], v[2], v[0]);
+		cross(plane, e[0], e[1]);
+		const auto len = sqrt(dot(plane, plane));
+		const auto rcpLen = len > 0.0f ? 1.0f / len : 0.0f;
+
+		int lo[2], hi[2];
+		for (uint8_t i = 0; i < 2; ++i)
+		{
+			const auto minV = (min)(v[0][i], (min)(v[1][i], v[2][i]));
+			const auto maxV = (max)(v[0][i], (max)(v[1][i], v[2][i]));
+			lo[i] = (max)(static_cast<int>(ceil(minV - 0.5f - bandWidth)), 0);
+			hi[i] = (min)(static_cast<int>(floor(maxV - 0.5f + bandWidth)), maxCoord);
+		}
+
+		for (auto y = lo[1]; y <= hi[1]; ++y)
+		{
+			for (auto x = lo[0]; x <= hi[0]; ++x)
+			{
+				// The distance to the plane is a lower bound
+				const auto i = static_cast<size_t>(y) * m_size + x;
+				const float p[] = { x + 0.5f, y + 0.5f, z + 0.5f };
+				float closest[3], d[3];
+				sub(d, p, v[0]);
+				const auto planeDist = dot(d, plane) * rcpLen;
+				if (planeDist * planeDist >= m_distances[sliceOffset + i]) continue;
+
+				closestPointOnTriangle(closest, p, v);
+				sub(d, p, closest);
+
+				const auto distSq = dot(d, d);
+				if (distSq < m_distances[sliceOffset + i])
+				{
+					m_distances[sliceOffset + i] = distSq;
+					memcpy(&closestPoints[(sliceOffset + i) * 3], closest, sizeof(closest));
+					closestTris[i] = t;
+				}
+			}
+		}
+	}
+
+	const auto bandWidthSq = bandWidth * bandWidth;
+	for (auto i = 0u; i < sliceSize; ++i)
+	{
+		const auto idx = sliceOffset + i;
+		const auto t = closestTris[i];
+		if (t != g_invalidTri && m_distances[idx] <= bandWidthSq) ++numSeeds;
+
+		const auto voxel = pVoxels[idx];
+		if (t != g_invalidTri && (voxel & ~VoxelGrid::CoverageMask))
+		{
+			const float p[] = { i % m_size + 0.5f, i / m_size + 0.5f, z + 0.5f };
+			float d[3];
+			sub(d, p, &closestPoints[idx * 3]);
+			isInside[idx] = dot(d, triangles[t].N) < 0.0f ? 1 : 0;
+		}
+		else isInside[idx] = voxel & VoxelGrid::CoverageMask ? 1 : 0;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Forward and backward passes along the axis, where each voxel tries the closest point
+// of its predecessor. The rows of X are updated from their neighbor rows at once for Y
+// and Z, where the lines are distributed over Z and Y respectively, and the X sweep
+// runs along each row. The missing closest points are at FLT_MAX, whose squared
+// distances overflow to infinity, so they never win.
+//--------------------------------------------------------------------------------------
+void CPUDistanceField::sweep(uint8_t axis, vector<float>& closestPoints, uint32_t numThreads)
+{
+	const auto size = m_size;
+	const auto update = [&](size_t idx, size_t prev, float x, float y, float z)
+	{
+		const auto closest = &closestPoints[prev * 3];
+		const auto dx = x - closest[0];
+		const auto dy = y - closest[1];
+		const auto dz = z - closest[2];
+		const auto distSq = dx * dx + dy * dy + dz * dz;
+		if (distSq < m_distances[idx])
+		{
+			m_distances[idx] = distSq;
+			memcpy(&closestPoints[idx * 3], closest, sizeof(float[3]));
+		}
+	};
+
+	const auto updateRow = [&](uint32_t y, uint32_t z, uint32_t prevY, uint32_t prevZ)
+	{
+		const auto idx = (static_cast<size_t>(z) * size + y) * size;
+		const auto prev = (static_cast<size_t>(prevZ) * size + prevY) * size;
+		for (auto x = 0u; x < size; ++x) update(idx + x, prev + x, x + 0.5f, y + 0.5f, z + 0.5f);
+	};
+
+	switch (axis)
+	{
+	case 0:
+		ParallelFor(0, size, [&](uint32_t z)
+		{
+			for (auto y = 0u; y < size; ++y)
+			{
+				const auto idx = (static_cast<size_t>(z) * size + y) * size;
+				for (auto x = 1u; x < size; ++x) update(idx + x, idx + x - 1, x + 0.5f, y + 0.5f, z + 0.5f);
+				for (auto x = size - 1; x-- > 0;) update(idx + x, idx + x + 1, x + 0.5f, y + 0.5f, z + 0.5f);
+			}
+		}, numThreads);
+		break;
+	case 1:
+		ParallelFor(0, size, [&](uint32_t z)
+		{
+			for (auto y = 1u; y < size; ++y) updateRow(y, z, y - 1, z);
+			for (auto y = size - 1; y-- > 0;) updateRow(y, z, y + 1, z);
+		}, numThreads);
+		break;
+	default:
+		ParallelFor(0, size, [&](uint32_t y)
+		{
+			for (auto z = 1u; z < size; ++z) updateRow(y, z, y, z - 1);
+			for (auto z = size - 1; z-- > 0;) updateRow(y, z, y, z + 1);
+		}, numThreads);
+	}
+}
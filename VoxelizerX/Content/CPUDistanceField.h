@@ -0,0 +1,63 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "VoxelGrid.h"
+
+//--------------------------------------------------------------------------------------
+// Counters of the distance field generation, where seeds are the voxels within the band
+// of exact triangle distances
+//--------------------------------------------------------------------------------------
+struct DistanceFieldStats
+{
+	uint64_t NumSeeds;
+	double SeedingTime;		// In milliseconds
+	double SweepingTime;	// In milliseconds
+};
+
+//--------------------------------------------------------------------------------------
+// Signed distance field at the voxel centers of level 0 of a solid grid, in the units of
+// the model space, and negative inside. The voxels within the band around the triangles
+// take the exact distances to them, and their closest points on the surface are then
+// propagated to the rest of the grid by sweeps along X, Y, and Z in both directions,
+// where the lines of each sweep are independent and processed in parallel. The sign is
+// taken from the solid fill, except for the surface voxels, which are signed by the
+// normal of the closest triangle.
+//--------------------------------------------------------------------------------------
+class CPUDistanceField
+{
+public:
+	CPUDistanceField();
+	virtual ~CPUDistanceField();
+
+	// Vertices are float3 position followed by float3 normal, with the given stride in bytes.
+	// The band width is in voxels, and at least sqrt(3) / 2 to cover all the surface voxels.
+	void Generate(const VoxelGrid& grid, const uint8_t* pVertices, uint32_t stride,
+		const uint32_t* pIndices, uint32_t numIndices, const float bound[4],
+		float bandWidth = 1.0f, DistanceFieldStats* pStats = nullptr, uint32_t numThreads = 0);
+
+	const std::vector<float>& GetDistances() const;
+	uint32_t GetSize() const;
+
+	// Binary layout: "VXSD", uint32_t version (1), uint32_t size, float voxel size, then
+	// the distances in the voxel order of VoxelGrid, all little-endian
+	bool WriteRaw(const char* fileName) const;
+
+protected:
+	struct Triangle
+	{
+		float V[3][3];
+		float N[3];
+	};
+
+	void seedSlice(uint32_t z, const std::vector<Triangle>& triangles, const std::vector<uint32_t>& slice,
+		const uint32_t* pVoxels, float bandWidth, std::vector<float>& closestPoints,
+		std::vector<uint8_t>& isInside, uint64_t& numSeeds);
+	void sweep(uint8_t axis, std::vector<float>& closestPoints, uint32_t numThreads);
+
+	std::vector<float> m_distances;
+	uint32_t m_size;
+	float m_voxelSize;
+};
@@ -0,0 +1,292 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstring>
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "CPUDynamicVoxelizer.h"
+
+using namespace std;
+
+namespace
+{
+	const uint32_t g_itemsPerTask = 1024;
+	const uint32_t g_cleanBrick = UINT32_MAX;
+	const size_t g_attribSize = sizeof(float[6]);	// Position and normal
+}
+
+CPUDynamicVoxelizer::CPUDynamicVoxelizer() :
+	m_pIndices(nullptr),
+	m_stride(0),
+	m_numVertices(0),
+	m_numIndices(0),
+	m_bound(),
+	m_brickSize(8),
+	m_numBricks(0),
+	m_pGrid(nullptr),
+	m_gridSize(0),
+	m_valid(false)
+{
+}
+
+CPUDynamicVoxelizer::~CPUDynamicVoxelizer()
+{
+}
+
+void CPUDynamicVoxelizer::SetMesh(uint32_t stride, uint32_t numVertices, const uint32_t* pIndices,
+	uint32_t numIndices, const float bound[4], uint32_t brickSize)
+{
+	m_pIndices = pIndices;
+	m_stride = stride;
+	m_numVertices = numVertices;
+	m_numIndices = numIndices;
+	memcpy(m_bound, bound, sizeof(m_bound));
+
+	m_brickSize = 1;
+	while (m_brickSize < brickSize) m_brickSize <<= 1;
+	m_valid = false;
+}
+
+void CPUDynamicVoxelizer::Invalidate()
+{
+	m_valid = false;
+}
+
+bool CPUDynamicVoxelizer::Update(VoxelGrid& grid, const uint8_t* pVertices, uint32_t numThreads)
+{
+	const auto size = grid.GetSize();
+	const auto gridSize = static_cast<float>(size);
+	const auto numTriangles = m_numIndices / 3;
+	const auto numTriangleTasks = (numTriangles + g_itemsPerTask - 1) / g_itemsPerTask;
+	const VoxelRegion gridRegion = { { 0, 0, 0 }, { size, size, size } };
+	const size_t vertexDataSize = static_cast<size_t>(m_numVertices) * m_stride;
+
+	// Voxel range of a triangle at the given vertices, where lo > hi if outside the grid
+	const auto getRange = [&](uint32_t t, const uint8_t* pTriVertices, int range[6])
+	{
+		float v[3][3], n[3];
+		loadTriangle(v, n, pTriVertices, m_stride, &m_pIndices[t * 3], m_bound, nullptr, gridSize);
+		if (!getVoxelRange(v, gridRegion, range, &range[3]))
+		{
+			range[0] = range[1] = range[2] = 0;
+			range[3] = range[4] = range[5] = -1;
+		}
+	};
+
+	if (!m_valid || m_pGrid != &grid || m_gridSize != size)
+	{
+		PROFILE_SCOPE("CPUDynamicVoxelizer::Update");
+
+		m_numBricks = (size + m_brickSize - 1) / m_brickSize;
+		m_brickSlots.assign(static_cast<size_t>(m_numBricks) * m_numBricks * m_numBricks, g_cleanBrick);
+		m_dirtyBricks.resize(m_brickSlots.size());
+		for (size_t i = 0; i < m_dirtyBricks.size(); ++i) m_dirtyBricks[i] = static_cast<uint32_t>(i);
+		m_dirtyTriangles.assign(numTriangles, 1);
+		m_ranges.resize(static_cast<size_t>(numTriangles) * 6);
+		ParallelFor(0, numTriangleTasks, [&](uint32_t task)
+		{
+			const auto end = (min)((task + 1) * g_itemsPerTask, numTriangles);
+			for (auto t = task * g_itemsPerTask; t < end; ++t) getRange(t, pVertices, &m_ranges[t * 6]);
+		}, numThreads);
+
+		grid.Clear();
+		Voxelize(grid, pVertices, m_stride, m_pIndices, m_numIndices, m_bound, numThreads);
+
+		m_vertices.assign(pVertices, pVertices + vertexDataSize);
+		m_pGrid = &grid;
+		m_gridSize = size;
+		m_valid = true;
+
+		return true;
+	}
+
+	// Dirty vertices and triangles, with the new ranges of the dirty triangles
+	vector<uint8_t> dirtyVertices(m_numVertices);
+	ParallelFor(0, (m_numVertices + g_itemsPerTask - 1) / g_itemsPerTask, [&](uint32_t task)
+	{
+		const auto end = (min)((task + 1) * g_itemsPerTask, m_numVertices);
+		for (auto i = task * g_itemsPerTask; i < end; ++i)
+		{
+			const auto offset = static_cast<size_t>(i) * m_stride;
+			dirtyVertices[i] = memcmp(&pVertices[offset], &m_vertices[offset], g_attribSize) != 0;
+		}
+	}, numThreads);
+
+	m_dirtyBricks.clear();
+	if (find(dirtyVertices.cbegin(), dirtyVertices.cend(), 1) == dirtyVertices.cend())
+	{
+		fill(m_dirtyTriangles.begin(), m_dirtyTriangles.end(), 0);
+
+		return false;
+	}
+
+	vector<int> newRanges(m_ranges.size());
+	ParallelFor(0, numTriangleTasks, [&](uint32_t task)
+	{
+		const auto end = (min)((task + 1) * g_itemsPerTask, numTriangles);
+		for (auto t = task * g_itemsPerTask; t < end; ++t)
+		{
+			const auto pIndices = &m_pIndices[t * 3];
+			m_dirtyTriangles[t] = dirtyVertices[pIndices[0]] | dirtyVertices[pIndices[1]] | dirtyVertices[pIndices[2]];
+			if (m_dirtyTriangles[t]) getRange(t, pVertices, &newRanges[t * 6]);
+		}
+	}, numThreads);
+
+	// Dirty bricks at the old and the new positions
+	for (auto t = 0u; t < numTriangles; ++t)
+	{
+		if (!m_dirtyTriangles[t]) continue;
+
+		markBricks(&m_ranges[t * 6]);
+		markBricks(&newRanges[t * 6]);
+		copy_n(&newRanges[t * 6], 6, &m_ranges[t * 6]);
+	}
+
+	m_vertices.assign(pVertices, pVertices + vertexDataSize);
+	if (m_dirtyBricks.empty()) return false;
+
+	PROFILE_SCOPE("CPUDynamicVoxelizer::Update");
+
+	// All the triangles touching each dirty brick
+	vector<vector<uint32_t>> brickTriangles(m_dirtyBricks.size());
+	for (auto t = 0u; t < numTriangles; ++t)
+	{
+		const auto range = &m_ranges[t * 6];
+		if (range[0] > range[3]) continue;
+
+		for (auto z = range[2] / m_brickSize; z <= range[5] / m_brickSize; ++z)
+		{
+			for (auto y = range[1] / m_brickSize; y <= range[4] / m_brickSize; ++y)
+			{
+				for (auto x = range[0] / m_brickSize; x <= range[3] / m_brickSize; ++x)
+				{
+					const auto slot = m_brickSlots[(static_cast<size_t>(z) * m_numBricks + y) * m_numBricks + x];
+					if (slot != g_cleanBrick) brickTriangles[slot].emplace_back(t);
+				}
+			}
+		}
+	}
+
+	// Clear and voxelize the dirty bricks of level 0, where the triangles are clipped to
+	// the brick, so each brick is only written by its own task
+	ParallelFor(0, static_cast<uint32_t>(m_dirtyBricks.size()), [&](uint32_t i)
+	{
+		const auto brick = m_dirtyBricks[i];
+		const uint32_t coords[] = { brick % m_numBricks, brick / m_numBricks % m_numBricks, brick / m_numBricks / m_numBricks };
+		VoxelRegion region;
+		for (uint8_t j = 0; j < 3; ++j)
+		{
+			region.Min[j] = coords[j] * m_brickSize;
+			region.Max[j] = (min)(region.Min[j] + m_brickSize, size);
+		}
+
+		const auto pData = grid.GetData();
+		for (auto z = region.Min[2]; z < region.Max[2]; ++z)
+		{
+			for (auto y = region.Min[1]; y < region.Max[1]; ++y)
+			{
+				fill_n(&pData[(static_cast<size_t>(z) * size + y) * size + region.Min[0]], region.Max[0] - region.Min[0], 0u);
+				if (grid.GetIDBits())
+					for (auto x = region.Min[0]; x < region.Max[0]; ++x) grid.SetID(x, y, z, VoxelGrid::EmptyID);
+			}
+		}
+
+		for (const auto& t : brickTriangles[i])
+		{
+			float v[3][3], n[3];
+			loadTriangle(v, n, pVertices, m_stride, &m_pIndices[t * 3], m_bound, nullptr, gridSize);
+			voxelizeTriangle(grid, v, n, region, 1, m_objectID);
+		}
+	}, numThreads);
+
+	propagateBricks(grid, numThreads);
+
+	for (const auto& brick : m_dirtyBricks) m_brickSlots[brick] = g_cleanBrick;
+
+	return true;
+}
+
+const vector<uint8_t>& CPUDynamicVoxelizer::GetDirtyTriangles() const
+{
+	return m_dirtyTriangles;
+}
+
+uint32_t CPUDynamicVoxelizer::GetNumDirtyBricks() const
+{
+	return static_cast<uint32_t>(m_dirtyBricks.size());
+}
+
+uint32_t CPUDynamicVoxelizer::GetBrickSize() const
+{
+	return m_brickSize;
+}
+
+void CPUDynamicVoxelizer::markBricks(const int range[6])
+{
+	if (range[0] > range[3]) return;
+
+	for (auto z = range[2] / m_brickSize; z <= range[5] / m_brickSize; ++z)
+	{
+		for (auto y = range[1] / m_brickSize; y <= range[4] / m_brickSize; ++y)
+		{
+			for (auto x = range[0] / m_brickSize; x <= range[3] / m_brickSize; ++x)
+			{
+				const auto brick = (z * m_numBricks + y) * m_numBricks + x;
+				auto& slot = m_brickSlots[brick];
+				if (slot != g_cleanBrick) continue;
+
+				slot = static_cast<uint32_t>(m_dirtyBricks.size());
+				m_dirtyBricks.emplace_back(brick);
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Rebuild the coarser levels over the dirty bricks. The bricks shrink by half per level
+// into cells, which are disjoint, so they are processed in parallel. Once the cells are
+// single voxels, they are merged into their parents, so that each one is rebuilt once.
+//--------------------------------------------------------------------------------------
+void CPUDynamicVoxelizer::propagateBricks(VoxelGrid& grid, uint32_t numThreads)
+{
+	auto cells = m_dirtyBricks;
+	auto numCells = m_numBricks;	// Per axis
+	auto cellSize = m_brickSize;
+	for (uint8_t i = 1; i < grid.GetNumLevels(); ++i)
+	{
+		if (cellSize > 1) cellSize >>= 1;
+		else
+		{
+			const auto numParents = (numCells + 1) / 2;
+			for (auto& cell : cells)
+			{
+				const auto x = cell % numCells / 2;
+				const auto y = cell / numCells % numCells / 2;
+				const auto z = cell / numCells / numCells / 2;
+				cell = (z * numParents + y) * numParents + x;
+			}
+			sort(cells.begin(), cells.end());
+			cells.erase(unique(cells.begin(), cells.end()), cells.end());
+			numCells = numParents;
+		}
+
+		const auto size = grid.GetSize(i);
+		ParallelFor(0, static_cast<uint32_t>(cells.size()), [&](uint32_t j)
+		{
+			const auto cell = cells[j];
+			const uint32_t coords[] = { cell % numCells, cell / numCells % numCells, cell / numCells / numCells };
+			uint32_t lo[3], hi[3];
+			for (uint8_t k = 0; k < 3; ++k)
+			{
+				lo[k] = (min)(coords[k] * cellSize, size - 1);
+				hi[k] = (min)(lo[k] + cellSize, size);
+			}
+
+			for (auto z = lo[2]; z < hi[2]; ++z)
+				for (auto y = lo[1]; y < hi[1]; ++y)
+					propagateRow(grid, i, y, z, lo[0], hi[0]);
+		}, numThreads);
+	}
+}
@@ -0,0 +1,62 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CPUVoxelizer.h"
+
+//--------------------------------------------------------------------------------------
+// Surface voxelizer of a deforming mesh with a fixed topology, e.g. a skinned character,
+// whose vertices are given every frame. A triangle is dirty if any of its vertices has
+// changed since the last update, and the grid is divided into cubic bricks, which are
+// dirty if touched by a dirty triangle at either its old or its new position. Only the
+// dirty bricks are cleared and voxelized again, from all the triangles touching them,
+// and the coarser levels are rebuilt over them. The result is the same as a full
+// voxelization, as long as the grid is only written by this voxelizer between updates.
+//--------------------------------------------------------------------------------------
+class CPUDynamicVoxelizer :
+	public CPUVoxelizer
+{
+public:
+	CPUDynamicVoxelizer();
+	virtual ~CPUDynamicVoxelizer();
+
+	// The indices are referenced rather than copied, so they must outlive the updates.
+	// The brick size is rounded up to a power of 2. Setting the mesh forces a full update.
+	void SetMesh(uint32_t stride, uint32_t numVertices, const uint32_t* pIndices,
+		uint32_t numIndices, const float bound[4], uint32_t brickSize = 8);
+	void Invalidate();
+
+	// Voxelize the vertices of the frame, in the stride and count of the mesh, where only
+	// the positions and normals are compared. Returns false if the grid is unchanged.
+	bool Update(VoxelGrid& grid, const uint8_t* pVertices, uint32_t numThreads = 0);
+
+	// Per-triangle mask and number of dirty bricks of the last update
+	const std::vector<uint8_t>& GetDirtyTriangles() const;
+	uint32_t GetNumDirtyBricks() const;
+	uint32_t GetBrickSize() const;
+
+protected:
+	void markBricks(const int range[6]);
+	void propagateBricks(VoxelGrid& grid, uint32_t numThreads);
+
+	const uint32_t*	m_pIndices;
+	uint32_t		m_stride;
+	uint32_t		m_numVertices;
+	uint32_t		m_numIndices;
+	float			m_bound[4];
+
+	uint32_t		m_brickSize;
+	uint32_t		m_numBricks;		// Per axis
+	std::vector<uint32_t> m_brickSlots;	// Indices into m_dirtyBricks, if dirty
+	std::vector<uint32_t> m_dirtyBricks;
+
+	std::vector<uint8_t> m_vertices;	// Of the last update
+	std::vector<int> m_ranges;			// Voxel ranges [lo, hi] of the triangles, 6 per triangle
+	std::vector<uint8_t> m_dirtyTriangles;
+
+	const VoxelGrid* m_pGrid;
+	uint32_t		m_gridSize;
+	bool			m_valid;
+};
@@ -0,0 +1,235 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <chrono>
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "CPUGreedyMesher.h"
+
+using namespace std;
+
+namespace
+{
+	const uint32_t g_invalidIdx = UINT32_MAX;
+
+	uint32_t findLowestBit(uint64_t x)
+	{
+		auto n = 0u;
+		if (!(x & 0xffffffff)) { n += 32; x >>= 32; }
+		if (!(x & 0xffff)) { n += 16; x >>= 16; }
+		if (!(x & 0xff)) { n += 8; x >>= 8; }
+		if (!(x & 0xf)) { n += 4; x >>= 4; }
+		if (!(x & 0x3)) { n += 2; x >>= 2; }
+		if (!(x & 0x1)) ++n;
+
+		return n;
+	}
+
+	// Bits of the run [u0, u0 + w) in the given word of a row
+	uint64_t getRunMask(uint32_t word, uint32_t u0, uint32_t w)
+	{
+		const auto first = (max)(u0, word * 64);
+		const auto last = (min)(u0 + w, word * 64 + 64);
+		const auto n = last - first;
+
+		return (n >= 64 ? ~0ull : (1ull << n) - 1) << (first - word * 64);
+	}
+
+	// Number of set bits from u0 on, which is at least 1
+	uint32_t getRunLength(const uint64_t* row, uint32_t u0, uint32_t size)
+	{
+		auto length = 0u;
+		for (auto u = u0; u < size;)
+		{
+			const auto shift = u & 63;
+			const auto inverted = ~(row[u >> 6] >> shift);
+			const auto n = (min)(inverted ? findLowestBit(inverted) : 64u, 64 - shift);
+			length += n;
+			u += n;
+			if (n < 64 - shift) break;
+		}
+
+		return length;
+	}
+
+	bool hasRun(const uint64_t* row, uint32_t u0, uint32_t w)
+	{
+		for (auto i = u0 >> 6; i <= (u0 + w - 1) >> 6; ++i)
+		{
+			const auto mask = getRunMask(i, u0, w);
+			if ((row[i] & mask) != mask) return false;
+		}
+
+		return true;
+	}
+
+	void clearRun(uint64_t* row, uint32_t u0, uint32_t w)
+	{
+		for (auto i = u0 >> 6; i <= (u0 + w - 1) >> 6; ++i)
+			row[i] &= ~getRunMask(i, u0, w);
+	}
+}
+
+CPUGreedyMesher::CPUGreedyMesher()
+{
+}
+
+CPUGreedyMesher::~CPUGreedyMesher()
+{
+}
+
+void CPUGreedyMesher::Mesh(const VoxelGrid& grid, const float bound[4], uint8_t level,
+	MeshStats* pStats, uint32_t numThreads)
+{
+	PROFILE_SCOPE("CPUGreedyMesher::Mesh");
+
+	const auto start = chrono::steady_clock::now();
+	const auto size = grid.GetSize(level);
+
+	// Occupancy bytes of the level
+	vector<uint8_t> occupancy(grid.GetNumVoxels(level));
+	const auto pData = grid.GetData(level);
+	ParallelFor(0, size, [&](uint32_t z)
+	{
+		const auto sliceSize = static_cast<size_t>(size) * size;
+		for (auto i = z * sliceSize; i < (z + 1) * sliceSize; ++i)
+			occupancy[i] = (pData[i] & VoxelGrid::CoverageMask) ? 1 : 0;
+	}, numThreads);
+
+	// Mesh the slices of the 6 face directions in parallel
+	vector<Slice> slices(6 * size);
+	ParallelFor(0, 6 * size, [&](uint32_t i)
+	{
+		meshSlice(grid, occupancy, bound, level, static_cast<uint8_t>(i / size), i % size, slices[i]);
+	}, numThreads);
+
+	// Concatenate the slices in order
+	size_t numVertices = 0, numIndices = 0;
+	uint64_t numFaces = 0;
+	for (const auto& slice : slices)
+	{
+		numVertices += slice.Vertices.size();
+		numIndices += slice.Indices.size();
+		numFaces += slice.NumFaces;
+	}
+
+	m_vertices.resize(numVertices);
+	m_indices.resize(numIndices);
+	numVertices = numIndices = 0;
+	for (const auto& slice : slices)
+	{
+		copy(slice.Vertices.cbegin(), slice.Vertices.cend(), m_vertices.begin() + numVertices);
+		for (const auto& index : slice.Indices) m_indices[numIndices++] = static_cast<uint32_t>(numVertices) + index;
+		numVertices += slice.Vertices.size();
+	}
+
+	if (pStats)
+	{
+		pStats->NumFaces = numFaces;
+		pStats->NumQuads = m_indices.size() / 6;
+		pStats->NumVertices = m_vertices.size();
+		pStats->NumTriangles = m_indices.size() / 3;
+		pStats->MeshingTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Direction dir is the axis (dir / 2) with the sign of (dir & 1 ? +1 : -1), in voxels
+// with Y down. The slice mask has a row per voxel along the axis v and a bit per voxel
+// along the axis u of the slice plane.
+//--------------------------------------------------------------------------------------
+void CPUGreedyMesher::meshSlice(const VoxelGrid& grid, const vector<uint8_t>& occupancy, const float bound[4],
+	uint8_t level, uint8_t dir, uint32_t slice, Slice& result) const
+{
+	const auto size = grid.GetSize(level);
+	const auto numWords = (size + 63) / 64;
+	const uint8_t axis = dir / 2, u = (axis + 1) % 3, v = (axis + 2) % 3;
+	const auto sign = dir & 1 ? 1 : -1;
+	const size_t strides[] = { 1, size, static_cast<size_t>(size) * size };
+
+	// Exposed faces of the slice, whose neighbors along the direction are empty or outside
+	const auto neighbor = static_cast<int>(slice) + sign;
+	const auto hasNeighbor = neighbor >= 0 && neighbor < static_cast<int>(size);
+	vector<uint64_t> mask(static_cast<size_t>(size) * numWords, 0);
+	result.NumFaces = 0;
+	for (auto j = 0u; j < size; ++j)
+	{
+		for (auto i = 0u; i < size; ++i)
+		{
+			const auto idx = slice * strides[axis] + i * strides[u] + j * strides[v];
+			if (!occupancy[idx]) continue;
+			if (hasNeighbor && occupancy[idx + sign * static_cast<ptrdiff_t>(strides[axis])]) continue;
+			mask[j * numWords + (i >> 6)] |= 1ull << (i & 63);
+			++result.NumFaces;
+		}
+	}
+
+	// Corners in the model space, and the normal
+	const auto plane = slice + (sign > 0 ? 1 : 0);
+	Vertex vertex = {};
+	vertex.Nrm[axis] = axis == 1 ? -static_cast<float>(sign) : static_cast<float>(sign);
+	const auto getVertex = [&](uint32_t cu, uint32_t cv)
+	{
+		float p[3];
+		p[axis] = static_cast<float>(plane);
+		p[u] = static_cast<float>(cu);
+		p[v] = static_cast<float>(cv);
+		toModelSpace(vertex.Pos, p, size, bound);
+
+		return vertex;
+	};
+
+	// Counter-clockwise from outside, where (u, v, axis) is a cyclic permutation of the
+	// axes and Y is flipped, so the order of (u, v) is reversed for the positive sign
+	const auto isReversed = sign > 0;
+
+	vector<uint32_t> cornerIndices;
+	const auto addCorner = [&](uint32_t cu, uint32_t cv)
+	{
+		auto& index = cornerIndices[cv * (size + 1) + cu];
+		if (index == g_invalidIdx)
+		{
+			index = static_cast<uint32_t>(result.Vertices.size());
+			result.Vertices.emplace_back(getVertex(cu, cv));
+		}
+
+		return index;
+	};
+
+	// Merge the faces into maximal rectangles
+	for (auto j = 0u; j < size; ++j)
+	{
+		const auto row = &mask[j * numWords];
+		for (auto w = 0u; w < numWords;)
+		{
+			if (!row[w])
+			{
+				++w;
+				continue;
+			}
+
+			if (cornerIndices.empty()) cornerIndices.resize(static_cast<size_t>(size + 1) * (size + 1), g_invalidIdx);
+
+			// Extend the run along the row, and then across the rows
+			const auto u0 = w * 64 + findLowestBit(row[w]);
+			const auto width = getRunLength(row, u0, size);
+			auto height = 1u;
+			while (j + height < size && hasRun(&mask[(j + height) * numWords], u0, width)) ++height;
+			for (auto k = 0u; k < height; ++k) clearRun(&mask[(j + k) * numWords], u0, width);
+
+			const uint32_t corners[] =
+			{
+				addCorner(u0, j),
+				addCorner(u0 + width, j),
+				addCorner(u0 + width, j + height),
+				addCorner(u0, j + height)
+			};
+
+			if (isReversed) result.Indices.insert(result.Indices.end(),
+				{ corners[0], corners[2], corners[1], corners[0], corners[3], corners[2] });
+			else result.Indices.insert(result.Indices.end(),
+				{ corners[0], corners[1], corners[2], corners[0], corners[2], corners[3] });
+		}
+	}
+}
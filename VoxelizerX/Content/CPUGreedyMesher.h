@@ -0,0 +1,34 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "VoxelMesh.h"
+
+//--------------------------------------------------------------------------------------
+// Greedy mesher of the voxel surface: the exposed faces of each slice along each of the
+// 6 face directions are kept as row bitmasks, and merged into maximal rectangles by
+// extending runs of set bits first along the row and then across the rows. Slices are
+// meshed in parallel, and the vertices are shared by the quads of the same slice.
+//--------------------------------------------------------------------------------------
+class CPUGreedyMesher : public VoxelMesh
+{
+public:
+	CPUGreedyMesher();
+	virtual ~CPUGreedyMesher();
+
+	void Mesh(const VoxelGrid& grid, const float bound[4], uint8_t level = 0,
+		MeshStats* pStats = nullptr, uint32_t numThreads = 0);
+
+protected:
+	struct Slice
+	{
+		std::vector<Vertex> Vertices;
+		std::vector<uint32_t> Indices;
+		uint64_t NumFaces;
+	};
+
+	void meshSlice(const VoxelGrid& grid, const std::vector<uint8_t>& occupancy, const float bound[4],
+		uint8_t level, uint8_t dir, uint32_t slice, Slice& result) const;
+};
@@ -0,0 +1,155 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include "Profiler.h"
+#include "CPUIncrementalVoxelizer.h"
+
+using namespace std;
+
+namespace
+{
+	bool isEmpty(const VoxelRegion& region)
+	{
+		return region.Min[0] >= region.Max[0] || region.Min[1] >= region.Max[1] || region.Min[2] >= region.Max[2];
+	}
+}
+
+CPUIncrementalVoxelizer::CPUIncrementalVoxelizer() :
+	m_pVertices(nullptr),
+	m_pIndices(nullptr),
+	m_stride(0),
+	m_numVertices(0),
+	m_numIndices(0),
+	m_bound(),
+	m_pGrid(nullptr),
+	m_gridSize(0),
+	m_transform(),
+	m_region(),
+	m_dirtyRegion(),
+	m_valid(false)
+{
+}
+
+CPUIncrementalVoxelizer::~CPUIncrementalVoxelizer()
+{
+}
+
+void CPUIncrementalVoxelizer::SetMesh(const uint8_t* pVertices, uint32_t stride, uint32_t numVertices,
+	const uint32_t* pIndices, uint32_t numIndices, const float bound[4])
+{
+	m_pVertices = pVertices;
+	m_pIndices = pIndices;
+	m_stride = stride;
+	m_numVertices = numVertices;
+	m_numIndices = numIndices;
+	memcpy(m_bound, bound, sizeof(m_bound));
+	m_valid = false;
+}
+
+void CPUIncrementalVoxelizer::Invalidate()
+{
+	m_valid = false;
+}
+
+bool CPUIncrementalVoxelizer::Update(VoxelGrid& grid, const float transform[3][4], uint32_t numThreads)
+{
+	// Nothing to do for the same mesh, grid and transform
+	const auto valid = m_valid && m_pGrid == &grid && m_gridSize == grid.GetSize();
+	if (valid && memcmp(m_transform, transform, sizeof(m_transform)) == 0)
+	{
+		m_dirtyRegion = VoxelRegion();
+
+		return false;
+	}
+
+	PROFILE_SCOPE("CPUIncrementalVoxelizer::Update");
+
+	const auto region = computeRegion(grid, transform);
+	if (valid)
+	{
+		// Union of the old and the new bounds
+		m_dirtyRegion = region;
+		if (isEmpty(region)) m_dirtyRegion = m_region;
+		else if (!isEmpty(m_region))
+		{
+			for (uint8_t i = 0; i < 3; ++i)
+			{
+				m_dirtyRegion.Min[i] = (min)(m_dirtyRegion.Min[i], m_region.Min[i]);
+				m_dirtyRegion.Max[i] = (max)(m_dirtyRegion.Max[i], m_region.Max[i]);
+			}
+		}
+
+		if (!isEmpty(m_dirtyRegion))
+		{
+			grid.Clear(m_dirtyRegion);
+			voxelize(grid, m_pVertices, m_stride, m_pIndices, m_numIndices, m_bound, transform, m_dirtyRegion, 1, numThreads);
+			propagateMips(grid, m_dirtyRegion, numThreads);
+		}
+	}
+	else
+	{
+		const auto size = grid.GetSize();
+		m_dirtyRegion = { { 0, 0, 0 }, { size, size, size } };
+		grid.Clear();
+		Voxelize(grid, m_pVertices, m_stride, m_pIndices, m_numIndices, m_bound, transform, numThreads);
+	}
+
+	m_pGrid = &grid;
+	m_gridSize = grid.GetSize();
+	memcpy(m_transform, transform, sizeof(m_transform));
+	m_region = region;
+	m_valid = true;
+
+	return true;
+}
+
+const VoxelRegion& CPUIncrementalVoxelizer::GetDirtyRegion() const
+{
+	return m_dirtyRegion;
+}
+
+//--------------------------------------------------------------------------------------
+// Voxel bound of the transformed vertices with the same mapping and flooring as the
+// triangle bounds in voxelizeTriangle, clamped to the grid
+//--------------------------------------------------------------------------------------
+VoxelRegion CPUIncrementalVoxelizer::computeRegion(const VoxelGrid& grid, const float transform[3][4]) const
+{
+	float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (auto i = 0u; i < m_numVertices; ++i)
+	{
+		float p[3];
+		memcpy(p, &m_pVertices[static_cast<size_t>(i) * m_stride], sizeof(p));
+		for (uint8_t j = 0; j < 3; ++j)
+		{
+			const auto c = transform[j][0] * p[0] + transform[j][1] * p[1] + transform[j][2] * p[2] + transform[j][3];
+			lo[j] = (min)(lo[j], c);
+			hi[j] = (max)(hi[j], c);
+		}
+	}
+
+	const auto gridSize = static_cast<float>(grid.GetSize());
+	const auto scale = 0.5f * gridSize / m_bound[3];
+	VoxelRegion region = {};
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		// Y is flipped, so its bounds are swapped
+		const auto minC = i == 1 ? m_bound[1] - hi[1] : lo[i] - m_bound[i];
+		const auto maxC = i == 1 ? m_bound[1] - lo[1] : hi[i] - m_bound[i];
+
+		// Padded by a voxel against any rounding difference from the triangle mapping
+		const auto minV = floor(minC * scale + 0.5f * gridSize) - 1.0f;
+		const auto maxV = floor(maxC * scale + 0.5f * gridSize) + 2.0f;
+		if (!(minV < maxV) || maxV <= 0.0f || minV >= gridSize) return VoxelRegion();
+
+		region.Min[i] = static_cast<uint32_t>((max)(minV, 0.0f));
+		region.Max[i] = static_cast<uint32_t>((min)(maxV, gridSize));
+	}
+
+	return region;
+}
@@ -0,0 +1,53 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CPUVoxelizer.h"
+
+//--------------------------------------------------------------------------------------
+// Incremental surface voxelizer of a rigidly moving mesh into a fixed grid. The grid is
+// left untouched when neither the mesh nor the transform has changed since the last
+// update. Otherwise, only the dirty region, which is the union of the voxel bounds of the
+// mesh at the old and the new transforms, is cleared and voxelized again, and the coarser
+// levels are rebuilt over it. The result is the same as a full voxelization, as long as
+// the grid is only written by this voxelizer between the updates.
+//--------------------------------------------------------------------------------------
+class CPUIncrementalVoxelizer :
+	public CPUVoxelizer
+{
+public:
+	CPUIncrementalVoxelizer();
+	virtual ~CPUIncrementalVoxelizer();
+
+	// The mesh is referenced rather than copied, so it must outlive the updates. Setting
+	// it, or changing its data afterward and calling Invalidate, forces a full update.
+	void SetMesh(const uint8_t* pVertices, uint32_t stride, uint32_t numVertices,
+		const uint32_t* pIndices, uint32_t numIndices, const float bound[4]);
+	void Invalidate();
+
+	// Returns false if the update was skipped, where the transform is as in
+	// CPUVoxelizer::Voxelize
+	bool Update(VoxelGrid& grid, const float transform[3][4], uint32_t numThreads = 0);
+
+	// Region of level 0 written by the last update, which is empty if it was skipped
+	const VoxelRegion& GetDirtyRegion() const;
+
+protected:
+	VoxelRegion computeRegion(const VoxelGrid& grid, const float transform[3][4]) const;
+
+	const uint8_t*	m_pVertices;
+	const uint32_t*	m_pIndices;
+	uint32_t		m_stride;
+	uint32_t		m_numVertices;
+	uint32_t		m_numIndices;
+	float			m_bound[4];
+
+	const VoxelGrid* m_pGrid;
+	uint32_t		m_gridSize;
+	float			m_transform[3][4];
+	VoxelRegion		m_region;		// Voxel bound of the mesh at the current transform
+	VoxelRegion		m_dirtyRegion;
+	bool			m_valid;
+};
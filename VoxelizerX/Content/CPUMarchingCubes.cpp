@@ -0,0 +1,518 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <chrono>
+#include <cmath>
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "CPUMarchingCubes.h"
+
+using namespace std;
+
+namespace
+{
+	const uint8_t g_cornerOffsets[8][3] =
+	{
+		{ 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 },
+		{ 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 }
+	};
+
+	const uint8_t g_edgeCorners[12][2] =
+	{
+		{ 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 0 },
+		{ 4, 5 }, { 5, 6 }, { 6, 7 }, { 7, 4 },
+		{ 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }
+	};
+
+	//----------------------------------------------------------------------------------
+	// Triangles of the edges for each cell configuration, where bit i is set if corner i
+	// is inside. On an ambiguous face the inside corners are always separated, so the
+	// neighboring cells agree on the face and the surface is closed, and no triangle
+	// lies on a face, where it would coincide with one of the neighbor. Right-handed
+	// triangle normals point inward in voxels, and hence outward in the model space
+	// after the Y flip.
+	//----------------------------------------------------------------------------------
+	const int8_t g_triTable[256][16] =
+	{
+		{ -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 9, 8, 1, 8, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 3, 1, 2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 2, 10, 0, 10, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 10, 9, 2, 9, 8, 2, 8, 3, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 3, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 11, 0, 11, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 9, 2, 3, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 9, 8, 1, 8, 11, 1, 11, 2, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 3, 11, 1, 11, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 11, 0, 11, 10, 0, 10, 1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 3, 11, 0, 11, 10, 0, 10, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 11, 10, 8, 10, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 4, 7, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 7, 0, 7, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 9, 4, 7, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 9, 4, 1, 4, 7, 1, 7, 3, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 2, 10, 4, 7, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 7, 0, 7, 3, 1, 2, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 2, 10, 0, 10, 9, 4, 7, 8, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 10, 9, 2, 9, 4, 2, 4, 7, 2, 7, 3, -1, -1, -1, -1 },
+		{ 2, 3, 11, 4, 7, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 7, 0, 7, 11, 0, 11, 2, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 9, 2, 3, 11, 4, 7, 8, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 9, 4, 1, 4, 7, 1, 7, 11, 1, 11, 2, -1, -1, -1, -1 },
+		{ 1, 3, 11, 1, 11, 10, 4, 7, 8, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 7, 0, 7, 11, 0, 11, 10, 0, 10, 1, -1, -1, -1, -1 },
+		{ 0, 3, 11, 0, 11, 10, 0, 10, 9, 4, 7, 8, -1, -1, -1, -1 },
+		{ 4, 7, 11, 4, 11, 10, 4, 10, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 4, 9, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 3, 4, 9, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 5, 0, 5, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 5, 4, 1, 4, 8, 1, 8, 3, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 2, 10, 4, 9, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 3, 1, 2, 10, 4, 9, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 2, 10, 0, 10, 5, 0, 5, 4, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 10, 5, 2, 5, 4, 2, 4, 8, 2, 8, 3, -1, -1, -1, -1 },
+		{ 2, 3, 11, 4, 9, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 11, 0, 11, 2, 4, 9, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 5, 0, 5, 4, 2, 3, 11, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 5, 4, 1, 4, 8, 1, 8, 11, 1, 11, 2, -1, -1, -1, -1 },
+		{ 1, 3, 11, 1, 11, 10, 4, 9, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 11, 0, 11, 10, 0, 10, 1, 4, 9, 5, -1, -1, -1, -1 },
+		{ 0, 3, 11, 0, 11, 10, 0, 10, 5, 0, 5, 4, -1, -1, -1, -1 },
+		{ 4, 8, 11, 4, 11, 10, 4, 10, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 5, 7, 8, 5, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 5, 0, 5, 7, 0, 7, 3, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 5, 0, 5, 7, 0, 7, 8, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 5, 7, 1, 7, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 2, 10, 5, 7, 8, 5, 8, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 5, 0, 5, 7, 0, 7, 3, 1, 2, 10, -1, -1, -1, -1 },
+		{ 0, 2, 10, 0, 10, 5, 0, 5, 7, 0, 7, 8, -1, -1, -1, -1 },
+		{ 2, 10, 5, 2, 5, 7, 2, 7, 3, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 3, 11, 5, 7, 8, 5, 8, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 5, 0, 5, 7, 0, 7, 11, 0, 11, 2, -1, -1, -1, -1 },
+		{ 0, 1, 5, 0, 5, 7, 0, 7, 8, 2, 3, 11, -1, -1, -1, -1 },
+		{ 1, 5, 7, 1, 7, 11, 1, 11, 2, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 3, 11, 1, 11, 10, 5, 7, 8, 5, 8, 9, -1, -1, -1, -1 },
+		{ 0, 9, 5, 0, 5, 7, 0, 7, 11, 0, 11, 10, 0, 10, 1, -1 },
+		{ 0, 3, 11, 0, 11, 10, 0, 10, 5, 0, 5, 7, 0, 7, 8, -1 },
+		{ 5, 7, 11, 5, 11, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 5, 10, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 3, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 9, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 9, 8, 1, 8, 3, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 2, 6, 1, 6, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 3, 1, 2, 6, 1, 6, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 2, 6, 0, 6, 5, 0, 5, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 6, 5, 2, 5, 9, 2, 9, 8, 2, 8, 3, -1, -1, -1, -1 },
+		{ 2, 3, 11, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 11, 0, 11, 2, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 9, 2, 3, 11, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 9, 8, 1, 8, 11, 1, 11, 2, 5, 10, 6, -1, -1, -1, -1 },
+		{ 1, 3, 11, 1, 11, 6, 1, 6, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 11, 0, 11, 6, 0, 6, 5, 0, 5, 1, -1, -1, -1, -1 },
+		{ 0, 3, 11, 0, 11, 6, 0, 6, 5, 0, 5, 9, -1, -1, -1, -1 },
+		{ 5, 9, 8, 5, 8, 11, 5, 11, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 4, 7, 8, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 7, 0, 7, 3, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 9, 4, 7, 8, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 9, 4, 1, 4, 7, 1, 7, 3, 5, 10, 6, -1, -1, -1, -1 },
+		{ 1, 2, 6, 1, 6, 5, 4, 7, 8, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 7, 0, 7, 3, 1, 2, 6, 1, 6, 5, -1, -1, -1, -1 },
+		{ 0, 2, 6, 0, 6, 5, 0, 5, 9, 4, 7, 8, -1, -1, -1, -1 },
+		{ 2, 6, 5, 2, 5, 9, 2, 9, 4, 2, 4, 7, 2, 7, 3, -1 },
+		{ 2, 3, 11, 4, 7, 8, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 7, 0, 7, 11, 0, 11, 2, 5, 10, 6, -1, -1, -1, -1 },
+		{ 0, 1, 9, 2, 3, 11, 4, 7, 8, 5, 10, 6, -1, -1, -1, -1 },
+		{ 1, 9, 4, 1, 4, 7, 1, 7, 11, 1, 11, 2, 5, 10, 6, -1 },
+		{ 1, 3, 11, 1, 11, 6, 1, 6, 5, 4, 7, 8, -1, -1, -1, -1 },
+		{ 0, 4, 7, 0, 7, 11, 0, 11, 6, 0, 6, 5, 0, 5, 1, -1 },
+		{ 0, 3, 11, 0, 11, 6, 0, 6, 5, 0, 5, 9, 4, 7, 8, -1 },
+		{ 11, 6, 5, 11, 5, 9, 11, 9, 4, 11, 4, 7, -1, -1, -1, -1 },
+		{ 4, 9, 10, 4, 10, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 3, 4, 9, 10, 4, 10, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 10, 0, 10, 6, 0, 6, 4, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 10, 6, 1, 6, 4, 1, 4, 8, 1, 8, 3, -1, -1, -1, -1 },
+		{ 1, 2, 6, 1, 6, 4, 1, 4, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 3, 1, 2, 6, 1, 6, 4, 1, 4, 9, -1, -1, -1, -1 },
+		{ 0, 2, 6, 0, 6, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 6, 4, 2, 4, 8, 2, 8, 3, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 3, 11, 4, 9, 10, 4, 10, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 11, 0, 11, 2, 4, 9, 10, 4, 10, 6, -1, -1, -1, -1 },
+		{ 0, 1, 10, 0, 10, 6, 0, 6, 4, 2, 3, 11, -1, -1, -1, -1 },
+		{ 1, 10, 6, 1, 6, 4, 1, 4, 8, 1, 8, 11, 1, 11, 2, -1 },
+		{ 1, 3, 11, 1, 11, 6, 1, 6, 4, 1, 4, 9, -1, -1, -1, -1 },
+		{ 11, 6, 4, 11, 4, 9, 11, 9, 1, 11, 1, 0, 11, 0, 8, -1 },
+		{ 0, 3, 11, 0, 11, 6, 0, 6, 4, -1, -1, -1, -1, -1, -1, -1 },
+		{ 4, 8, 11, 4, 11, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 6, 7, 8, 6, 8, 9, 6, 9, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 10, 0, 10, 6, 0, 6, 7, 0, 7, 3, -1, -1, -1, -1 },
+		{ 0, 1, 10, 0, 10, 6, 0, 6, 7, 0, 7, 8, -1, -1, -1, -1 },
+		{ 1, 10, 6, 1, 6, 7, 1, 7, 3, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 2, 6, 1, 6, 7, 1, 7, 8, 1, 8, 9, -1, -1, -1, -1 },
+		{ 9, 1, 2, 9, 2, 6, 9, 6, 7, 9, 7, 3, 9, 3, 0, -1 },
+		{ 0, 2, 6, 0, 6, 7, 0, 7, 8, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 6, 7, 2, 7, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 3, 11, 6, 7, 8, 6, 8, 9, 6, 9, 10, -1, -1, -1, -1 },
+		{ 0, 9, 10, 0, 10, 6, 0, 6, 7, 0, 7, 11, 0, 11, 2, -1 },
+		{ 0, 1, 10, 0, 10, 6, 0, 6, 7, 0, 7, 8, 2, 3, 11, -1 },
+		{ 1, 10, 6, 1, 6, 7, 1, 7, 11, 1, 11, 2, -1, -1, -1, -1 },
+		{ 1, 3, 11, 1, 11, 6, 1, 6, 7, 1, 7, 8, 1, 8, 9, -1 },
+		{ 0, 9, 1, 6, 7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 3, 11, 0, 11, 6, 0, 6, 7, 0, 7, 8, -1, -1, -1, -1 },
+		{ 6, 7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 6, 11, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 3, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 9, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 9, 8, 1, 8, 3, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 2, 10, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 3, 1, 2, 10, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 2, 10, 0, 10, 9, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 10, 9, 2, 9, 8, 2, 8, 3, 6, 11, 7, -1, -1, -1, -1 },
+		{ 2, 3, 7, 2, 7, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 7, 0, 7, 6, 0, 6, 2, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 9, 2, 3, 7, 2, 7, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 9, 8, 1, 8, 7, 1, 7, 6, 1, 6, 2, -1, -1, -1, -1 },
+		{ 1, 3, 7, 1, 7, 6, 1, 6, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 7, 0, 7, 6, 0, 6, 10, 0, 10, 1, -1, -1, -1, -1 },
+		{ 0, 3, 7, 0, 7, 6, 0, 6, 10, 0, 10, 9, -1, -1, -1, -1 },
+		{ 6, 10, 9, 6, 9, 8, 6, 8, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 4, 6, 11, 4, 11, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 6, 0, 6, 11, 0, 11, 3, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 9, 4, 6, 11, 4, 11, 8, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 9, 4, 1, 4, 6, 1, 6, 11, 1, 11, 3, -1, -1, -1, -1 },
+		{ 1, 2, 10, 4, 6, 11, 4, 11, 8, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 6, 0, 6, 11, 0, 11, 3, 1, 2, 10, -1, -1, -1, -1 },
+		{ 0, 2, 10, 0, 10, 9, 4, 6, 11, 4, 11, 8, -1, -1, -1, -1 },
+		{ 9, 4, 6, 9, 6, 11, 9, 11, 3, 9, 3, 2, 9, 2, 10, -1 },
+		{ 2, 3, 8, 2, 8, 4, 2, 4, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 6, 0, 6, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 9, 2, 3, 8, 2, 8, 4, 2, 4, 6, -1, -1, -1, -1 },
+		{ 1, 9, 4, 1, 4, 6, 1, 6, 2, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 3, 8, 1, 8, 4, 1, 4, 6, 1, 6, 10, -1, -1, -1, -1 },
+		{ 0, 4, 6, 0, 6, 10, 0, 10, 1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 8, 4, 3, 4, 6, 3, 6, 10, 3, 10, 9, 3, 9, 0, -1 },
+		{ 4, 6, 10, 4, 10, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 4, 9, 5, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 3, 4, 9, 5, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 5, 0, 5, 4, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 5, 4, 1, 4, 8, 1, 8, 3, 6, 11, 7, -1, -1, -1, -1 },
+		{ 1, 2, 10, 4, 9, 5, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 3, 1, 2, 10, 4, 9, 5, 6, 11, 7, -1, -1, -1, -1 },
+		{ 0, 2, 10, 0, 10, 5, 0, 5, 4, 6, 11, 7, -1, -1, -1, -1 },
+		{ 2, 10, 5, 2, 5, 4, 2, 4, 8, 2, 8, 3, 6, 11, 7, -1 },
+		{ 2, 3, 7, 2, 7, 6, 4, 9, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 7, 0, 7, 6, 0, 6, 2, 4, 9, 5, -1, -1, -1, -1 },
+		{ 0, 1, 5, 0, 5, 4, 2, 3, 7, 2, 7, 6, -1, -1, -1, -1 },
+		{ 1, 5, 4, 1, 4, 8, 1, 8, 7, 1, 7, 6, 1, 6, 2, -1 },
+		{ 1, 3, 7, 1, 7, 6, 1, 6, 10, 4, 9, 5, -1, -1, -1, -1 },
+		{ 0, 8, 7, 0, 7, 6, 0, 6, 10, 0, 10, 1, 4, 9, 5, -1 },
+		{ 0, 3, 7, 0, 7, 6, 0, 6, 10, 0, 10, 5, 0, 5, 4, -1 },
+		{ 8, 7, 6, 8, 6, 10, 8, 10, 5, 8, 5, 4, -1, -1, -1, -1 },
+		{ 5, 6, 11, 5, 11, 8, 5, 8, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 5, 0, 5, 6, 0, 6, 11, 0, 11, 3, -1, -1, -1, -1 },
+		{ 0, 1, 5, 0, 5, 6, 0, 6, 11, 0, 11, 8, -1, -1, -1, -1 },
+		{ 1, 5, 6, 1, 6, 11, 1, 11, 3, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 2, 10, 5, 6, 11, 5, 11, 8, 5, 8, 9, -1, -1, -1, -1 },
+		{ 0, 9, 5, 0, 5, 6, 0, 6, 11, 0, 11, 3, 1, 2, 10, -1 },
+		{ 0, 2, 10, 0, 10, 5, 0, 5, 6, 0, 6, 11, 0, 11, 8, -1 },
+		{ 5, 6, 11, 5, 11, 3, 5, 3, 2, 5, 2, 10, -1, -1, -1, -1 },
+		{ 2, 3, 8, 2, 8, 9, 2, 9, 5, 2, 5, 6, -1, -1, -1, -1 },
+		{ 0, 9, 5, 0, 5, 6, 0, 6, 2, -1, -1, -1, -1, -1, -1, -1 },
+		{ 5, 6, 2, 5, 2, 3, 5, 3, 8, 5, 8, 0, 5, 0, 1, -1 },
+		{ 1, 5, 6, 1, 6, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 8, 9, 3, 9, 5, 3, 5, 6, 3, 6, 10, 3, 10, 1, -1 },
+		{ 0, 9, 5, 0, 5, 6, 0, 6, 10, 0, 10, 1, -1, -1, -1, -1 },
+		{ 0, 3, 8, 5, 6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 5, 6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 5, 10, 11, 5, 11, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 3, 5, 10, 11, 5, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 9, 5, 10, 11, 5, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 9, 8, 1, 8, 3, 5, 10, 11, 5, 11, 7, -1, -1, -1, -1 },
+		{ 1, 2, 11, 1, 11, 7, 1, 7, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 3, 1, 2, 11, 1, 11, 7, 1, 7, 5, -1, -1, -1, -1 },
+		{ 0, 2, 11, 0, 11, 7, 0, 7, 5, 0, 5, 9, -1, -1, -1, -1 },
+		{ 2, 11, 7, 2, 7, 5, 2, 5, 9, 2, 9, 8, 2, 8, 3, -1 },
+		{ 2, 3, 7, 2, 7, 5, 2, 5, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 7, 0, 7, 5, 0, 5, 10, 0, 10, 2, -1, -1, -1, -1 },
+		{ 0, 1, 9, 2, 3, 7, 2, 7, 5, 2, 5, 10, -1, -1, -1, -1 },
+		{ 8, 7, 5, 8, 5, 10, 8, 10, 2, 8, 2, 1, 8, 1, 9, -1 },
+		{ 1, 3, 7, 1, 7, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 7, 0, 7, 5, 0, 5, 1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 3, 7, 0, 7, 5, 0, 5, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 5, 9, 8, 5, 8, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 4, 5, 10, 4, 10, 11, 4, 11, 8, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 5, 0, 5, 10, 0, 10, 11, 0, 11, 3, -1, -1, -1, -1 },
+		{ 0, 1, 9, 4, 5, 10, 4, 10, 11, 4, 11, 8, -1, -1, -1, -1 },
+		{ 4, 5, 10, 4, 10, 11, 4, 11, 3, 4, 3, 1, 4, 1, 9, -1 },
+		{ 1, 2, 11, 1, 11, 8, 1, 8, 4, 1, 4, 5, -1, -1, -1, -1 },
+		{ 4, 5, 1, 4, 1, 2, 4, 2, 11, 4, 11, 3, 4, 3, 0, -1 },
+		{ 2, 11, 8, 2, 8, 4, 2, 4, 5, 2, 5, 9, 2, 9, 0, -1 },
+		{ 2, 11, 3, 4, 5, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 3, 8, 2, 8, 4, 2, 4, 5, 2, 5, 10, -1, -1, -1, -1 },
+		{ 0, 4, 5, 0, 5, 10, 0, 10, 2, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 9, 2, 3, 8, 2, 8, 4, 2, 4, 5, 2, 5, 10, -1 },
+		{ 4, 5, 10, 4, 10, 2, 4, 2, 1, 4, 1, 9, -1, -1, -1, -1 },
+		{ 1, 3, 8, 1, 8, 4, 1, 4, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 5, 0, 5, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 8, 4, 3, 4, 5, 3, 5, 9, 3, 9, 0, -1, -1, -1, -1 },
+		{ 4, 5, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 4, 9, 10, 4, 10, 11, 4, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 3, 4, 9, 10, 4, 10, 11, 4, 11, 7, -1, -1, -1, -1 },
+		{ 0, 1, 10, 0, 10, 11, 0, 11, 7, 0, 7, 4, -1, -1, -1, -1 },
+		{ 1, 10, 11, 1, 11, 7, 1, 7, 4, 1, 4, 8, 1, 8, 3, -1 },
+		{ 1, 2, 11, 1, 11, 7, 1, 7, 4, 1, 4, 9, -1, -1, -1, -1 },
+		{ 0, 8, 3, 1, 2, 11, 1, 11, 7, 1, 7, 4, 1, 4, 9, -1 },
+		{ 0, 2, 11, 0, 11, 7, 0, 7, 4, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 11, 7, 2, 7, 4, 2, 4, 8, 2, 8, 3, -1, -1, -1, -1 },
+		{ 2, 3, 7, 2, 7, 4, 2, 4, 9, 2, 9, 10, -1, -1, -1, -1 },
+		{ 7, 4, 9, 7, 9, 10, 7, 10, 2, 7, 2, 0, 7, 0, 8, -1 },
+		{ 10, 2, 3, 10, 3, 7, 10, 7, 4, 10, 4, 0, 10, 0, 1, -1 },
+		{ 1, 10, 2, 4, 8, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 3, 7, 1, 7, 4, 1, 4, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 4, 9, 7, 9, 1, 7, 1, 0, 7, 0, 8, -1, -1, -1, -1 },
+		{ 0, 3, 7, 0, 7, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 4, 8, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 9, 10, 8, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 10, 0, 10, 11, 0, 11, 3, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 10, 0, 10, 11, 0, 11, 8, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 10, 11, 1, 11, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 2, 11, 1, 11, 8, 1, 8, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 9, 1, 2, 9, 2, 11, 9, 11, 3, 9, 3, 0, -1, -1, -1, -1 },
+		{ 0, 2, 11, 0, 11, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 11, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 3, 8, 2, 8, 9, 2, 9, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 10, 0, 10, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 10, 2, 3, 10, 3, 8, 10, 8, 0, 10, 0, 1, -1, -1, -1, -1 },
+		{ 1, 10, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 3, 8, 1, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 3, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+	};
+
+	float getCoverage(uint32_t voxel)
+	{
+		return (voxel >> 30) / 3.0f;
+	}
+}
+
+CPUMarchingCubes::CPUMarchingCubes()
+{
+}
+
+CPUMarchingCubes::~CPUMarchingCubes()
+{
+}
+
+void CPUMarchingCubes::Extract(const VoxelGrid& grid, const float bound[4], uint8_t level,
+	float isoValue, MeshStats* pStats, uint32_t numThreads)
+{
+	PROFILE_SCOPE("CPUMarchingCubes::Extract");
+
+	const auto start = chrono::steady_clock::now();
+	const auto size = grid.GetSize(level);
+
+	// The cell layers range in [-1, size), including the padding
+	const auto numLayers = size + 1;
+	const auto numSlabs = (numLayers + SlabThickness - 1) / SlabThickness;
+	vector<Slab> slabs(numSlabs);
+	ParallelFor(0, numSlabs, [&](uint32_t i)
+	{
+		const auto zBeg = static_cast<int>(i * SlabThickness) - 1;
+		const auto zEnd = (min)(zBeg + static_cast<int>(SlabThickness), static_cast<int>(size));
+		extractSlab(grid, bound, level, isoValue, zBeg, zEnd, slabs[i]);
+	}, numThreads);
+
+	// Vertex offsets of the slabs
+	vector<uint32_t> offsets(numSlabs + 1, 0);
+	size_t numIndices = 0;
+	uint64_t numCells = 0;
+	for (auto i = 0u; i < numSlabs; ++i)
+	{
+		offsets[i + 1] = offsets[i] + static_cast<uint32_t>(slabs[i].Vertices.size());
+		numIndices += slabs[i].Indices.size();
+		numCells += slabs[i].NumCells;
+	}
+
+	m_vertices.resize(offsets[numSlabs]);
+	m_indices.resize(numIndices);
+	vector<size_t> indexOffsets(numSlabs + 1, 0);
+	for (auto i = 0u; i < numSlabs; ++i) indexOffsets[i + 1] = indexOffsets[i] + slabs[i].Indices.size();
+
+	// Concatenate the slabs, where the external edges are owned by the next slab
+	ParallelFor(0, numSlabs, [&](uint32_t i)
+	{
+		const auto& slab = slabs[i];
+		copy(slab.Vertices.cbegin(), slab.Vertices.cend(), m_vertices.begin() + offsets[i]);
+
+		auto pIndex = &m_indices[indexOffsets[i]];
+		for (const auto& index : slab.Indices)
+		{
+			if (index & ExternalBit)
+			{
+				const auto& next = slabs[i + 1];
+				*pIndex++ = offsets[i + 1] + next.EdgeVertices.at(slab.ExternalEdges[index & ~ExternalBit]);
+			}
+			else *pIndex++ = offsets[i] + index;
+		}
+	}, numThreads);
+
+	if (pStats)
+	{
+		pStats->NumFaces = numCells;
+		pStats->NumQuads = 0;
+		pStats->NumVertices = m_vertices.size();
+		pStats->NumTriangles = m_indices.size() / 3;
+		pStats->MeshingTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Cells of the layers [zBeg, zEnd), whose min corners are the voxels (x, y, z) in
+// [-1, size), and the coverage of the two corner planes of a layer are kept in a ring.
+// An edge is identified by its min corner and axis, and owned by the slab of the layer
+// of its min corner.
+//--------------------------------------------------------------------------------------
+void CPUMarchingCubes::extractSlab(const VoxelGrid& grid, const float bound[4], uint8_t level,
+	float isoValue, int zBeg, int zEnd, Slab& result) const
+{
+	const auto size = grid.GetSize(level);
+	const auto pitch = static_cast<int>(size) + 2;
+	const auto pData = grid.GetData(level);
+	result.NumCells = 0;
+
+	// Coverage of the padded corner plane z
+	vector<float> planes[2];
+	const auto loadPlane = [&](vector<float>& plane, int z)
+	{
+		plane.assign(static_cast<size_t>(pitch) * pitch, 0.0f);
+		if (z < 0 || z >= static_cast<int>(size)) return;
+
+		for (auto y = 0u; y < size; ++y)
+		{
+			const auto pRow = &pData[(static_cast<size_t>(z) * size + y) * size];
+			auto pDst = &plane[static_cast<size_t>(y + 1) * pitch + 1];
+			for (auto x = 0u; x < size; ++x) pDst[x] = getCoverage(pRow[x]);
+		}
+	};
+
+	const auto getVoxel = [&](int x, int y, int z)
+	{
+		const auto isInside = x >= 0 && y >= 0 && z >= 0 && x < static_cast<int>(size) &&
+			y < static_cast<int>(size) && z < static_cast<int>(size);
+
+		return isInside ? pData[(static_cast<size_t>(z) * size + y) * size + x] : 0u;
+	};
+
+	loadPlane(planes[0], zBeg);
+	for (auto z = zBeg; z < zEnd; ++z)
+	{
+		const auto& plane0 = planes[(z - zBeg) & 1];
+		auto& plane1 = planes[(z - zBeg + 1) & 1];
+		loadPlane(plane1, z + 1);
+
+		vector<uint8_t> columns(pitch);
+		for (auto y = -1; y < static_cast<int>(size); ++y)
+		{
+			// Inside bits of the 4 corners (y, z), (y + 1, z), (y, z + 1), and (y + 1, z + 1)
+			// of each column x, so the empty and full cells are skipped by the bits
+			const auto row0 = static_cast<size_t>(y + 1) * pitch;
+			const auto row1 = row0 + pitch;
+			for (auto i = 0; i < pitch; ++i)
+				columns[i] = (plane0[row0 + i] > isoValue ? 1 : 0) | (plane0[row1 + i] > isoValue ? 2 : 0) |
+					(plane1[row0 + i] > isoValue ? 4 : 0) | (plane1[row1 + i] > isoValue ? 8 : 0);
+
+			for (auto x = -1; x < static_cast<int>(size); ++x)
+			{
+				const auto c0 = columns[x + 1];
+				const auto c1 = columns[x + 2];
+				if ((c0 | c1) == 0 || (c0 & c1) == 0xf) continue;
+
+				// Cell configuration
+				const auto cellIdx = static_cast<uint8_t>((c0 & 1) | ((c1 & 1) << 1) | ((c1 & 2) << 1) | ((c0 & 2) << 2) |
+					((c0 & 4) << 2) | ((c1 & 4) << 3) | ((c1 & 8) << 3) | ((c0 & 8) << 4));
+
+				float values[8];
+				for (uint8_t i = 0; i < 8; ++i)
+				{
+					const auto& offset = g_cornerOffsets[i];
+					const auto& plane = offset[2] ? plane1 : plane0;
+					values[i] = plane[static_cast<size_t>(y + 1 + offset[1]) * pitch + x + 1 + offset[0]];
+				}
+
+				++result.NumCells;
+
+				for (auto pEdge = g_triTable[cellIdx]; *pEdge >= 0; ++pEdge)
+				{
+					// Min corner and axis of the edge
+					const auto& edge = g_edgeCorners[*pEdge];
+					const auto& a = g_cornerOffsets[edge[0]];
+					const auto& b = g_cornerOffsets[edge[1]];
+					int corner[3];
+					uint8_t axis = 0;
+					for (uint8_t i = 0; i < 3; ++i)
+					{
+						corner[i] = (min)(a[i], b[i]);
+						if (a[i] != b[i]) axis = i;
+					}
+
+					const uint64_t key = ((static_cast<uint64_t>(z + corner[2] + 1) * pitch +
+						(y + corner[1] + 1)) * pitch + (x + corner[0] + 1)) * 3 + axis;
+
+					// The edges of the top corner plane belong to the next slab
+					if (z + corner[2] >= zEnd)
+					{
+						result.Indices.emplace_back(ExternalBit | static_cast<uint32_t>(result.ExternalEdges.size()));
+						result.ExternalEdges.emplace_back(key);
+						continue;
+					}
+
+					const auto inserted = result.EdgeVertices.emplace(key, static_cast<uint32_t>(result.Vertices.size()));
+					result.Indices.emplace_back(inserted.first->second);
+					if (!inserted.second) continue;
+
+					// New vertex on the edge, from the min corner
+					const auto va = values[a[axis] ? edge[1] : edge[0]];
+					const auto vb = values[a[axis] ? edge[0] : edge[1]];
+					const auto t = (isoValue - va) / (vb - va);
+					const int p0[] = { x + corner[0], y + corner[1], z + corner[2] };
+					float p[3], n[3] = {};
+					for (uint8_t i = 0; i < 3; ++i) p[i] = p0[i] + 0.5f;
+					p[axis] += t;
+
+					// Normals of both ends weighted by coverage and distance, where the filled
+					// solid voxels have no normal
+					for (uint8_t i = 0; i < 2; ++i)
+					{
+						int loc[] = { p0[0], p0[1], p0[2] };
+						loc[axis] += i;
+						const auto voxel = getVoxel(loc[0], loc[1], loc[2]);
+						float nrm[3], coverage;
+						VoxelGrid::Unpack(voxel, nrm[0], nrm[1], nrm[2], coverage);
+						const auto w = voxel & ~VoxelGrid::CoverageMask ? coverage * (i ? t : 1.0f - t) : 0.0f;
+						for (uint8_t j = 0; j < 3; ++j) n[j] += w * nrm[j];
+					}
+
+					auto len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					if (len < 1e-3f)
+					{
+						// Negative gradient of the cell, with Y flipped into the model space
+						for (uint8_t i = 0; i < 8; ++i)
+							for (uint8_t j = 0; j < 3; ++j)
+								n[j] -= values[i] * (g_cornerOffsets[i][j] ? 1.0f : -1.0f);
+						n[1] = -n[1];
+						len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					}
+
+					Vertex vertex;
+					toModelSpace(vertex.Pos, p, size, bound);
+					for (uint8_t i = 0; i < 3; ++i) vertex.Nrm[i] = len > 0.0f ? n[i] / len : 0.0f;
+					result.Vertices.emplace_back(vertex);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,43 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <unordered_map>
+#include "VoxelMesh.h"
+
+//--------------------------------------------------------------------------------------
+// Marching cubes over the coverage of a grid level: the cells connect the voxel centers,
+// padded by a layer of empty voxels, so the isosurface is closed. The normals are taken
+// from the packed voxel normals at the ends of each crossed edge, weighted by coverage,
+// or the cell gradient when both ends are filled solid voxels without normals, or they
+// cancel out. Z slabs of cells are extracted in parallel, each with a hash table of its
+// edge vertices, and the vertices on the edges shared with the next slab are looked up
+// in its table, so the mesh has no duplicated vertices.
+//--------------------------------------------------------------------------------------
+class CPUMarchingCubes : public VoxelMesh
+{
+public:
+	CPUMarchingCubes();
+	virtual ~CPUMarchingCubes();
+
+	void Extract(const VoxelGrid& grid, const float bound[4], uint8_t level = 0,
+		float isoValue = 0.5f, MeshStats* pStats = nullptr, uint32_t numThreads = 0);
+
+protected:
+	struct Slab
+	{
+		std::vector<Vertex> Vertices;
+		std::vector<uint32_t> Indices;	// With the top bit for the index of ExternalEdges
+		std::vector<uint64_t> ExternalEdges;
+		std::unordered_map<uint64_t, uint32_t> EdgeVertices;
+		uint64_t NumCells;
+	};
+
+	void extractSlab(const VoxelGrid& grid, const float bound[4], uint8_t level,
+		float isoValue, int zBeg, int zEnd, Slab& result) const;
+
+	static const uint32_t SlabThickness = 8;
+	static const uint32_t ExternalBit = 0x80000000;
+};
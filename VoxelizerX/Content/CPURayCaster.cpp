@@ -0,0 +1,950 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "SharedConst.h"
+#include "stb_image_write.h"
+#include "CPURayCaster.h"
+
+#if	defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define	USE_SSE2	1
+#include <emmintrin.h>
+#else
+#define	USE_SSE2	0
+#endif
+
+using namespace std;
+
+namespace
+{
+	const float g_absorption = 1.0f;
+	const float g_zeroThreshold = 0.01f;
+	const float g_maxDist = 2.0f * sqrt(3.0f);
+	const float g_stepScale = g_maxDist / CPURayCaster::NumSamples;
+	const float g_lightStepScale = g_maxDist / CPURayCaster::NumLightSamples;
+	const float g_clearColor[] = { CLEAR_COLOR };
+
+	float saturate(float x)
+	{
+		return (min)((max)(x, 0.0f), 1.0f);
+	}
+
+	bool isOutside(const float pos[3])
+	{
+		return fabs(pos[0]) > 1.0f || fabs(pos[1]) > 1.0f || fabs(pos[2]) > 1.0f;
+	}
+
+	void toTex(float tex[3], const float pos[3])
+	{
+		tex[0] = 0.5f * pos[0] + 0.5f;
+		tex[1] = -0.5f * pos[1] + 0.5f;
+		tex[2] = 0.5f * pos[2] + 0.5f;
+	}
+
+	void transformCoord(float r[3], const float v[3], const float m[16])
+	{
+		float p[4];
+		for (uint8_t i = 0; i < 4; ++i)
+			p[i] = v[0] * m[i] + v[1] * m[4 + i] + v[2] * m[8 + i] + m[12 + i];
+		for (uint8_t i = 0; i < 3; ++i) r[i] = p[i] / p[3];
+	}
+
+	void normalize(float v[3])
+	{
+		const auto len = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		if (len > 0.0f) for (uint8_t i = 0; i < 3; ++i) v[i] /= len;
+	}
+
+	// Same as ComputeStartPoint in PSRayCast
+	bool computeStartPoint(float pos[3], const float rayDir[3])
+	{
+		if (!isOutside(pos)) return true;
+
+		auto U = FLT_MAX;
+		auto isHit = false;
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			const auto u = ((rayDir[i] > 0.0f ? -1.0f : (rayDir[i] < 0.0f ? 1.0f : 0.0f)) - pos[i]) / rayDir[i];
+			if (!(u >= 0.0f)) continue;
+
+			const auto j = (i + 1) % 3, k = (i + 2) % 3;
+			if (fabs(rayDir[j] * u + pos[j]) > 1.0f) continue;
+			if (fabs(rayDir[k] * u + pos[k]) > 1.0f) continue;
+			if (u < U)
+			{
+				U = u;
+				isHit = true;
+			}
+		}
+
+		for (uint8_t i = 0; i < 3; ++i) pos[i] = (min)((max)(rayDir[i] * U + pos[i], -1.0f), 1.0f);
+
+		return isHit;
+	}
+
+	// Final color as PSRayCast, with the clear color for rays missing the grid
+	void shade(uint8_t pixel[4], bool isHit, float transmit, float scatter)
+	{
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			const auto clear = g_clearColor[i] * g_clearColor[i];
+			const auto result = isHit ? sqrt(saturate((scatter * 0.8f + 0.2f) * (1.0f - transmit) + clear * transmit)) : g_clearColor[i];
+			pixel[i] = static_cast<uint8_t>(saturate(result) * 255.0f + 0.5f);
+		}
+		pixel[3] = isHit ? 255 : 0;
+	}
+
+	// Trilinear lookup of the light transmittance volume with clamp addressing
+	float getLightTrans(const float* pLightTrans, int size, const float tex[3])
+	{
+		int i0[3], i1[3];
+		float w[3];
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			const auto u = tex[i] * size - 0.5f;
+			const auto f = floor(u);
+			w[i] = u - f;
+			i0[i] = (min)((max)(static_cast<int>(f), 0), size - 1);
+			i1[i] = (min)((max)(static_cast<int>(f) + 1, 0), size - 1);
+		}
+
+		auto lightTrans = 0.0f;
+		for (uint8_t i = 0; i < 8; ++i)
+		{
+			const auto wx = i & 1 ? w[0] : 1.0f - w[0];
+			const auto wy = i & 2 ? w[1] : 1.0f - w[1];
+			const auto wz = i & 4 ? w[2] : 1.0f - w[2];
+			const auto x = i & 1 ? i1[0] : i0[0];
+			const auto y = i & 2 ? i1[1] : i0[1];
+			const auto z = i & 4 ? i1[2] : i0[2];
+			lightTrans += wx * wy * wz * pLightTrans[(static_cast<size_t>(z) * size + y) * size + x];
+		}
+
+		return lightTrans;
+	}
+
+	void multiply(float r[16], const float a[16], const float b[16])
+	{
+		float m[16];
+		for (uint8_t i = 0; i < 4; ++i)
+			for (uint8_t j = 0; j < 4; ++j)
+				m[i * 4 + j] = a[i * 4] * b[j] + a[i * 4 + 1] * b[4 + j] + a[i * 4 + 2] * b[8 + j] + a[i * 4 + 3] * b[12 + j];
+		memcpy(r, m, sizeof(m));
+	}
+
+	// Gauss-Jordan elimination with partial pivoting
+	bool invert(float r[16], const float m[16])
+	{
+		double a[4][8];
+		for (uint8_t i = 0; i < 4; ++i)
+			for (uint8_t j = 0; j < 8; ++j)
+				a[i][j] = j < 4 ? m[i * 4 + j] : (j - 4 == i ? 1.0 : 0.0);
+
+		for (uint8_t c = 0; c < 4; ++c)
+		{
+			auto p = c;
+			for (uint8_t i = c + 1; i < 4; ++i) if (fabs(a[i][c]) > fabs(a[p][c])) p = i;
+			if (a[p][c] == 0.0) return false;
+			for (uint8_t j = 0; j < 8; ++j) swap(a[c][j], a[p][j]);
+
+			const auto rcp = 1.0 / a[c][c];
+			for (uint8_t j = 0; j < 8; ++j) a[c][j] *= rcp;
+			for (uint8_t i = 0; i < 4; ++i)
+			{
+				if (i == c) continue;
+				const auto f = a[i][c];
+				for (uint8_t j = 0; j < 8; ++j) a[i][j] -= f * a[c][j];
+			}
+		}
+
+		for (uint8_t i = 0; i < 4; ++i)
+			for (uint8_t j = 0; j < 4; ++j)
+				r[i * 4 + j] = static_cast<float>(a[i][j + 4]);
+
+		return true;
+	}
+
+	// Same as XMMatrixLookAtLH
+	void lookAtLH(float r[16], const float eyePt[3], const float focusPt[3])
+	{
+		float z[3] = { focusPt[0] - eyePt[0], focusPt[1] - eyePt[1], focusPt[2] - eyePt[2] };
+		normalize(z);
+		float x[] = { z[2], 0.0f, -z[0] };	// cross((0, 1, 0), z)
+		normalize(x);
+		const float y[] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+
+		const float m[] =
+		{
+			x[0], y[0], z[0], 0.0f,
+			x[1], y[1], z[1], 0.0f,
+			x[2], y[2], z[2], 0.0f,
+			-(x[0] * eyePt[0] + x[1] * eyePt[1] + x[2] * eyePt[2]),
+			-(y[0] * eyePt[0] + y[1] * eyePt[1] + y[2] * eyePt[2]),
+			-(z[0] * eyePt[0] + z[1] * eyePt[1] + z[2] * eyePt[2]), 1.0f
+		};
+		memcpy(r, m, sizeof(m));
+	}
+
+	// Same as XMMatrixPerspectiveFovLH
+	void perspectiveFovLH(float r[16], float fovAngleY, float aspectRatio, float zNear, float zFar)
+	{
+		const auto h = 1.0f / tan(0.5f * fovAngleY);
+		const auto range = zFar / (zFar - zNear);
+		const float m[] =
+		{
+			h / aspectRatio, 0.0f, 0.0f, 0.0f,
+			0.0f, h, 0.0f, 0.0f,
+			0.0f, 0.0f, range, 1.0f,
+			0.0f, 0.0f, -range * zNear, 0.0f
+		};
+		memcpy(r, m, sizeof(m));
+	}
+
+	void accumulate(RayCastStats& dst, const RayCastStats& src)
+	{
+		dst.NumRays += src.NumRays;
+		dst.NumSteps += src.NumSteps;
+		dst.NumSamples += src.NumSamples;
+		dst.NumLightSteps += src.NumLightSteps;
+		dst.NumLightSamples += src.NumLightSamples;
+		dst.NumSkips += src.NumSkips;
+	}
+
+#if	USE_SSE2
+	uint32_t countBits(uint32_t mask)
+	{
+		auto count = 0u;
+		for (; mask; mask &= mask - 1) ++count;
+
+		return count;
+	}
+
+	__m128 laneMask(uint32_t mask)
+	{
+		return _mm_castsi128_ps(_mm_set_epi32(mask & 8 ? -1 : 0, mask & 4 ? -1 : 0, mask & 2 ? -1 : 0, mask & 1 ? -1 : 0));
+	}
+
+	uint32_t isOutside(const __m128 pos[3])
+	{
+		const auto absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		const auto dist = _mm_max_ps(_mm_and_ps(pos[0], absMask), _mm_max_ps(_mm_and_ps(pos[1], absMask), _mm_and_ps(pos[2], absMask)));
+
+		return _mm_movemask_ps(_mm_cmpgt_ps(dist, _mm_set1_ps(1.0f)));
+	}
+
+	void toTex(__m128 tex[3], const __m128 pos[3])
+	{
+		const auto half = _mm_set1_ps(0.5f);
+		tex[0] = _mm_add_ps(_mm_mul_ps(half, pos[0]), half);
+		tex[1] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-0.5f), pos[1]), half);
+		tex[2] = _mm_add_ps(_mm_mul_ps(half, pos[2]), half);
+	}
+
+	// Trilinear coverage of 4 lanes, with the same arithmetic as CPURayCaster::getSample
+	__m128 getSamples(const VoxelGrid& grid, const __m128 tex[3], uint8_t mipLevel)
+	{
+		const auto size = static_cast<int>(grid.GetSize(mipLevel));
+		const auto pData = grid.GetData(mipLevel);
+		const auto one = _mm_set1_ps(1.0f);
+
+		__m128 w[3];
+		alignas(16) int i0[3][4], i1[3][4];
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			const auto u = _mm_sub_ps(_mm_mul_ps(tex[i], _mm_set1_ps(static_cast<float>(size))), _mm_set1_ps(0.5f));
+			const auto t = _mm_cvttps_epi32(u);
+			const auto f = _mm_sub_ps(_mm_cvtepi32_ps(t), _mm_and_ps(_mm_cmpgt_ps(_mm_cvtepi32_ps(t), u), one));	// floor
+			w[i] = _mm_sub_ps(u, f);
+
+			const auto lo = _mm_cvttps_epi32(f);
+			_mm_store_si128(reinterpret_cast<__m128i*>(i0[i]), lo);
+			_mm_store_si128(reinterpret_cast<__m128i*>(i1[i]), _mm_add_epi32(lo, _mm_set1_epi32(1)));
+			for (uint8_t j = 0; j < 4; ++j)
+			{
+				i0[i][j] = (min)((max)(i0[i][j], 0), size - 1);
+				i1[i][j] = (min)((max)(i1[i][j], 0), size - 1);
+			}
+		}
+
+		auto density = _mm_setzero_ps();
+		for (uint8_t i = 0; i < 8; ++i)
+		{
+			alignas(16) float coverage[4];
+			for (uint8_t j = 0; j < 4; ++j)
+			{
+				const auto x = i & 1 ? i1[0][j] : i0[0][j];
+				const auto y = i & 2 ? i1[1][j] : i0[1][j];
+				const auto z = i & 4 ? i1[2][j] : i0[2][j];
+				coverage[j] = (pData[(static_cast<size_t>(z) * size + y) * size + x] >> 30) / 3.0f;
+			}
+
+			const auto wx = i & 1 ? w[0] : _mm_sub_ps(one, w[0]);
+			const auto wy = i & 2 ? w[1] : _mm_sub_ps(one, w[1]);
+			const auto wz = i & 4 ? w[2] : _mm_sub_ps(one, w[2]);
+			const auto weight = _mm_mul_ps(_mm_mul_ps(wx, wy), wz);
+			const auto isValid = _mm_cmpgt_ps(weight, _mm_setzero_ps());
+			density = _mm_add_ps(density, _mm_and_ps(_mm_mul_ps(weight, _mm_load_ps(coverage)), isValid));
+		}
+
+		return _mm_min_ps(_mm_mul_ps(density, _mm_set1_ps(8.0f)), _mm_set1_ps(16.0f));
+	}
+
+	__m128 saturate(__m128 x)
+	{
+		return _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	}
+#endif
+}
+
+CPURayCaster::CPURayCaster() :
+	m_screenToLocal(),
+	m_eyePt(),
+	m_lightPt(),
+	m_usePackets(USE_SSE2 != 0),
+	m_useLightVolume(USE_LIGHT_VOLUME != 0)
+{
+}
+
+CPURayCaster::~CPURayCaster()
+{
+}
+
+void CPURayCaster::SetCamera(const float screenToLocal[16], const float localSpaceEyePt[3])
+{
+	memcpy(m_screenToLocal, screenToLocal, sizeof(m_screenToLocal));
+	memcpy(m_eyePt, localSpaceEyePt, sizeof(m_eyePt));
+}
+
+void CPURayCaster::SetLight(const float localSpaceLightPt[3])
+{
+	memcpy(m_lightPt, localSpaceLightPt, sizeof(m_lightPt));
+}
+
+void CPURayCaster::SetView(const float bound[4], const float posScale[4], const float eyePt[3],
+	const float focusPt[3], uint32_t width, uint32_t height)
+{
+	// World matrix of Voxelizer::UpdateFrame
+	const auto scl = bound[3] * posScale[3];
+	const float world[] =
+	{
+		scl, 0.0f, 0.0f, 0.0f,
+		0.0f, scl, 0.0f, 0.0f,
+		0.0f, 0.0f, scl, 0.0f,
+		bound[0] * posScale[3] + posScale[0], bound[1] * posScale[3] + posScale[1], bound[2] * posScale[3] + posScale[2], 1.0f
+	};
+
+	float view[16], proj[16], worldViewProj[16], worldI[16];
+	lookAtLH(view, eyePt, focusPt);
+	perspectiveFovLH(proj, g_FOVAngleY, static_cast<float>(width) / height, g_zNear, g_zFar);
+	multiply(worldViewProj, world, view);
+	multiply(worldViewProj, worldViewProj, proj);
+	invert(worldI, world);
+
+	const float toScreen[] =
+	{
+		0.5f * width, 0.0f, 0.0f, 0.0f,
+		0.0f, -0.5f * height, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.5f * width, 0.5f * height, 0.0f, 1.0f
+	};
+
+	float localToScreen[16];
+	multiply(localToScreen, worldViewProj, toScreen);
+	invert(m_screenToLocal, localToScreen);
+
+	const float lightPt[] = { -10.0f, 45.0f, -75.0f };
+	transformCoord(m_eyePt, eyePt, worldI);
+	transformCoord(m_lightPt, lightPt, worldI);
+}
+
+void CPURayCaster::SetPacketTraversal(bool enable)
+{
+	m_usePackets = enable && USE_SSE2;
+}
+
+void CPURayCaster::SetLightVolume(bool enable)
+{
+	m_useLightVolume = enable;
+}
+
+uint8_t CPURayCaster::GetMipLevel(const VoxelGrid& grid, uint8_t finestLevel) const
+{
+	float localToScreen[16], centerPt[3], pixelPt[3];
+	const float origin[3] = {};
+	invert(localToScreen, m_screenToLocal);
+	transformCoord(centerPt, origin, localToScreen);
+	centerPt[0] += 1.0f;
+	transformCoord(pixelPt, centerPt, m_screenToLocal);
+
+	const auto pixelSize = sqrt(pixelPt[0] * pixelPt[0] + pixelPt[1] * pixelPt[1] + pixelPt[2] * pixelPt[2]);
+	const auto lod = floor(log2(pixelSize * grid.GetSize() / 2.0f));
+
+	return static_cast<uint8_t>((min)((max)(lod, static_cast<float>(finestLevel)), grid.GetNumLevels() - 1.0f));
+}
+
+bool CPURayCaster::WritePNG(const char* fileName, uint32_t width, uint32_t height, const uint8_t* pPixels)
+{
+	return stbi_write_png(fileName, static_cast<int>(width), static_cast<int>(height), 4, pPixels, 0) != 0;
+}
+
+void CPURayCaster::Render(const VoxelGrid& grid, uint32_t width, uint32_t height, uint8_t* pPixels,
+	uint8_t mipLevel, bool skipEmpty, RayCastStats* pStats, uint32_t numThreads) const
+{
+	PROFILE_SCOPE("CPURayCaster::Render");
+
+	mipLevel = static_cast<uint8_t>((min)(static_cast<uint32_t>(mipLevel), grid.GetNumLevels() - 1u));
+
+	vector<uint8_t> emptyDist;
+	if (skipEmpty) computeEmptyDistance(grid, emptyDist, numThreads);
+	const auto pEmptyDist = skipEmpty ? emptyDist.data() : nullptr;
+
+	vector<float> lightTrans;
+	if (m_useLightVolume) computeLightTrans(grid, mipLevel, lightTrans, numThreads);
+	const auto pLightTrans = m_useLightVolume ? lightTrans.data() : nullptr;
+
+	const auto numTilesX = (width + TileSize - 1) / TileSize;
+	const auto numTilesY = (height + TileSize - 1) / TileSize;
+	vector<RayCastStats> tileStats(numTilesX * numTilesY, RayCastStats());
+
+	ParallelFor(0, numTilesX * numTilesY, [&](uint32_t tile)
+	{
+		renderTile(grid, pEmptyDist, pLightTrans, tile % numTilesX * TileSize, tile / numTilesX * TileSize,
+			width, height, mipLevel, pPixels, tileStats[tile]);
+	}, numThreads);
+
+	if (pStats)
+	{
+		*pStats = RayCastStats();
+		for (const auto& stats : tileStats) accumulate(*pStats, stats);
+	}
+}
+
+void CPURayCaster::renderTile(const VoxelGrid& grid, const uint8_t* pEmptyDist, const float* pLightTrans,
+	uint32_t x0, uint32_t y0, uint32_t width, uint32_t height, uint8_t mipLevel,
+	uint8_t* pPixels, RayCastStats& stats) const
+{
+	const auto x1 = (min)(x0 + TileSize, width);
+	const auto y1 = (min)(y0 + TileSize, height);
+	const auto getPixel = [&](uint32_t x, uint32_t y) { return &pPixels[(static_cast<size_t>(y) * width + x) * 4]; };
+
+	auto y = y0;
+#if	USE_SSE2
+	// 2x2 packets
+	if (m_usePackets)
+	{
+		for (; y + 1 < y1; y += 2)
+		{
+			auto x = x0;
+			for (; x + 1 < x1; x += 2)
+			{
+				uint8_t* pixels[] = { getPixel(x, y), getPixel(x + 1, y), getPixel(x, y + 1), getPixel(x + 1, y + 1) };
+				renderPacket(grid, pEmptyDist, pLightTrans, x + 0.5f, y + 0.5f, mipLevel, pixels, stats);
+			}
+
+			// Remaining column
+			for (; x < x1; ++x)
+			{
+				renderPixel(grid, pEmptyDist, pLightTrans, x + 0.5f, y + 0.5f, mipLevel, getPixel(x, y), stats);
+				renderPixel(grid, pEmptyDist, pLightTrans, x + 0.5f, y + 1.5f, mipLevel, getPixel(x, y + 1), stats);
+			}
+		}
+	}
+#endif
+
+	// Single rays for the remaining rows
+	for (; y < y1; ++y)
+		for (auto x = x0; x < x1; ++x)
+			renderPixel(grid, pEmptyDist, pLightTrans, x + 0.5f, y + 0.5f, mipLevel, getPixel(x, y), stats);
+}
+
+void CPURayCaster::renderPixel(const VoxelGrid& grid, const uint8_t* pEmptyDist, const float* pLightTrans,
+	float x, float y, uint8_t mipLevel, uint8_t pixel[4], RayCastStats& stats) const
+{
+	++stats.NumRays;
+
+	// The point on the near plane
+	const float screenPos[] = { x, y, 0.0f };
+	float pos[3], rayDir[3];
+	transformCoord(pos, screenPos, m_screenToLocal);
+	for (uint8_t i = 0; i < 3; ++i) rayDir[i] = pos[i] - m_eyePt[i];
+	normalize(rayDir);
+
+	if (computeStartPoint(pos, rayDir))
+	{
+		float step[3], lightStep[3] = { m_lightPt[0], m_lightPt[1], m_lightPt[2] };
+		normalize(lightStep);
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			step[i] = rayDir[i] * g_stepScale;
+			lightStep[i] *= g_lightStepScale;
+		}
+
+		const float texStep[] = { 0.5f * step[0], -0.5f * step[1], 0.5f * step[2] };
+		const float lightTexStep[] = { 0.5f * lightStep[0], -0.5f * lightStep[1], 0.5f * lightStep[2] };
+
+		auto transmit = 1.0f;	// Transmittance
+		auto scatter = 0.0f;	// In-scattered radiance
+		for (auto i = 0u; i < NumSamples; ++i)
+		{
+			if (isOutside(pos)) break;
+			++stats.NumSteps;
+
+			float tex[3];
+			toTex(tex, pos);
+
+			// Skip empty space by macro-cells, staying on the same sample lattice
+			const auto numEmptySteps = pEmptyDist ? getNumEmptySteps(grid, pEmptyDist, tex, texStep, mipLevel) : 0;
+			if (numEmptySteps > 0)
+			{
+				++stats.NumSkips;
+				i += numEmptySteps - 1;
+				for (uint8_t k = 0; k < 3; ++k) pos[k] += step[k] * numEmptySteps;
+				continue;
+			}
+
+			// Get a sample
+			const auto density = getSample(grid, tex, mipLevel);
+			++stats.NumSamples;
+
+			if (density > g_zeroThreshold)
+			{
+				// Attenuate ray-throughput
+				const auto scaledDens = density * g_stepScale;
+				transmit *= saturate(1.0f - scaledDens * g_absorption);
+				if (transmit < g_zeroThreshold) break;
+
+				// Sample light
+				auto lightTrans = 1.0f;	// Transmittance along light ray
+				if (pLightTrans) lightTrans = getLightTrans(pLightTrans, grid.GetSize(), tex);	// Precomputed, as CSLightTrans
+				else
+				{
+					float lightPos[] = { pos[0] + lightStep[0], pos[1] + lightStep[1], pos[2] + lightStep[2] };
+					for (auto j = 0u; j < NumLightSamples; ++j)
+					{
+						if (isOutside(lightPos)) break;
+						++stats.NumLightSteps;
+						toTex(tex, lightPos);
+
+						const auto numLightEmptySteps = pEmptyDist ? getNumEmptySteps(grid, pEmptyDist, tex, lightTexStep, mipLevel) : 0;
+						if (numLightEmptySteps > 0)
+						{
+							++stats.NumSkips;
+							j += numLightEmptySteps - 1;
+							for (uint8_t k = 0; k < 3; ++k) lightPos[k] += lightStep[k] * numLightEmptySteps;
+							continue;
+						}
+
+						// Attenuate ray-throughput along light direction
+						const auto lightDens = getSample(grid, tex, mipLevel);
+						++stats.NumLightSamples;
+						lightTrans *= saturate(1.0f - g_absorption * g_lightStepScale * lightDens);
+						if (lightTrans < g_zeroThreshold) break;
+
+						for (uint8_t k = 0; k < 3; ++k) lightPos[k] += lightStep[k];
+					}
+				}
+
+				scatter += lightTrans * transmit * scaledDens;
+			}
+
+			for (uint8_t k = 0; k < 3; ++k) pos[k] += step[k];
+		}
+
+		shade(pixel, true, transmit, scatter);
+	}
+	else shade(pixel, false, 1.0f, 0.0f);
+}
+
+#if	USE_SSE2
+//--------------------------------------------------------------------------------------
+// Marches the rays of a 2x2 pixel quad together in SSE2 lanes, in the same order of
+// operations as renderPixel, so the image and the counters are identical. Lanes leave
+// the packet independently; the empty-space lookups stay scalar per lane.
+//--------------------------------------------------------------------------------------
+void CPURayCaster::renderPacket(const VoxelGrid& grid, const uint8_t* pEmptyDist, const float* pLightTrans,
+	float x, float y, uint8_t mipLevel, uint8_t* pPixels[4], RayCastStats& stats) const
+{
+	stats.NumRays += 4;
+
+	// Ray setup per lane
+	alignas(16) float pos[3][4], step[3][4];
+	auto active = 0u;
+	for (uint8_t j = 0; j < 4; ++j)
+	{
+		const float screenPos[] = { x + (j & 1), y + (j >> 1), 0.0f };
+		float rayPos[3], rayDir[3];
+		transformCoord(rayPos, screenPos, m_screenToLocal);
+		for (uint8_t k = 0; k < 3; ++k) rayDir[k] = rayPos[k] - m_eyePt[k];
+		normalize(rayDir);
+
+		const auto isHit = computeStartPoint(rayPos, rayDir);
+		for (uint8_t k = 0; k < 3; ++k)
+		{
+			pos[k][j] = isHit ? rayPos[k] : 0.0f;
+			step[k][j] = rayDir[k] * g_stepScale;
+		}
+		active |= isHit ? 1 << j : 0;
+	}
+
+	const auto isHit = active;
+	if (!isHit)
+	{
+		for (uint8_t j = 0; j < 4; ++j) shade(pPixels[j], false, 1.0f, 0.0f);
+		return;
+	}
+
+	float lightStep[3] = { m_lightPt[0], m_lightPt[1], m_lightPt[2] };
+	normalize(lightStep);
+	for (auto& c : lightStep) c *= g_lightStepScale;
+	const float lightTexStep[] = { 0.5f * lightStep[0], -0.5f * lightStep[1], 0.5f * lightStep[2] };
+
+	__m128 rayPos[3], rayStep[3], lightRayStep[3];
+	for (uint8_t k = 0; k < 3; ++k)
+	{
+		rayPos[k] = _mm_load_ps(pos[k]);
+		rayStep[k] = _mm_load_ps(step[k]);
+		lightRayStep[k] = _mm_set1_ps(lightStep[k]);
+	}
+
+	const auto zeroThreshold = _mm_set1_ps(g_zeroThreshold);
+	auto transmit = _mm_set1_ps(1.0f);	// Transmittance
+	auto scatter = _mm_setzero_ps();	// In-scattered radiance
+	uint32_t counters[4] = {};
+	while (true)
+	{
+		active &= ~isOutside(rayPos);
+		for (uint8_t j = 0; j < 4; ++j) if (counters[j] >= NumSamples) active &= ~(1u << j);
+		if (!active) break;
+		stats.NumSteps += countBits(active);
+
+		__m128 tex[3];
+		toTex(tex, rayPos);
+
+		// Skip empty space per lane, staying on the same sample lattice
+		alignas(16) float numSteps[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		auto sampled = active;
+		if (pEmptyDist)
+		{
+			alignas(16) float texels[3][4];
+			for (uint8_t k = 0; k < 3; ++k) _mm_store_ps(texels[k], tex[k]);
+			for (uint8_t j = 0; j < 4; ++j)
+			{
+				if (!(active & (1 << j))) continue;
+				const float laneTex[] = { texels[0][j], texels[1][j], texels[2][j] };
+				const float texStep[] = { 0.5f * step[0][j], -0.5f * step[1][j], 0.5f * step[2][j] };
+				const auto numEmptySteps = getNumEmptySteps(grid, pEmptyDist, laneTex, texStep, mipLevel);
+				if (numEmptySteps > 0)
+				{
+					++stats.NumSkips;
+					sampled &= ~(1u << j);
+					numSteps[j] = static_cast<float>(numEmptySteps);
+				}
+			}
+		}
+
+		if (sampled)
+		{
+			// Get samples
+			const auto density = getSamples(grid, tex, mipLevel);
+			stats.NumSamples += countBits(sampled);
+
+			// Attenuate ray-throughput
+			const auto dense = sampled & _mm_movemask_ps(_mm_cmpgt_ps(density, zeroThreshold));
+			const auto isDense = laneMask(dense);
+			const auto scaledDens = _mm_mul_ps(density, _mm_set1_ps(g_stepScale));
+			const auto attenuation = saturate(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(scaledDens, _mm_set1_ps(g_absorption))));
+			transmit = _mm_or_ps(_mm_and_ps(isDense, _mm_mul_ps(transmit, attenuation)), _mm_andnot_ps(isDense, transmit));
+			const auto opaque = dense & _mm_movemask_ps(_mm_cmplt_ps(transmit, zeroThreshold));
+			active &= ~opaque;
+
+			// Sample light
+			auto lightActive = dense & ~opaque;
+			auto lightTrans = _mm_set1_ps(1.0f);	// Transmittance along light ray
+			if (lightActive && pLightTrans)
+			{
+				alignas(16) float texels[3][4], lightTranses[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+				for (uint8_t k = 0; k < 3; ++k) _mm_store_ps(texels[k], tex[k]);
+				for (uint8_t j = 0; j < 4; ++j)
+				{
+					if (!(lightActive & (1 << j))) continue;
+					const float laneTex[] = { texels[0][j], texels[1][j], texels[2][j] };
+					lightTranses[j] = getLightTrans(pLightTrans, grid.GetSize(), laneTex);
+				}
+
+				lightTrans = _mm_load_ps(lightTranses);
+				const auto inScatter = _mm_mul_ps(_mm_mul_ps(lightTrans, transmit), scaledDens);
+				scatter = _mm_add_ps(scatter, _mm_and_ps(laneMask(lightActive), inScatter));
+			}
+			else if (lightActive)
+			{
+				__m128 lightPos[3];
+				for (uint8_t k = 0; k < 3; ++k) lightPos[k] = _mm_add_ps(rayPos[k], lightRayStep[k]);
+
+				const auto lightAbsorption = _mm_set1_ps(g_absorption * g_lightStepScale);
+				const auto scatterLanes = laneMask(lightActive);
+				uint32_t lightCounters[4] = {};
+				while (true)
+				{
+					lightActive &= ~isOutside(lightPos);
+					for (uint8_t j = 0; j < 4; ++j) if (lightCounters[j] >= NumLightSamples) lightActive &= ~(1u << j);
+					if (!lightActive) break;
+					stats.NumLightSteps += countBits(lightActive);
+
+					__m128 lightTex[3];
+					toTex(lightTex, lightPos);
+
+					alignas(16) float numLightSteps[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+					auto lightSampled = lightActive;
+					if (pEmptyDist)
+					{
+						alignas(16) float texels[3][4];
+						for (uint8_t k = 0; k < 3; ++k) _mm_store_ps(texels[k], lightTex[k]);
+						for (uint8_t j = 0; j < 4; ++j)
+						{
+							if (!(lightActive & (1 << j))) continue;
+							const float laneTex[] = { texels[0][j], texels[1][j], texels[2][j] };
+							const auto numEmptySteps = getNumEmptySteps(grid, pEmptyDist, laneTex, lightTexStep, mipLevel);
+							if (numEmptySteps > 0)
+							{
+								++stats.NumSkips;
+								lightSampled &= ~(1u << j);
+								numLightSteps[j] = static_cast<float>(numEmptySteps);
+							}
+						}
+					}
+
+					if (lightSampled)
+					{
+						// Attenuate ray-throughput along light direction
+						const auto lightDens = getSamples(grid, lightTex, mipLevel);
+						stats.NumLightSamples += countBits(lightSampled);
+						const auto isSampled = laneMask(lightSampled);
+						const auto lightAtten = saturate(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(lightAbsorption, lightDens)));
+						lightTrans = _mm_or_ps(_mm_and_ps(isSampled, _mm_mul_ps(lightTrans, lightAtten)), _mm_andnot_ps(isSampled, lightTrans));
+						lightActive &= ~(lightSampled & _mm_movemask_ps(_mm_cmplt_ps(lightTrans, zeroThreshold)));
+					}
+
+					const auto n = _mm_load_ps(numLightSteps);
+					const auto isActive = laneMask(lightActive);
+					for (uint8_t k = 0; k < 3; ++k)
+						lightPos[k] = _mm_add_ps(lightPos[k], _mm_and_ps(isActive, _mm_mul_ps(lightRayStep[k], n)));
+					for (uint8_t j = 0; j < 4; ++j) lightCounters[j] += static_cast<uint32_t>(numLightSteps[j]);
+				}
+
+				const auto inScatter = _mm_mul_ps(_mm_mul_ps(lightTrans, transmit), scaledDens);
+				scatter = _mm_add_ps(scatter, _mm_and_ps(scatterLanes, inScatter));
+			}
+		}
+
+		const auto n = _mm_load_ps(numSteps);
+		const auto isActive = laneMask(active);
+		for (uint8_t k = 0; k < 3; ++k)
+			rayPos[k] = _mm_add_ps(rayPos[k], _mm_and_ps(isActive, _mm_mul_ps(rayStep[k], n)));
+		for (uint8_t j = 0; j < 4; ++j) counters[j] += static_cast<uint32_t>(numSteps[j]);
+	}
+
+	alignas(16) float transmits[4], scatters[4];
+	_mm_store_ps(transmits, transmit);
+	_mm_store_ps(scatters, scatter);
+	for (uint8_t j = 0; j < 4; ++j)
+		shade(pPixels[j], (isHit & (1 << j)) != 0, transmits[j], scatters[j]);
+}
+#endif
+
+//--------------------------------------------------------------------------------------
+// Trilinear coverage with clamp addressing, as GetSample in PSRayCast
+//--------------------------------------------------------------------------------------
+float CPURayCaster::getSample(const VoxelGrid& grid, const float tex[3], uint8_t mipLevel) const
+{
+	const auto size = static_cast<int>(grid.GetSize(mipLevel));
+	const auto pData = grid.GetData(mipLevel);
+
+	int i0[3], i1[3];
+	float w[3];
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		const auto u = tex[i] * size - 0.5f;
+		const auto f = floor(u);
+		w[i] = u - f;
+		i0[i] = (min)((max)(static_cast<int>(f), 0), size - 1);
+		i1[i] = (min)((max)(static_cast<int>(f) + 1, 0), size - 1);
+	}
+
+	const auto coverage = [&](int x, int y, int z)
+	{
+		return (pData[(static_cast<size_t>(z) * size + y) * size + x] >> 30) / 3.0f;
+	};
+
+	auto density = 0.0f;
+	for (uint8_t i = 0; i < 8; ++i)
+	{
+		const auto wx = i & 1 ? w[0] : 1.0f - w[0];
+		const auto wy = i & 2 ? w[1] : 1.0f - w[1];
+		const auto wz = i & 4 ? w[2] : 1.0f - w[2];
+		const auto weight = wx * wy * wz;
+		if (weight > 0.0f) density += weight * coverage(i & 1 ? i1[0] : i0[0], i & 2 ? i1[1] : i0[1], i & 4 ? i1[2] : i0[2]);
+	}
+
+	return (min)(density * 8.0f, 16.0f);
+}
+
+//--------------------------------------------------------------------------------------
+// Same as GetNumEmptySteps in PSRayCast
+//--------------------------------------------------------------------------------------
+uint32_t CPURayCaster::getNumEmptySteps(const VoxelGrid& grid, const uint8_t* pEmptyDist,
+	const float tex[3], const float texStep[3], uint8_t mipLevel) const
+{
+	const auto gridSize = static_cast<int>(grid.GetSize());
+	int voxel[3];
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		voxel[i] = static_cast<int>(floor(tex[i] * gridSize));
+		if (voxel[i] < 0 || voxel[i] >= gridSize) return 0;
+	}
+
+	const int dist = pEmptyDist[(static_cast<size_t>(voxel[2]) * gridSize + voxel[1]) * gridSize + voxel[0]];
+	if (dist == 0) return 0;
+
+	// Empty cube around the voxel, in texels of the base level whose coverage is conservative
+	const auto scale = 1 << mipLevel;
+	const auto size = static_cast<float>(grid.GetSize(mipLevel));
+	const auto halfTexel = 0.5f / size;
+	auto numSteps = FLT_MAX;
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		const auto lo = ceil(static_cast<float>(voxel[i] - dist + 1) / scale) / size + halfTexel;
+		const auto hi = floor(static_cast<float>(voxel[i] + dist) / scale) / size - halfTexel;
+		if (tex[i] < lo || tex[i] > hi) return 0;
+		if (fabs(texStep[i]) > 1e-8f) numSteps = (min)(numSteps, ((texStep[i] >= 0.0f ? hi : lo) - tex[i]) / texStep[i]);
+	}
+
+	return (max)(static_cast<uint32_t>(ceil(numSteps)), 1u);
+}
+
+//--------------------------------------------------------------------------------------
+// Chebyshev distance in voxels from each voxel of level 0 to the nearest occupied voxel,
+// capped at MAX_EMPTY_DIST. The transform is separable, one pass per axis, as the
+// CSEmptyDist passes.
+//--------------------------------------------------------------------------------------
+void CPURayCaster::computeEmptyDistance(const VoxelGrid& grid, vector<uint8_t>& emptyDist, uint32_t numThreads)
+{
+	const auto size = static_cast<int>(grid.GetSize());
+	const auto pGrid = grid.GetData();
+	const size_t strides[] = { 1, static_cast<size_t>(size), static_cast<size_t>(size) * size };
+	vector<uint8_t> temp(grid.GetNumVoxels());
+	emptyDist.resize(grid.GetNumVoxels());
+
+	for (uint8_t axis = 0; axis < 3; ++axis)
+	{
+		const auto pSrc = axis == 1 ? emptyDist.data() : temp.data();
+		const auto pDst = axis == 1 ? temp.data() : emptyDist.data();
+		const auto stride = strides[axis];
+		const auto stride1 = strides[axis == 0 ? 1 : 0];
+		const auto stride2 = strides[axis == 2 ? 1 : 2];
+
+		ParallelFor(0, size * size, [&](uint32_t row)
+		{
+			const auto base = (row % size) * stride1 + (row / size) * stride2;
+			for (auto i = 0; i < size; ++i)
+			{
+				int dist = MAX_EMPTY_DIST;
+				const auto first = (max)(i - MAX_EMPTY_DIST + 1, 0);
+				const auto last = (min)(i + MAX_EMPTY_DIST - 1, size - 1);
+				for (auto j = first; j <= last; ++j)
+				{
+					const auto idx = base + j * stride;
+					const auto d = axis > 0 ? (max)(static_cast<int>(pSrc[idx]), abs(j - i)) :
+						((pGrid[idx] & VoxelGrid::CoverageMask) ? abs(j - i) : MAX_EMPTY_DIST);
+					dist = (min)(dist, d);
+				}
+				pDst[base + i * stride] = static_cast<uint8_t>(dist);
+			}
+		}, numThreads);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Transmittance toward the directional light at each voxel center of level 0, swept
+// slice by slice along the dominant axis of the light direction as CSLightTrans, where
+// each slice is parallel over its rows.
+//--------------------------------------------------------------------------------------
+void CPURayCaster::computeLightTrans(const VoxelGrid& grid, uint8_t mipLevel, vector<float>& lightTrans,
+	uint32_t numThreads) const
+{
+	const auto size = static_cast<int>(grid.GetSize());
+	lightTrans.resize(grid.GetNumVoxels());
+
+	// Light direction in voxels, with the step of one slice along the dominant axis
+	float lightDir[3] = { m_lightPt[0], m_lightPt[1], m_lightPt[2] };
+	normalize(lightDir);
+	lightDir[0] *= 0.5f;
+	lightDir[1] *= -0.5f;
+	lightDir[2] *= 0.5f;
+
+	const float absDir[] = { fabs(lightDir[0]), fabs(lightDir[1]), fabs(lightDir[2]) };
+	const uint8_t axis = absDir[0] >= absDir[1] && absDir[0] >= absDir[2] ? 0 : (absDir[1] >= absDir[2] ? 1 : 2);
+	const uint8_t u = (axis + 1) % 3, v = (axis + 2) % 3;
+	const float step[] = { lightDir[0] / absDir[axis], lightDir[1] / absDir[axis], lightDir[2] / absDir[axis] };
+	const auto stepScale = sqrt(step[0] * step[0] + step[1] * step[1] + step[2] * step[2]) * 2.0f / size;
+
+	const auto getIndex = [size](const int voxel[3])
+	{
+		return (static_cast<size_t>(voxel[2]) * size + voxel[1]) * size + voxel[0];
+	};
+
+	for (auto slice = 0; slice < size; ++slice)
+	{
+		ParallelFor(0, size, [&](uint32_t row)
+		{
+			int voxel[3];
+			voxel[axis] = step[axis] > 0.0f ? size - 1 - slice : slice;
+			voxel[v] = row;
+
+			for (auto i = 0; i < size; ++i)
+			{
+				voxel[u] = i;
+
+				// The point one slice toward the light, in voxels
+				const float pos[] = { voxel[0] + step[0], voxel[1] + step[1], voxel[2] + step[2] };
+
+				auto trans = 1.0f;
+				if (pos[0] >= -0.5f && pos[1] >= -0.5f && pos[2] >= -0.5f &&
+					pos[0] <= size - 0.5f && pos[1] <= size - 0.5f && pos[2] <= size - 0.5f)
+				{
+					// Bilinear transmittance of the previous slice
+					const auto pu = (min)((max)(pos[u], 0.0f), size - 1.0f);
+					const auto pv = (min)((max)(pos[v], 0.0f), size - 1.0f);
+					const int i0[] = { static_cast<int>(pu), static_cast<int>(pv) };
+					const int i1[] = { (min)(i0[0] + 1, size - 1), (min)(i0[1] + 1, size - 1) };
+					const float w[] = { pu - i0[0], pv - i0[1] };
+
+					int loc[3];
+					loc[axis] = static_cast<int>(pos[axis]);
+					float prev[4];
+					for (uint8_t j = 0; j < 4; ++j)
+					{
+						loc[u] = j & 1 ? i1[0] : i0[0];
+						loc[v] = j & 2 ? i1[1] : i0[1];
+						prev[j] = lightTrans[getIndex(loc)];
+					}
+
+					const auto prevTrans0 = prev[0] + (prev[1] - prev[0]) * w[0];
+					const auto prevTrans1 = prev[2] + (prev[3] - prev[2]) * w[0];
+					const auto prevTrans = prevTrans0 + (prevTrans1 - prevTrans0) * w[1];
+
+					// Attenuate by the density over the step, whose length is in the local space
+					const float tex[] = { (pos[0] + 0.5f) / size, (pos[1] + 0.5f) / size, (pos[2] + 0.5f) / size };
+					trans = prevTrans * saturate(1.0f - g_absorption * stepScale * getSample(grid, tex, mipLevel));
+				}
+
+				lightTrans[getIndex(voxel)] = trans;
+			}
+		}, numThreads);
+	}
+}
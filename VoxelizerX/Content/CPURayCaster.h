@@ -0,0 +1,86 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "VoxelGrid.h"
+
+//--------------------------------------------------------------------------------------
+// Counters of the ray marching, where steps are loop iterations and samples are
+// density fetches; skips count the jumps over empty space.
+//--------------------------------------------------------------------------------------
+struct RayCastStats
+{
+	uint64_t NumRays;
+	uint64_t NumSteps;
+	uint64_t NumSamples;
+	uint64_t NumLightSteps;
+	uint64_t NumLightSamples;
+	uint64_t NumSkips;
+};
+
+//--------------------------------------------------------------------------------------
+// CPU port of PSRayCast: the same volume integration and constants, with optional
+// empty-space skipping by the empty distance field of the grid, and the in-scattering
+// either by the secondary light march or by the precomputed light transmittance
+// volume, as CSLightTrans. The image is rendered
+// in tiles on worker threads, marching 2x2 pixel packets of rays with SSE2 when
+// available, or one ray at a time as the reference.
+// Matrices are row-major in the DirectXMath convention (row vector times matrix).
+//--------------------------------------------------------------------------------------
+class CPURayCaster
+{
+public:
+	CPURayCaster();
+	virtual ~CPURayCaster();
+
+	// Camera and light in the local space of the grid, as computed in Voxelizer::UpdateFrame
+	void SetCamera(const float screenToLocal[16], const float localSpaceEyePt[3]);
+	void SetLight(const float localSpaceLightPt[3]);
+
+	// Compute the camera and light as Voxelizer::UpdateFrame for the view of VoxelizerX
+	void SetView(const float bound[4], const float posScale[4], const float eyePt[3],
+		const float focusPt[3], uint32_t width, uint32_t height);
+	void SetPacketTraversal(bool enable);
+	void SetLightVolume(bool enable);
+
+	// MIP level whose voxels are no smaller than a pixel at the grid center, as UpdateFrame
+	uint8_t GetMipLevel(const VoxelGrid& grid, uint8_t finestLevel = 0) const;
+
+	// Render RGBA8 pixels of width x height, where the alpha is 0 for rays missing the grid
+	void Render(const VoxelGrid& grid, uint32_t width, uint32_t height, uint8_t* pPixels,
+		uint8_t mipLevel = 0, bool skipEmpty = true, RayCastStats* pStats = nullptr,
+		uint32_t numThreads = 0) const;
+
+	static bool WritePNG(const char* fileName, uint32_t width, uint32_t height, const uint8_t* pPixels);
+
+	static const uint32_t NumSamples = 128;
+	static const uint32_t NumLightSamples = 32;
+	static const uint32_t TileSize = 16;
+
+protected:
+	void renderTile(const VoxelGrid& grid, const uint8_t* pEmptyDist, const float* pLightTrans,
+		uint32_t x0, uint32_t y0, uint32_t width, uint32_t height, uint8_t mipLevel,
+		uint8_t* pPixels, RayCastStats& stats) const;
+#if	defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+	void renderPacket(const VoxelGrid& grid, const uint8_t* pEmptyDist, const float* pLightTrans,
+		float x, float y, uint8_t mipLevel, uint8_t* pPixels[4], RayCastStats& stats) const;
+#endif
+	void renderPixel(const VoxelGrid& grid, const uint8_t* pEmptyDist, const float* pLightTrans,
+		float x, float y, uint8_t mipLevel, uint8_t pixel[4], RayCastStats& stats) const;
+	void computeLightTrans(const VoxelGrid& grid, uint8_t mipLevel, std::vector<float>& lightTrans,
+		uint32_t numThreads) const;
+	float getSample(const VoxelGrid& grid, const float tex[3], uint8_t mipLevel) const;
+	uint32_t getNumEmptySteps(const VoxelGrid& grid, const uint8_t* pEmptyDist,
+		const float tex[3], const float texStep[3], uint8_t mipLevel) const;
+
+	static void computeEmptyDistance(const VoxelGrid& grid, std::vector<uint8_t>& emptyDist, uint32_t numThreads);
+
+	float m_screenToLocal[16];
+	float m_eyePt[3];
+	float m_lightPt[3];
+
+	bool m_usePackets;
+	bool m_useLightVolume;
+};
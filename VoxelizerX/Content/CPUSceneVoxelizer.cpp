@@ -0,0 +1,179 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "CPUSceneVoxelizer.h"
+
+using namespace std;
+
+namespace
+{
+	const uint32_t g_trianglesPerTask = 256;
+}
+
+CPUSceneVoxelizer::CPUSceneVoxelizer()
+{
+}
+
+CPUSceneVoxelizer::~CPUSceneVoxelizer()
+{
+}
+
+uint32_t CPUSceneVoxelizer::AddMesh(const uint8_t* pVertices, uint32_t stride, uint32_t numVertices,
+	const uint32_t* pIndices, uint32_t numIndices)
+{
+	float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (auto i = 0u; i < numVertices; ++i)
+	{
+		float p[3];
+		memcpy(p, &pVertices[static_cast<size_t>(i) * stride], sizeof(p));
+		for (uint8_t j = 0; j < 3; ++j)
+		{
+			lo[j] = (min)(lo[j], p[j]);
+			hi[j] = (max)(hi[j], p[j]);
+		}
+	}
+
+	SceneMesh mesh = { pVertices, pIndices, stride, numIndices, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+	if (numVertices)
+	{
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			mesh.Center[i] = 0.5f * (lo[i] + hi[i]);
+			mesh.Extent[i] = 0.5f * (hi[i] - lo[i]);
+		}
+	}
+	m_meshes.emplace_back(mesh);
+
+	return static_cast<uint32_t>(m_meshes.size() - 1);
+}
+
+uint32_t CPUSceneVoxelizer::AddInstance(uint32_t mesh, const float transform[3][4], uint32_t objectID)
+{
+	Instance instance;
+	memcpy(instance.Transform, transform, sizeof(instance.Transform));
+	instance.Mesh = mesh;
+	instance.ObjectID = objectID;
+	m_instances.emplace_back(instance);
+
+	return static_cast<uint32_t>(m_instances.size() - 1);
+}
+
+void CPUSceneVoxelizer::SetTransform(uint32_t instance, const float transform[3][4])
+{
+	memcpy(m_instances[instance].Transform, transform, sizeof(m_instances[instance].Transform));
+}
+
+void CPUSceneVoxelizer::ClearScene()
+{
+	m_meshes.clear();
+	m_instances.clear();
+	m_visibleInstances.clear();
+}
+
+//--------------------------------------------------------------------------------------
+// The instances are culled by their world bounds, padded by a voxel, against the cube of
+// the bound. The triangles of the visible ones are split into tasks of a single instance
+// each, all of which are run by one ParallelFor, so many small instances are balanced
+// over the threads as well as a few large ones.
+//--------------------------------------------------------------------------------------
+void CPUSceneVoxelizer::VoxelizeScene(VoxelGrid& grid, const float bound[4], uint32_t numThreads)
+{
+	PROFILE_SCOPE("CPUSceneVoxelizer::VoxelizeScene");
+
+	const auto size = grid.GetSize();
+	const auto gridSize = static_cast<float>(size);
+	const auto padding = 2.0f * bound[3] / gridSize;
+
+	m_visibleInstances.clear();
+	m_taskOffsets.assign(1, 0);
+	for (auto i = 0u; i < m_instances.size(); ++i)
+	{
+		float center[3], extent[3];
+		getWorldBound(m_instances[i], center, extent);
+
+		auto culled = false;
+		for (uint8_t j = 0; j < 3; ++j) culled = culled || fabs(center[j] - bound[j]) > extent[j] + bound[3] + padding;
+		if (culled) continue;
+
+		const auto numTriangles = m_meshes[m_instances[i].Mesh].NumIndices / 3;
+		m_visibleInstances.emplace_back(i);
+		m_taskOffsets.emplace_back(m_taskOffsets.back() + (numTriangles + g_trianglesPerTask - 1) / g_trianglesPerTask);
+	}
+
+	const VoxelRegion region = { { 0, 0, 0 }, { size, size, size } };
+	const auto numLevels = grid.GetNumLevels();
+	ParallelFor(0, m_taskOffsets.back(), [&](uint32_t task)
+	{
+		const auto slot = static_cast<uint32_t>(upper_bound(m_taskOffsets.cbegin(), m_taskOffsets.cend(), task) - m_taskOffsets.cbegin()) - 1;
+		const auto& instance = m_instances[m_visibleInstances[slot]];
+		const auto& mesh = m_meshes[instance.Mesh];
+
+		const auto begin = (task - m_taskOffsets[slot]) * g_trianglesPerTask;
+		const auto end = (min)(begin + g_trianglesPerTask, mesh.NumIndices / 3);
+		for (auto t = begin; t < end; ++t)
+		{
+			float v[3][3], n[3];
+			loadTriangle(v, n, mesh.pVertices, mesh.Stride, &mesh.pIndices[t * 3], bound, instance.Transform, gridSize);
+			voxelizeTriangle(grid, v, n, region, numLevels, instance.ObjectID);
+		}
+	}, numThreads);
+}
+
+void CPUSceneVoxelizer::ComputeBound(float bound[4]) const
+{
+	if (m_instances.empty())
+	{
+		bound[0] = bound[1] = bound[2] = 0.0f;
+		bound[3] = 1.0f;
+
+		return;
+	}
+
+	float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (const auto& instance : m_instances)
+	{
+		float center[3], extent[3];
+		getWorldBound(instance, center, extent);
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			lo[i] = (min)(lo[i], center[i] - extent[i]);
+			hi[i] = (max)(hi[i], center[i] + extent[i]);
+		}
+	}
+
+	GetBound(bound, lo, hi);
+}
+
+uint32_t CPUSceneVoxelizer::GetNumInstances() const
+{
+	return static_cast<uint32_t>(m_instances.size());
+}
+
+uint32_t CPUSceneVoxelizer::GetNumVisibleInstances() const
+{
+	return static_cast<uint32_t>(m_visibleInstances.size());
+}
+
+//--------------------------------------------------------------------------------------
+// World AABB of the transformed mesh AABB, whose extent is that of the mesh by the
+// absolute values of the matrix
+//--------------------------------------------------------------------------------------
+void CPUSceneVoxelizer::getWorldBound(const Instance& instance, float center[3], float extent[3]) const
+{
+	const auto& mesh = m_meshes[instance.Mesh];
+	const auto& m = instance.Transform;
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		center[i] = m[i][0] * mesh.Center[0] + m[i][1] * mesh.Center[1] + m[i][2] * mesh.Center[2] + m[i][3];
+		extent[i] = fabs(m[i][0]) * mesh.Extent[0] + fabs(m[i][1]) * mesh.Extent[1] + fabs(m[i][2]) * mesh.Extent[2];
+	}
+}
@@ -0,0 +1,68 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CPUVoxelizer.h"
+
+//--------------------------------------------------------------------------------------
+// Surface voxelizer of a scene of instanced meshes into a shared grid of a world-space
+// bound. Each instance places a registered mesh by its transform, as in
+// CPUVoxelizer::Voxelize, and carries an object ID. The instances whose world bounds are
+// outside the grid are culled, and the triangles of all the others are voxelized in one
+// batched parallel pass. The object IDs of the instances are written into the ID channel
+// of the grid, if any, with the lowest ID winning in each voxel.
+//--------------------------------------------------------------------------------------
+class CPUSceneVoxelizer :
+	public CPUVoxelizer
+{
+public:
+	CPUSceneVoxelizer();
+	virtual ~CPUSceneVoxelizer();
+
+	// The mesh is referenced rather than copied, so it must outlive the voxelizations.
+	// Its bound for the culling is taken from the vertices here. Returns the mesh index.
+	uint32_t AddMesh(const uint8_t* pVertices, uint32_t stride, uint32_t numVertices,
+		const uint32_t* pIndices, uint32_t numIndices);
+
+	// Returns the instance index
+	uint32_t AddInstance(uint32_t mesh, const float transform[3][4], uint32_t objectID);
+	void SetTransform(uint32_t instance, const float transform[3][4]);
+	void ClearScene();
+
+	// Voxelize all the instances within the bound (center, radius) into the grid, on top of
+	// its current voxels and IDs, so the grid must be cleared beforehand for a new scene
+	void VoxelizeScene(VoxelGrid& grid, const float bound[4], uint32_t numThreads = 0);
+
+	// Bound (center, radius) of the cube enclosing all the instances
+	void ComputeBound(float bound[4]) const;
+
+	uint32_t GetNumInstances() const;
+	uint32_t GetNumVisibleInstances() const;	// Of the last voxelization
+
+protected:
+	struct SceneMesh
+	{
+		const uint8_t*	pVertices;
+		const uint32_t*	pIndices;
+		uint32_t		Stride;
+		uint32_t		NumIndices;
+		float			Center[3];
+		float			Extent[3];	// Half size
+	};
+
+	struct Instance
+	{
+		float		Transform[3][4];
+		uint32_t	Mesh;
+		uint32_t	ObjectID;
+	};
+
+	void getWorldBound(const Instance& instance, float center[3], float extent[3]) const;
+
+	std::vector<SceneMesh>	m_meshes;
+	std::vector<Instance>	m_instances;
+	std::vector<uint32_t>	m_visibleInstances;
+	std::vector<uint32_t>	m_taskOffsets;	// Prefix sums of the tasks of the visible instances
+};
@@ -0,0 +1,233 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <new>
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "CPUTiledVoxelizer.h"
+
+using namespace std;
+
+namespace
+{
+	const uint32_t g_trianglesPerTask = 256;
+	const uint32_t g_minBlockSize = 16;
+	const uint32_t g_maxBlockSize = 4096;
+}
+
+CPUTiledVoxelizer::CPUTiledVoxelizer() :
+	m_tileSize(256),
+	m_size(0),
+	m_numTilesPerAxis(0),
+	m_blockSize(0),
+	m_numTiles(0),
+	m_numConcurrentTiles(0),
+	m_numBucketedTriangles(0),
+	m_numOccupied(0)
+{
+}
+
+CPUTiledVoxelizer::~CPUTiledVoxelizer()
+{
+}
+
+void CPUTiledVoxelizer::SetTileSize(uint32_t tileSize)
+{
+	m_tileSize = tileSize;
+}
+
+//--------------------------------------------------------------------------------------
+// A quarter of the budget buffers the buckets in the pre-pass, after which the buffers
+// are released, and the whole budget is shared by the tiles in flight. The threads are
+// split over the concurrent tiles, and each tile runs its triangles on its share.
+//--------------------------------------------------------------------------------------
+bool CPUTiledVoxelizer::Voxelize(VoxelChunkWriter& writer, const uint8_t* pVertices, uint32_t stride,
+	const uint32_t* pIndices, uint32_t numIndices, const float bound[4],
+	const char* bucketFileName, size_t memoryBudget, uint32_t numThreads)
+{
+	PROFILE_SCOPE("CPUTiledVoxelizer::Voxelize");
+
+	m_size = writer.GetSize();
+	if (m_tileSize == 0 || writer.GetChunkSize() == 0 || m_tileSize % writer.GetChunkSize() != 0) return false;
+
+	m_numTilesPerAxis = (m_size + m_tileSize - 1) / m_tileSize;
+	m_numOccupied = 0;
+	if (!bucketTriangles(pVertices, stride, pIndices, numIndices, bound, bucketFileName, memoryBudget / 4))
+	{
+		remove(bucketFileName);
+
+		return false;
+	}
+
+	vector<uint32_t> tiles;
+	for (auto i = 0u; i < m_buckets.size(); ++i)
+		if (!m_buckets[i].Blocks.empty()) tiles.emplace_back(i);
+	m_numTiles = static_cast<uint32_t>(tiles.size());
+
+	const auto tileMemory = sizeof(uint32_t) * m_tileSize * m_tileSize * m_tileSize;
+	numThreads = GetNumWorkerThreads(numThreads);
+	m_numConcurrentTiles = static_cast<uint32_t>((min)((max)(memoryBudget / tileMemory, static_cast<size_t>(1)),
+		static_cast<size_t>(numThreads)));
+	const auto numThreadsPerTile = (max)(numThreads / m_numConcurrentTiles, 1u);
+
+	atomic<bool> succeeded(true);
+	ParallelFor(0, m_numTiles, [&](uint32_t i)
+	{
+		if (succeeded && !voxelizeTile(writer, tiles[i], bucketFileName, numThreadsPerTile)) succeeded = false;
+	}, m_numConcurrentTiles);
+
+	m_buckets.clear();
+	remove(bucketFileName);
+
+	return succeeded;
+}
+
+uint32_t CPUTiledVoxelizer::GetTileSize() const
+{
+	return m_tileSize;
+}
+
+uint32_t CPUTiledVoxelizer::GetNumTiles() const
+{
+	return m_numTiles;
+}
+
+uint32_t CPUTiledVoxelizer::GetNumConcurrentTiles() const
+{
+	return m_numConcurrentTiles;
+}
+
+uint64_t CPUTiledVoxelizer::GetNumBucketedTriangles() const
+{
+	return m_numBucketedTriangles;
+}
+
+size_t CPUTiledVoxelizer::GetNumOccupied() const
+{
+	return m_numOccupied;
+}
+
+//--------------------------------------------------------------------------------------
+// Each triangle goes to the tiles of its voxel range in the grid, as in voxelizeTriangle,
+// where the blocks of all the buckets are sized to fit the buffer budget together
+//--------------------------------------------------------------------------------------
+bool CPUTiledVoxelizer::bucketTriangles(const uint8_t* pVertices, uint32_t stride, const uint32_t* pIndices,
+	uint32_t numIndices, const float bound[4], const char* bucketFileName, size_t bufferBudget)
+{
+	PROFILE_SCOPE("CPUTiledVoxelizer::bucketTriangles");
+
+	const size_t numTiles = static_cast<size_t>(m_numTilesPerAxis) * m_numTilesPerAxis * m_numTilesPerAxis;
+	const auto blockSize = bufferBudget / (numTiles * sizeof(BucketTriangle));
+	m_blockSize = static_cast<uint32_t>((min)((max)(blockSize, static_cast<size_t>(g_minBlockSize)), static_cast<size_t>(g_maxBlockSize)));
+	m_buckets.clear();
+	m_buckets.resize(numTiles);
+	m_numBucketedTriangles = 0;
+
+	ofstream file(bucketFileName, ios::binary | ios::trunc);
+	if (!file) return false;
+
+	uint64_t offset = 0;
+	const auto flush = [&](Bucket& bucket)
+	{
+		const auto numTriangles = static_cast<uint32_t>(bucket.Buffer.size());
+		file.write(reinterpret_cast<const char*>(bucket.Buffer.data()), sizeof(BucketTriangle) * numTriangles);
+		bucket.Blocks.push_back({ offset, numTriangles });
+		offset += sizeof(BucketTriangle) * numTriangles;
+		bucket.Buffer.clear();
+	};
+
+	const auto gridSize = static_cast<float>(m_size);
+	const VoxelRegion region = { { 0, 0, 0 }, { m_size, m_size, m_size } };
+	for (auto t = 0u; t < numIndices / 3; ++t)
+	{
+		BucketTriangle triangle;
+		loadTriangle(triangle.V, triangle.N, pVertices, stride, &pIndices[t * 3], bound, nullptr, gridSize);
+
+		int lo[3], hi[3];
+		if (!getVoxelRange(triangle.V, region, lo, hi)) continue;
+
+		for (auto z = lo[2] / m_tileSize; z <= hi[2] / m_tileSize; ++z)
+		{
+			for (auto y = lo[1] / m_tileSize; y <= hi[1] / m_tileSize; ++y)
+			{
+				for (auto x = lo[0] / m_tileSize; x <= hi[0] / m_tileSize; ++x)
+				{
+					auto& bucket = m_buckets[(static_cast<size_t>(z) * m_numTilesPerAxis + y) * m_numTilesPerAxis + x];
+					if (bucket.Buffer.empty()) bucket.Buffer.reserve(m_blockSize);
+					bucket.Buffer.emplace_back(triangle);
+					if (bucket.Buffer.size() >= m_blockSize) flush(bucket);
+					++m_numBucketedTriangles;
+				}
+			}
+		}
+	}
+
+	for (auto& bucket : m_buckets)
+	{
+		if (!bucket.Buffer.empty()) flush(bucket);
+		vector<BucketTriangle>().swap(bucket.Buffer);
+	}
+
+	return file.good();
+}
+
+bool CPUTiledVoxelizer::voxelizeTile(VoxelChunkWriter& writer, uint32_t tile, const char* bucketFileName, uint32_t numThreads)
+{
+	const auto& bucket = m_buckets[tile];
+	const uint32_t origin[] =
+	{
+		tile % m_numTilesPerAxis * m_tileSize,
+		tile / m_numTilesPerAxis % m_numTilesPerAxis * m_tileSize,
+		tile / (m_numTilesPerAxis * m_numTilesPerAxis) * m_tileSize
+	};
+
+	VoxelGrid grid;
+	vector<BucketTriangle> triangles;
+	try
+	{
+		auto numTriangles = 0u;
+		for (const auto& block : bucket.Blocks) numTriangles += block.NumTriangles;
+		triangles.resize(numTriangles);
+		if (!grid.Create(m_tileSize)) return false;
+	}
+	catch (const bad_alloc&)
+	{
+		return false;
+	}
+
+	ifstream file(bucketFileName, ios::binary);
+	auto pTriangle = triangles.data();
+	for (const auto& block : bucket.Blocks)
+	{
+		file.seekg(block.Offset);
+		if (!file.read(reinterpret_cast<char*>(pTriangle), sizeof(BucketTriangle) * block.NumTriangles)) return false;
+		pTriangle += block.NumTriangles;
+	}
+
+	// The voxels of the tile region are written at its origin in the tile grid
+	VoxelRegion region;
+	int offset[3];
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		region.Min[i] = origin[i];
+		region.Max[i] = (min)(origin[i] + m_tileSize, m_size);
+		offset[i] = -static_cast<int>(origin[i]);
+	}
+
+	const auto numTriangles = static_cast<uint32_t>(triangles.size());
+	const auto numTasks = (numTriangles + g_trianglesPerTask - 1) / g_trianglesPerTask;
+	ParallelFor(0, numTasks, [&](uint32_t task)
+	{
+		const auto end = (min)((task + 1) * g_trianglesPerTask, numTriangles);
+		for (auto t = task * g_trianglesPerTask; t < end; ++t)
+			voxelizeTriangle(grid, triangles[t].V, triangles[t].N, region, 1, m_objectID, offset);
+	}, numThreads);
+
+	m_numOccupied += grid.GetNumOccupied();
+
+	return writer.WriteGrid(grid, origin, numThreads);
+}
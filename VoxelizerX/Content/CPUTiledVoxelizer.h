@@ -0,0 +1,76 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include "CPUVoxelizer.h"
+#include "VoxelChunkFile.h"
+
+//--------------------------------------------------------------------------------------
+// Out-of-core surface voxelizer of level 0 into a chunked file, for grids too large for
+// memory. The grid is partitioned into tiles. A streaming pre-pass maps each triangle
+// to the grid once, and appends it to the buckets of the tiles it overlaps, which are
+// buffered in blocks and spilled to a bucket file on disk. The tiles are then voxelized
+// from their buckets, as many at a time as the memory budget allows, and written to the
+// chunked file as they complete, so only the tiles in flight and the bucket buffers
+// reside in memory, besides the mesh. The result is the same as a full voxelization.
+//--------------------------------------------------------------------------------------
+class CPUTiledVoxelizer :
+	public CPUVoxelizer
+{
+public:
+	CPUTiledVoxelizer();
+	virtual ~CPUTiledVoxelizer();
+
+	// The tile size must be a multiple of the chunk size of the writer (256 by default)
+	void SetTileSize(uint32_t tileSize);
+
+	// Voxelize into the writer, which has been created with the grid size, where the
+	// bucket file is temporary, and the memory budget is in bytes
+	bool Voxelize(VoxelChunkWriter& writer, const uint8_t* pVertices, uint32_t stride,
+		const uint32_t* pIndices, uint32_t numIndices, const float bound[4],
+		const char* bucketFileName, size_t memoryBudget, uint32_t numThreads = 0);
+
+	uint32_t GetTileSize() const;
+	uint32_t GetNumTiles() const;			// Of the last voxelization, with triangles
+	uint32_t GetNumConcurrentTiles() const;	// Of the last voxelization
+	uint64_t GetNumBucketedTriangles() const;	// Triangles times the tiles they overlap
+	size_t GetNumOccupied() const;
+
+protected:
+	// Grid-space triangle, as loaded by loadTriangle
+	struct BucketTriangle
+	{
+		float V[3][3];
+		float N[3];
+	};
+
+	// Spilled run of the bucket of a tile
+	struct Block
+	{
+		uint64_t Offset;
+		uint32_t NumTriangles;
+	};
+
+	struct Bucket
+	{
+		std::vector<BucketTriangle>	Buffer;
+		std::vector<Block>			Blocks;
+	};
+
+	bool bucketTriangles(const uint8_t* pVertices, uint32_t stride, const uint32_t* pIndices,
+		uint32_t numIndices, const float bound[4], const char* bucketFileName, size_t bufferBudget);
+	bool voxelizeTile(VoxelChunkWriter& writer, uint32_t tile, const char* bucketFileName, uint32_t numThreads);
+
+	std::vector<Bucket> m_buckets;
+	uint32_t	m_tileSize;
+	uint32_t	m_size;
+	uint32_t	m_numTilesPerAxis;
+	uint32_t	m_blockSize;		// In triangles
+	uint32_t	m_numTiles;
+	uint32_t	m_numConcurrentTiles;
+	uint64_t	m_numBucketedTriangles;
+	std::atomic<size_t> m_numOccupied;
+};
@@ -0,0 +1,437 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "CPUVoxelizer.h"
+
+using namespace std;
+
+static_assert(sizeof(atomic<uint32_t>) == sizeof(uint32_t), "Voxels must be updated in place atomically");
+
+namespace
+{
+	const uint32_t g_trianglesPerTask = 256;
+
+	void sub(float r[3], const float a[3], const float b[3])
+	{
+		r[0] = a[0] - b[0];
+		r[1] = a[1] - b[1];
+		r[2] = a[2] - b[2];
+	}
+
+	void cross(float r[3], const float a[3], const float b[3])
+	{
+		r[0] = a[1] * b[2] - a[2] * b[1];
+		r[1] = a[2] * b[0] - a[0] * b[2];
+		r[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	float dot(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	// Inverse transpose of the upper-left 3x3 up to a positive scale, i.e. the cofactor
+	// matrix with the sign of the determinant, so normals stay perpendicular to the
+	// surface under non-uniform scales, and on the outside under reflections
+	void getNormalMatrix(float m[3][3], const float transform[3][4])
+	{
+		for (uint8_t i = 0; i < 3; ++i) cross(m[i], transform[(i + 1) % 3], transform[(i + 2) % 3]);
+		if (dot(transform[0], m[0]) < 0.0f)
+			for (uint8_t i = 0; i < 3; ++i)
+				for (uint8_t j = 0; j < 3; ++j) m[i][j] = -m[i][j];
+	}
+
+	// Separating axis test of the triangle (relative to the box center) against a unit box
+	bool separatedOnAxis(const float axis[3], const float v[3][3])
+	{
+		const auto p0 = dot(axis, v[0]);
+		const auto p1 = dot(axis, v[1]);
+		const auto p2 = dot(axis, v[2]);
+		const auto r = 0.5f * (fabs(axis[0]) + fabs(axis[1]) + fabs(axis[2]));
+
+		return (min)(p0, (min)(p1, p2)) > r || (max)(p0, (max)(p1, p2)) < -r;
+	}
+
+	//----------------------------------------------------------------------------------
+	// Triangle-box overlap by the separating axis theorem (Akenine-Moller), where the
+	// AABB axes are already excluded by the caller iterating over the triangle bound.
+	//----------------------------------------------------------------------------------
+	bool triangleBoxOverlap(const float center[3], const float tri[3][3], const float e[3][3], const float n[3])
+	{
+		float v[3][3];
+		for (uint8_t i = 0; i < 3; ++i) sub(v[i], tri[i], center);
+
+		// Plane of the triangle
+		const auto d = dot(n, v[0]);
+		const auto r = 0.5f * (fabs(n[0]) + fabs(n[1]) + fabs(n[2]));
+		if (fabs(d) > r) return false;
+
+		// Cross products of the box axes and the triangle edges
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			const float axes[3][3] =
+			{
+				{ 0.0f, -e[i][2], e[i][1] },
+				{ e[i][2], 0.0f, -e[i][0] },
+				{ -e[i][1], e[i][0], 0.0f }
+			};
+
+			for (const auto& axis : axes)
+				if (separatedOnAxis(axis, v)) return false;
+		}
+
+		return true;
+	}
+}
+
+CPUVoxelizer::CPUVoxelizer() :
+	m_objectID(0)
+{
+}
+
+CPUVoxelizer::~CPUVoxelizer()
+{
+}
+
+void CPUVoxelizer::Voxelize(VoxelGrid& grid, const uint8_t* pVertices, uint32_t stride,
+	const uint32_t* pIndices, uint32_t numIndices, const float bound[4], uint32_t numThreads)
+{
+	Voxelize(grid, pVertices, stride, pIndices, numIndices, bound, nullptr, numThreads);
+}
+
+void CPUVoxelizer::GetBound(float bound[4], const float lo[3], const float hi[3])
+{
+	for (uint8_t i = 0; i < 3; ++i) bound[i] = (hi[i] + lo[i]) / 2.0f;
+	bound[3] = (max)(hi[0] - lo[0], (max)(hi[1] - lo[1], hi[2] - lo[2])) / 2.0f;
+}
+
+void CPUVoxelizer::SetObjectID(uint32_t objectID)
+{
+	m_objectID = objectID;
+}
+
+void CPUVoxelizer::Voxelize(VoxelGrid& grid, const uint8_t* pVertices, uint32_t stride,
+	const uint32_t* pIndices, uint32_t numIndices, const float bound[4],
+	const float transform[3][4], uint32_t numThreads)
+{
+	PROFILE_SCOPE("CPUVoxelizer::Voxelize");
+
+	const auto size = grid.GetSize();
+	const VoxelRegion region = { { 0, 0, 0 }, { size, size, size } };
+	voxelize(grid, pVertices, stride, pIndices, numIndices, bound, transform, region, grid.GetNumLevels(), numThreads);
+}
+
+//--------------------------------------------------------------------------------------
+// Each gap of empty voxels in a Z column, between the surface voxels depthBeg and
+// depthEnd, is inside if the normal at depthBeg faces -Z or the one at depthEnd faces
+// +Z, as CSFillSolid with USE_NORMAL. The filled voxels have the zero normal of
+// pack(float4(0.0.xxx, 1.0)), and the lower ID of the 2 surface voxels, if any.
+// Rows of Y are processed in parallel, with X innermost.
+//--------------------------------------------------------------------------------------
+void CPUVoxelizer::FillSolid(VoxelGrid& grid, uint32_t numThreads, FillMethod method)
+{
+	PROFILE_SCOPE("CPUVoxelizer::FillSolid");
+
+	if (method == FILL_VOTE_XYZ)
+	{
+		fillSolidVote(grid, numThreads);
+
+		return;
+	}
+
+	const auto size = grid.GetSize();
+	const auto pData = grid.GetData();
+
+	ParallelFor(0, size, [&](uint32_t y)
+	{
+		vector<int> depthBegs(size, -1);
+		vector<float> normBegZs(size);
+		for (auto z = 0u; z < size; ++z)
+		{
+			const auto pRow = &pData[(static_cast<size_t>(z) * size + y) * size];
+			for (auto x = 0u; x < size; ++x)
+			{
+				if (!(pRow[x] & VoxelGrid::CoverageMask)) continue;
+
+				float n[3], coverage;
+				VoxelGrid::Unpack(pRow[x], n[0], n[1], n[2], coverage);
+
+				const auto depthBeg = depthBegs[x];
+				if (depthBeg >= 0 && static_cast<int>(z) > depthBeg + 1 && (normBegZs[x] < 0.0f || n[2] > 0.0f))
+				{
+					const auto id = (min)(grid.GetID(x, y, depthBeg), grid.GetID(x, y, z));
+					for (auto depth = static_cast<uint32_t>(depthBeg) + 1; depth < z; ++depth)
+					{
+						writeVoxel(grid, x, y, depth, VoxelGrid::CoverageMask, grid.GetNumLevels());
+						grid.WriteID(x, y, depth, id);
+					}
+				}
+
+				depthBegs[x] = z;
+				normBegZs[x] = n[2];
+			}
+		}
+	}, numThreads);
+}
+
+//--------------------------------------------------------------------------------------
+// Majority vote of the gap rule of FillSolid along X, Y, and Z, as CSFillSolidVote. The
+// gaps of each axis add their votes to a count per voxel from the surface alone, before
+// any voxel is filled. The grid Y is flipped against the local space, so a gap along Y
+// is inside if the normal at depthBeg faces +Y or the one at depthEnd faces -Y. A filled
+// voxel has the lowest ID of the surface voxels bounding the gaps that voted for it.
+// Each axis processes its columns in parallel by rows, with X innermost where possible.
+//--------------------------------------------------------------------------------------
+void CPUVoxelizer::fillSolidVote(VoxelGrid& grid, uint32_t numThreads)
+{
+	const auto size = grid.GetSize();
+	const auto pData = grid.GetData();
+	const auto writeID = grid.GetIDBits() != 0;
+	const auto getIndex = [size](const uint32_t coord[3])
+	{
+		return (static_cast<size_t>(coord[2]) * size + coord[1]) * size + coord[0];
+	};
+
+	vector<uint8_t> votes(grid.GetNumVoxels());
+	vector<uint32_t> ids(writeID ? grid.GetNumVoxels() : 0, VoxelGrid::EmptyID);
+	for (uint8_t axis = 0; axis < 3; ++axis)
+	{
+		const uint8_t laneAxis = axis == 0 ? 1 : 0;
+		const uint8_t rowAxis = axis == 2 ? 1 : 2;
+		const auto sign = axis == 1 ? -1.0f : 1.0f;
+
+		ParallelFor(0, size, [&](uint32_t row)
+		{
+			vector<int> depthBegs(size, -1);
+			vector<float> normBegs(size);
+			uint32_t coord[3];
+			coord[rowAxis] = row;
+			for (auto depth = 0u; depth < size; ++depth)
+			{
+				for (auto lane = 0u; lane < size; ++lane)
+				{
+					coord[axis] = depth;
+					coord[laneAxis] = lane;
+					const auto voxel = pData[getIndex(coord)];
+					if (!(voxel & VoxelGrid::CoverageMask)) continue;
+
+					float n[3], coverage;
+					VoxelGrid::Unpack(voxel, n[0], n[1], n[2], coverage);
+					const auto normEnd = sign * n[axis];
+
+					const auto depthBeg = depthBegs[lane];
+					if (depthBeg >= 0 && static_cast<int>(depth) > depthBeg + 1 && (normBegs[lane] < 0.0f || normEnd > 0.0f))
+					{
+						auto id = VoxelGrid::EmptyID;
+						if (writeID)
+						{
+							id = grid.GetID(coord[0], coord[1], coord[2]);
+							coord[axis] = depthBeg;
+							id = (min)(id, grid.GetID(coord[0], coord[1], coord[2]));
+						}
+
+						for (coord[axis] = depthBeg + 1; coord[axis] < depth; ++coord[axis])
+						{
+							const auto i = getIndex(coord);
+							++votes[i];
+							if (writeID) ids[i] = (min)(ids[i], id);
+						}
+					}
+
+					depthBegs[lane] = depth;
+					normBegs[lane] = normEnd;
+				}
+			}
+		}, numThreads);
+	}
+
+	ParallelFor(0, size, [&](uint32_t z)
+	{
+		for (auto y = 0u; y < size; ++y)
+		{
+			for (auto x = 0u; x < size; ++x)
+			{
+				const auto i = (static_cast<size_t>(z) * size + y) * size + x;
+				if (votes[i] < 2) continue;
+
+				writeVoxel(grid, x, y, z, VoxelGrid::CoverageMask, grid.GetNumLevels());
+				if (writeID) grid.WriteID(x, y, z, ids[i]);
+			}
+		}
+	}, numThreads);
+}
+
+void CPUVoxelizer::voxelize(VoxelGrid& grid, const uint8_t* pVertices, uint32_t stride,
+	const uint32_t* pIndices, uint32_t numIndices, const float bound[4],
+	const float transform[3][4], const VoxelRegion& region, uint8_t numLevels,
+	uint32_t numThreads)
+{
+	const auto gridSize = static_cast<float>(grid.GetSize());
+	const auto numTriangles = numIndices / 3;
+	const auto numTasks = (numTriangles + g_trianglesPerTask - 1) / g_trianglesPerTask;
+
+	ParallelFor(0, numTasks, [&](uint32_t task)
+	{
+		const auto end = (min)((task + 1) * g_trianglesPerTask, numTriangles);
+		for (auto t = task * g_trianglesPerTask; t < end; ++t)
+		{
+			float v[3][3], n[3];
+			loadTriangle(v, n, pVertices, stride, &pIndices[t * 3], bound, transform, gridSize);
+			voxelizeTriangle(grid, v, n, region, numLevels, m_objectID);
+		}
+	}, numThreads);
+}
+
+//--------------------------------------------------------------------------------------
+// Grid-space vertices and the normalized average normal of a triangle
+//--------------------------------------------------------------------------------------
+void CPUVoxelizer::loadTriangle(float v[3][3], float n[3], const uint8_t* pVertices, uint32_t stride,
+	const uint32_t* pIndices, const float bound[4], const float transform[3][4], float gridSize) const
+{
+	const auto scale = 0.5f * gridSize / bound[3];
+	float normalMatrix[3][3];
+	if (transform) getNormalMatrix(normalMatrix, transform);
+
+	n[0] = n[1] = n[2] = 0.0f;
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		float attribs[6];
+		memcpy(attribs, &pVertices[static_cast<size_t>(pIndices[i]) * stride], sizeof(attribs));
+		if (transform)
+		{
+			const float p[] = { attribs[0], attribs[1], attribs[2] };
+			const float nrm[] = { attribs[3], attribs[4], attribs[5] };
+			for (uint8_t j = 0; j < 3; ++j)
+			{
+				attribs[j] = dot(transform[j], p) + transform[j][3];
+				attribs[j + 3] = dot(normalMatrix[j], nrm);
+			}
+		}
+
+		// Same as TexLoc * gridSize in the shaders, with Y flipped
+		v[i][0] = (attribs[0] - bound[0]) * scale + 0.5f * gridSize;
+		v[i][1] = (bound[1] - attribs[1]) * scale + 0.5f * gridSize;
+		v[i][2] = (attribs[2] - bound[2]) * scale + 0.5f * gridSize;
+
+		n[0] += attribs[3];
+		n[1] += attribs[4];
+		n[2] += attribs[5];
+	}
+
+	const auto len = sqrt(dot(n, n));
+	if (len > 0.0f) for (uint8_t i = 0; i < 3; ++i) n[i] /= len;
+}
+
+void CPUVoxelizer::voxelizeTriangle(VoxelGrid& grid, const float v[3][3], const float n[3],
+	const VoxelRegion& region, uint8_t numLevels, uint32_t objectID, const int offset[3])
+{
+	float e[3][3], faceNrm[3];
+	sub(e[0], v[1], v[0]);
+	sub(e[1], v[2], v[1]);
+	sub(e[2], v[0], v[2]);
+	cross(faceNrm, e[0], e[1]);
+
+	int lo[3], hi[3];
+	if (!getVoxelRange(v, region, lo, hi)) return;
+
+	const auto voxel = VoxelGrid::Pack(n[0], n[1], n[2]);
+	const auto writeID = grid.GetIDBits() != 0;
+	const int o[] = { offset ? offset[0] : 0, offset ? offset[1] : 0, offset ? offset[2] : 0 };
+	for (auto z = lo[2]; z <= hi[2]; ++z)
+	{
+		for (auto y = lo[1]; y <= hi[1]; ++y)
+		{
+			for (auto x = lo[0]; x <= hi[0]; ++x)
+			{
+				const float center[] = { x + 0.5f, y + 0.5f, z + 0.5f };
+				if (!triangleBoxOverlap(center, v, e, faceNrm)) continue;
+
+				writeVoxel(grid, x + o[0], y + o[1], z + o[2], voxel, numLevels);
+				if (writeID) grid.WriteID(x + o[0], y + o[1], z + o[2], objectID);
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Voxel range [lo, hi] of the triangle AABB, clamped to the region, if not empty
+//--------------------------------------------------------------------------------------
+bool CPUVoxelizer::getVoxelRange(const float v[3][3], const VoxelRegion& region, int lo[3], int hi[3])
+{
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		const auto minV = (min)(v[0][i], (min)(v[1][i], v[2][i]));
+		const auto maxV = (max)(v[0][i], (max)(v[1][i], v[2][i]));
+		lo[i] = (max)(static_cast<int>(floor(minV)), static_cast<int>(region.Min[i]));
+		hi[i] = (min)(static_cast<int>(floor(maxV)), static_cast<int>(region.Max[i]) - 1);
+		if (lo[i] > hi[i]) return false;
+	}
+
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+// Atomic max of the packed voxel, as InterlockedMax in PSTriProj, on the finest level
+// and every coarser level. Since the coverage bits are the most significant, the
+// parent coverage is the bit-OR of its children, and the result is order independent.
+//--------------------------------------------------------------------------------------
+void CPUVoxelizer::writeVoxel(VoxelGrid& grid, uint32_t x, uint32_t y, uint32_t z, uint32_t voxel, uint8_t numLevels)
+{
+	for (uint8_t i = 0; i < numLevels; ++i)
+	{
+		const size_t size = grid.GetSize(i);
+		auto& dst = reinterpret_cast<atomic<uint32_t>&>(grid.GetData(i)[(grid.GetCoord(z, i) * size +
+			grid.GetCoord(y, i)) * size + grid.GetCoord(x, i)]);
+
+		auto prev = dst.load(memory_order_relaxed);
+		while (prev < voxel && !dst.compare_exchange_weak(prev, voxel, memory_order_relaxed));
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Max of the 2x2x2 children, level by level, which equals the atomic max of all the
+// writes under each voxel, so the pyramid is the same as with writeVoxel on every level.
+//--------------------------------------------------------------------------------------
+void CPUVoxelizer::propagateMips(VoxelGrid& grid, const VoxelRegion& region, uint32_t numThreads)
+{
+	for (uint8_t i = 1; i < grid.GetNumLevels(); ++i)
+	{
+		const auto levelRegion = grid.GetRegion(region, i);
+		const auto numRows = levelRegion.Max[1] - levelRegion.Min[1];
+
+		ParallelFor(levelRegion.Min[2] * numRows, levelRegion.Max[2] * numRows, [&](uint32_t row)
+		{
+			propagateRow(grid, i, levelRegion.Min[1] + row % numRows, row / numRows, levelRegion.Min[0], levelRegion.Max[0]);
+		}, numThreads);
+	}
+}
+
+void CPUVoxelizer::propagateRow(VoxelGrid& grid, uint8_t level, uint32_t y, uint32_t z, uint32_t xBeg, uint32_t xEnd)
+{
+	const size_t size = grid.GetSize(level);
+	const size_t srcSize = grid.GetSize(level - 1);
+	const auto pSrc = grid.GetData(level - 1);
+	const auto pDst = grid.GetData(level);
+
+	uint32_t lo[3], hi[3];
+	VoxelGrid::GetChildRange(y, static_cast<uint32_t>(size), static_cast<uint32_t>(srcSize), lo[1], hi[1]);
+	VoxelGrid::GetChildRange(z, static_cast<uint32_t>(size), static_cast<uint32_t>(srcSize), lo[2], hi[2]);
+	for (auto x = xBeg; x < xEnd; ++x)
+	{
+		VoxelGrid::GetChildRange(x, static_cast<uint32_t>(size), static_cast<uint32_t>(srcSize), lo[0], hi[0]);
+
+		auto voxel = 0u;
+		for (size_t sz = lo[2]; sz < hi[2]; ++sz)
+			for (size_t sy = lo[1]; sy < hi[1]; ++sy)
+				for (size_t sx = lo[0]; sx < hi[0]; ++sx)
+					voxel = (max)(voxel, pSrc[(sz * srcSize + sy) * srcSize + sx]);
+		pDst[(z * size + y) * size + x] = voxel;
+	}
+}
@@ -0,0 +1,75 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "VoxelGrid.h"
+
+//--------------------------------------------------------------------------------------
+// CPU surface voxelizer using the same grid mapping as the GPU path: positions are
+// normalized by the bound (center, radius) and the grid Y is flipped.
+// Each triangle is tested against the voxels of the finest level by exact triangle-box
+// overlap, and every hit is propagated to the parents of all the coarser levels in the
+// same traversal, so a full pyramid is produced by a single pass over the triangles.
+//--------------------------------------------------------------------------------------
+class CPUVoxelizer
+{
+public:
+	// Same as Voxelizer::FillMethod
+	enum FillMethod : uint8_t
+	{
+		FILL_PARITY_Z,
+		FILL_VOTE_XYZ,
+
+		NUM_FILL_METHOD
+	};
+
+	CPUVoxelizer();
+	virtual ~CPUVoxelizer();
+
+	// Vertices are float3 position followed by float3 normal, with the given stride in bytes
+	void Voxelize(VoxelGrid& grid, const uint8_t* pVertices, uint32_t stride,
+		const uint32_t* pIndices, uint32_t numIndices, const float bound[4],
+		uint32_t numThreads = 0);
+
+	// Same, with the positions transformed by the row-major 3x4 matrix before the mapping
+	// of the bound, and the normals by the inverse transpose of its upper-left 3x3, so any
+	// affine transform with non-uniform scales or reflections is supported
+	void Voxelize(VoxelGrid& grid, const uint8_t* pVertices, uint32_t stride,
+		const uint32_t* pIndices, uint32_t numIndices, const float bound[4],
+		const float transform[3][4], uint32_t numThreads = 0);
+
+	// Bound (center, radius) of the cube enclosing the box [lo, hi], by which a mesh is
+	// mapped to the grid from its AABB, as in Voxelizer::Init
+	static void GetBound(float bound[4], const float lo[3], const float hi[3]);
+
+	// ID written into the ID channel of the grid, if any, by the voxelizations (0 by default)
+	void SetObjectID(uint32_t objectID);
+
+	// Fill the empty voxels of level 0 inside the surface with the normal rule of
+	// CSFillSolid along Z, or by the majority vote of the rule along X, Y, and Z as
+	// CSFillSolidVote, and propagate them to the coarser levels
+	void FillSolid(VoxelGrid& grid, uint32_t numThreads = 0, FillMethod method = FILL_PARITY_Z);
+
+protected:
+	// Voxelize into the region of level 0 only, and into the levels below numLevels
+	void voxelize(VoxelGrid& grid, const uint8_t* pVertices, uint32_t stride,
+		const uint32_t* pIndices, uint32_t numIndices, const float bound[4],
+		const float transform[3][4], const VoxelRegion& region, uint8_t numLevels,
+		uint32_t numThreads);
+	void loadTriangle(float v[3][3], float n[3], const uint8_t* pVertices, uint32_t stride,
+		const uint32_t* pIndices, const float bound[4], const float transform[3][4], float gridSize) const;
+	// The voxels of the region are written at the offset from their coordinates, if any
+	void voxelizeTriangle(VoxelGrid& grid, const float v[3][3], const float n[3],
+		const VoxelRegion& region, uint8_t numLevels, uint32_t objectID, const int offset[3] = nullptr);
+	static bool getVoxelRange(const float v[3][3], const VoxelRegion& region, int lo[3], int hi[3]);
+	void writeVoxel(VoxelGrid& grid, uint32_t x, uint32_t y, uint32_t z, uint32_t voxel, uint8_t numLevels);
+	void fillSolidVote(VoxelGrid& grid, uint32_t numThreads);
+
+	// Rebuild the coarser levels over the region from level 0, as writeVoxel would have
+	void propagateMips(VoxelGrid& grid, const VoxelRegion& region, uint32_t numThreads);
+	void propagateRow(VoxelGrid& grid, uint8_t level, uint32_t y, uint32_t z, uint32_t xBeg, uint32_t xEnd);
+
+	uint32_t m_objectID;
+};
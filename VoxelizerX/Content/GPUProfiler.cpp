@@ -0,0 +1,147 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "GPUProfiler.h"
+
+using namespace std;
+using namespace XUSG;
+
+GPUProfiler::GPUProfiler() :
+	m_pCommandQueue(nullptr),
+	m_pProfiler(nullptr),
+	m_maxScopes(0),
+	m_track(0),
+	m_frameIndex(0),
+	m_recording(false),
+	m_msPerTick(0.0),
+	m_gpuCalibration(0),
+	m_cpuCalibration(0.0)
+{
+}
+
+GPUProfiler::~GPUProfiler()
+{
+}
+
+bool GPUProfiler::Init(const Device* pDevice, const CommandQueue* pCommandQueue,
+	uint8_t frameCount, uint32_t maxScopesPerFrame, Profiler* pProfiler)
+{
+	m_pCommandQueue = pCommandQueue;
+	m_pProfiler = pProfiler ? pProfiler : &Profiler::GetDefault();
+	m_maxScopes = maxScopesPerFrame;
+	m_frames.resize(frameCount);
+	for (auto& frame : m_frames) frame.Resolved = false;
+
+	// A begin and an end timestamp per scope
+	const auto numQueries = 2 * m_maxScopes * frameCount;
+	D3D12_QUERY_HEAP_DESC desc = {};
+	desc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	desc.Count = numQueries;
+	const auto pD3DDevice = static_cast<ID3D12Device*>(pDevice->GetHandle());
+	XUSG_N_RETURN(SUCCEEDED(pD3DDevice->CreateQueryHeap(&desc, IID_PPV_ARGS(&m_queryHeap))), false);
+
+	m_readBuffer = Buffer::MakeUnique();
+	XUSG_N_RETURN(m_readBuffer->Create(pDevice, sizeof(uint64_t) * numQueries, ResourceFlag::NONE,
+		MemoryType::READBACK, 0, nullptr, 0, nullptr, MemoryFlag::NONE, L"TimestampReadBack"), false);
+
+	uint64_t frequency;
+	const auto pD3DCommandQueue = static_cast<ID3D12CommandQueue*>(pCommandQueue->GetHandle());
+	XUSG_N_RETURN(SUCCEEDED(pD3DCommandQueue->GetTimestampFrequency(&frequency)), false);
+	m_msPerTick = 1000.0 / static_cast<double>(frequency);
+	m_track = m_pProfiler->AddTrack("GPU");
+	calibrate();
+
+	return true;
+}
+
+void GPUProfiler::BeginFrame(uint8_t frameIndex)
+{
+	auto& frame = m_frames[frameIndex];
+	if (frame.Resolved && !frame.ScopeNames.empty())
+	{
+		const auto base = 2 * m_maxScopes * frameIndex;
+		const auto pTimestamps = static_cast<const uint64_t*>(m_readBuffer->Map(nullptr)) + base;
+		for (size_t i = 0; i < frame.ScopeNames.size(); ++i)
+		{
+			const auto begin = pTimestamps[2 * i];
+			const auto end = pTimestamps[2 * i + 1];
+			if (end < begin || begin < m_gpuCalibration) continue;	// Not ended, or before the calibration
+
+			const auto start = m_cpuCalibration + static_cast<double>(begin - m_gpuCalibration) * m_msPerTick;
+			m_pProfiler->AddSample(frame.ScopeNames[i], start, static_cast<double>(end - begin) * m_msPerTick, m_track);
+		}
+		m_readBuffer->Unmap();
+	}
+
+	frame.ScopeNames.clear();
+	frame.Resolved = false;
+	m_frameIndex = frameIndex;
+
+	// Recalibrate when the recording starts
+	const auto recording = m_pProfiler->IsEnabled();
+	if (recording && !m_recording) calibrate();
+	m_recording = recording;
+}
+
+void GPUProfiler::EndFrame(const CommandList* pCommandList)
+{
+	auto& frame = m_frames[m_frameIndex];
+	if (frame.ScopeNames.empty()) return;
+
+	const auto base = 2 * m_maxScopes * m_frameIndex;
+	const auto numQueries = static_cast<uint32_t>(2 * frame.ScopeNames.size());
+	pCommandList->ResolveQueryData(m_queryHeap.get(), QueryType::TIMESTAMP, base, numQueries,
+		m_readBuffer.get(), sizeof(uint64_t) * base);
+	frame.Resolved = true;
+}
+
+uint32_t GPUProfiler::BeginScope(const CommandList* pCommandList, const char* name)
+{
+	auto& frame = m_frames[m_frameIndex];
+	if (!m_recording || frame.ScopeNames.size() >= m_maxScopes) return InvalidScope;
+
+	const auto scope = static_cast<uint32_t>(frame.ScopeNames.size());
+	frame.ScopeNames.emplace_back(name);
+	pCommandList->EndQuery(m_queryHeap.get(), QueryType::TIMESTAMP, 2 * (m_maxScopes * m_frameIndex + scope));
+
+	return scope;
+}
+
+void GPUProfiler::EndScope(const CommandList* pCommandList, uint32_t scope)
+{
+	if (scope == InvalidScope) return;
+
+	pCommandList->EndQuery(m_queryHeap.get(), QueryType::TIMESTAMP, 2 * (m_maxScopes * m_frameIndex + scope) + 1);
+}
+
+Profiler* GPUProfiler::GetProfiler() const
+{
+	return m_pProfiler;
+}
+
+void GPUProfiler::calibrate()
+{
+	// The CPU timestamp of the calibration is of the performance counter, so sample the
+	// profiler clock right after it, which is close enough at the scale of the passes
+	uint64_t cpuTimestamp;
+	const auto pD3DCommandQueue = static_cast<ID3D12CommandQueue*>(m_pCommandQueue->GetHandle());
+	if (SUCCEEDED(pD3DCommandQueue->GetClockCalibration(&m_gpuCalibration, &cpuTimestamp)))
+		m_cpuCalibration = m_pProfiler->GetTime();
+}
+
+//--------------------------------------------------------------------------------------
+// Scope
+//--------------------------------------------------------------------------------------
+
+GPUProfileScope::GPUProfileScope(GPUProfiler* pProfiler, const CommandList* pCommandList, const char* name) :
+	m_pProfiler(pProfiler),
+	m_pCommandList(pCommandList),
+	m_scope(pProfiler ? pProfiler->BeginScope(pCommandList, name) : GPUProfiler::InvalidScope)
+{
+}
+
+GPUProfileScope::~GPUProfileScope()
+{
+	if (m_pProfiler) m_pProfiler->EndScope(m_pCommandList, m_scope);
+}
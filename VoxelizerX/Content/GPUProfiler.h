@@ -0,0 +1,76 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Core/XUSG.h"
+#include "Profiler.h"
+
+//--------------------------------------------------------------------------------------
+// GPU timing of named scopes by timestamp queries on the command list. Each frame in
+// flight owns a range of the query heap and of the readback buffer: the timestamps are
+// resolved at the end of the frame, and read back when the same frame index is begun
+// again, by which time the fence of the frame has been waited for. They are converted
+// to the time base of the profiler by a clock calibration of the queue, and added as
+// samples on a "GPU" track. Scope names must outlive the frame, e.g. string literals.
+//--------------------------------------------------------------------------------------
+class GPUProfiler
+{
+public:
+	GPUProfiler();
+	virtual ~GPUProfiler();
+
+	bool Init(const XUSG::Device* pDevice, const XUSG::CommandQueue* pCommandQueue,
+		uint8_t frameCount, uint32_t maxScopesPerFrame = 64, Profiler* pProfiler = nullptr);
+
+	// Collect the results of the last use of the frame index, and start the frame
+	void BeginFrame(uint8_t frameIndex);
+	void EndFrame(const XUSG::CommandList* pCommandList);
+
+	uint32_t BeginScope(const XUSG::CommandList* pCommandList, const char* name);
+	void EndScope(const XUSG::CommandList* pCommandList, uint32_t scope);
+
+	Profiler* GetProfiler() const;
+
+	static const uint32_t InvalidScope = UINT32_MAX;
+
+protected:
+	struct Frame
+	{
+		std::vector<const char*> ScopeNames;
+		bool Resolved;
+	};
+
+	void calibrate();
+
+	XUSG::com_ptr<ID3D12QueryHeap> m_queryHeap;
+	XUSG::Buffer::uptr m_readBuffer;
+	const XUSG::CommandQueue* m_pCommandQueue;
+	Profiler*		m_pProfiler;
+
+	std::vector<Frame> m_frames;
+	uint32_t		m_maxScopes;
+	uint32_t		m_track;
+	uint8_t			m_frameIndex;
+	bool			m_recording;
+
+	double			m_msPerTick;
+	uint64_t		m_gpuCalibration;
+	double			m_cpuCalibration;	// In milliseconds of the profiler
+};
+
+//--------------------------------------------------------------------------------------
+// Times the enclosing block of commands, if there is a profiler
+//--------------------------------------------------------------------------------------
+class GPUProfileScope
+{
+public:
+	GPUProfileScope(GPUProfiler* pProfiler, const XUSG::CommandList* pCommandList, const char* name);
+	~GPUProfileScope();
+
+protected:
+	GPUProfiler* m_pProfiler;
+	const XUSG::CommandList* m_pCommandList;
+	uint32_t m_scope;
+};
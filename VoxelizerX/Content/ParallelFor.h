@@ -0,0 +1,49 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+//--------------------------------------------------------------------------------------
+// Number of worker threads, where 0 means all the hardware threads
+//--------------------------------------------------------------------------------------
+inline uint32_t GetNumWorkerThreads(uint32_t numThreads = 0)
+{
+	return numThreads ? numThreads : (std::max)(std::thread::hardware_concurrency(), 1u);
+}
+
+//--------------------------------------------------------------------------------------
+// Run func(i) for i in [begin, end) on worker threads with dynamic scheduling
+//--------------------------------------------------------------------------------------
+template<typename Func>
+void ParallelFor(uint32_t begin, uint32_t end, const Func& func, uint32_t numThreads = 0)
+{
+	if (begin >= end) return;
+
+	numThreads = (std::min)(GetNumWorkerThreads(numThreads), end - begin);
+	if (numThreads <= 1)
+	{
+		for (auto i = begin; i < end; ++i) func(i);
+
+		return;
+	}
+
+	std::atomic<uint32_t> next(begin);
+	const auto worker = [&]()
+	{
+		for (auto i = next++; i < end; i = next++) func(i);
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(numThreads - 1);
+	for (auto i = 1u; i < numThreads; ++i) threads.emplace_back(worker);
+	worker();
+
+	for (auto& thread : threads) thread.join();
+}
@@ -0,0 +1,25 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+//--------------------------------------------------------------------------------------
+// The standard headers and the secure CRT functions that the ObjLoader and stb_image_write
+// get from the precompiled header of the app, for building them outside of the app.
+//--------------------------------------------------------------------------------------
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#define fopen_s(ppFile, fileName, mode)	((*(ppFile) = fopen(fileName, mode)) ? 0 : errno)
+#define fscanf_s						fscanf
+#define sscanf_s						sscanf
+#define sprintf_s						snprintf
+#endif
@@ -0,0 +1,196 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cfloat>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+#include "Profiler.h"
+
+using namespace std;
+
+namespace
+{
+	string escapeJSON(const string& str)
+	{
+		string escaped;
+		for (const auto& c : str)
+		{
+			if (c == '"' || c == '\\') escaped += '\\';
+			escaped += c;
+		}
+
+		return escaped;
+	}
+}
+
+Profiler::Profiler(uint32_t windowSize, size_t maxEvents) :
+	m_epoch(chrono::steady_clock::now()),
+	m_enabled(false),
+	m_windowSize((max)(windowSize, 1u)),
+	m_maxEvents(maxEvents),
+	m_numDroppedEvents(0)
+{
+}
+
+Profiler::~Profiler()
+{
+}
+
+void Profiler::SetEnabled(bool enabled)
+{
+	m_enabled = enabled;
+}
+
+void Profiler::Reset()
+{
+	lock_guard<mutex> lock(m_mutex);
+	for (auto& scope : m_scopes)
+	{
+		scope.Window.clear();
+		scope.Next = 0;
+	}
+	m_events.clear();
+	m_numDroppedEvents = 0;
+}
+
+void Profiler::AddSample(const char* name, double start, double duration, uint32_t track)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	const auto result = m_scopeIndices.emplace(name, static_cast<uint32_t>(m_scopes.size()));
+	if (result.second)
+	{
+		m_scopeNames.emplace_back(name);
+		m_scopes.emplace_back();
+		m_scopes.back().Next = 0;
+	}
+
+	// Overwrite the oldest sample once the window is full
+	const auto scopeIdx = result.first->second;
+	auto& scope = m_scopes[scopeIdx];
+	if (scope.Window.size() < m_windowSize) scope.Window.emplace_back(duration);
+	else scope.Window[scope.Next] = duration;
+	scope.Next = (scope.Next + 1) % m_windowSize;
+
+	if (m_events.size() < m_maxEvents) m_events.push_back({ scopeIdx, track, start, duration });
+	else ++m_numDroppedEvents;
+}
+
+uint32_t Profiler::GetThreadTrack()
+{
+	const auto id = hash<thread::id>()(this_thread::get_id());
+
+	lock_guard<mutex> lock(m_mutex);
+	const auto result = m_threadTracks.emplace(id, static_cast<uint32_t>(m_trackNames.size()));
+	if (result.second) m_trackNames.emplace_back("CPU thread " + to_string(m_threadTracks.size() - 1));
+
+	return result.first->second;
+}
+
+uint32_t Profiler::AddTrack(const char* name)
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_trackNames.emplace_back(name);
+
+	return static_cast<uint32_t>(m_trackNames.size() - 1);
+}
+
+bool Profiler::GetStats(const char* name, ProfileStats& stats) const
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	const auto it = m_scopeIndices.find(name);
+	if (it == m_scopeIndices.cend()) return false;
+
+	const auto& scope = m_scopes[it->second];
+	if (scope.Window.empty()) return false;
+
+	auto samples = scope.Window;
+	const auto n = samples.size();
+	stats.NumSamples = static_cast<uint32_t>(n);
+	stats.Last = scope.Window[(scope.Next + m_windowSize - 1) % m_windowSize];
+	stats.Min = DBL_MAX;
+	stats.Avg = 0.0;
+	for (const auto& sample : samples)
+	{
+		stats.Min = (min)(stats.Min, sample);
+		stats.Avg += sample;
+	}
+	stats.Avg /= n;
+
+	// Nearest rank
+	const auto rank = (n * 99 + 99) / 100 - 1;
+	nth_element(samples.begin(), samples.begin() + rank, samples.end());
+	stats.P99 = samples[rank];
+
+	return true;
+}
+
+vector<string> Profiler::GetScopeNames() const
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	return m_scopeNames;
+}
+
+bool Profiler::WriteChromeTrace(const char* fileName) const
+{
+	ofstream file(fileName);
+	if (!file) return false;
+
+	lock_guard<mutex> lock(m_mutex);
+
+	// Timestamps and durations are in microseconds
+	file << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":" << m_numDroppedEvents << "},\n\"traceEvents\":[";
+	for (size_t i = 0; i < m_trackNames.size(); ++i)
+		file << (i ? ",\n" : "\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << i
+			<< ",\"args\":{\"name\":\"" << escapeJSON(m_trackNames[i]) << "\"}}";
+
+	file << fixed << setprecision(3);
+	for (size_t i = 0; i < m_events.size(); ++i)
+	{
+		const auto& event = m_events[i];
+		file << (i || !m_trackNames.empty() ? ",\n" : "\n") << "{\"name\":\"" << escapeJSON(m_scopeNames[event.Name])
+			<< "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.Track << ",\"ts\":" << event.Start * 1000.0
+			<< ",\"dur\":" << event.Duration * 1000.0 << "}";
+	}
+	file << "\n]}\n";
+
+	return static_cast<bool>(file);
+}
+
+bool Profiler::IsEnabled() const
+{
+	return m_enabled.load(memory_order_relaxed);
+}
+
+double Profiler::GetTime() const
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - m_epoch).count();
+}
+
+Profiler& Profiler::GetDefault()
+{
+	static Profiler profiler;
+
+	return profiler;
+}
+
+//--------------------------------------------------------------------------------------
+// Scope
+//--------------------------------------------------------------------------------------
+
+ProfileScope::ProfileScope(const char* name, Profiler& profiler) :
+	m_pProfiler(profiler.IsEnabled() ? &profiler : nullptr),
+	m_name(name),
+	m_start(m_pProfiler ? profiler.GetTime() : 0.0)
+{
+}
+
+ProfileScope::~ProfileScope()
+{
+	if (m_pProfiler) m_pProfiler->AddSample(m_name, m_start, m_pProfiler->GetTime() - m_start, m_pProfiler->GetThreadTrack());
+}
@@ -0,0 +1,107 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//--------------------------------------------------------------------------------------
+// Rolling statistics of a named scope over its most recent samples, in milliseconds
+//--------------------------------------------------------------------------------------
+struct ProfileStats
+{
+	double Min;
+	double Avg;
+	double P99;
+	double Last;
+	uint32_t NumSamples;	// In the window
+};
+
+//--------------------------------------------------------------------------------------
+// Profiler of named scopes: each sample is kept in a fixed window of the scope for the
+// rolling statistics, and as an event on its track for the Chrome trace (chrome://tracing
+// or Perfetto), up to a maximum number of events. Tracks are the CPU threads, numbered
+// in the order of their first samples, and the GPU queues. Times are in milliseconds
+// since the creation of the profiler. Samples are added under a lock, so scopes should be
+// at the granularity of passes rather than inner loops.
+//--------------------------------------------------------------------------------------
+class Profiler
+{
+public:
+	Profiler(uint32_t windowSize = 256, size_t maxEvents = 1 << 20);
+	virtual ~Profiler();
+
+	void SetEnabled(bool enabled);
+	void Reset();
+
+	void AddSample(const char* name, double start, double duration, uint32_t track);
+	uint32_t GetThreadTrack();
+	uint32_t AddTrack(const char* name);
+
+	bool GetStats(const char* name, ProfileStats& stats) const;
+	std::vector<std::string> GetScopeNames() const;
+
+	// JSON object format of the Trace Event Format with complete ("X") events
+	bool WriteChromeTrace(const char* fileName) const;
+
+	bool IsEnabled() const;
+	double GetTime() const;
+
+	// Process-wide profiler of the CPU engine and the app, disabled by default
+	static Profiler& GetDefault();
+
+protected:
+	struct Scope
+	{
+		std::vector<double> Window;
+		uint32_t Next;
+	};
+
+	struct Event
+	{
+		uint32_t Name;	// Index into m_scopeNames
+		uint32_t Track;
+		double Start;
+		double Duration;
+	};
+
+	std::unordered_map<std::string, uint32_t> m_scopeIndices;
+	std::vector<std::string> m_scopeNames;
+	std::vector<Scope> m_scopes;
+	std::vector<Event> m_events;
+	std::vector<std::string> m_trackNames;
+	std::unordered_map<size_t, uint32_t> m_threadTracks;
+	mutable std::mutex m_mutex;
+
+	std::chrono::steady_clock::time_point m_epoch;
+	std::atomic<bool> m_enabled;
+	uint32_t m_windowSize;
+	size_t m_maxEvents;
+	size_t m_numDroppedEvents;
+};
+
+//--------------------------------------------------------------------------------------
+// Times the enclosing block on the CPU into the given profiler when it is enabled
+//--------------------------------------------------------------------------------------
+class ProfileScope
+{
+public:
+	ProfileScope(const char* name, Profiler& profiler = Profiler::GetDefault());
+	~ProfileScope();
+
+protected:
+	Profiler* m_pProfiler;
+	const char* m_name;
+	double m_start;
+};
+
+#define PROFILE_CONCAT_(a, b)	a##b
+#define PROFILE_CONCAT(a, b)	PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name)		ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
@@ -0,0 +1,69 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "SharedConst.h"
+
+//--------------------------------------------------------------------------------------
+// Constant buffer
+//--------------------------------------------------------------------------------------
+cbuffer cbPerMipLevel
+{
+	float g_gridSize;
+	float g_mipLevel;
+};
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+Texture3D					g_txGrid;
+
+//--------------------------------------------------------------------------------------
+// Unordered access buffers
+//--------------------------------------------------------------------------------------
+RWStructuredBuffer<uint>	g_rwFaces;
+RWByteAddressBuffer			g_rwDrawArgs;
+
+// Neighbor of each box plane of VSBoxArray, in voxels with Y down
+static const int3 g_neighbors[6] =
+{
+	int3(0, 0, 1),	// back plane
+	int3(-1, 0, 0),	// left plane
+	int3(0, 0, -1),	// front plane
+	int3(1, 0, 0),	// right plane
+	int3(0, -1, 0),	// top plane
+	int3(0, 1, 0)	// bottom plane
+};
+
+//--------------------------------------------------------------------------------------
+// Appends the exposed faces of each occupied voxel, whose neighbors on the face are
+// empty or outside the grid, to the face list, and counts them as the instances of
+// the indirect draw. Faces are packed as x | y << 9 | z << 18 | plane << 27.
+//--------------------------------------------------------------------------------------
+[numthreads(4, 4, 4)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	const uint gridSize = g_gridSize;
+	const uint mipLevel = g_mipLevel;
+	if (any(DTid >= gridSize)) return;
+	if (g_txGrid.mips[mipLevel][DTid].w <= 0.0) return;
+
+	uint faceMask = 0;
+	[unroll]
+	for (uint i = 0; i < 6; ++i)
+	{
+		const int3 loc = int3(DTid) + g_neighbors[i];
+		if (any(loc < 0 || loc >= int(gridSize))) faceMask |= 1 << i;
+		else if (g_txGrid.mips[mipLevel][loc].w <= 0.0) faceMask |= 1 << i;
+	}
+
+	if (faceMask == 0) return;
+
+	// Allocate the faces by the instance count of the draw arguments
+	uint base;
+	g_rwDrawArgs.InterlockedAdd(4, countbits(faceMask), base);
+
+	const uint voxel = DTid.x | (DTid.y << 9) | (DTid.z << 18);
+	for (uint j = 0; j < 6; ++j)
+		if (faceMask & (1 << j)) g_rwFaces[base++] = voxel | (j << 27);
+}
@@ -0,0 +1,52 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "SharedConst.h"
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+#if	AXIS == 0
+Texture3D			g_txGrid;
+#else
+Texture3D<uint>		g_txSource;
+#endif
+
+//--------------------------------------------------------------------------------------
+// Unordered access textures
+//--------------------------------------------------------------------------------------
+RWTexture3D<uint>	g_rwEmptyDist;
+
+//--------------------------------------------------------------------------------------
+// One axis of the separable Chebyshev distance transform to the nearest occupied
+// voxel, capped at MAX_EMPTY_DIST. The X pass reads the occupancy from the grid, and
+// the Y and Z passes take the max with the distance of the previous passes.
+//--------------------------------------------------------------------------------------
+[numthreads(4, 4, 4)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	uint3 dim;
+	g_rwEmptyDist.GetDimensions(dim.x, dim.y, dim.z);
+	if (any(DTid >= dim)) return;
+
+	const int i = DTid[AXIS];
+	const int first = max(i - MAX_EMPTY_DIST + 1, 0);
+	const int last = min(i + MAX_EMPTY_DIST - 1, int(dim[AXIS]) - 1);
+
+	uint dist = MAX_EMPTY_DIST;
+	uint3 loc = DTid;
+	for (int j = first; j <= last; ++j)
+	{
+		loc[AXIS] = j;
+		const uint offset = abs(j - i);
+#if	AXIS == 0
+		const uint d = g_txGrid[loc].w > 0.0 ? offset : MAX_EMPTY_DIST;
+#else
+		const uint d = max(g_txSource[loc], offset);
+#endif
+		dist = min(dist, d);
+	}
+
+	g_rwEmptyDist[DTid] = dist;
+}
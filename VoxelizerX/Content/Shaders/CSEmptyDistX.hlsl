@@ -0,0 +1,6 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#define AXIS	0
+#include "CSEmptyDist.hlsli"
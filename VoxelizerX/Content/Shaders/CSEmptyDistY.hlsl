@@ -0,0 +1,6 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#define AXIS	1
+#include "CSEmptyDist.hlsli"
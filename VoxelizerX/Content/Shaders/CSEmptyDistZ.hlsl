@@ -0,0 +1,6 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#define AXIS	2
+#include "CSEmptyDist.hlsli"
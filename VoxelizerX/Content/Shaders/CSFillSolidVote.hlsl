@@ -0,0 +1,173 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "SharedConst.h"
+#include "Common\D3DX_DXGIFormatConvert.inl"
+#define	pack(x)		D3DX_FLOAT4_to_R10G10B10A2_UNORM(x)
+#define	unpack(x)	D3DX_R10G10B10A2_UNORM_to_FLOAT4(x)
+
+#define	AXIS_X		0
+#define	AXIS_Y		1
+#define	AXIS_Z		2
+#define	EMPTY_DEPTH	0xffffffff
+
+//--------------------------------------------------------------------------------------
+// Constant buffer
+//--------------------------------------------------------------------------------------
+cbuffer cbPerMipLevel
+{
+	float g_gridSize;
+};
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+Texture2DArray<uint>	g_txKBufDepth;
+RWTexture3D<uint>		g_rwGrid;
+
+//--------------------------------------------------------------------------------------
+// Map a K-buffer column location and a depth on the axis back to the grid
+//--------------------------------------------------------------------------------------
+uint3 ColumnToGrid(uint2 col, uint depth, uint axis)
+{
+	return axis == AXIS_X ? uint3(depth, col) :
+		(axis == AXIS_Y ? uint3(col.y, depth, col.x) : uint3(col, depth));
+}
+
+//--------------------------------------------------------------------------------------
+// Determine whether the interval between 2 surface voxels is inside along the axis
+//--------------------------------------------------------------------------------------
+bool IsIntervalInside(uint2 col, uint depthBeg, uint depthEnd, uint axis)
+{
+	const float normBeg = unpack(g_rwGrid[ColumnToGrid(col, depthBeg, axis)])[axis];
+	const float normEnd = unpack(g_rwGrid[ColumnToGrid(col, depthEnd, axis)])[axis];
+
+	// The grid Y is flipped against the local space
+	return axis == AXIS_Y ? normBeg > 0.5 || normEnd < 0.5 : normBeg < 0.5 || normEnd > 0.5;
+}
+
+//--------------------------------------------------------------------------------------
+// Ray parity of a single voxel along the axis (same rule as CSFillSolid)
+//--------------------------------------------------------------------------------------
+bool IsInside(uint2 col, uint depth, uint axis, uint numLayer)
+{
+	const uint baseLayer = axis == AXIS_Z ? 0 : (axis + 1) * numLayer;
+
+	bool needFill = false;
+	uint depthBeg = EMPTY_DEPTH, depthEnd = EMPTY_DEPTH;
+
+	for (uint i = 0; i < numLayer; ++i)
+	{
+		depthEnd = g_txKBufDepth[uint3(col, baseLayer + i)];
+#if	USE_NORMAL
+		if (depthEnd > depth) break;
+#else
+		if (depthEnd == EMPTY_DEPTH) return false;
+		if (depthEnd > depth) break;
+		needFill = depthBeg == depthEnd - 1 ? needFill : !needFill;
+#endif
+		depthBeg = depthEnd;
+	}
+
+#if	USE_NORMAL
+	if (depthBeg != EMPTY_DEPTH && depthEnd != EMPTY_DEPTH)
+		needFill = IsIntervalInside(col, depthBeg, depthEnd, axis);
+#endif
+
+	return needFill;
+}
+
+//--------------------------------------------------------------------------------------
+// Bit mask of [beg, end) within the 32-voxel word starting at x0
+//--------------------------------------------------------------------------------------
+uint RangeMask(uint beg, uint end, uint x0)
+{
+	beg = clamp(int(beg) - int(x0), 0, 32);
+	end = clamp(int(end) - int(x0), 0, 32);
+
+	const uint lo = beg < 32 ? (1u << beg) - 1 : 0xffffffff;
+	const uint hi = end < 32 ? (1u << end) - 1 : 0xffffffff;
+
+	return hi & ~lo;
+}
+
+//--------------------------------------------------------------------------------------
+// Inside mask of a 32-voxel word along X from a single scan of its K-buffer column
+//--------------------------------------------------------------------------------------
+uint InsideMaskX(uint2 col, uint x0, uint numLayer)
+{
+	uint mask = 0;
+	uint depthBeg = EMPTY_DEPTH;
+#if	!USE_NORMAL
+	bool needFill = false;
+#endif
+
+	for (uint i = 0; i < numLayer; ++i)
+	{
+		const uint depthEnd = g_txKBufDepth[uint3(col, numLayer + i)];
+		if (depthEnd == EMPTY_DEPTH) break;
+		if (depthBeg != EMPTY_DEPTH && depthBeg >= x0 + 32) break;
+
+#if	USE_NORMAL
+		if (depthBeg != EMPTY_DEPTH && IsIntervalInside(col, depthBeg, depthEnd, AXIS_X))
+			mask |= RangeMask(depthBeg + 1, depthEnd, x0);
+#else
+		if (needFill) mask |= RangeMask(depthBeg + 1, depthEnd, x0);
+		needFill = depthBeg == depthEnd - 1 ? needFill : !needFill;
+#endif
+		depthBeg = depthEnd;
+	}
+
+	return mask;
+}
+
+//--------------------------------------------------------------------------------------
+// Fill solid voxels by majority voting of the ray parities along X, Y, and Z.
+// Each thread handles 32 consecutive voxels along X as a packed bit mask. The grid is
+// the packed one, so USE_MUTEX builds always fill with CSFillSolid instead.
+//--------------------------------------------------------------------------------------
+[numthreads(4, 4, 4)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	const uint gridSize = g_gridSize;
+	const uint x0 = DTid.x * 32;
+	if (x0 >= gridSize) return;
+
+	const uint numLayer = gridSize * DEPTH_SCALE;
+	const uint numBits = min(gridSize - x0, 32);
+
+	// Collect empty voxels of the word
+	uint emptyMask = 0;
+	for (uint i = 0; i < numBits; ++i)
+		emptyMask |= unpack(g_rwGrid[uint3(x0 + i, DTid.yz)]).w <= 0.0 ? 1u << i : 0;
+	if (emptyMask == 0) return;
+
+	// X-axis parity of all the 32 voxels comes from one column
+	const uint maskX = InsideMaskX(DTid.yz, x0, numLayer) & emptyMask;
+
+	// Y-axis parity
+	uint maskY = 0;
+	for (uint j = 0; j < numBits; ++j)
+		if (emptyMask & (1u << j))
+			maskY |= IsInside(uint2(DTid.z, x0 + j), DTid.y, AXIS_Y, numLayer) ? 1u << j : 0;
+
+	// Z-axis parity is only required where X and Y disagree
+	uint maskZ = 0;
+	uint tieMask = maskX ^ maskY;
+	while (tieMask)
+	{
+		const uint k = firstbitlow(tieMask);
+		tieMask &= tieMask - 1;
+		maskZ |= IsInside(uint2(x0 + k, DTid.y), DTid.z, AXIS_Z, numLayer) ? 1u << k : 0;
+	}
+
+	// Majority voting
+	uint fillMask = (maskX & maskY) | (maskY & maskZ) | (maskZ & maskX);
+	while (fillMask)
+	{
+		const uint k = firstbitlow(fillMask);
+		fillMask &= fillMask - 1;
+		g_rwGrid[uint3(x0 + k, DTid.yz)] = pack(float4(0.0.xxx, 1.0));
+	}
+}
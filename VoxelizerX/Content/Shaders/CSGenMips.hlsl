@@ -0,0 +1,42 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Common\D3DX_DXGIFormatConvert.inl"
+#define	pack(x)		D3DX_FLOAT4_to_R10G10B10A2_UNORM(x)
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+Texture3D				g_txSource;
+RWTexture3D<uint>		g_rwDest;
+
+//--------------------------------------------------------------------------------------
+// 2x2x2 reduction: coverage-weighted average of the normals and average of the
+// coverages, where the coverage is rounded up to keep any occupancy in 2-bit alpha.
+// Children with all zero normal bits, e.g. filled interiors, have no normal, so they
+// count in the coverage only, and a parent without any normal keeps zero normal bits.
+//--------------------------------------------------------------------------------------
+[numthreads(4, 4, 4)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	uint3 size;
+	g_rwDest.GetDimensions(size.x, size.y, size.z);
+	if (any(DTid >= size)) return;
+
+	float4 sum = 0.0;
+	[unroll]
+	for (uint i = 0; i < 8; ++i)
+	{
+		const uint3 offset = { i & 1, (i >> 1) & 1, i >> 2 };
+		const float4 child = g_txSource[DTid * 2 + offset];
+		const float weight = any(child.xyz > 0.0) ? child.w : 0.0;
+		sum += float4((child.xyz * 2.0 - 1.0) * weight, child.w);
+	}
+
+	const float coverage = sum.w / 8.0;
+	const float len = length(sum.xyz);
+	const float3 normal = len > 0.0 ? sum.xyz / len * 0.5 + 0.5 : 0.0;
+
+	g_rwDest[DTid] = coverage > 0.0 ? pack(float4(normal, ceil(coverage * 3.0) / 3.0)) : 0;
+}
@@ -0,0 +1,114 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "SharedConst.h"
+
+#define ABSORPTION	1.0
+
+//--------------------------------------------------------------------------------------
+// Constant buffers
+//--------------------------------------------------------------------------------------
+cbuffer cbPerObject : register (b0)
+{
+	float3	g_localSpaceLightPt;
+	float3	g_localSpaceEyePt;
+	matrix	g_screenToLocal;
+	float	g_mipLevel;
+};
+
+cbuffer cbSlice : register (b1)
+{
+	uint	g_slice;
+};
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+#if	USE_MUTEX
+Texture3D<float>	g_txGrid;
+#else
+Texture3D			g_txGrid;
+#endif
+
+//--------------------------------------------------------------------------------------
+// Unordered access textures
+//--------------------------------------------------------------------------------------
+RWTexture3D<float>	g_rwLightTrans;
+
+//--------------------------------------------------------------------------------------
+// Texture samplers
+//--------------------------------------------------------------------------------------
+SamplerState		g_smpLinear;
+
+//--------------------------------------------------------------------------------------
+// Sample density field, as GetSample in PSRayCast
+//--------------------------------------------------------------------------------------
+float GetSample(float3 tex)
+{
+#if	USE_MUTEX
+	const float density = g_txGrid.SampleLevel(g_smpLinear, tex, g_mipLevel).x;
+#else
+	const float density = g_txGrid.SampleLevel(g_smpLinear, tex, g_mipLevel).w;
+#endif
+
+	return min(density * 8.0, 16.0);
+}
+
+//--------------------------------------------------------------------------------------
+// One slice of the light transmittance sweep. Slices are processed along the dominant
+// axis of the light direction, starting from the side facing the light, and each voxel
+// steps one slice toward the light, where it attenuates the bilinear transmittance of
+// the previous slice by the density there. As the light march of PSRayCast, the
+// transmittance of a voxel excludes the voxel itself.
+//--------------------------------------------------------------------------------------
+[numthreads(8, 8, 1)]
+void main(uint2 DTid : SV_DispatchThreadID)
+{
+	if (any(DTid >= GRID_SIZE)) return;
+
+	// Light direction in voxels, with the step of one slice along the dominant axis
+	const float3 lightDir = normalize(g_localSpaceLightPt) * float3(0.5, -0.5, 0.5);
+	const float3 absDir = abs(lightDir);
+	const uint axis = absDir.x >= absDir.y && absDir.x >= absDir.z ? 0 : (absDir.y >= absDir.z ? 1 : 2);
+	const uint u = (axis + 1) % 3, v = (axis + 2) % 3;
+	const float3 step = lightDir / absDir[axis];
+
+	uint3 voxel;
+	voxel[axis] = step[axis] > 0.0 ? GRID_SIZE - 1 - g_slice : g_slice;
+	voxel[u] = DTid.x;
+	voxel[v] = DTid.y;
+
+	// The point one slice toward the light, in voxels
+	const float3 pos = voxel + step;
+
+	float lightTrans = 1.0;
+	if (all(pos >= -0.5 && pos <= GRID_SIZE - 0.5))
+	{
+		// Bilinear transmittance of the previous slice
+		const float2 uv = clamp(float2(pos[u], pos[v]), 0.0, GRID_SIZE - 1.0);
+		const uint2 i0 = uint2(uv);
+		const uint2 i1 = min(i0 + 1, GRID_SIZE - 1);
+		const float2 w = uv - i0;
+
+		uint3 loc;
+		loc[axis] = uint(pos[axis]);
+		float trans[4];
+		[unroll]
+		for (uint i = 0; i < 4; ++i)
+		{
+			loc[u] = i & 1 ? i1.x : i0.x;
+			loc[v] = i & 2 ? i1.y : i0.y;
+			trans[i] = g_rwLightTrans[loc];
+		}
+
+		const float prevTrans = lerp(lerp(trans[0], trans[1], w.x), lerp(trans[2], trans[3], w.x), w.y);
+
+		// Attenuate by the density over the step, whose length is in the local space
+		const float stepScale = length(step) * 2.0 / GRID_SIZE;
+		const float density = GetSample((pos + 0.5) / GRID_SIZE);
+		lightTrans = prevTrans * saturate(1.0 - ABSORPTION * stepScale * density);
+	}
+
+	g_rwLightTrans[voxel] = lightTrans;
+}
@@ -18,14 +18,14 @@ RWTexture2DArray<uint>	g_rwKBufDepth : register(U_DEPTH);
 //--------------------------------------------------------------------------------------
 // Depth peeling
 //--------------------------------------------------------------------------------------
-void DepthPeel(uint depth, uint2 loc, uint numLayer)
+void DepthPeel(uint depth, uint2 loc, uint numLayer, uint baseLayer = 0)
 {
 	uint depthPrev;
 
 	//[allow_uav_condition]
 	for (uint i = 0; i < numLayer; ++i)
 	{
-		const uint3 tex = { loc, i };
+		const uint3 tex = { loc, baseLayer + i };
 		InterlockedMin(g_rwKBufDepth[tex], depth, depthPrev);
 
 #if	USE_NORMAL
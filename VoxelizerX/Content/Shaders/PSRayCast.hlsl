@@ -25,6 +25,7 @@ cbuffer cbPerObject
 	float3	g_localSpaceLightPt;
 	float3	g_localSpaceEyePt;
 	matrix	g_screenToLocal;
+	float	g_mipLevel;
 };
 
 //static const float3 g_vLightRad = g_vDirectional.xyz * g_vDirectional.w;	// 4.0
@@ -44,6 +45,12 @@ Texture3D<float>	g_txGrid;
 #else
 Texture3D			g_txGrid;
 #endif
+#if	USE_EMPTY_SKIP && !USE_MUTEX
+Texture3D<uint>		g_txEmptyDist;
+#endif
+#if	USE_LIGHT_VOLUME
+Texture3D<float>	g_txLightTrans : register (t2);
+#endif
 
 //--------------------------------------------------------------------------------------
 // Unordered access textures
@@ -103,14 +110,43 @@ bool ComputeStartPoint(inout float3 pos, float3 rayDir)
 min16float GetSample(float3 tex)
 {
 #if	USE_MUTEX
-	const min16float density = min16float(g_txGrid.SampleLevel(g_smpLinear, tex, SHOW_MIP).x);
+	const min16float density = min16float(g_txGrid.SampleLevel(g_smpLinear, tex, g_mipLevel).x);
 #else
-	const min16float density = min16float(g_txGrid.SampleLevel(g_smpLinear, tex, SHOW_MIP).w);
+	const min16float density = min16float(g_txGrid.SampleLevel(g_smpLinear, tex, g_mipLevel).w);
 #endif
 
 	return min(density * 8.0, 16.0);
 }
 
+#if	USE_EMPTY_SKIP && !USE_MUTEX
+//--------------------------------------------------------------------------------------
+// Number of steps to leave the empty cube around the sample, given by the Chebyshev
+// distance to the nearest occupied voxel of level 0. The cube is shrunk to whole
+// texels of the sampled level, whose coverage is conservative, and then by the
+// trilinear footprint, so the skipped samples are exactly 0.
+//--------------------------------------------------------------------------------------
+uint GetNumEmptySteps(float3 tex, float3 texStep)
+{
+	const int3 voxel = floor(tex * GRID_SIZE);
+	if (any(voxel < 0 || voxel >= GRID_SIZE)) return 0;
+
+	const int dist = g_txEmptyDist[voxel];
+	if (dist == 0) return 0;
+
+	const float scale = 1 << (uint)g_mipLevel;
+	const float size = GRID_SIZE / scale;
+	const float3 cubeMin = ceil((voxel - dist + 1) / scale) / size + 0.5 / size;
+	const float3 cubeMax = floor((voxel + dist) / scale) / size - 0.5 / size;
+	if (any(tex < cubeMin || tex > cubeMax)) return 0;
+
+	// Exit distance in units of steps
+	const float3 bound = texStep >= 0.0 ? cubeMax : cubeMin;
+	const float3 steps = abs(texStep) > 1e-8 ? (bound - tex) / texStep : 3.402823466e+38;
+
+	return max(uint(ceil(min(steps.x, min(steps.y, steps.z)))), 1);
+}
+#endif
+
 //--------------------------------------------------------------------------------------
 // Pixel Shader
 //--------------------------------------------------------------------------------------
@@ -122,7 +158,7 @@ min16float4 main(float4 sspos : SV_POSITION) : SV_TARGET
 
 	const float3 step = rayDir * g_stepScale;
 
-#ifndef _POINT_LIGHT_
+#if	!defined(_POINT_LIGHT_) && !USE_LIGHT_VOLUME
 	const float3 lightStep = normalize(g_localSpaceLightPt) * g_lightStepScale;
 #endif
 
@@ -136,6 +172,17 @@ min16float4 main(float4 sspos : SV_POSITION) : SV_TARGET
 		if (abs(pos.x) > 1.0 || abs(pos.y) > 1.0 || abs(pos.z) > 1.0) break;
 		float3 tex = float3(0.5, -0.5, 0.5) * pos + 0.5;
 
+#if	USE_EMPTY_SKIP && !USE_MUTEX
+		// Skip empty space by macro-cells, staying on the same sample lattice
+		const uint numEmptySteps = GetNumEmptySteps(tex, float3(0.5, -0.5, 0.5) * step);
+		if (numEmptySteps > 0)
+		{
+			i += numEmptySteps - 1;
+			pos += step * numEmptySteps;
+			continue;
+		}
+#endif
+
 		// Get a sample
 		const min16float density = GetSample(tex);
 
@@ -147,6 +194,10 @@ min16float4 main(float4 sspos : SV_POSITION) : SV_TARGET
 			transmit *= saturate(1.0 - scaledDens * ABSORPTION);
 			if (transmit < ZERO_THRESHOLD) break;
 
+#if	USE_LIGHT_VOLUME
+			// Transmittance along light ray, precomputed by CSLightTrans
+			const min16float lightTrans = min16float(g_txLightTrans.SampleLevel(g_smpLinear, tex, 0.0));
+#else
 			// Point light direction in texture space
 #ifdef _POINT_LIGHT_
 			const float3 lightStep = normalize(g_localSpaceLightPt - pos) * g_lightStepScale;
@@ -161,6 +212,16 @@ min16float4 main(float4 sspos : SV_POSITION) : SV_TARGET
 				if (abs(lightPos.x) > 1.0 || abs(lightPos.y) > 1.0 || abs(lightPos.z) > 1.0) break;
 				tex = min16float3(0.5, -0.5, 0.5) * lightPos + 0.5;
 
+#if	USE_EMPTY_SKIP && !USE_MUTEX
+				const uint numLightEmptySteps = GetNumEmptySteps(tex, float3(0.5, -0.5, 0.5) * lightStep);
+				if (numLightEmptySteps > 0)
+				{
+					j += numLightEmptySteps - 1;
+					lightPos += lightStep * numLightEmptySteps;
+					continue;
+				}
+#endif
+
 				// Get a sample along light ray
 				const min16float lightDens = GetSample(tex);
 
@@ -171,6 +232,7 @@ min16float4 main(float4 sspos : SV_POSITION) : SV_TARGET
 				// Update position along light ray
 				lightPos += lightStep;
 			}
+#endif
 
 			scatter += lightTrans * transmit * scaledDens;
 		}
@@ -29,6 +29,9 @@ struct PSIn
 cbuffer cbPerMipLevel
 {
 	float g_gridSize;
+	float g_mipLevel;
+	float g_numLevels;	// Number of levels from this level to the coarsest
+	uint g_objectID;
 };
 
 //--------------------------------------------------------------------------------------
@@ -39,6 +42,11 @@ globallycoherent
 RWTexture3D<float>	g_rwGrids[3]	: register (u0);
 #else
 RWTexture3D<uint>	g_rwGrid		: register (u0);
+#ifdef _MULTI_RES_
+RWTexture3D<uint>	g_rwCoarseGrids[MAX_NUM_LEVELS - 1] : register (u1);
+#elif defined(_OBJECT_ID_)
+RWTexture3D<uint>	g_rwObjectIDs	: register (u1);
+#endif
 #endif
 
 //--------------------------------------------------------------------------------------
@@ -77,7 +85,21 @@ void PSTriProj(PSIn input, uint3 loc)
 #ifdef _CONSERVATIVE_
 	if (needWrite)
 #endif
+	{
 		InterlockedMax(g_rwGrid[loc], packedData, packedData);
 
+#ifdef _MULTI_RES_
+		// Propagate to the parents of all the coarser levels in the same pass,
+		// where the coverage in the top bits makes the max a bit-OR of occupancy
+		const uint numLevels = g_numLevels;
+		[unroll]
+		for (uint i = 1; i < MAX_NUM_LEVELS; ++i)
+			if (i < numLevels) InterlockedMax(g_rwCoarseGrids[i - 1][loc >> i], packedData);
+#elif defined(_OBJECT_ID_)
+		// The lowest ID wins, regardless of the order of the writes
+		InterlockedMin(g_rwObjectIDs[loc], g_objectID);
+#endif
+	}
+
 #endif
 }
@@ -0,0 +1,6 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#define _CONSERVATIVE_
+#include "PSTriProjUnionSolidVote.hlsl"
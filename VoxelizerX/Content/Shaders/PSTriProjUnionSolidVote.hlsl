@@ -0,0 +1,22 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "PSTriProj.hlsli"
+#include "PSDepthPeel.hlsli"
+
+//--------------------------------------------------------------------------------------
+// Surface voxelization and depth peeling along X, Y, and Z for multi-axis voting
+//--------------------------------------------------------------------------------------
+void main(PSIn input)
+{
+	const uint3 loc = input.TexLoc * g_gridSize;
+	const uint numLayer = g_gridSize * DEPTH_SCALE;
+	
+	PSTriProj(input, loc);
+
+	// K-buffer layers are arranged as [Z-columns, X-columns, Y-columns]
+	DepthPeel(loc.z, loc.xy, numLayer);
+	DepthPeel(loc.x, loc.yz, numLayer, numLayer);
+	DepthPeel(loc.y, loc.zx, numLayer, numLayer * 2);
+}
@@ -24,6 +24,12 @@ cbuffer cbMatrices
 	float3x3 g_worldIT;
 };
 
+cbuffer cbPerMipLevel
+{
+	float g_gridSize;
+	float g_mipLevel;
+};
+
 //--------------------------------------------------------------------------------------
 // Textures
 //--------------------------------------------------------------------------------------
@@ -32,6 +38,9 @@ Texture3D<float>	g_txGrids[3];
 #else
 Texture3D			g_txGrid;
 #endif
+#if	USE_BOX_LIST
+StructuredBuffer<uint>	g_faces;
+#endif
 
 static const float3x3 plane[6] =
 {
@@ -56,29 +65,39 @@ VSOut main(uint vID : SV_VertexID, uint instID : SV_InstanceID)
 {
 	VSOut output;
 
+	const uint gridSize = g_gridSize;
+	const uint mipLevel = g_mipLevel;
+
+#if	USE_BOX_LIST
+	// Exposed face of an occupied voxel, compacted by CSCompactBoxes
+	const uint face = g_faces[instID];
+	const uint planeID = face >> 27;
+	const uint3 loc = { face & 0x1ff, (face >> 9) & 0x1ff, (face >> 18) & 0x1ff };
+#else
 	const uint boxID = instID / 6;
 	const uint planeID = instID % 6;
 
+	const uint sliceSize = gridSize * gridSize;
+	const uint perSliceID = boxID % sliceSize;
+	const uint3 loc = { perSliceID % gridSize, perSliceID / gridSize, boxID / sliceSize };
+#endif
+
 	const float2 pos2D = float2(vID & 1, vID >> 1) * 2.0 - 1.0;
 	float3 perBoxPos = float3(pos2D.x, -pos2D.y, 1.0);
 	perBoxPos = mul(perBoxPos, plane[planeID]);
 
-	const uint gridSize = GRID_SIZE >> SHOW_MIP;
-	const uint sliceSize = gridSize * gridSize;
-	const uint perSliceID = boxID % sliceSize;
-	const uint3 loc = { perSliceID % gridSize, perSliceID / gridSize, boxID / sliceSize };
 	float3 pos = (loc * 2 + 1) / (gridSize * 2.0);
 	pos = pos * float3(2.0, -2.0, 2.0) + float3(-1.0, 1.0, -1.0);
 	pos += perBoxPos / gridSize;
 	
 #if	USE_MUTEX
 	float4 grid;
-	grid.x = g_txGrids[0].mips[SHOW_MIP][loc];
-	grid.y = g_txGrids[1].mips[SHOW_MIP][loc];
-	grid.z = g_txGrids[2].mips[SHOW_MIP][loc];
+	grid.x = g_txGrids[0].mips[mipLevel][loc];
+	grid.y = g_txGrids[1].mips[mipLevel][loc];
+	grid.z = g_txGrids[2].mips[mipLevel][loc];
 	grid.w = any(grid.xyz);
 #else
-	float4 grid = g_txGrid.mips[SHOW_MIP][loc];
+	float4 grid = g_txGrid.mips[mipLevel][loc];
 	grid.xyz -= 0.5;
 #endif
 	
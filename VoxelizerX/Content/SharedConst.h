@@ -6,6 +6,7 @@
 
 #define GRID_SIZE	64
 #define SHOW_MIP	0
+#define MAX_NUM_LEVELS	9	// Direct multi-resolution voxelization supports GRID_SIZE up to 256
 
 #define USING_SRV	0
 
@@ -13,6 +14,17 @@
 
 #define	USE_MUTEX	0
 
+#define	USE_EMPTY_SKIP	1
+#define	MAX_EMPTY_DIST	16
+
+#define	USE_LIGHT_VOLUME	1	// Directional light only
+
+#if	USE_MUTEX
+#define	USE_BOX_LIST	0	// The face compaction reads the packed grid
+#else
+#define	USE_BOX_LIST	1	// Draw the exposed faces of the boxes indirectly, for GRID_SIZE up to 512
+#endif
+
 #if	USE_NORMAL
 #define	DEPTH_SCALE	0.25
 #else
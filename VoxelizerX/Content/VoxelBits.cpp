@@ -0,0 +1,331 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "VoxelBits.h"
+
+#if	defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define	USE_SSE2	1
+#include <emmintrin.h>
+#else
+#define	USE_SSE2	0
+#endif
+
+using namespace std;
+
+namespace
+{
+	// 256 KB of each operand per task
+	const size_t g_wordsPerChunk = 32768;
+
+	// Neighborhood of the occupancy gradient, in voxels
+	const int g_normalRadius = 2;
+
+	uint64_t combineWord(uint64_t a, uint64_t b, VoxelColumns::Operation op)
+	{
+		switch (op)
+		{
+		case VoxelColumns::UNION:
+			return a | b;
+		case VoxelColumns::INTERSECTION:
+			return a & b;
+		default:
+			return a & ~b;
+		}
+	}
+
+	uint32_t countBits(uint64_t x)
+	{
+		x -= (x >> 1) & 0x5555555555555555ull;
+		x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+		x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+
+		return static_cast<uint32_t>((x * 0x0101010101010101ull) >> 56);
+	}
+}
+
+VoxelBits::VoxelBits() :
+	m_size(0),
+	m_wordsPerRow(0)
+{
+}
+
+VoxelBits::~VoxelBits()
+{
+}
+
+void VoxelBits::Create(uint32_t size)
+{
+	m_size = size;
+	m_wordsPerRow = (size + 63) / 64;
+	m_words.assign(static_cast<size_t>(m_wordsPerRow) * size * size, 0);
+}
+
+void VoxelBits::Clear()
+{
+	fill(m_words.begin(), m_words.end(), 0);
+}
+
+void VoxelBits::Build(const VoxelGrid& grid, uint32_t numThreads)
+{
+	PROFILE_SCOPE("VoxelBits::Build");
+
+	const auto size = grid.GetSize();
+	const auto pData = grid.GetData();
+	Create(size);
+
+	ParallelFor(0, size, [&](uint32_t z)
+	{
+		for (auto y = 0u; y < size; ++y)
+		{
+			const auto pRow = &pData[(static_cast<size_t>(z) * size + y) * size];
+			const auto pWords = &m_words[(static_cast<size_t>(z) * size + y) * m_wordsPerRow];
+			for (auto x = 0u; x < size; ++x)
+				if (pRow[x] & VoxelGrid::CoverageMask) pWords[x >> 6] |= 1ull << (x & 63);
+		}
+	}, numThreads);
+}
+
+//--------------------------------------------------------------------------------------
+// Each row of columns of a Y sets the bits of its own rows of words
+//--------------------------------------------------------------------------------------
+void VoxelBits::Build(const VoxelColumns& columns, uint32_t numThreads)
+{
+	PROFILE_SCOPE("VoxelBits::Build");
+
+	const auto size = columns.GetSize();
+	Create(size);
+
+	ParallelFor(0, size, [&](uint32_t y)
+	{
+		for (auto x = 0u; x < size; ++x)
+		{
+			uint32_t numRuns;
+			const auto pRuns = columns.GetRuns(x, y, numRuns);
+			const auto bit = 1ull << (x & 63);
+			for (auto i = 0u; i < numRuns; ++i)
+				for (auto z = pRuns[i].Begin; z < pRuns[i].End; ++z)
+					m_words[(static_cast<size_t>(z) * size + y) * m_wordsPerRow + (x >> 6)] |= bit;
+		}
+	}, numThreads);
+}
+
+//--------------------------------------------------------------------------------------
+// The words are split into chunks processed in parallel, each by 128-bit operations with
+// SSE2, and a word at a time for the rest. The padding bits stay zero in all operations.
+//--------------------------------------------------------------------------------------
+void VoxelBits::Combine(const VoxelBits& a, const VoxelBits& b, VoxelColumns::Operation op, uint32_t numThreads)
+{
+	PROFILE_SCOPE("VoxelBits::Combine");
+
+	if (a.GetSize() != b.GetSize()) return;
+	if (this != &a && this != &b) Create(a.GetSize());
+
+	const auto numWords = m_words.size();
+	const auto numChunks = static_cast<uint32_t>((numWords + g_wordsPerChunk - 1) / g_wordsPerChunk);
+	const auto pA = a.m_words.data();
+	const auto pB = b.m_words.data();
+	const auto pDst = m_words.data();
+
+	ParallelFor(0, numChunks, [&](uint32_t chunk)
+	{
+		auto i = chunk * g_wordsPerChunk;
+		const auto end = (min)(i + g_wordsPerChunk, numWords);
+#if	USE_SSE2
+		for (; i + 2 <= end; i += 2)
+		{
+			const auto va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&pA[i]));
+			const auto vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&pB[i]));
+			__m128i vc;
+			switch (op)
+			{
+			case VoxelColumns::UNION:
+				vc = _mm_or_si128(va, vb);
+				break;
+			case VoxelColumns::INTERSECTION:
+				vc = _mm_and_si128(va, vb);
+				break;
+			default:
+				vc = _mm_andnot_si128(vb, va);
+				break;
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&pDst[i]), vc);
+		}
+#endif
+		for (; i < end; ++i) pDst[i] = combineWord(pA[i], pB[i], op);
+	}, numThreads);
+}
+
+void VoxelBits::Write(VoxelGrid& grid, uint32_t voxel, uint32_t numThreads) const
+{
+	const auto size = grid.GetSize();
+	if (size != m_size) return;
+
+	const auto pData = grid.GetData();
+	ParallelFor(0, size, [&](uint32_t z)
+	{
+		for (auto y = 0u; y < size; ++y)
+		{
+			const auto pRow = &pData[(static_cast<size_t>(z) * size + y) * size];
+			const auto pWords = &m_words[(static_cast<size_t>(z) * size + y) * m_wordsPerRow];
+			for (auto x = 0u; x < size; ++x)
+				if (pWords[x >> 6] >> (x & 63) & 1) pRow[x] = voxel;
+		}
+	}, numThreads);
+}
+
+//--------------------------------------------------------------------------------------
+// The boundary of each word comes from the words of the 4 neighboring rows and the word
+// shifted by a voxel each way, and the slices in Z are processed in parallel
+//--------------------------------------------------------------------------------------
+void VoxelBits::WriteSurface(VoxelGrid& grid, uint32_t numThreads) const
+{
+	PROFILE_SCOPE("VoxelBits::WriteSurface");
+
+	const auto size = grid.GetSize();
+	if (size != m_size) return;
+
+	const auto pData = grid.GetData();
+	ParallelFor(0, size, [&](uint32_t z)
+	{
+		vector<uint64_t> boundary(m_wordsPerRow);
+		for (auto y = 0u; y < size; ++y)
+		{
+			for (auto j = 0u; j < m_wordsPerRow; ++j) boundary[j] = getBoundaryWord(y, z, j);
+
+			const auto pRow = &pData[(static_cast<size_t>(z) * size + y) * size];
+			for (auto x = 0u; x < size; ++x)
+			{
+				if (!(boundary[x >> 6] >> (x & 63) & 1))
+				{
+					pRow[x] = 0;
+					continue;
+				}
+
+				float n[3];
+				computeNormal(x, y, z, n);
+				if (pRow[x] & VoxelGrid::CoverageMask)
+				{
+					float m[3], coverage;
+					VoxelGrid::Unpack(pRow[x], m[0], m[1], m[2], coverage);
+					if (m[0] * n[0] + m[1] * n[1] + m[2] * n[2] > 0.0f) continue;
+				}
+				pRow[x] = VoxelGrid::Pack(n[0], n[1], n[2]);
+			}
+		}
+	}, numThreads);
+}
+
+bool VoxelBits::IsInside(uint32_t x, uint32_t y, uint32_t z) const
+{
+	return m_words[(static_cast<size_t>(z) * m_size + y) * m_wordsPerRow + (x >> 6)] >> (x & 63) & 1;
+}
+
+bool VoxelBits::IsBoundary(uint32_t x, uint32_t y, uint32_t z) const
+{
+	return getBoundaryWord(y, z, x >> 6) >> (x & 63) & 1;
+}
+
+uint32_t VoxelBits::GetSize() const
+{
+	return m_size;
+}
+
+uint32_t VoxelBits::GetWordsPerRow() const
+{
+	return m_wordsPerRow;
+}
+
+uint64_t VoxelBits::GetNumVoxels() const
+{
+	uint64_t numVoxels = 0;
+	for (const auto& word : m_words) numVoxels += countBits(word);
+
+	return numVoxels;
+}
+
+size_t VoxelBits::GetMemorySize() const
+{
+	return sizeof(uint64_t) * m_words.size();
+}
+
+uint64_t* VoxelBits::GetData()
+{
+	return m_words.data();
+}
+
+const uint64_t* VoxelBits::GetData() const
+{
+	return m_words.data();
+}
+
+bool VoxelBits::isInside(int x, int y, int z) const
+{
+	const auto size = static_cast<int>(m_size);
+	if (x < 0 || y < 0 || z < 0 || x >= size || y >= size || z >= size) return false;
+
+	return IsInside(x, y, z);
+}
+
+uint64_t VoxelBits::getBoundaryWord(uint32_t y, uint32_t z, uint32_t j) const
+{
+	const auto pRow = &m_words[(static_cast<size_t>(z) * m_size + y) * m_wordsPerRow];
+	const auto word = pRow[j];
+	if (!word) return 0;
+
+	// Out of the grid is empty
+	const auto rowStride = static_cast<size_t>(m_wordsPerRow);
+	const auto sliceStride = rowStride * m_size;
+	const auto left = (word << 1) | (j > 0 ? pRow[j - 1] >> 63 : 0);
+	const auto right = (word >> 1) | (j + 1 < m_wordsPerRow ? pRow[j + 1] << 63 : 0);
+	const auto below = y > 0 ? pRow[j - rowStride] : 0;
+	const auto above = y + 1 < m_size ? pRow[j + rowStride] : 0;
+	const auto back = z > 0 ? pRow[j - sliceStride] : 0;
+	const auto front = z + 1 < m_size ? pRow[j + sliceStride] : 0;
+
+	return word & ~(left & right & below & above & back & front);
+}
+
+//--------------------------------------------------------------------------------------
+// Sum of the directions to the empty voxels of the neighborhood, each weighted by the
+// inverse square of its distance, with Y flipped back to model space as the normals of
+// CPUVoxelizer. A boundary balanced on all sides, e.g. of a sheet of a voxel, falls back
+// to its first empty face neighbor.
+//--------------------------------------------------------------------------------------
+void VoxelBits::computeNormal(uint32_t x, uint32_t y, uint32_t z, float n[3]) const
+{
+	float g[3] = {};
+	for (auto k = -g_normalRadius; k <= g_normalRadius; ++k)
+		for (auto j = -g_normalRadius; j <= g_normalRadius; ++j)
+			for (auto i = -g_normalRadius; i <= g_normalRadius; ++i)
+			{
+				const auto dist2 = i * i + j * j + k * k;
+				if (dist2 == 0 || isInside(x + i, y + j, z + k)) continue;
+
+				const auto weight = 1.0f / dist2;
+				g[0] += i * weight;
+				g[1] += j * weight;
+				g[2] += k * weight;
+			}
+
+	auto len = sqrt(g[0] * g[0] + g[1] * g[1] + g[2] * g[2]);
+	if (len < 1.0e-4f)
+	{
+		static const int faces[][3] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+		for (const auto& face : faces)
+		{
+			if (isInside(x + face[0], y + face[1], z + face[2])) continue;
+			for (uint8_t i = 0; i < 3; ++i) g[i] = static_cast<float>(face[i]);
+			break;
+		}
+		len = 1.0f;
+	}
+
+	n[0] = g[0] / len;
+	n[1] = -g[1] / len;
+	n[2] = g[2] / len;
+}
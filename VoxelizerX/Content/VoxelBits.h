@@ -0,0 +1,65 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "VoxelColumns.h"
+
+//--------------------------------------------------------------------------------------
+// Bit-packed occupancy of level 0, a bit per voxel, X-major as in VoxelGrid, with each
+// row along X padded to whole 64-bit words. Boolean operations run word by word over
+// chunks of the words in parallel, with SSE2 where available, so any pair of solids of
+// the same size combines in constant time per voxel, whatever their complexity. The
+// surface of the result is written with the normals of the gradient of the occupancy
+// where the operands do not provide them, e.g. on the faces cut by a difference.
+//--------------------------------------------------------------------------------------
+class VoxelBits
+{
+public:
+	VoxelBits();
+	virtual ~VoxelBits();
+
+	void Create(uint32_t size);
+	void Clear();
+
+	// Occupied voxels of level 0 of the grid
+	void Build(const VoxelGrid& grid, uint32_t numThreads = 0);
+
+	// Voxels in the runs of the columns
+	void Build(const VoxelColumns& columns, uint32_t numThreads = 0);
+
+	// a op b, where both have the same size, and either can be this
+	void Combine(const VoxelBits& a, const VoxelBits& b, VoxelColumns::Operation op, uint32_t numThreads = 0);
+
+	// Write the voxel into level 0 of the grid of the same size at the occupied voxels
+	void Write(VoxelGrid& grid, uint32_t voxel = VoxelGrid::CoverageMask, uint32_t numThreads = 0) const;
+
+	// Replace level 0 of the grid of the same size by the boundary, i.e. the occupied voxels
+	// with an empty or out-of-grid face neighbor. A boundary voxel keeps the voxel of the
+	// grid if it is occupied, with a normal on the same side as the gradient of the
+	// occupancy, and gets the normal of the gradient otherwise, so the grid can hold the
+	// surfaces of the operands beforehand. The ID channel is left as is.
+	void WriteSurface(VoxelGrid& grid, uint32_t numThreads = 0) const;
+
+	bool IsInside(uint32_t x, uint32_t y, uint32_t z) const;
+	bool IsBoundary(uint32_t x, uint32_t y, uint32_t z) const;
+
+	uint32_t GetSize() const;
+	uint32_t GetWordsPerRow() const;
+	uint64_t GetNumVoxels() const;
+	size_t GetMemorySize() const;	// In bytes
+
+	// Rows of (y, z) at GetWordsPerRow() words each, where bit i of word j is voxel 64 * j + i
+	uint64_t* GetData();
+	const uint64_t* GetData() const;
+
+protected:
+	bool isInside(int x, int y, int z) const;	// False out of the grid
+	uint64_t getBoundaryWord(uint32_t y, uint32_t z, uint32_t j) const;
+	void computeNormal(uint32_t x, uint32_t y, uint32_t z, float n[3]) const;
+
+	std::vector<uint64_t> m_words;
+	uint32_t m_size;
+	uint32_t m_wordsPerRow;
+};
@@ -0,0 +1,599 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstring>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "ParallelFor.h"
+#include "VoxelChunkFile.h"
+
+using namespace std;
+
+namespace
+{
+	const uint32_t g_magic = 0x43475856;	// "VXGC"
+
+	struct Header
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t Size;
+		uint32_t ChunkSize;
+		uint64_t IndexOffset;
+	};
+
+	static_assert(sizeof(Header) == 24, "The header must be packed");
+	static_assert(sizeof(VoxelChunkEntry) == 16, "The index entries must be packed");
+
+	// The header is followed by uint32_t idBits from this version
+	const uint32_t g_idBitsVersion = 3;
+
+	// Runs shorter than this are kept in the literals
+	const size_t g_minRunLength = 3;
+
+	void writeVarint(vector<uint8_t>& code, uint64_t value)
+	{
+		for (; value >= 0x80; value >>= 7) code.push_back(static_cast<uint8_t>(value | 0x80));
+		code.push_back(static_cast<uint8_t>(value));
+	}
+
+	bool readVarint(const uint8_t*& pCode, const uint8_t* pEnd, uint64_t& value)
+	{
+		value = 0;
+		for (uint8_t shift = 0; pCode < pEnd && shift < 64; shift += 7)
+		{
+			const auto byte = *pCode++;
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0) return true;
+		}
+
+		return false;
+	}
+
+	template<typename T>
+	void writeVoxels(vector<uint8_t>& code, const T* pVoxels, size_t numVoxels)
+	{
+		const auto size = code.size();
+		code.resize(size + sizeof(T) * numVoxels);
+		memcpy(&code[size], pVoxels, sizeof(T) * numVoxels);
+	}
+
+	template<typename T>
+	void encodeRLE(const T* pVoxels, size_t numVoxels, vector<uint8_t>& code)
+	{
+		code.clear();
+
+		const auto flushLiterals = [&](size_t begin, size_t end)
+		{
+			if (begin >= end) return;
+			writeVarint(code, static_cast<uint64_t>(end - begin) << 1);
+			writeVoxels(code, &pVoxels[begin], end - begin);
+		};
+
+		size_t literals = 0;
+		for (size_t i = 0; i < numVoxels;)
+		{
+			auto j = i + 1;
+			while (j < numVoxels && pVoxels[j] == pVoxels[i]) ++j;
+			if (j - i >= g_minRunLength)
+			{
+				flushLiterals(literals, i);
+				writeVarint(code, static_cast<uint64_t>(j - i) << 1 | 1);
+				writeVoxels(code, &pVoxels[i], 1);
+				literals = j;
+			}
+			i = j;
+		}
+		flushLiterals(literals, numVoxels);
+	}
+
+	// The code is not aligned in the file, so the voxels are copied bytewise
+	template<typename T>
+	bool decodeRLE(const uint8_t* pCode, size_t size, T* pVoxels, size_t numVoxels)
+	{
+		const auto pEnd = pCode + size;
+		size_t i = 0;
+		while (pCode < pEnd)
+		{
+			uint64_t op;
+			if (!readVarint(pCode, pEnd, op)) return false;
+
+			const auto count = op >> 1;
+			if (count > numVoxels - i) return false;
+			if (op & 1)
+			{
+				if (pEnd - pCode < static_cast<ptrdiff_t>(sizeof(T))) return false;
+				T voxel;
+				memcpy(&voxel, pCode, sizeof(T));
+				pCode += sizeof(T);
+				fill_n(&pVoxels[i], count, voxel);
+			}
+			else
+			{
+				if (static_cast<uint64_t>(pEnd - pCode) < sizeof(T) * count) return false;
+				memcpy(&pVoxels[i], pCode, sizeof(T) * count);
+				pCode += sizeof(T) * count;
+			}
+			i += count;
+		}
+
+		return i == numVoxels;
+	}
+
+	// The raw values, or their RLE code in the buffer if it is smaller
+	template<typename T>
+	VoxelChunkEntry encodeChunk(const T* pVoxels, size_t numVoxels, bool compress, vector<uint8_t>& code, const char*& pData)
+	{
+		VoxelChunkEntry entry = { 0, static_cast<uint32_t>(sizeof(T) * numVoxels), CODEC_RAW };
+		pData = reinterpret_cast<const char*>(pVoxels);
+		if (compress)
+		{
+			encodeRLE(pVoxels, numVoxels, code);
+			if (code.size() < entry.Size)
+			{
+				pData = reinterpret_cast<const char*>(code.data());
+				entry.Size = static_cast<uint32_t>(code.size());
+				entry.Codec = CODEC_RLE;
+			}
+		}
+
+		return entry;
+	}
+
+	template<typename T>
+	bool decodeChunk(const uint8_t* pCode, const VoxelChunkEntry& entry, T* pVoxels, size_t numVoxels)
+	{
+		switch (entry.Codec)
+		{
+		case CODEC_RAW:
+			if (entry.Size != sizeof(T) * numVoxels) return false;
+			memcpy(pVoxels, pCode, entry.Size);
+
+			return true;
+		case CODEC_RLE:
+			return decodeRLE(pCode, entry.Size, pVoxels, numVoxels);
+		default:
+			return false;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Writer
+//--------------------------------------------------------------------------------------
+
+VoxelChunkWriter::VoxelChunkWriter() :
+	m_offset(0),
+	m_size(0),
+	m_chunkSize(0),
+	m_numWrittenChunks(0),
+	m_idBits(0),
+	m_compress(true),
+	m_failed(false)
+{
+}
+
+VoxelChunkWriter::~VoxelChunkWriter()
+{
+	if (m_file.is_open()) Close();
+}
+
+bool VoxelChunkWriter::Create(const char* fileName, uint32_t size, uint32_t chunkSize, bool compress, uint8_t idBits)
+{
+	if (chunkSize == 0 || size == 0 || size % chunkSize != 0) return false;
+	if (idBits != 0 && idBits != 16 && idBits != 32) return false;
+
+	m_file.open(fileName, ios::binary | ios::trunc);
+	if (!m_file) return false;
+
+	m_size = size;
+	m_chunkSize = chunkSize;
+	const size_t numChunks = GetNumChunks();
+	m_index.assign(numChunks * numChunks * numChunks, VoxelChunkEntry());
+	m_idIndex.assign(idBits ? m_index.size() : 0, VoxelChunkEntry());
+	m_numWrittenChunks = 0;
+	m_idBits = idBits;
+	m_compress = compress;
+	m_failed = false;
+
+	// The index offset is patched in by Close
+	const Header header = { g_magic, Version, m_size, m_chunkSize, 0 };
+	const uint32_t headerIDBits = m_idBits;
+	m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	m_file.write(reinterpret_cast<const char*>(&headerIDBits), sizeof(headerIDBits));
+	m_offset = sizeof(header) + sizeof(headerIDBits);
+
+	return m_file.good();
+}
+
+//--------------------------------------------------------------------------------------
+// The IDs of a chunk are narrowed to the width of the file, and written right after its
+// voxels under the same lock
+//--------------------------------------------------------------------------------------
+bool VoxelChunkWriter::WriteChunk(uint32_t x, uint32_t y, uint32_t z, const uint32_t* pVoxels, const uint32_t* pIDs)
+{
+	const size_t numVoxels = static_cast<size_t>(m_chunkSize) * m_chunkSize * m_chunkSize;
+	if (all_of(pVoxels, pVoxels + numVoxels, [](uint32_t voxel) { return voxel == 0; })) return true;
+
+	vector<uint8_t> code, idCode;
+	vector<uint16_t> narrowIDs;
+	const char* pData;
+	const char* pIDData = nullptr;
+	auto entry = encodeChunk(pVoxels, numVoxels, m_compress, code, pData);
+	VoxelChunkEntry idEntry = {};
+	if (m_idBits && pIDs && !all_of(pIDs, pIDs + numVoxels, [](uint32_t id) { return id == VoxelGrid::EmptyID; }))
+	{
+		if (m_idBits == 32) idEntry = encodeChunk(pIDs, numVoxels, m_compress, idCode, pIDData);
+		else
+		{
+			narrowIDs.resize(numVoxels);
+			transform(pIDs, pIDs + numVoxels, narrowIDs.begin(), [](uint32_t id) { return static_cast<uint16_t>(id); });
+			idEntry = encodeChunk(narrowIDs.data(), numVoxels, m_compress, idCode, pIDData);
+		}
+	}
+
+	const auto numChunks = GetNumChunks();
+	const auto i = (static_cast<size_t>(z) * numChunks + y) * numChunks + x;
+	lock_guard<mutex> lock(m_mutex);
+	m_file.write(pData, entry.Size);
+	if (pIDData) m_file.write(pIDData, idEntry.Size);
+	if (!m_file)
+	{
+		m_failed = true;
+
+		return false;
+	}
+
+	entry.Offset = m_offset;
+	m_index[i] = entry;
+	m_offset += entry.Size;
+	if (pIDData)
+	{
+		idEntry.Offset = m_offset;
+		m_idIndex[i] = idEntry;
+		m_offset += idEntry.Size;
+	}
+	++m_numWrittenChunks;
+
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+// Each row of chunks along X is gathered and compressed by a worker, and only the file
+// writes are serialized
+//--------------------------------------------------------------------------------------
+bool VoxelChunkWriter::WriteGrid(const VoxelGrid& grid, const uint32_t origin[3], uint32_t numThreads)
+{
+	const uint32_t o[] = { origin ? origin[0] : 0, origin ? origin[1] : 0, origin ? origin[2] : 0 };
+	const auto gridSize = grid.GetSize();
+	if (gridSize % m_chunkSize != 0 || o[0] % m_chunkSize != 0 || o[1] % m_chunkSize != 0 || o[2] % m_chunkSize != 0)
+		return false;
+
+	// Chunks of the grid within the file
+	const auto c = m_chunkSize;
+	uint32_t numChunks[3];
+	for (uint8_t i = 0; i < 3; ++i)
+		numChunks[i] = o[i] < m_size ? (min)(gridSize, m_size - o[i]) / c : 0;
+
+	const auto pData = grid.GetData();
+	const auto hasIDs = m_idBits && grid.GetIDBits();
+	atomic<bool> succeeded(true);
+	ParallelFor(0, numChunks[1] * numChunks[2], [&](uint32_t row)
+	{
+		const auto y = row % numChunks[1] * c;
+		const auto z = row / numChunks[1] * c;
+		vector<uint32_t> chunk(static_cast<size_t>(c) * c * c);
+		vector<uint32_t> ids(hasIDs ? chunk.size() : 0);
+		for (auto x = 0u; x < numChunks[0] * c && succeeded; x += c)
+		{
+			auto pDst = chunk.data();
+			auto pID = ids.data();
+			for (auto k = 0u; k < c; ++k)
+			{
+				for (auto j = 0u; j < c; ++j)
+				{
+					const auto pSrc = &pData[(static_cast<size_t>(z + k) * gridSize + y + j) * gridSize + x];
+					memcpy(pDst, pSrc, sizeof(uint32_t) * c);
+					pDst += c;
+
+					if (hasIDs) for (auto i = 0u; i < c; ++i) *pID++ = grid.GetID(x + i, y + j, z + k);
+				}
+			}
+
+			if (!WriteChunk((o[0] + x) / c, (o[1] + y) / c, (o[2] + z) / c, chunk.data(), hasIDs ? ids.data() : nullptr))
+				succeeded = false;
+		}
+	}, numThreads);
+
+	return succeeded;
+}
+
+bool VoxelChunkWriter::Close()
+{
+	if (!m_file.is_open()) return false;
+
+	const Header header = { g_magic, Version, m_size, m_chunkSize, m_offset };
+	m_file.write(reinterpret_cast<const char*>(m_index.data()), sizeof(VoxelChunkEntry) * m_index.size());
+	m_file.write(reinterpret_cast<const char*>(m_idIndex.data()), sizeof(VoxelChunkEntry) * m_idIndex.size());
+	m_file.seekp(0);
+	m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	const auto succeeded = m_file.good() && !m_failed;
+	m_file.close();
+
+	return succeeded;
+}
+
+uint32_t VoxelChunkWriter::GetSize() const
+{
+	return m_size;
+}
+
+uint32_t VoxelChunkWriter::GetChunkSize() const
+{
+	return m_chunkSize;
+}
+
+uint32_t VoxelChunkWriter::GetNumChunks() const
+{
+	return m_chunkSize ? m_size / m_chunkSize : 0;
+}
+
+uint8_t VoxelChunkWriter::GetIDBits() const
+{
+	return m_idBits;
+}
+
+size_t VoxelChunkWriter::GetNumWrittenChunks() const
+{
+	return m_numWrittenChunks;
+}
+
+uint64_t VoxelChunkWriter::GetFileSize() const
+{
+	return m_offset;
+}
+
+//--------------------------------------------------------------------------------------
+// Reader
+//--------------------------------------------------------------------------------------
+
+VoxelChunkReader::VoxelChunkReader() :
+	m_pData(nullptr),
+	m_fileSize(0),
+	m_size(0),
+	m_chunkSize(0),
+	m_idBits(0)
+#ifdef _WIN32
+	, m_hFile(INVALID_HANDLE_VALUE),
+	m_hMapping(nullptr)
+#endif
+{
+}
+
+VoxelChunkReader::~VoxelChunkReader()
+{
+	Close();
+}
+
+bool VoxelChunkReader::Open(const char* fileName)
+{
+	Close();
+
+	// Map the whole file read-only
+#ifdef _WIN32
+	m_hFile = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_hFile == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_hFile, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(Header)))
+	{
+		Close();
+
+		return false;
+	}
+	m_fileSize = static_cast<uint64_t>(fileSize.QuadPart);
+
+	m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_hMapping) m_pData = static_cast<const uint8_t*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	const auto file = open(fileName, O_RDONLY);
+	if (file < 0) return false;
+
+	struct stat fileStat;
+	if (fstat(file, &fileStat) == 0 && fileStat.st_size >= static_cast<off_t>(sizeof(Header)))
+	{
+		m_fileSize = static_cast<uint64_t>(fileStat.st_size);
+		const auto pData = mmap(nullptr, m_fileSize, PROT_READ, MAP_SHARED, file, 0);
+		if (pData != MAP_FAILED) m_pData = static_cast<const uint8_t*>(pData);
+	}
+	close(file);	// The mapping stays valid
+#endif
+	if (!m_pData)
+	{
+		Close();
+
+		return false;
+	}
+
+	Header header;
+	uint32_t idBits = 0;
+	memcpy(&header, m_pData, sizeof(header));
+	const auto hasIDBits = header.Version >= g_idBitsVersion && m_fileSize >= sizeof(header) + sizeof(idBits);
+	if (hasIDBits) memcpy(&idBits, m_pData + sizeof(header), sizeof(idBits));
+	if (header.Magic != g_magic || header.Version == 0 || header.Version > VoxelChunkWriter::Version ||
+		(header.Version >= g_idBitsVersion && !hasIDBits) || (idBits != 0 && idBits != 16 && idBits != 32) ||
+		header.ChunkSize == 0 || header.Size % header.ChunkSize != 0)
+	{
+		Close();
+
+		return false;
+	}
+
+	// The indices are copied out, since they need not be aligned in the file
+	const size_t numChunks = header.Size / header.ChunkSize;
+	const auto indexSize = sizeof(VoxelChunkEntry) * numChunks * numChunks * numChunks;
+	if (header.IndexOffset > m_fileSize || m_fileSize - header.IndexOffset < (idBits ? 2 : 1) * indexSize)
+	{
+		Close();
+
+		return false;
+	}
+
+	m_size = header.Size;
+	m_chunkSize = header.ChunkSize;
+	m_idBits = static_cast<uint8_t>(idBits);
+	m_index.resize(numChunks * numChunks * numChunks);
+	memcpy(m_index.data(), m_pData + header.IndexOffset, indexSize);
+	if (m_idBits)
+	{
+		m_idIndex.resize(m_index.size());
+		memcpy(m_idIndex.data(), m_pData + header.IndexOffset + indexSize, indexSize);
+	}
+
+	return true;
+}
+
+void VoxelChunkReader::Close()
+{
+#ifdef _WIN32
+	if (m_pData) UnmapViewOfFile(m_pData);
+	if (m_hMapping) CloseHandle(m_hMapping);
+	if (m_hFile != INVALID_HANDLE_VALUE) CloseHandle(m_hFile);
+	m_hMapping = nullptr;
+	m_hFile = INVALID_HANDLE_VALUE;
+#else
+	if (m_pData) munmap(const_cast<uint8_t*>(m_pData), m_fileSize);
+#endif
+	m_pData = nullptr;
+	m_fileSize = 0;
+	m_index.clear();
+	m_idIndex.clear();
+	m_size = m_chunkSize = 0;
+	m_idBits = 0;
+}
+
+bool VoxelChunkReader::ReadChunk(uint32_t x, uint32_t y, uint32_t z, uint32_t* pVoxels) const
+{
+	const auto& entry = GetEntry(x, y, z);
+	const size_t numVoxels = static_cast<size_t>(m_chunkSize) * m_chunkSize * m_chunkSize;
+	if (entry.Size == 0)
+	{
+		memset(pVoxels, 0, sizeof(uint32_t) * numVoxels);
+
+		return true;
+	}
+
+	if (entry.Offset > m_fileSize || m_fileSize - entry.Offset < entry.Size) return false;
+
+	return decodeChunk(m_pData + entry.Offset, entry, pVoxels, numVoxels);
+}
+
+//--------------------------------------------------------------------------------------
+// The 16-bit IDs are decoded in their width, and widened with the empty value of all
+// ones mapped to EmptyID
+//--------------------------------------------------------------------------------------
+bool VoxelChunkReader::ReadChunkIDs(uint32_t x, uint32_t y, uint32_t z, uint32_t* pIDs) const
+{
+	const size_t numVoxels = static_cast<size_t>(m_chunkSize) * m_chunkSize * m_chunkSize;
+	const auto pEntry = m_idBits ? &m_idIndex[(static_cast<size_t>(z) * GetNumChunks() + y) * GetNumChunks() + x] : nullptr;
+	if (!pEntry || pEntry->Size == 0)
+	{
+		fill_n(pIDs, numVoxels, VoxelGrid::EmptyID);
+
+		return true;
+	}
+
+	const auto& entry = *pEntry;
+	if (entry.Offset > m_fileSize || m_fileSize - entry.Offset < entry.Size) return false;
+	if (m_idBits == 32) return decodeChunk(m_pData + entry.Offset, entry, pIDs, numVoxels);
+
+	vector<uint16_t> narrowIDs(numVoxels);
+	if (!decodeChunk(m_pData + entry.Offset, entry, narrowIDs.data(), numVoxels)) return false;
+	for (size_t i = 0; i < numVoxels; ++i) pIDs[i] = narrowIDs[i] == 0xffff ? VoxelGrid::EmptyID : narrowIDs[i];
+
+	return true;
+}
+
+bool VoxelChunkReader::IsChunkEmpty(uint32_t x, uint32_t y, uint32_t z) const
+{
+	return GetEntry(x, y, z).Size == 0;
+}
+
+const VoxelChunkEntry& VoxelChunkReader::GetEntry(uint32_t x, uint32_t y, uint32_t z) const
+{
+	const size_t numChunks = GetNumChunks();
+
+	return m_index[(z * numChunks + y) * numChunks + x];
+}
+
+bool VoxelChunkReader::ReadGrid(VoxelGrid& grid, uint32_t numThreads) const
+{
+	if (grid.GetSize() != m_size) return false;
+
+	const auto pData = grid.GetData();
+	const auto numChunks = GetNumChunks();
+	const auto c = m_chunkSize;
+	const auto hasIDs = m_idBits && grid.GetIDBits();
+	atomic<bool> succeeded(true);
+	ParallelFor(0, numChunks * numChunks, [&](uint32_t row)
+	{
+		const auto y = row % numChunks;
+		const auto z = row / numChunks;
+		vector<uint32_t> chunk(static_cast<size_t>(c) * c * c);
+		vector<uint32_t> ids(hasIDs ? chunk.size() : 0);
+		for (auto x = 0u; x < numChunks && succeeded; ++x)
+		{
+			if (!ReadChunk(x, y, z, chunk.data()) || (hasIDs && !ReadChunkIDs(x, y, z, ids.data())))
+			{
+				succeeded = false;
+
+				return;
+			}
+
+			auto pSrc = chunk.data();
+			auto pID = ids.data();
+			for (auto k = 0u; k < c; ++k)
+			{
+				for (auto j = 0u; j < c; ++j)
+				{
+					const auto pDst = &pData[(static_cast<size_t>(z * c + k) * m_size + y * c + j) * m_size + x * c];
+					memcpy(pDst, pSrc, sizeof(uint32_t) * c);
+					pSrc += c;
+
+					if (hasIDs) for (auto i = 0u; i < c; ++i) grid.SetID(x * c + i, y * c + j, z * c + k, *pID++);
+				}
+			}
+		}
+	}, numThreads);
+
+	return succeeded;
+}
+
+uint32_t VoxelChunkReader::GetSize() const
+{
+	return m_size;
+}
+
+uint32_t VoxelChunkReader::GetChunkSize() const
+{
+	return m_chunkSize;
+}
+
+uint32_t VoxelChunkReader::GetNumChunks() const
+{
+	return m_chunkSize ? m_size / m_chunkSize : 0;
+}
+
+uint8_t VoxelChunkReader::GetIDBits() const
+{
+	return m_idBits;
+}
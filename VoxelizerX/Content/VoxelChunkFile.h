@@ -0,0 +1,131 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <fstream>
+#include <mutex>
+#include "VoxelGrid.h"
+
+//--------------------------------------------------------------------------------------
+// Chunked on-disk layout of level 0 of a voxel grid, for caching the results and for
+// grids that need not fit in memory: "VXGC", uint32_t version (3), uint32_t size,
+// uint32_t chunkSize, uint64_t indexOffset, uint32_t idBits, then the chunks in any
+// order, and the index of all the chunks, X-major, then Y, then Z, followed by that of
+// their IDs if idBits is not 0, all little-endian. Each chunk holds chunkSize^3 voxels in
+// the layout of VoxelGrid, either raw or compressed by its codec, and the empty chunks
+// are omitted. The IDs of a chunk are in the width of idBits (16 or 32), with the empty
+// value of all ones, coded the same way, and omitted with the chunk, or if all empty.
+// Version 2 has no idBits, and version 1 has raw chunks only.
+//--------------------------------------------------------------------------------------
+struct VoxelChunkEntry
+{
+	uint64_t Offset;
+	uint32_t Size;		// In bytes, or 0 if the chunk is empty
+	uint32_t Codec;
+};
+
+//--------------------------------------------------------------------------------------
+// CODEC_RLE is a run-length code of the 32-bit voxels, or of the IDs in their width, as
+// a sequence of a varint header (count << 1 | run) followed by a single voxel repeated
+// count times for a run, or by count literal voxels otherwise. The empty space and the
+// solid interiors collapse into runs, and the surfaces are kept as literals. A chunk is
+// stored raw if the code is no smaller.
+//--------------------------------------------------------------------------------------
+enum VoxelChunkCodec : uint32_t
+{
+	CODEC_RAW,
+	CODEC_RLE
+};
+
+class VoxelChunkWriter
+{
+public:
+	VoxelChunkWriter();
+	virtual ~VoxelChunkWriter();
+
+	// The size must be a multiple of the chunk size, and idBits is 0 for no IDs, or 16 or 32
+	bool Create(const char* fileName, uint32_t size, uint32_t chunkSize = 32, bool compress = true, uint8_t idBits = 0);
+
+	// Chunk coordinates are in chunks. The chunk is skipped if it is empty, and compressed
+	// before taking the lock of the file. The IDs, if any, are as VoxelGrid::GetID, and
+	// ignored without the IDs in the file. Thread-safe.
+	bool WriteChunk(uint32_t x, uint32_t y, uint32_t z, const uint32_t* pVoxels, const uint32_t* pIDs = nullptr);
+
+	// Chunks of level 0 of the grid, placed at the origin in voxels, if any, where both
+	// the origin and the grid size must be multiples of the chunk size. The chunks out of
+	// the file are skipped. The chunks are compressed in parallel. The IDs of the grid
+	// are written if both the grid and the file have them.
+	bool WriteGrid(const VoxelGrid& grid, const uint32_t origin[3] = nullptr, uint32_t numThreads = 0);
+
+	// Write the index, and close the file
+	bool Close();
+
+	uint32_t GetSize() const;
+	uint32_t GetChunkSize() const;
+	uint32_t GetNumChunks() const;	// Per axis
+	uint8_t GetIDBits() const;
+	size_t GetNumWrittenChunks() const;
+	uint64_t GetFileSize() const;	// So far
+
+	static const uint32_t Version = 3;
+
+protected:
+	std::ofstream m_file;
+	std::mutex m_mutex;
+	std::vector<VoxelChunkEntry> m_index;
+	std::vector<VoxelChunkEntry> m_idIndex;
+	uint64_t m_offset;
+	uint32_t m_size;
+	uint32_t m_chunkSize;
+	size_t m_numWrittenChunks;
+	uint8_t m_idBits;
+	bool m_compress;
+	bool m_failed;
+};
+
+//--------------------------------------------------------------------------------------
+// Reader of a memory-mapped chunked file, so any chunk can be decoded from the mapping
+// at random, from any number of threads at once, without reading the rest of the file
+//--------------------------------------------------------------------------------------
+class VoxelChunkReader
+{
+public:
+	VoxelChunkReader();
+	virtual ~VoxelChunkReader();
+
+	bool Open(const char* fileName);
+	void Close();
+
+	// An empty chunk is read as zeros. Thread-safe.
+	bool ReadChunk(uint32_t x, uint32_t y, uint32_t z, uint32_t* pVoxels) const;
+	bool IsChunkEmpty(uint32_t x, uint32_t y, uint32_t z) const;
+	const VoxelChunkEntry& GetEntry(uint32_t x, uint32_t y, uint32_t z) const;
+
+	// IDs of the chunk as VoxelGrid::GetID, i.e. EmptyID where there is none, which is
+	// everywhere without the IDs in the file. Thread-safe.
+	bool ReadChunkIDs(uint32_t x, uint32_t y, uint32_t z, uint32_t* pIDs) const;
+
+	// Whole level 0 into a grid of the same size, with the chunks decoded in parallel, and
+	// the IDs if both the file and the grid have them
+	bool ReadGrid(VoxelGrid& grid, uint32_t numThreads = 0) const;
+
+	uint32_t GetSize() const;
+	uint32_t GetChunkSize() const;
+	uint32_t GetNumChunks() const;	// Per axis
+	uint8_t GetIDBits() const;
+
+protected:
+	std::vector<VoxelChunkEntry> m_index;
+	std::vector<VoxelChunkEntry> m_idIndex;
+	const uint8_t* m_pData;
+	uint64_t m_fileSize;
+	uint32_t m_size;
+	uint32_t m_chunkSize;
+	uint8_t m_idBits;
+#ifdef _WIN32
+	void* m_hFile;
+	void* m_hMapping;
+#endif
+};
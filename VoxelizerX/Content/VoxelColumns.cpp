@@ -0,0 +1,339 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "VoxelColumns.h"
+
+using namespace std;
+
+namespace
+{
+	struct Crossing
+	{
+		uint32_t X;
+		float Z;
+
+		bool operator<(const Crossing& rhs) const
+		{
+			return X < rhs.X || (X == rhs.X && Z < rhs.Z);
+		}
+	};
+
+	// Twice the signed area of (p, a, b), exactly negated by swapping a and b, so a center
+	// on a shared edge gets the opposite values in the 2 triangles
+	double orient(const float a[3], const float b[3], double px, double py)
+	{
+		return (a[0] - px) * (b[1] - py) - (a[1] - py) * (b[0] - px);
+	}
+
+	// Edges taking the centers on them, among the two directions of an edge in the
+	// counter-clockwise triangles on both of its sides
+	bool isTakingEdge(double dx, double dy)
+	{
+		return dy < 0.0 || (dy == 0.0 && dx > 0.0);
+	}
+
+	// Range [lo, hi] of the voxel centers within [minCoord, maxCoord], if any
+	bool getCenterRange(float minCoord, float maxCoord, uint32_t size, uint32_t& lo, uint32_t& hi)
+	{
+		const auto l = (max)(ceil(minCoord - 0.5f), 0.0f);
+		const auto h = (min)(floor(maxCoord - 0.5f), size - 1.0f);
+		if (l > h) return false;
+		lo = static_cast<uint32_t>(l);
+		hi = static_cast<uint32_t>(h);
+
+		return true;
+	}
+}
+
+VoxelColumns::VoxelColumns() :
+	m_size(0)
+{
+}
+
+VoxelColumns::~VoxelColumns()
+{
+}
+
+template<typename Func>
+void VoxelColumns::buildRows(uint32_t size, const Func& func, uint32_t numThreads)
+{
+	const auto numColumns = static_cast<size_t>(size) * size;
+	vector<vector<VoxelRun>> rows(size);
+	vector<uint32_t> counts(numColumns, 0);
+	ParallelFor(0, size, [&](uint32_t y) { func(y, rows[y], &counts[static_cast<size_t>(y) * size]); }, numThreads);
+
+	m_size = size;
+	m_offsets.resize(numColumns + 1);
+	m_offsets[0] = 0;
+	for (size_t i = 0; i < numColumns; ++i) m_offsets[i + 1] = m_offsets[i] + counts[i];
+
+	m_runs.resize(m_offsets[numColumns]);
+	ParallelFor(0, size, [&](uint32_t y)
+	{
+		if (!rows[y].empty()) memcpy(&m_runs[m_offsets[static_cast<size_t>(y) * size]], rows[y].data(), sizeof(VoxelRun) * rows[y].size());
+	}, numThreads);
+}
+
+//--------------------------------------------------------------------------------------
+// The triangles are binned by the rows of centers they span in Y, and each row sorts the
+// depths of its crossings by column, and pairs them into runs of the voxel centers
+// between the entry and the exit, as CSFillSolid does with the peeled depths
+//--------------------------------------------------------------------------------------
+void VoxelColumns::Build(uint32_t size, const uint8_t* pVertices, uint32_t stride,
+	const uint32_t* pIndices, uint32_t numIndices, const float bound[4], uint32_t numThreads)
+{
+	PROFILE_SCOPE("VoxelColumns::Build");
+
+	// Same mapping as CPUVoxelizer::loadTriangle
+	const auto numTriangles = numIndices / 3;
+	const auto scale = 0.5f * size / bound[3];
+	vector<float> vertices(static_cast<size_t>(numTriangles) * 9);
+	vector<uint32_t> binOffsets(size + 1, 0);
+	for (auto t = 0u; t < numTriangles; ++t)
+	{
+		const auto v = &vertices[static_cast<size_t>(t) * 9];
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			float p[3];
+			memcpy(p, &pVertices[static_cast<size_t>(pIndices[t * 3 + i]) * stride], sizeof(p));
+			v[i * 3] = (p[0] - bound[0]) * scale + 0.5f * size;
+			v[i * 3 + 1] = (bound[1] - p[1]) * scale + 0.5f * size;
+			v[i * 3 + 2] = (p[2] - bound[2]) * scale + 0.5f * size;
+		}
+
+		uint32_t lo, hi;
+		if (getCenterRange((min)(v[1], (min)(v[4], v[7])), (max)(v[1], (max)(v[4], v[7])), size, lo, hi))
+			for (auto y = lo; y <= hi; ++y) ++binOffsets[y + 1];
+	}
+
+	for (auto y = 0u; y < size; ++y) binOffsets[y + 1] += binOffsets[y];
+	vector<uint32_t> binTriangles(binOffsets[size]);
+	{
+		auto bins = binOffsets;
+		for (auto t = 0u; t < numTriangles; ++t)
+		{
+			const auto v = &vertices[static_cast<size_t>(t) * 9];
+			uint32_t lo, hi;
+			if (getCenterRange((min)(v[1], (min)(v[4], v[7])), (max)(v[1], (max)(v[4], v[7])), size, lo, hi))
+				for (auto y = lo; y <= hi; ++y) binTriangles[bins[y]++] = t;
+		}
+	}
+
+	buildRows(size, [&](uint32_t y, vector<VoxelRun>& runs, uint32_t* pCounts)
+	{
+		vector<Crossing> crossings;
+		const auto py = y + 0.5;
+		for (auto i = binOffsets[y]; i < binOffsets[y + 1]; ++i)
+		{
+			const auto v = &vertices[static_cast<size_t>(binTriangles[i]) * 9];
+			const float* p[] = { v, v + 3, v + 6 };
+			const auto area = orient(p[0], p[1], p[2][0], p[2][1]);
+			if (area == 0.0) continue;
+
+			uint32_t lo, hi;
+			if (!getCenterRange((min)(p[0][0], (min)(p[1][0], p[2][0])), (max)(p[0][0], (max)(p[1][0], p[2][0])), size, lo, hi))
+				continue;
+
+			const auto sign = area > 0.0 ? 1.0 : -1.0;
+			for (auto x = lo; x <= hi; ++x)
+			{
+				const auto px = x + 0.5;
+				double w[3];
+				auto isInside = true;
+				for (uint8_t j = 0; j < 3 && isInside; ++j)
+				{
+					const auto a = p[(j + 1) % 3];
+					const auto b = p[(j + 2) % 3];
+					w[j] = sign * orient(a, b, px, py);
+					isInside = w[j] > 0.0 || (w[j] == 0.0 && isTakingEdge(sign * (b[0] - a[0]), sign * (b[1] - a[1])));
+				}
+				if (!isInside) continue;
+
+				const auto sum = w[0] + w[1] + w[2];
+				const auto z = (w[0] * p[0][2] + w[1] * p[1][2] + w[2] * p[2][2]) / sum;
+				crossings.push_back({ x, static_cast<float>(z) });
+			}
+		}
+		sort(crossings.begin(), crossings.end());
+
+		// An odd crossing left by an open surface is dropped
+		for (size_t i = 0; i < crossings.size();)
+		{
+			const auto x = crossings[i].X;
+			auto end = i;
+			while (end < crossings.size() && crossings[end].X == x) ++end;
+
+			const auto first = runs.size();
+			for (; i + 1 < end; i += 2)
+			{
+				uint32_t lo, hi;
+				if (!getCenterRange(crossings[i].Z, crossings[i + 1].Z, size, lo, hi)) continue;
+				if (runs.size() > first && runs.back().End >= lo) runs.back().End = (max)(runs.back().End, hi + 1);
+				else runs.push_back({ lo, hi + 1 });
+			}
+			pCounts[x] = static_cast<uint32_t>(runs.size() - first);
+			i = end;
+		}
+	}, numThreads);
+}
+
+//--------------------------------------------------------------------------------------
+// Each row of columns walks the slices in Z with X innermost, as FillSolid
+//--------------------------------------------------------------------------------------
+void VoxelColumns::Build(const VoxelGrid& grid, uint32_t numThreads)
+{
+	PROFILE_SCOPE("VoxelColumns::Build");
+
+	const auto size = grid.GetSize();
+	const auto pData = grid.GetData();
+	buildRows(size, [&](uint32_t y, vector<VoxelRun>& runs, uint32_t* pCounts)
+	{
+		vector<vector<VoxelRun>> columns(size);
+		vector<uint32_t> begins(size, UINT32_MAX);
+		for (auto z = 0u; z <= size; ++z)
+		{
+			const auto pRow = z < size ? &pData[(static_cast<size_t>(z) * size + y) * size] : nullptr;
+			for (auto x = 0u; x < size; ++x)
+			{
+				const auto isOccupied = pRow && (pRow[x] & VoxelGrid::CoverageMask);
+				if (isOccupied && begins[x] == UINT32_MAX) begins[x] = z;
+				else if (!isOccupied && begins[x] != UINT32_MAX)
+				{
+					columns[x].push_back({ begins[x], z });
+					begins[x] = UINT32_MAX;
+				}
+			}
+		}
+
+		for (auto x = 0u; x < size; ++x)
+		{
+			runs.insert(runs.end(), columns[x].cbegin(), columns[x].cend());
+			pCounts[x] = static_cast<uint32_t>(columns[x].size());
+		}
+	}, numThreads);
+}
+
+//--------------------------------------------------------------------------------------
+// Each pair of columns is merged by a sweep over the boundaries of both, toggling the
+// inside of each at its boundaries, and emitting the runs where the operation holds
+//--------------------------------------------------------------------------------------
+void VoxelColumns::Combine(const VoxelColumns& a, const VoxelColumns& b, Operation op, uint32_t numThreads)
+{
+	PROFILE_SCOPE("VoxelColumns::Combine");
+
+	const auto size = a.GetSize();
+	if (b.GetSize() != size) return;
+
+	buildRows(size, [&](uint32_t y, vector<VoxelRun>& runs, uint32_t* pCounts)
+	{
+		for (auto x = 0u; x < size; ++x)
+		{
+			uint32_t numRuns[2];
+			const VoxelRun* pRuns[] = { a.GetRuns(x, y, numRuns[0]), b.GetRuns(x, y, numRuns[1]) };
+			const auto getBoundary = [&](uint8_t i, uint32_t j)
+			{
+				return j < 2 * numRuns[i] ? (j & 1 ? pRuns[i][j >> 1].End : pRuns[i][j >> 1].Begin) : UINT32_MAX;
+			};
+
+			const auto first = runs.size();
+			uint32_t j[] = { 0, 0 };
+			bool isInside[] = { false, false };
+			auto wasInside = false;
+			auto begin = 0u;
+			while (j[0] < 2 * numRuns[0] || j[1] < 2 * numRuns[1])
+			{
+				const auto z = (min)(getBoundary(0, j[0]), getBoundary(1, j[1]));
+				for (uint8_t i = 0; i < 2; ++i)
+				{
+					if (getBoundary(i, j[i]) != z) continue;
+					isInside[i] = !isInside[i];
+					++j[i];
+				}
+
+				bool inside;
+				switch (op)
+				{
+				case UNION:
+					inside = isInside[0] || isInside[1];
+					break;
+				case INTERSECTION:
+					inside = isInside[0] && isInside[1];
+					break;
+				default:
+					inside = isInside[0] && !isInside[1];
+					break;
+				}
+
+				if (inside && !wasInside) begin = z;
+				else if (!inside && wasInside) runs.push_back({ begin, z });
+				wasInside = inside;
+			}
+			pCounts[x] = static_cast<uint32_t>(runs.size() - first);
+		}
+	}, numThreads);
+}
+
+void VoxelColumns::Write(VoxelGrid& grid, uint32_t voxel, uint32_t numThreads) const
+{
+	const auto size = grid.GetSize();
+	if (size != m_size) return;
+
+	const auto pData = grid.GetData();
+	ParallelFor(0, size, [&](uint32_t y)
+	{
+		for (auto x = 0u; x < size; ++x)
+		{
+			uint32_t numRuns;
+			const auto pRuns = GetRuns(x, y, numRuns);
+			for (auto i = 0u; i < numRuns; ++i)
+				for (auto z = pRuns[i].Begin; z < pRuns[i].End; ++z)
+					pData[(static_cast<size_t>(z) * size + y) * size + x] = voxel;
+		}
+	}, numThreads);
+}
+
+bool VoxelColumns::IsInside(uint32_t x, uint32_t y, uint32_t z) const
+{
+	uint32_t numRuns;
+	const auto pRuns = GetRuns(x, y, numRuns);
+	const auto pRun = upper_bound(pRuns, pRuns + numRuns, z, [](uint32_t z, const VoxelRun& run) { return z < run.Begin; });
+
+	return pRun != pRuns && z < pRun[-1].End;
+}
+
+const VoxelRun* VoxelColumns::GetRuns(uint32_t x, uint32_t y, uint32_t& numRuns) const
+{
+	const auto column = static_cast<size_t>(y) * m_size + x;
+	numRuns = m_offsets[column + 1] - m_offsets[column];
+
+	return m_runs.data() + m_offsets[column];
+}
+
+uint32_t VoxelColumns::GetSize() const
+{
+	return m_size;
+}
+
+size_t VoxelColumns::GetNumRuns() const
+{
+	return m_runs.size();
+}
+
+uint64_t VoxelColumns::GetNumVoxels() const
+{
+	uint64_t numVoxels = 0;
+	for (const auto& run : m_runs) numVoxels += run.End - run.Begin;
+
+	return numVoxels;
+}
+
+size_t VoxelColumns::GetMemorySize() const
+{
+	return sizeof(uint32_t) * m_offsets.size() + sizeof(VoxelRun) * m_runs.size();
+}
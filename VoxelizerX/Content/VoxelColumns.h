@@ -0,0 +1,76 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "VoxelGrid.h"
+
+//--------------------------------------------------------------------------------------
+// Voxels [Begin, End) along Z of a column
+//--------------------------------------------------------------------------------------
+struct VoxelRun
+{
+	uint32_t Begin;
+	uint32_t End;
+};
+
+//--------------------------------------------------------------------------------------
+// Run-length encoded solid of level 0, as a sorted list of disjoint, non-adjacent runs
+// along Z per XY column, in the grid mapping of CPUVoxelizer. The runs of all the
+// columns are stored contiguously, Y-major then X, with an offset per column, so a
+// solid costs a few runs per column instead of a voxel per voxel. The runs are built
+// straight from the depths of the surface crossings along Z, which the solid fill on
+// the GPU reconstructs from the peeled depths, or from the occupancy of a grid.
+// Boolean operations merge the columns pairwise in parallel.
+//--------------------------------------------------------------------------------------
+class VoxelColumns
+{
+public:
+	enum Operation : uint8_t
+	{
+		UNION,
+		INTERSECTION,
+		DIFFERENCE,
+
+		NUM_OPERATION
+	};
+
+	VoxelColumns();
+	virtual ~VoxelColumns();
+
+	// Inside of the mesh by the parity of the crossings of the surface along Z through
+	// the voxel centers, where a center on a shared edge is taken by one triangle only,
+	// as by the fill rule of the rasterizer. Vertices are float3 position followed by
+	// float3 normal, with the given stride in bytes.
+	void Build(uint32_t size, const uint8_t* pVertices, uint32_t stride,
+		const uint32_t* pIndices, uint32_t numIndices, const float bound[4],
+		uint32_t numThreads = 0);
+
+	// Occupied voxels of level 0 of the grid
+	void Build(const VoxelGrid& grid, uint32_t numThreads = 0);
+
+	// a op b, where both have the same size, and neither is this
+	void Combine(const VoxelColumns& a, const VoxelColumns& b, Operation op, uint32_t numThreads = 0);
+
+	// Write the voxel into level 0 of the grid of the same size at the runs
+	void Write(VoxelGrid& grid, uint32_t voxel = VoxelGrid::CoverageMask, uint32_t numThreads = 0) const;
+
+	bool IsInside(uint32_t x, uint32_t y, uint32_t z) const;
+	const VoxelRun* GetRuns(uint32_t x, uint32_t y, uint32_t& numRuns) const;
+
+	uint32_t GetSize() const;
+	size_t GetNumRuns() const;
+	uint64_t GetNumVoxels() const;
+	size_t GetMemorySize() const;	// In bytes
+
+protected:
+	// Fill the runs of each row of columns, and the number of runs of each column of the
+	// row, then concatenate the rows
+	template<typename Func>
+	void buildRows(uint32_t size, const Func& func, uint32_t numThreads);
+
+	std::vector<uint32_t> m_offsets;	// Of the first run of each column, and the end
+	std::vector<VoxelRun> m_runs;
+	uint32_t m_size;
+};
@@ -0,0 +1,640 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include "Profiler.h"
+#include "VoxelExporter.h"
+
+using namespace std;
+
+namespace
+{
+	// Tree configuration, in log2 of the children per axis
+	const uint32_t g_leafLog2 = 3;
+	const uint32_t g_lowerLog2 = 4;
+	const uint32_t g_upperLog2 = 5;
+	const uint32_t g_leafSpan = 1 << g_leafLog2;
+	const uint32_t g_lowerSpan = g_leafSpan << g_lowerLog2;
+	const uint32_t g_upperSpan = g_lowerSpan << g_upperLog2;
+	const uint32_t g_numLeafWords = (1 << 3 * g_leafLog2) / 64;
+	const uint32_t g_numLowerChildren = 1 << 3 * g_lowerLog2;
+	const uint32_t g_numUpperChildren = 1 << 3 * g_upperLog2;
+
+	struct TreeHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t Size;
+		uint32_t Log2Dims;
+		uint32_t NumUpper;
+		uint32_t NumLower;
+		uint64_t NumLeaves;
+		uint64_t NumActive;
+	};
+
+	static_assert(sizeof(TreeHeader) == 40, "The header must be packed");
+
+	void writeIDs(ostream& file, const vector<uint32_t>& ids, uint32_t idBits)
+	{
+		if (idBits == 32)
+		{
+			file.write(reinterpret_cast<const char*>(ids.data()), sizeof(uint32_t) * ids.size());
+
+			return;
+		}
+
+		vector<uint16_t> narrowIDs(ids.size());
+		transform(ids.cbegin(), ids.cend(), narrowIDs.begin(), [](uint32_t id) { return static_cast<uint16_t>(id); });
+		file.write(reinterpret_cast<const char*>(narrowIDs.data()), sizeof(uint16_t) * narrowIDs.size());
+	}
+
+	// MagicaVoxel models are at most 256 voxels per axis
+	const uint32_t g_maxVOXModelSize = 256;
+
+	// The palette quantizes the normal, in the R10G10B10 encoding, to 6 x 6 x 7 colors
+	const uint32_t g_numPaletteR = 6;
+	const uint32_t g_numPaletteG = 6;
+	const uint32_t g_numPaletteB = 7;
+
+	uint8_t getColorIndex(uint32_t voxel)
+	{
+		const auto r = (voxel & 0x3ff) * g_numPaletteR >> 10;
+		const auto g = ((voxel >> 10) & 0x3ff) * g_numPaletteG >> 10;
+		const auto b = ((voxel >> 20) & 0x3ff) * g_numPaletteB >> 10;
+
+		return static_cast<uint8_t>(1 + (r * g_numPaletteG + g) * g_numPaletteB + b);
+	}
+
+	void appendInt(string& content, int32_t value)
+	{
+		content.append(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	void appendString(string& content, const string& str)
+	{
+		appendInt(content, static_cast<int32_t>(str.size()));
+		content += str;
+	}
+
+	void writeVOXChunk(ostream& file, const char* id, const string& content)
+	{
+		const int32_t sizes[] = { static_cast<int32_t>(content.size()), 0 };
+		file.write(id, 4);
+		file.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+		file.write(content.data(), content.size());
+	}
+
+	bool isAnyBrickOccupied(const vector<uint8_t>& isBrickEmpty, uint32_t numBricks, const uint32_t lo[3], const uint32_t hi[3])
+	{
+		for (auto z = lo[2]; z < hi[2]; ++z)
+			for (auto y = lo[1]; y < hi[1]; ++y)
+				for (auto x = lo[0]; x < hi[0]; ++x)
+					if (!isBrickEmpty[(static_cast<size_t>(z) * numBricks + y) * numBricks + x]) return true;
+
+		return false;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Brick sources
+//--------------------------------------------------------------------------------------
+
+uint32_t VoxelBrickSource::GetNumBricks() const
+{
+	const auto brickSize = GetBrickSize();
+
+	return brickSize ? (GetSize() + brickSize - 1) / brickSize : 0;
+}
+
+VoxelGridSource::VoxelGridSource(const VoxelGrid& grid, uint32_t brickSize) :
+	m_grid(grid),
+	m_brickSize(brickSize)
+{
+}
+
+uint32_t VoxelGridSource::GetSize() const
+{
+	return m_grid.GetSize();
+}
+
+uint32_t VoxelGridSource::GetBrickSize() const
+{
+	return m_brickSize;
+}
+
+bool VoxelGridSource::IsBrickEmpty(uint32_t x, uint32_t y, uint32_t z) const
+{
+	const auto size = m_grid.GetSize();
+	const auto pData = m_grid.GetData();
+	const uint32_t lo[] = { x * m_brickSize, y * m_brickSize, z * m_brickSize };
+	const uint32_t hi[] = { (min)(lo[0] + m_brickSize, size), (min)(lo[1] + m_brickSize, size), (min)(lo[2] + m_brickSize, size) };
+	for (auto k = lo[2]; k < hi[2]; ++k)
+	{
+		for (auto j = lo[1]; j < hi[1]; ++j)
+		{
+			const auto pRow = &pData[(static_cast<size_t>(k) * size + j) * size];
+			if (any_of(pRow + lo[0], pRow + hi[0], [](uint32_t voxel) { return voxel != 0; })) return false;
+		}
+	}
+
+	return true;
+}
+
+bool VoxelGridSource::ReadBrick(uint32_t x, uint32_t y, uint32_t z, uint32_t* pVoxels) const
+{
+	const auto size = m_grid.GetSize();
+	const auto pData = m_grid.GetData();
+	const auto b = m_brickSize;
+	const uint32_t lo[] = { x * b, y * b, z * b };
+	const auto width = lo[0] < size ? (min)(b, size - lo[0]) : 0;
+	for (auto k = 0u; k < b; ++k)
+	{
+		for (auto j = 0u; j < b; ++j)
+		{
+			const auto pDst = &pVoxels[(static_cast<size_t>(k) * b + j) * b];
+			auto n = 0u;
+			if (lo[1] + j < size && lo[2] + k < size)
+			{
+				n = width;
+				memcpy(pDst, &pData[(static_cast<size_t>(lo[2] + k) * size + lo[1] + j) * size + lo[0]], sizeof(uint32_t) * n);
+			}
+			fill(pDst + n, pDst + b, 0u);
+		}
+	}
+
+	return true;
+}
+
+uint8_t VoxelGridSource::GetIDBits() const
+{
+	return m_grid.GetIDBits();
+}
+
+bool VoxelGridSource::ReadBrickIDs(uint32_t x, uint32_t y, uint32_t z, uint32_t* pIDs) const
+{
+	const auto size = m_grid.GetSize();
+	const auto b = m_brickSize;
+	const uint32_t lo[] = { x * b, y * b, z * b };
+	for (auto k = 0u; k < b; ++k)
+		for (auto j = 0u; j < b; ++j)
+			for (auto i = 0u; i < b; ++i)
+			{
+				const auto inside = lo[0] + i < size && lo[1] + j < size && lo[2] + k < size;
+				*pIDs++ = inside ? m_grid.GetID(lo[0] + i, lo[1] + j, lo[2] + k) : VoxelGrid::EmptyID;
+			}
+
+	return true;
+}
+
+VoxelChunkSource::VoxelChunkSource(const VoxelChunkReader& reader) :
+	m_reader(reader)
+{
+}
+
+uint32_t VoxelChunkSource::GetSize() const
+{
+	return m_reader.GetSize();
+}
+
+uint32_t VoxelChunkSource::GetBrickSize() const
+{
+	return m_reader.GetChunkSize();
+}
+
+bool VoxelChunkSource::IsBrickEmpty(uint32_t x, uint32_t y, uint32_t z) const
+{
+	return m_reader.IsChunkEmpty(x, y, z);
+}
+
+bool VoxelChunkSource::ReadBrick(uint32_t x, uint32_t y, uint32_t z, uint32_t* pVoxels) const
+{
+	return m_reader.ReadChunk(x, y, z, pVoxels);
+}
+
+uint8_t VoxelChunkSource::GetIDBits() const
+{
+	return m_reader.GetIDBits();
+}
+
+bool VoxelChunkSource::ReadBrickIDs(uint32_t x, uint32_t y, uint32_t z, uint32_t* pIDs) const
+{
+	return m_reader.ReadChunkIDs(x, y, z, pIDs);
+}
+
+//--------------------------------------------------------------------------------------
+// Exporter
+//--------------------------------------------------------------------------------------
+
+VoxelExporter::VoxelExporter() :
+	m_numExported(0)
+{
+}
+
+VoxelExporter::~VoxelExporter()
+{
+}
+
+//--------------------------------------------------------------------------------------
+// The volume is written by slabs of one brick in Z, so only a slab of coverage bytes is
+// resident. The grid Y points down in model space, hence the negative Y direction.
+//--------------------------------------------------------------------------------------
+bool VoxelExporter::WriteNRRD(const char* fileName, const VoxelBrickSource& source, const float bound[4])
+{
+	PROFILE_SCOPE("VoxelExporter::WriteNRRD");
+
+	m_numExported = 0;
+	const auto size = source.GetSize();
+	const auto b = source.GetBrickSize();
+	if (size == 0 || b == 0) return false;
+
+	ofstream file(fileName, ios::binary);
+	if (!file) return false;
+
+	ostringstream header;
+	header << setprecision(9) << "NRRD0004\n"
+		"# Coverage of level 0 of a voxel grid\n"
+		"type: uint8\n"
+		"dimension: 3\n"
+		"sizes: " << size << " " << size << " " << size << "\n";
+	if (bound)
+	{
+		const auto s = 2.0f * bound[3] / size;
+		header << "space dimension: 3\n"
+			"space origin: (" << bound[0] - bound[3] + 0.5f * s << "," << bound[1] + bound[3] - 0.5f * s << "," <<
+			bound[2] - bound[3] + 0.5f * s << ")\n"
+			"space directions: (" << s << ",0,0) (0," << -s << ",0) (0,0," << s << ")\n";
+	}
+	header << "kinds: domain domain domain\n"
+		"encoding: raw\n\n";
+	file << header.str();
+
+	const auto numBricks = source.GetNumBricks();
+	const auto sliceSize = static_cast<size_t>(size) * size;
+	vector<uint8_t> slab(sliceSize * b);
+	vector<uint32_t> brick(static_cast<size_t>(b) * b * b);
+	for (auto bz = 0u; bz < numBricks; ++bz)
+	{
+		fill(slab.begin(), slab.end(), static_cast<uint8_t>(0));
+		for (auto by = 0u; by < numBricks; ++by)
+		{
+			for (auto bx = 0u; bx < numBricks; ++bx)
+			{
+				if (source.IsBrickEmpty(bx, by, bz)) continue;
+				if (!source.ReadBrick(bx, by, bz, brick.data())) return false;
+
+				const auto depth = (min)(b, size - bz * b);
+				const auto height = (min)(b, size - by * b);
+				const auto width = (min)(b, size - bx * b);
+				for (auto k = 0u; k < depth; ++k)
+				{
+					for (auto j = 0u; j < height; ++j)
+					{
+						const auto pSrc = &brick[(static_cast<size_t>(k) * b + j) * b];
+						const auto pDst = &slab[k * sliceSize + static_cast<size_t>(by * b + j) * size + bx * b];
+						for (auto i = 0u; i < width; ++i)
+						{
+							pDst[i] = static_cast<uint8_t>((pSrc[i] >> 30) * 85);
+							if (pDst[i]) ++m_numExported;
+						}
+					}
+				}
+			}
+		}
+
+		file.write(reinterpret_cast<const char*>(slab.data()), sliceSize * (min)(b, size - bz * b));
+	}
+
+	return file.good();
+}
+
+//--------------------------------------------------------------------------------------
+// Each model is streamed brick by brick into its XYZI chunk, whose sizes are patched in
+// afterwards, as is the size of MAIN. The model space is right-handed with Y up and the
+// grid Y points down, so the grid (x, y, z) is the .vox (x, -z, -y) in Z up.
+//--------------------------------------------------------------------------------------
+bool VoxelExporter::WriteVOX(const char* fileName, const VoxelBrickSource& source)
+{
+	PROFILE_SCOPE("VoxelExporter::WriteVOX");
+
+	m_numExported = 0;
+	const auto size = source.GetSize();
+	const auto b = source.GetBrickSize();
+	if (size == 0 || b == 0 || b > g_maxVOXModelSize) return false;
+
+	ofstream file(fileName, ios::binary);
+	if (!file) return false;
+
+	const int32_t version = 150;
+	const int32_t mainSizes[] = { 0, 0 };	// The children size is patched in
+	file.write("VOX ", 4);
+	file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+	file.write("MAIN", 4);
+	file.write(reinterpret_cast<const char*>(mainSizes), sizeof(mainSizes));
+	const auto mainBegin = file.tellp();
+
+	const auto modelSize = g_maxVOXModelSize / b * b;
+	const auto numModels = (size + modelSize - 1) / modelSize;
+	const auto numBricks = source.GetNumBricks();
+	vector<uint8_t> isBrickEmpty(static_cast<size_t>(numBricks) * numBricks * numBricks);
+	for (auto i = 0u; i < isBrickEmpty.size(); ++i)
+		isBrickEmpty[i] = source.IsBrickEmpty(i % numBricks, i / numBricks % numBricks, i / (numBricks * numBricks));
+
+	// Translations of the model centers, with the grid centered on the ground
+	vector<string> translations;
+	vector<uint32_t> brick(static_cast<size_t>(b) * b * b);
+	string content;
+	for (auto m = 0u; m < numModels * numModels * numModels; ++m)
+	{
+		const uint32_t origin[] = { m % numModels * modelSize, m / numModels % numModels * modelSize, m / (numModels * numModels) * modelSize };
+		const uint32_t extent[] = { (min)(modelSize, size - origin[0]), (min)(modelSize, size - origin[1]), (min)(modelSize, size - origin[2]) };
+		uint32_t lo[3], hi[3];
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			lo[i] = origin[i] / b;
+			hi[i] = (origin[i] + extent[i] + b - 1) / b;
+		}
+
+		// An empty grid still gets a model, since MagicaVoxel expects one
+		if (!isAnyBrickOccupied(isBrickEmpty, numBricks, lo, hi) && (m + 1 < numModels * numModels * numModels || !translations.empty()))
+			continue;
+
+		content.clear();
+		appendInt(content, extent[0]);
+		appendInt(content, extent[2]);
+		appendInt(content, extent[1]);
+		writeVOXChunk(file, "SIZE", content);
+
+		const int32_t xyziHeader[] = { 0, 0, 0 };
+		const auto xyziBegin = file.tellp();
+		file.write("XYZI", 4);
+		file.write(reinterpret_cast<const char*>(xyziHeader), sizeof(xyziHeader));
+
+		auto numVoxels = 0u;
+		for (auto bz = lo[2]; bz < hi[2]; ++bz)
+		{
+			for (auto by = lo[1]; by < hi[1]; ++by)
+			{
+				for (auto bx = lo[0]; bx < hi[0]; ++bx)
+				{
+					if (isBrickEmpty[(static_cast<size_t>(bz) * numBricks + by) * numBricks + bx]) continue;
+					if (!source.ReadBrick(bx, by, bz, brick.data())) return false;
+
+					uint8_t xyzi[4 * 256];
+					for (auto k = 0u; k < b && bz * b + k < size; ++k)
+					{
+						for (auto j = 0u; j < b && by * b + j < size; ++j)
+						{
+							auto n = 0u;
+							const auto pSrc = &brick[(static_cast<size_t>(k) * b + j) * b];
+							for (auto i = 0u; i < b && bx * b + i < size; ++i)
+							{
+								if ((pSrc[i] & VoxelGrid::CoverageMask) == 0) continue;
+								xyzi[n++] = static_cast<uint8_t>(bx * b + i - origin[0]);
+								xyzi[n++] = static_cast<uint8_t>(extent[2] - 1 - (bz * b + k - origin[2]));
+								xyzi[n++] = static_cast<uint8_t>(extent[1] - 1 - (by * b + j - origin[1]));
+								xyzi[n++] = getColorIndex(pSrc[i]);
+							}
+							file.write(reinterpret_cast<const char*>(xyzi), n);
+							numVoxels += n / 4;
+						}
+					}
+				}
+			}
+		}
+
+		const auto xyziEnd = file.tellp();
+		const int32_t xyziSizes[] = { static_cast<int32_t>(sizeof(int32_t) + 4 * numVoxels), 0, static_cast<int32_t>(numVoxels) };
+		file.seekp(xyziBegin + static_cast<streamoff>(4));
+		file.write(reinterpret_cast<const char*>(xyziSizes), sizeof(xyziSizes));
+		file.seekp(xyziEnd);
+		m_numExported += numVoxels;
+
+		const int center[] =
+		{
+			static_cast<int>(origin[0] + extent[0] / 2) - static_cast<int>(size / 2),
+			static_cast<int>(size - origin[2] - extent[2] + extent[2] / 2) - static_cast<int>(size / 2),
+			static_cast<int>(size - origin[1] - extent[1] + extent[1] / 2)
+		};
+		translations.emplace_back(to_string(center[0]) + " " + to_string(center[1]) + " " + to_string(center[2]));
+	}
+
+	// Scene graph: the root transform, a group, and a transform and a shape per model
+	const auto numTranslations = static_cast<int32_t>(translations.size());
+	content.clear();
+	for (const auto i : { 0, 0, 1, -1, -1, 1, 0 }) appendInt(content, i);
+	writeVOXChunk(file, "nTRN", content);
+
+	content.clear();
+	for (const auto i : { 1, 0, numTranslations }) appendInt(content, i);
+	for (auto i = 0; i < numTranslations; ++i) appendInt(content, 2 + 2 * i);
+	writeVOXChunk(file, "nGRP", content);
+
+	for (auto i = 0; i < numTranslations; ++i)
+	{
+		content.clear();
+		for (const auto j : { 2 + 2 * i, 0, 3 + 2 * i, -1, 0, 1, 1 }) appendInt(content, j);
+		appendString(content, "_t");
+		appendString(content, translations[i]);
+		writeVOXChunk(file, "nTRN", content);
+
+		content.clear();
+		for (const auto j : { 3 + 2 * i, 0, 1, i, 0 }) appendInt(content, j);
+		writeVOXChunk(file, "nSHP", content);
+	}
+
+	// Entry i of the palette is the color index i + 1
+	content.assign(4 * 256, static_cast<char>(0xff));
+	for (auto i = 0u; i < g_numPaletteR * g_numPaletteG * g_numPaletteB; ++i)
+	{
+		const auto r = i / (g_numPaletteG * g_numPaletteB);
+		const auto g = i / g_numPaletteB % g_numPaletteG;
+		const auto b = i % g_numPaletteB;
+		content[4 * i] = static_cast<char>((2 * r + 1) * 255 / (2 * g_numPaletteR));
+		content[4 * i + 1] = static_cast<char>((2 * g + 1) * 255 / (2 * g_numPaletteG));
+		content[4 * i + 2] = static_cast<char>((2 * b + 1) * 255 / (2 * g_numPaletteB));
+	}
+	writeVOXChunk(file, "RGBA", content);
+
+	const auto mainEnd = file.tellp();
+	const auto childrenSize = static_cast<int32_t>(mainEnd - mainBegin);
+	file.seekp(mainBegin - static_cast<streamoff>(sizeof(int32_t)));
+	file.write(reinterpret_cast<const char*>(&childrenSize), sizeof(childrenSize));
+
+	return file.good();
+}
+
+//--------------------------------------------------------------------------------------
+// The child masks of the upper nodes are known from the empty bricks up front, and each
+// lower node is gathered from its bricks before it is written, so only the leaves of a
+// single lower node are buffered. The counts in the header are patched in at the end.
+// The IDs of the source, if any, make the file version 2.
+//--------------------------------------------------------------------------------------
+bool VoxelExporter::WriteTree(const char* fileName, const VoxelBrickSource& source)
+{
+	PROFILE_SCOPE("VoxelExporter::WriteTree");
+
+	m_numExported = 0;
+	const auto size = source.GetSize();
+	const auto b = source.GetBrickSize();
+	if (size == 0 || b == 0 || b % g_leafSpan != 0 || g_lowerSpan % b != 0) return false;
+
+	ofstream file(fileName, ios::binary);
+	if (!file) return false;
+
+	const uint32_t idBits = source.GetIDBits();
+	TreeHeader header = { 0x52545856, idBits ? 2u : 1u, size, g_leafLog2 | g_lowerLog2 << 8 | g_upperLog2 << 16, 0, 0, 0, 0 };
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	if (idBits) file.write(reinterpret_cast<const char*>(&idBits), sizeof(idBits));
+
+	const auto numBricks = source.GetNumBricks();
+	vector<uint8_t> isBrickEmpty(static_cast<size_t>(numBricks) * numBricks * numBricks);
+	for (auto i = 0u; i < isBrickEmpty.size(); ++i)
+		isBrickEmpty[i] = source.IsBrickEmpty(i % numBricks, i / numBricks % numBricks, i / (numBricks * numBricks));
+
+	vector<uint32_t> brick(static_cast<size_t>(b) * b * b);
+	vector<uint32_t> brickIDs(idBits ? brick.size() : 0);
+	vector<uint64_t> leafMasks(static_cast<size_t>(g_numLowerChildren) * g_numLeafWords);
+	vector<vector<uint32_t>> leafValues(g_numLowerChildren);
+	vector<vector<uint32_t>> leafIDs(g_numLowerChildren);
+	vector<uint64_t> childMask(g_numUpperChildren / 64);
+	const auto numUpper = (size + g_upperSpan - 1) / g_upperSpan;
+	const auto numLowerPerAxis = 1u << g_upperLog2;
+	for (auto u = 0u; u < numUpper * numUpper * numUpper; ++u)
+	{
+		const uint32_t origin[] = { u % numUpper * g_upperSpan, u / numUpper % numUpper * g_upperSpan, u / (numUpper * numUpper) * g_upperSpan };
+		fill(childMask.begin(), childMask.end(), 0ull);
+		auto isEmpty = true;
+		for (auto i = 0u; i < g_numUpperChildren; ++i)
+		{
+			uint32_t lo[3], hi[3];
+			lo[0] = origin[0] + i % numLowerPerAxis * g_lowerSpan;
+			lo[1] = origin[1] + i / numLowerPerAxis % numLowerPerAxis * g_lowerSpan;
+			lo[2] = origin[2] + i / (numLowerPerAxis * numLowerPerAxis) * g_lowerSpan;
+			if (lo[0] >= size || lo[1] >= size || lo[2] >= size) continue;
+			for (uint8_t j = 0; j < 3; ++j)
+			{
+				hi[j] = (min)((lo[j] + g_lowerSpan) / b, numBricks);
+				lo[j] /= b;
+			}
+
+			if (isAnyBrickOccupied(isBrickEmpty, numBricks, lo, hi))
+			{
+				childMask[i / 64] |= 1ull << (i % 64);
+				isEmpty = false;
+			}
+		}
+		if (isEmpty) continue;
+
+		file.write(reinterpret_cast<const char*>(origin), sizeof(origin));
+		file.write(reinterpret_cast<const char*>(childMask.data()), sizeof(uint64_t) * childMask.size());
+		++header.NumUpper;
+
+		for (auto i = 0u; i < g_numUpperChildren; ++i)
+		{
+			if ((childMask[i / 64] >> (i % 64) & 1) == 0) continue;
+
+			const uint32_t lowerOrigin[] =
+			{
+				origin[0] + i % numLowerPerAxis * g_lowerSpan,
+				origin[1] + i / numLowerPerAxis % numLowerPerAxis * g_lowerSpan,
+				origin[2] + i / (numLowerPerAxis * numLowerPerAxis) * g_lowerSpan
+			};
+			if (!writeLowerNode(file, source, lowerOrigin, brick, brickIDs, leafMasks, leafValues, leafIDs, header.NumLeaves))
+				return false;
+			++header.NumLower;
+		}
+	}
+
+	header.NumActive = m_numExported;
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	return file.good();
+}
+
+uint64_t VoxelExporter::GetNumExported() const
+{
+	return m_numExported;
+}
+
+//--------------------------------------------------------------------------------------
+// Every leaf lies within a brick, whose voxels are visited in the order of the bits of
+// the value masks, so the values of each leaf, and their IDs, are appended in mask order
+//--------------------------------------------------------------------------------------
+bool VoxelExporter::writeLowerNode(ostream& file, const VoxelBrickSource& source, const uint32_t origin[3],
+	vector<uint32_t>& brick, vector<uint32_t>& brickIDs, vector<uint64_t>& leafMasks,
+	vector<vector<uint32_t>>& leafValues, vector<vector<uint32_t>>& leafIDs, uint64_t& numLeaves)
+{
+	const uint32_t idBits = source.GetIDBits();
+	const auto size = source.GetSize();
+	const auto b = source.GetBrickSize();
+	const auto numBricks = source.GetNumBricks();
+	const auto numLeavesPerAxis = 1u << g_lowerLog2;
+	fill(leafMasks.begin(), leafMasks.end(), 0ull);
+
+	uint32_t lo[3], hi[3];
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		lo[i] = origin[i] / b;
+		hi[i] = (min)((origin[i] + g_lowerSpan) / b, numBricks);
+	}
+
+	for (auto bz = lo[2]; bz < hi[2]; ++bz)
+	{
+		for (auto by = lo[1]; by < hi[1]; ++by)
+		{
+			for (auto bx = lo[0]; bx < hi[0]; ++bx)
+			{
+				if (source.IsBrickEmpty(bx, by, bz)) continue;
+				if (!source.ReadBrick(bx, by, bz, brick.data())) return false;
+				if (idBits && !source.ReadBrickIDs(bx, by, bz, brickIDs.data())) return false;
+
+				for (auto k = 0u; k < b && bz * b + k < size; ++k)
+				{
+					for (auto j = 0u; j < b && by * b + j < size; ++j)
+					{
+						const auto pSrc = &brick[(static_cast<size_t>(k) * b + j) * b];
+						for (auto i = 0u; i < b && bx * b + i < size; ++i)
+						{
+							if (pSrc[i] == 0) continue;
+
+							const auto x = bx * b + i - origin[0];
+							const auto y = by * b + j - origin[1];
+							const auto z = bz * b + k - origin[2];
+							const auto leaf = ((z >> g_leafLog2) * numLeavesPerAxis + (y >> g_leafLog2)) * numLeavesPerAxis + (x >> g_leafLog2);
+							const auto bit = (((z & (g_leafSpan - 1)) << g_leafLog2 | (y & (g_leafSpan - 1))) << g_leafLog2) | (x & (g_leafSpan - 1));
+							leafMasks[leaf * g_numLeafWords + bit / 64] |= 1ull << (bit % 64);
+							leafValues[leaf].emplace_back(pSrc[i]);
+							if (idBits) leafIDs[leaf].emplace_back(brickIDs[pSrc - brick.data() + i]);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	uint64_t childMask[g_numLowerChildren / 64] = {};
+	for (auto i = 0u; i < g_numLowerChildren; ++i)
+		if (!leafValues[i].empty()) childMask[i / 64] |= 1ull << (i % 64);
+	file.write(reinterpret_cast<const char*>(childMask), sizeof(childMask));
+
+	for (auto i = 0u; i < g_numLowerChildren; ++i)
+	{
+		auto& values = leafValues[i];
+		if (values.empty()) continue;
+
+		file.write(reinterpret_cast<const char*>(&leafMasks[i * g_numLeafWords]), sizeof(uint64_t) * g_numLeafWords);
+		file.write(reinterpret_cast<const char*>(values.data()), sizeof(uint32_t) * values.size());
+		if (idBits) writeIDs(file, leafIDs[i], idBits);
+		m_numExported += values.size();
+		++numLeaves;
+		values.clear();
+		leafIDs[i].clear();
+	}
+
+	return file.good();
+}
@@ -0,0 +1,110 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "VoxelChunkFile.h"
+
+//--------------------------------------------------------------------------------------
+// Level 0 of a grid as cubic bricks, read one at a time, so the exporters stream from a
+// grid in memory or from a chunked file without a dense copy. The bricks on the far
+// sides may extend beyond the grid, where they read as zeros, and their IDs, if any, as
+// VoxelGrid::EmptyID.
+//--------------------------------------------------------------------------------------
+class VoxelBrickSource
+{
+public:
+	virtual ~VoxelBrickSource() {}
+
+	virtual uint32_t GetSize() const = 0;
+	virtual uint32_t GetBrickSize() const = 0;
+	virtual bool IsBrickEmpty(uint32_t x, uint32_t y, uint32_t z) const = 0;
+	virtual bool ReadBrick(uint32_t x, uint32_t y, uint32_t z, uint32_t* pVoxels) const = 0;
+
+	// Of the ID channel, 0 for none. The IDs are as VoxelGrid::GetID.
+	virtual uint8_t GetIDBits() const = 0;
+	virtual bool ReadBrickIDs(uint32_t x, uint32_t y, uint32_t z, uint32_t* pIDs) const = 0;
+
+	uint32_t GetNumBricks() const;	// Per axis
+};
+
+class VoxelGridSource :
+	public VoxelBrickSource
+{
+public:
+	VoxelGridSource(const VoxelGrid& grid, uint32_t brickSize = 32);
+
+	uint32_t GetSize() const;
+	uint32_t GetBrickSize() const;
+	bool IsBrickEmpty(uint32_t x, uint32_t y, uint32_t z) const;
+	bool ReadBrick(uint32_t x, uint32_t y, uint32_t z, uint32_t* pVoxels) const;
+	uint8_t GetIDBits() const;
+	bool ReadBrickIDs(uint32_t x, uint32_t y, uint32_t z, uint32_t* pIDs) const;
+
+protected:
+	const VoxelGrid& m_grid;
+	uint32_t m_brickSize;
+};
+
+// The bricks are the chunks of the file
+class VoxelChunkSource :
+	public VoxelBrickSource
+{
+public:
+	VoxelChunkSource(const VoxelChunkReader& reader);
+
+	uint32_t GetSize() const;
+	uint32_t GetBrickSize() const;
+	bool IsBrickEmpty(uint32_t x, uint32_t y, uint32_t z) const;
+	bool ReadBrick(uint32_t x, uint32_t y, uint32_t z, uint32_t* pVoxels) const;
+	uint8_t GetIDBits() const;
+	bool ReadBrickIDs(uint32_t x, uint32_t y, uint32_t z, uint32_t* pIDs) const;
+
+protected:
+	const VoxelChunkReader& m_reader;
+};
+
+//--------------------------------------------------------------------------------------
+// Exporters of level 0 to the volume formats of other tools, each streaming the bricks
+// of the source, so at most a slab of bricks is resident besides the output buffers
+//--------------------------------------------------------------------------------------
+class VoxelExporter
+{
+public:
+	VoxelExporter();
+	virtual ~VoxelExporter();
+
+	// Dense NRRD volume of the coverage as uint8 (0 to 255), in the voxel order of
+	// VoxelGrid, for quick inspection in ParaView, 3D Slicer, or Fiji. With the bound
+	// (center, radius) of the voxelization, the voxel centers are placed in model space.
+	bool WriteNRRD(const char* fileName, const VoxelBrickSource& source, const float bound[4] = nullptr);
+
+	// MagicaVoxel .vox (version 150) of the occupied voxels, Z up, colored by their
+	// normals from a fixed palette. Grids larger than 256 are split into models of up to
+	// 256^3, placed by a scene graph. The brick size must be at most 256.
+	bool WriteVOX(const char* fileName, const VoxelBrickSource& source);
+
+	// Sparse tree of the non-zero voxels in the configuration of an OpenVDB 5-4-3 tree:
+	// upper nodes of 32^3 lower nodes of 16^3 leaves of 8^3 voxels, with the child and
+	// value masks X-major as in VoxelGrid. Binary layout: "VXTR", uint32_t version (1, or
+	// 2 with IDs), uint32_t size, uint32_t log2 dimensions (3 | 4 << 8 | 5 << 16), uint32_t
+	// numUpper, uint32_t numLower, uint64_t numLeaves, uint64_t numActive, for version 2,
+	// uint32_t idBits, then each upper node as uint32_t origin[3] and uint64_t
+	// childMask[512], followed by its lower nodes in mask order, each as uint64_t
+	// childMask[64] followed by its leaves in mask order, each as uint64_t valueMask[8]
+	// and the values of the active voxels in mask order, and for version 2, their IDs in
+	// the width of idBits, with the empty value of all ones, all little-endian. The brick
+	// size must be a multiple of 8 dividing 128.
+	bool WriteTree(const char* fileName, const VoxelBrickSource& source);
+
+	uint64_t GetNumExported() const;	// Voxels of the last export
+
+protected:
+	bool writeLowerNode(std::ostream& file, const VoxelBrickSource& source, const uint32_t origin[3],
+		std::vector<uint32_t>& brick, std::vector<uint32_t>& brickIDs, std::vector<uint64_t>& leafMasks,
+		std::vector<std::vector<uint32_t>>& leafValues, std::vector<std::vector<uint32_t>>& leafIDs,
+		uint64_t& numLeaves);
+
+	uint64_t m_numExported;
+};
@@ -0,0 +1,437 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "VoxelGrid.h"
+
+#if	defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define	USE_SSE2	1
+#include <emmintrin.h>
+#else
+#define	USE_SSE2	0
+#endif
+
+using namespace std;
+
+namespace
+{
+	const float g_unormScale10 = 1023.0f;
+	const float g_unormScale2 = 3.0f;
+
+	uint32_t floatToUnorm(float x, float scale)
+	{
+		x = (min)((max)(x, 0.0f), 1.0f);
+
+		return static_cast<uint32_t>(x * scale + 0.5f);
+	}
+
+	// Quantize coverage to the 2-bit alpha conservatively, so that any occupancy survives
+	float conservativeCoverage(float coverage)
+	{
+		return ceil(coverage * g_unormScale2) / g_unormScale2;
+	}
+}
+
+const uint32_t VoxelGrid::EmptyID;
+
+VoxelGrid::VoxelGrid() :
+	m_size(0),
+	m_idBits(0)
+{
+}
+
+VoxelGrid::~VoxelGrid()
+{
+}
+
+bool VoxelGrid::Create(uint32_t size, uint8_t numLevels, uint8_t idBits)
+{
+	if (size == 0 || (idBits != 0 && idBits != 16 && idBits != 32)) return false;
+
+	auto maxLevels = 1u;
+	while ((size >> maxLevels) > 0) ++maxLevels;
+	numLevels = numLevels ? static_cast<uint8_t>((min)(static_cast<uint32_t>(numLevels), maxLevels)) :
+		static_cast<uint8_t>(maxLevels);
+
+	m_size = size;
+	m_levels.resize(numLevels);
+	for (uint8_t i = 0; i < numLevels; ++i)
+	{
+		const size_t levelSize = GetSize(i);
+		m_levels[i].assign(levelSize * levelSize * levelSize, 0);
+	}
+
+	// All ones is the empty ID of either width
+	m_idBits = idBits;
+	m_ids.assign((m_levels[0].size() * idBits + 31) / 32, EmptyID);
+
+	return true;
+}
+
+void VoxelGrid::Clear()
+{
+	for (auto& level : m_levels) fill(level.begin(), level.end(), 0u);
+	fill(m_ids.begin(), m_ids.end(), EmptyID);
+}
+
+void VoxelGrid::Clear(const VoxelRegion& region)
+{
+	for (uint8_t i = 0; i < GetNumLevels(); ++i)
+	{
+		const auto levelRegion = GetRegion(region, i);
+		const size_t size = GetSize(i);
+		for (auto z = levelRegion.Min[2]; z < levelRegion.Max[2]; ++z)
+		{
+			for (auto y = levelRegion.Min[1]; y < levelRegion.Max[1]; ++y)
+			{
+				const auto pRow = &m_levels[i][(z * size + y) * size];
+				fill(pRow + levelRegion.Min[0], pRow + levelRegion.Max[0], 0u);
+			}
+		}
+	}
+
+	if (m_idBits == 0) return;
+	for (auto z = region.Min[2]; z < region.Max[2]; ++z)
+		for (auto y = region.Min[1]; y < region.Max[1]; ++y)
+			for (auto x = region.Min[0]; x < region.Max[0]; ++x)
+				SetID(x, y, z, EmptyID);
+}
+
+void VoxelGrid::GenerateMips(uint32_t numThreads)
+{
+	PROFILE_SCOPE("VoxelGrid::GenerateMips");
+
+	for (uint8_t i = 1; i < GetNumLevels(); ++i) reduce(i, numThreads);
+}
+
+uint32_t VoxelGrid::Get(uint32_t x, uint32_t y, uint32_t z, uint8_t level) const
+{
+	const size_t size = GetSize(level);
+
+	return m_levels[level][(z * size + y) * size + x];
+}
+
+void VoxelGrid::Set(uint32_t x, uint32_t y, uint32_t z, uint32_t voxel, uint8_t level)
+{
+	const size_t size = GetSize(level);
+	m_levels[level][(z * size + y) * size + x] = voxel;
+}
+
+bool VoxelGrid::IsOccupied(uint32_t x, uint32_t y, uint32_t z, uint8_t level) const
+{
+	return (Get(x, y, z, level) & CoverageMask) != 0;
+}
+
+uint32_t VoxelGrid::GetID(uint32_t x, uint32_t y, uint32_t z) const
+{
+	const size_t size = m_size;
+	const auto i = (z * size + y) * size + x;
+	if (m_idBits == 32) return m_ids[i];
+	if (m_idBits == 0) return EmptyID;
+
+	const auto id = (m_ids[i >> 1] >> ((i & 1) * 16)) & 0xffff;
+
+	return id == 0xffff ? EmptyID : id;
+}
+
+void VoxelGrid::SetID(uint32_t x, uint32_t y, uint32_t z, uint32_t id)
+{
+	const size_t size = m_size;
+	const auto i = (z * size + y) * size + x;
+	if (m_idBits == 32) m_ids[i] = id;
+	else if (m_idBits == 16)
+	{
+		// Atomic on the word, as the other half may be of a voxel of another thread
+		const auto shift = static_cast<uint32_t>(i & 1) * 16;
+		const auto mask = 0xffffu << shift;
+		auto& dst = reinterpret_cast<atomic<uint32_t>&>(m_ids[i >> 1]);
+		auto prev = dst.load(memory_order_relaxed);
+		while (!dst.compare_exchange_weak(prev, (prev & ~mask) | ((id & 0xffff) << shift), memory_order_relaxed));
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Atomic min on the 32-bit word holding the ID, where a 16-bit ID only replaces its own
+// half, so the neighbor in the same word is preserved under concurrent writes
+//--------------------------------------------------------------------------------------
+void VoxelGrid::WriteID(uint32_t x, uint32_t y, uint32_t z, uint32_t id)
+{
+	if (m_idBits == 0) return;
+
+	const size_t size = m_size;
+	const auto i = (z * size + y) * size + x;
+	const auto wide = m_idBits == 32;
+	const auto shift = wide ? 0 : static_cast<uint32_t>(i & 1) * 16;
+	const auto mask = wide ? 0xffffffffu : 0xffffu << shift;
+	id = wide ? id : (id & 0xffff) << shift;
+
+	auto& dst = reinterpret_cast<atomic<uint32_t>&>(m_ids[wide ? i : i >> 1]);
+	auto prev = dst.load(memory_order_relaxed);
+	while ((prev & mask) > id && !dst.compare_exchange_weak(prev, (prev & ~mask) | id, memory_order_relaxed));
+}
+
+uint8_t VoxelGrid::GetIDBits() const
+{
+	return m_idBits;
+}
+
+uint32_t VoxelGrid::GetSize(uint8_t level) const
+{
+	return (max)(m_size >> level, 1u);
+}
+
+uint8_t VoxelGrid::GetNumLevels() const
+{
+	return static_cast<uint8_t>(m_levels.size());
+}
+
+size_t VoxelGrid::GetNumVoxels(uint8_t level) const
+{
+	return m_levels[level].size();
+}
+
+size_t VoxelGrid::GetNumOccupied(uint8_t level) const
+{
+	return count_if(m_levels[level].cbegin(), m_levels[level].cend(),
+		[](uint32_t voxel) { return (voxel & CoverageMask) != 0; });
+}
+
+VoxelRegion VoxelGrid::GetRegion(const VoxelRegion& region, uint8_t level) const
+{
+	const auto size = GetSize(level);
+	VoxelRegion levelRegion;
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		if (region.Max[i] > region.Min[i])
+		{
+			levelRegion.Min[i] = GetCoord(region.Min[i], level);
+			levelRegion.Max[i] = GetCoord(region.Max[i] - 1, level) + 1;
+		}
+		else levelRegion.Min[i] = levelRegion.Max[i] = (min)(region.Min[i] >> level, size);
+	}
+
+	return levelRegion;
+}
+
+uint32_t VoxelGrid::GetCoord(uint32_t coord, uint8_t level) const
+{
+	return (min)(coord >> level, GetSize(level) - 1);
+}
+
+void VoxelGrid::GetChildRange(uint32_t coord, uint32_t size, uint32_t srcSize, uint32_t& lo, uint32_t& hi)
+{
+	lo = coord * 2;
+	hi = coord + 1 < size ? lo + 2 : srcSize;
+}
+
+uint32_t* VoxelGrid::GetData(uint8_t level)
+{
+	return m_levels[level].data();
+}
+
+const uint32_t* VoxelGrid::GetData(uint8_t level) const
+{
+	return m_levels[level].data();
+}
+
+bool VoxelGrid::WriteRaw(const char* fileName) const
+{
+	ofstream file(fileName, ios::binary);
+	if (!file) return false;
+
+	const uint32_t header[] = { 0x52475856, m_idBits ? 2u : 1u, m_size, GetNumLevels() };
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+	for (const auto& level : m_levels)
+		file.write(reinterpret_cast<const char*>(level.data()), sizeof(uint32_t) * level.size());
+
+	// The pairs of 16-bit IDs are in order in the words on little-endian hosts
+	if (m_idBits)
+	{
+		const uint32_t idBits = m_idBits;
+		file.write(reinterpret_cast<const char*>(&idBits), sizeof(idBits));
+		file.write(reinterpret_cast<const char*>(m_ids.data()), m_levels[0].size() * m_idBits / 8);
+	}
+
+	return file.good();
+}
+
+uint32_t VoxelGrid::Pack(float nx, float ny, float nz, float coverage)
+{
+	return floatToUnorm(nx * 0.5f + 0.5f, g_unormScale10) |
+		(floatToUnorm(ny * 0.5f + 0.5f, g_unormScale10) << 10) |
+		(floatToUnorm(nz * 0.5f + 0.5f, g_unormScale10) << 20) |
+		(floatToUnorm(coverage, g_unormScale2) << 30);
+}
+
+void VoxelGrid::Unpack(uint32_t voxel, float& nx, float& ny, float& nz, float& coverage)
+{
+	nx = (voxel & 0x3ff) * (2.0f / g_unormScale10) - 1.0f;
+	ny = ((voxel >> 10) & 0x3ff) * (2.0f / g_unormScale10) - 1.0f;
+	nz = ((voxel >> 20) & 0x3ff) * (2.0f / g_unormScale10) - 1.0f;
+	coverage = (voxel >> 30) * (1.0f / g_unormScale2);
+}
+
+void VoxelGrid::reduce(uint8_t level, uint32_t numThreads)
+{
+	const auto size = GetSize(level);
+	const auto numRows = size * size;
+
+	ParallelFor(0, numRows, [&](uint32_t row)
+	{
+		const auto y = row % size;
+		const auto z = row / size;
+#if	USE_SSE2
+		if (GetSize(level - 1) % 8 == 0) reduceRowSSE(level, y, z);
+		else
+#endif
+		reduceRow(level, y, z);
+	}, numThreads);
+}
+
+//--------------------------------------------------------------------------------------
+// Coverage-weighted average of the normals and average of the coverages of the 2x2x2
+// children, and on the far sides of an odd level, of the 3 children along the axis. The
+// children without a normal, e.g. the interior written by FillSolid(), count in the
+// coverage but not in the normal, and a parent with no normal left keeps all zero normal
+// bits as well. The summation order matches reduceRowSSE, so both paths are bit-exact.
+//--------------------------------------------------------------------------------------
+void VoxelGrid::reduceRow(uint8_t level, uint32_t y, uint32_t z)
+{
+	const auto size = GetSize(level);
+	const auto srcSize = GetSize(level - 1);
+	const auto pSrc = GetData(level - 1);
+	const auto pDst = GetData(level);
+
+	uint32_t lo[3], hi[3];
+	GetChildRange(y, size, srcSize, lo[1], hi[1]);
+	GetChildRange(z, size, srcSize, lo[2], hi[2]);
+	for (auto x = 0u; x < size; ++x)
+	{
+		GetChildRange(x, size, srcSize, lo[0], hi[0]);
+
+		float sums[2][4] = {};
+		for (size_t sz = lo[2]; sz < hi[2]; ++sz)
+		{
+			for (size_t sy = lo[1]; sy < hi[1]; ++sy)
+			{
+				for (auto sx = lo[0]; sx < hi[0]; ++sx)
+				{
+					const auto j = (sx - lo[0]) & 1;
+					const auto voxel = pSrc[(sz * srcSize + sy) * srcSize + sx];
+					float n[3], w;
+					Unpack(voxel, n[0], n[1], n[2], w);
+					const auto nw = voxel & ~CoverageMask ? w : 0.0f;
+					sums[j][0] += n[0] * nw;
+					sums[j][1] += n[1] * nw;
+					sums[j][2] += n[2] * nw;
+					sums[j][3] += w;
+				}
+			}
+		}
+
+		const float sum[] = { sums[0][0] + sums[1][0], sums[0][1] + sums[1][1],
+			sums[0][2] + sums[1][2], sums[0][3] + sums[1][3] };
+		const auto coverage = sum[3] / static_cast<float>((hi[0] - lo[0]) * (hi[1] - lo[1]) * (hi[2] - lo[2]));
+		const auto len = sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+		const auto rcpLen = len > 0.0f ? 1.0f / len : 0.0f;
+
+		auto voxel = coverage > 0.0f ?
+			Pack(sum[0] * rcpLen, sum[1] * rcpLen, sum[2] * rcpLen, conservativeCoverage(coverage)) : 0;
+		if (len <= 0.0f) voxel &= CoverageMask;
+		pDst[(static_cast<size_t>(z) * size + y) * size + x] = voxel;
+	}
+}
+
+#if	USE_SSE2
+//--------------------------------------------------------------------------------------
+// SSE2 reduction of 4 parents at a time: the 8 children along X of each of the
+// 4 child rows are decoded into 2 vectors, accumulated, and then pairwise added. The
+// normals of the children with all zero normal bits are masked out of the sums.
+//--------------------------------------------------------------------------------------
+void VoxelGrid::reduceRowSSE(uint8_t level, uint32_t y, uint32_t z)
+{
+	const auto size = GetSize(level);
+	const size_t srcSize = GetSize(level - 1);
+	const auto pSrc = GetData(level - 1);
+	const auto pDst = GetData(level) + (static_cast<size_t>(z) * size + y) * size;
+
+	const auto mask10 = _mm_set1_epi32(0x3ff);
+	const auto normalMask = _mm_set1_epi32(static_cast<int>(~CoverageMask));
+	const auto normScale = _mm_set1_ps(2.0f / g_unormScale10);
+	const auto coverageScale = _mm_set1_ps(1.0f / g_unormScale2);
+	const auto one = _mm_set1_ps(1.0f);
+	const auto half = _mm_set1_ps(0.5f);
+	const auto zero = _mm_setzero_ps();
+
+	const uint32_t* pRows[4];
+	for (uint8_t i = 0; i < 4; ++i)
+		pRows[i] = pSrc + ((z * 2 + (i >> 1)) * srcSize + y * 2 + (i & 1)) * srcSize;
+
+	for (auto x = 0u; x < size; x += 4)
+	{
+		__m128 sums[2][4] = { { zero, zero, zero, zero }, { zero, zero, zero, zero } };
+		for (uint8_t i = 0; i < 4; ++i)
+		{
+			for (uint8_t j = 0; j < 2; ++j)
+			{
+				const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRows[i] + x * 2 + j * 4));
+				const auto w = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(v, 30)), coverageScale);
+				const auto noNormal = _mm_cmpeq_epi32(_mm_and_si128(v, normalMask), _mm_setzero_si128());
+				const auto nw = _mm_andnot_ps(_mm_castsi128_ps(noNormal), w);
+				for (uint8_t k = 0; k < 3; ++k)
+				{
+					const auto c = _mm_and_si128(_mm_srli_epi32(v, 10 * k), mask10);
+					const auto n = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(c), normScale), one);
+					sums[j][k] = _mm_add_ps(sums[j][k], _mm_mul_ps(n, nw));
+				}
+				sums[j][3] = _mm_add_ps(sums[j][3], w);
+			}
+		}
+
+		// Pairwise add the even and odd children
+		__m128 sum[4];
+		for (uint8_t k = 0; k < 4; ++k)
+		{
+			const auto even = _mm_shuffle_ps(sums[0][k], sums[1][k], _MM_SHUFFLE(2, 0, 2, 0));
+			const auto odd = _mm_shuffle_ps(sums[0][k], sums[1][k], _MM_SHUFFLE(3, 1, 3, 1));
+			sum[k] = _mm_add_ps(even, odd);
+		}
+
+		// Normalize
+		const auto coverage = _mm_div_ps(sum[3], _mm_set1_ps(8.0f));
+		const auto lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(sum[0], sum[0]), _mm_mul_ps(sum[1], sum[1])),
+			_mm_mul_ps(sum[2], sum[2]));
+		const auto len = _mm_sqrt_ps(lenSq);
+		const auto hasLen = _mm_cmpgt_ps(len, zero);
+		const auto rcpLen = _mm_and_ps(_mm_div_ps(one, _mm_or_ps(len, _mm_andnot_ps(hasLen, one))), hasLen);
+
+		// Pack with the same rounding as VoxelGrid::Pack()
+		auto packed = _mm_setzero_si128();
+		for (uint8_t k = 0; k < 3; ++k)
+		{
+			auto c = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sum[k], rcpLen), half), half);
+			c = _mm_min_ps(_mm_max_ps(c, zero), one);
+			c = _mm_add_ps(_mm_mul_ps(c, _mm_set1_ps(g_unormScale10)), half);
+			packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_cvttps_epi32(c), 10 * k));
+		}
+		packed = _mm_and_si128(packed, _mm_castps_si128(hasLen));
+
+		alignas(16) float coverages[4];
+		_mm_store_ps(coverages, coverage);
+		alignas(16) uint32_t alphas[4];
+		for (uint8_t k = 0; k < 4; ++k)
+			alphas[k] = floatToUnorm(conservativeCoverage(coverages[k]), g_unormScale2) << 30;
+		packed = _mm_or_si128(packed, _mm_load_si128(reinterpret_cast<const __m128i*>(alphas)));
+
+		// Empty parents are all zeros
+		const auto occupied = _mm_castps_si128(_mm_cmpgt_ps(coverage, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + x), _mm_and_si128(packed, occupied));
+	}
+}
+#endif
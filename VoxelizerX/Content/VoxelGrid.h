@@ -0,0 +1,100 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//--------------------------------------------------------------------------------------
+// Box of voxels [Min, Max) of level 0
+//--------------------------------------------------------------------------------------
+struct VoxelRegion
+{
+	uint32_t Min[3];
+	uint32_t Max[3];
+};
+
+//--------------------------------------------------------------------------------------
+// CPU-side voxel grid in the same layout as the GPU grid: each voxel is a packed
+// R10G10B10A2_UNORM value with the normal in RGB (n * 0.5 + 0.5) and the occupancy
+// coverage in A. Voxels are stored X-major, then Y, then Z, per MIP level. Each level
+// is half the size of the finer one, rounded down, so on a level of an odd size, the
+// last voxel along each axis also covers the remaining voxel of the finer level.
+// An optional ID channel of 16 or 32 bits per voxel of level 0 records the object or
+// material each voxel came from. Writers keep the lowest ID by an atomic min, so the
+// result does not depend on the order of the writes, and EmptyID marks no writer.
+//--------------------------------------------------------------------------------------
+class VoxelGrid
+{
+public:
+	VoxelGrid();
+	virtual ~VoxelGrid();
+
+	// Create a cubic grid, where numLevels can be 0 for full MIP chain, and idBits is 0 for
+	// no ID channel, or 16 or 32
+	bool Create(uint32_t size, uint8_t numLevels = 1, uint8_t idBits = 0);
+	void Clear();
+
+	// Clear the voxels of the region, and those of every coarser level that cover it
+	void Clear(const VoxelRegion& region);
+
+	// Build all the coarser levels from level 0 by 2x2x2 reductions
+	void GenerateMips(uint32_t numThreads = 0);
+
+	uint32_t Get(uint32_t x, uint32_t y, uint32_t z, uint8_t level = 0) const;
+	void Set(uint32_t x, uint32_t y, uint32_t z, uint32_t voxel, uint8_t level = 0);
+	bool IsOccupied(uint32_t x, uint32_t y, uint32_t z, uint8_t level = 0) const;
+
+	// IDs of level 0, which must be below the empty value of the channel width, i.e.
+	// 0xffff for 16 bits. WriteID keeps the min with the current ID. Both writes are
+	// thread-safe for distinct voxels, and WriteID also for the same voxel.
+	uint32_t GetID(uint32_t x, uint32_t y, uint32_t z) const;
+	void SetID(uint32_t x, uint32_t y, uint32_t z, uint32_t id);
+	void WriteID(uint32_t x, uint32_t y, uint32_t z, uint32_t id);
+	uint8_t GetIDBits() const;
+
+	uint32_t GetSize(uint8_t level = 0) const;
+	uint8_t GetNumLevels() const;
+	size_t GetNumVoxels(uint8_t level = 0) const;
+	size_t GetNumOccupied(uint8_t level = 0) const;
+
+	// Region of the voxels of the level covering the given region of level 0
+	VoxelRegion GetRegion(const VoxelRegion& region, uint8_t level) const;
+
+	// Coordinate on the level of the voxel covering a coordinate of level 0
+	uint32_t GetCoord(uint32_t coord, uint8_t level) const;
+
+	// Children [lo, hi) along an axis of a voxel of a level of the given size from its
+	// finer level of srcSize, i.e. 2, or 3 for the last voxel when srcSize is odd
+	static void GetChildRange(uint32_t coord, uint32_t size, uint32_t srcSize, uint32_t& lo, uint32_t& hi);
+
+	uint32_t* GetData(uint8_t level = 0);
+	const uint32_t* GetData(uint8_t level = 0) const;
+
+	// Binary layout: "VXGR", uint32_t version (1, or 2 with IDs), uint32_t size, uint32_t
+	// numLevels, then the voxels of each level from the finest, and for version 2, uint32_t
+	// idBits and the IDs of level 0 in that width, with the empty value of all ones, all
+	// little-endian
+	bool WriteRaw(const char* fileName) const;
+
+	static uint32_t Pack(float nx, float ny, float nz, float coverage = 1.0f);
+	static void Unpack(uint32_t voxel, float& nx, float& ny, float& nz, float& coverage);
+
+	static const uint32_t CoverageMask = 0xc0000000;
+	static const uint32_t EmptyID = 0xffffffff;
+
+protected:
+	void reduce(uint8_t level, uint32_t numThreads);
+	void reduceRow(uint8_t level, uint32_t y, uint32_t z);
+#if	defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+	void reduceRowSSE(uint8_t level, uint32_t y, uint32_t z);
+#endif
+
+	std::vector<std::vector<uint32_t>> m_levels;
+	std::vector<uint32_t> m_ids;	// Packed in pairs for 16 bits
+	uint32_t m_size;
+	uint8_t m_idBits;
+};
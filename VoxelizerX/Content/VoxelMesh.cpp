@@ -0,0 +1,65 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <fstream>
+#include "VoxelMesh.h"
+
+using namespace std;
+
+VoxelMesh::VoxelMesh()
+{
+}
+
+VoxelMesh::~VoxelMesh()
+{
+}
+
+const vector<VoxelMesh::Vertex>& VoxelMesh::GetVertices() const
+{
+	return m_vertices;
+}
+
+const vector<uint32_t>& VoxelMesh::GetIndices() const
+{
+	return m_indices;
+}
+
+bool VoxelMesh::WriteOBJ(const char* fileName) const
+{
+	ofstream file(fileName);
+	if (!file) return false;
+
+	file << "# Voxel mesh: " << m_vertices.size() << " vertices, " << m_indices.size() / 3 << " triangles\n";
+	for (const auto& v : m_vertices) file << "v " << v.Pos[0] << ' ' << v.Pos[1] << ' ' << v.Pos[2] << '\n';
+	for (const auto& v : m_vertices) file << "vn " << v.Nrm[0] << ' ' << v.Nrm[1] << ' ' << v.Nrm[2] << '\n';
+	for (size_t i = 0; i + 2 < m_indices.size(); i += 3)
+	{
+		file << 'f';
+		for (uint8_t j = 0; j < 3; ++j) file << ' ' << m_indices[i + j] + 1 << "//" << m_indices[i + j] + 1;
+		file << '\n';
+	}
+
+	return file.good();
+}
+
+bool VoxelMesh::WriteBinary(const char* fileName) const
+{
+	ofstream file(fileName, ios::binary);
+	if (!file) return false;
+
+	const uint32_t header[] = { 0x424d5856, 1, static_cast<uint32_t>(m_vertices.size()), static_cast<uint32_t>(m_indices.size()) };
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(m_vertices.data()), sizeof(Vertex) * m_vertices.size());
+	file.write(reinterpret_cast<const char*>(m_indices.data()), sizeof(uint32_t) * m_indices.size());
+
+	return file.good();
+}
+
+void VoxelMesh::toModelSpace(float pos[3], const float p[3], uint32_t size, const float bound[4])
+{
+	const auto scale = 2.0f / size;
+	pos[0] = bound[0] + bound[3] * (p[0] * scale - 1.0f);
+	pos[1] = bound[1] + bound[3] * (1.0f - p[1] * scale);
+	pos[2] = bound[2] + bound[3] * (p[2] * scale - 1.0f);
+}
@@ -0,0 +1,55 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "VoxelGrid.h"
+
+//--------------------------------------------------------------------------------------
+// Counters of the meshing, where faces are the exposed voxel faces before merging for
+// the greedy mesher, or the cells crossed by the isosurface for marching cubes
+//--------------------------------------------------------------------------------------
+struct MeshStats
+{
+	uint64_t NumFaces;
+	uint64_t NumQuads;
+	uint64_t NumVertices;
+	uint64_t NumTriangles;
+	double MeshingTime;	// In milliseconds
+};
+
+//--------------------------------------------------------------------------------------
+// Indexed triangle mesh extracted from a voxel grid, in the space of the voxelized model
+// given the bound (center, radius) used for voxelization, with the same vertex layout as
+// the ObjLoader (float3 position followed by float3 normal), and counter-clockwise
+// triangles seen from outside.
+//--------------------------------------------------------------------------------------
+class VoxelMesh
+{
+public:
+	struct Vertex
+	{
+		float Pos[3];
+		float Nrm[3];
+	};
+
+	VoxelMesh();
+	virtual ~VoxelMesh();
+
+	const std::vector<Vertex>& GetVertices() const;
+	const std::vector<uint32_t>& GetIndices() const;
+
+	bool WriteOBJ(const char* fileName) const;
+
+	// Binary layout: "VXMB", uint32_t version (1), uint32_t numVertices, uint32_t numIndices,
+	// then the vertices and the indices, all little-endian
+	bool WriteBinary(const char* fileName) const;
+
+protected:
+	// Model-space position of the point p in voxels, where the grid Y is flipped
+	static void toModelSpace(float pos[3], const float p[3], uint32_t size, const float bound[4]);
+
+	std::vector<Vertex> m_vertices;
+	std::vector<uint32_t> m_indices;
+};
@@ -3,12 +3,15 @@
 //--------------------------------------------------------------------------------------
 
 #include "Optional/XUSGObjLoader.h"
+#include "CPUVoxelizer.h"
 #include "Voxelizer.h"
 
 using namespace std;
 using namespace DirectX;
 using namespace XUSG;
 
+static_assert(!USE_BOX_LIST || GRID_SIZE <= 512, "Box faces pack 9 bits per coordinate");
+
 struct CBMatrices
 {
 	DirectX::XMMATRIX worldViewProj;
@@ -21,14 +24,34 @@ struct CBPerFrame
 	DirectX::XMFLOAT4 eyePos;
 };
 
+struct CBPerMipLevel
+{
+	float gridSize;
+	float mipLevel;
+	float numLevels;
+	uint32_t objectID;
+};
+
 struct CBPerObject
 {
 	DirectX::XMVECTOR localSpaceLightPt;
 	DirectX::XMVECTOR localSpaceEyePt;
 	DirectX::XMMATRIX screenToLocal;
+	float mipLevel;
 };
 
-Voxelizer::Voxelizer()
+Voxelizer::Voxelizer() :
+	m_showMip(SHOW_MIP),
+	m_objectID(NoObjectID),
+	m_gridKey(UINT32_MAX),
+	m_compactedMip(UINT8_MAX),
+	m_lightTransMip(UINT8_MAX),
+	m_alwaysVoxelize(false),
+	m_voteFill(false),
+	m_pVertexUploads(nullptr),
+	m_vertexStride(0),
+	m_pendingUpload(FrameCount),
+	m_pProfiler(nullptr)
 {
 	m_shaderLib = ShaderLib::MakeUnique();
 }
@@ -39,7 +62,7 @@ Voxelizer::~Voxelizer()
 
 bool Voxelizer::Init(CommandList* pCommandList, const DescriptorTableLib::sptr& descriptorTableLib,
 	uint32_t width, uint32_t height, Format rtFormat, Format dsFormat, vector<Resource::uptr>& uploaders,
-	const char* fileName, const XMFLOAT4& posScale)
+	const char* fileName, const XMFLOAT4& posScale, bool dynamicMesh, uint32_t objectID, bool voteFill)
 {
 	const auto pDevice = pCommandList->GetDevice();
 	m_graphicsPipelineLib = Graphics::PipelineLib::MakeUnique(pDevice);
@@ -50,6 +73,8 @@ bool Voxelizer::Init(CommandList* pCommandList, const DescriptorTableLib::sptr&
 	m_viewport.x = static_cast<float>(width);
 	m_viewport.y = static_cast<float>(height);
 	m_posScale = posScale;
+	m_objectID = objectID;
+	m_voteFill = voteFill && !USE_MUTEX;
 
 	// Create shaders
 	XUSG_N_RETURN(createShaders(), false);
@@ -61,43 +86,74 @@ bool Voxelizer::Init(CommandList* pCommandList, const DescriptorTableLib::sptr&
 	XUSG_N_RETURN(createInputLayout(), false);
 	XUSG_N_RETURN(createVB(pCommandList, objLoader.GetNumVertices(), objLoader.GetVertexStride(), objLoader.GetVertices(), uploaders), false);
 	XUSG_N_RETURN(createIB(pCommandList, objLoader.GetNumIndices(), objLoader.GetIndices(), uploaders), false);
+	if (dynamicMesh) XUSG_N_RETURN(createVertexUploads(pDevice, objLoader.GetNumVertices(),
+		objLoader.GetVertexStride(), objLoader.GetVertices()), false);
 
 	// Extract boundary
 	const auto& aabb = objLoader.GetAABB();
-	const XMFLOAT3 ext(aabb.Max.x - aabb.Min.x, aabb.Max.y - aabb.Min.y, aabb.Max.z - aabb.Min.z);
-	m_bound.x = (aabb.Max.x + aabb.Min.x) / 2.0f;
-	m_bound.y = (aabb.Max.y + aabb.Min.y) / 2.0f;
-	m_bound.z = (aabb.Max.z + aabb.Min.z) / 2.0f;
-	m_bound.w = (max)(ext.x, (max)(ext.y, ext.z)) / 2.0f;
-
-	m_numLevels = max(static_cast<uint32_t>(log2(GRID_SIZE)), 1);
+	const float lo[] = { aabb.Min.x, aabb.Min.y, aabb.Min.z };
+	const float hi[] = { aabb.Max.x, aabb.Max.y, aabb.Max.z };
+	float bound[4];
+	CPUVoxelizer::GetBound(bound, lo, hi);
+	m_bound = XMFLOAT4(bound);
+
+	// Full MIP chain down to the 1x1x1 level
+	m_numLevels = static_cast<uint32_t>(log2(GRID_SIZE)) + 1;
+	assert(m_numLevels <= MAX_NUM_LEVELS);
 	XUSG_N_RETURN(createCBs(pCommandList, uploaders), false);
 
 #if	USE_MUTEX
 	for (auto& grid : m_grid)
 	{
 		grid = Texture3D::MakeUnique();
-		XUSG_N_RETURN(grid->Create(m_device.get(), GRID_SIZE, GRID_SIZE, GRID_SIZE,
+		XUSG_N_RETURN(grid->Create(pDevice, GRID_SIZE, GRID_SIZE, GRID_SIZE,
 			Format::R32_FLOAT, ResourceFlag::ALLOW_UNORDERED_ACCESS), false);
 	}
 
 	m_mutex = Texture3D::MakeUnique();
-	XUSG_N_RETURN(m_mutex->Create(m_device.get(), GRID_SIZE, GRID_SIZE, GRID_SIZE,
+	XUSG_N_RETURN(m_mutex->Create(pDevice, GRID_SIZE, GRID_SIZE, GRID_SIZE,
 		Format::R32_UINT, ResourceFlag::ALLOW_UNORDERED_ACCESS), false);
 #else
 	const auto uavFormat = Format::R32_UINT;
 	m_grid = Texture3D::MakeUnique();
 	XUSG_N_RETURN(m_grid->Create(pDevice, GRID_SIZE, GRID_SIZE, GRID_SIZE, Format::R10G10B10A2_UNORM,
-		ResourceFlag::ALLOW_UNORDERED_ACCESS, 1, MemoryFlag::NONE, L"Grid", XUSG_DEFAULT_SRV_COMPONENT_MAPPING,
+		ResourceFlag::ALLOW_UNORDERED_ACCESS, static_cast<uint8_t>(m_numLevels), MemoryFlag::NONE, L"Grid", XUSG_DEFAULT_SRV_COMPONENT_MAPPING,
 		TextureLayout::UNKNOWN, 1, &uavFormat), false);
+
+	// Object IDs of level 0, where the lowest ID wins
+	if (objectID != NoObjectID)
+	{
+		m_objectIDs = Texture3D::MakeUnique();
+		XUSG_N_RETURN(m_objectIDs->Create(pDevice, GRID_SIZE, GRID_SIZE, GRID_SIZE, Format::R32_UINT,
+			ResourceFlag::ALLOW_UNORDERED_ACCESS, 1, MemoryFlag::NONE, L"ObjectIDs"), false);
+	}
 #endif
 
+	// K-buffer layers of Z columns, and of X and Y columns for multi-axis voting only
 	m_KBufferDepth = Texture2D::MakeUnique();
-	XUSG_N_RETURN(m_KBufferDepth->Create(pDevice, GRID_SIZE, GRID_SIZE, Format::R32_UINT, static_cast<uint32_t>(GRID_SIZE * DEPTH_SCALE),
+	XUSG_N_RETURN(m_KBufferDepth->Create(pDevice, GRID_SIZE, GRID_SIZE, Format::R32_UINT,
+		static_cast<uint32_t>(GRID_SIZE * DEPTH_SCALE) * (m_voteFill ? 3 : 1),
 		ResourceFlag::ALLOW_UNORDERED_ACCESS | ResourceFlag::ALLOW_SIMULTANEOUS_ACCESS), false);
 
+	// Chebyshev distances to the nearest occupied voxels for empty-space skipping
+	for (auto& emptyDist : m_emptyDist)
+	{
+		emptyDist = Texture3D::MakeUnique();
+		XUSG_N_RETURN(emptyDist->Create(pDevice, GRID_SIZE, GRID_SIZE, GRID_SIZE, Format::R8_UINT,
+			ResourceFlag::ALLOW_UNORDERED_ACCESS, 1, MemoryFlag::NONE, L"EmptyDistance"), false);
+	}
+
+	// Transmittance toward the directional light
+	m_lightTrans = Texture3D::MakeUnique();
+	XUSG_N_RETURN(m_lightTrans->Create(pDevice, GRID_SIZE, GRID_SIZE, GRID_SIZE, Format::R32_FLOAT,
+		ResourceFlag::ALLOW_UNORDERED_ACCESS, 1, MemoryFlag::NONE, L"LightTransmittance"), false);
+
+	// Exposed faces of the occupied voxels for the indirect box drawing
+	if (USE_BOX_LIST) XUSG_N_RETURN(createBoxList(pCommandList, uploaders), false);
+
 	// Prepare for rendering
 	XUSG_N_RETURN(prevoxelize(), false);
+	XUSG_N_RETURN(pregenerateMips(), false);
 	XUSG_N_RETURN(prerenderBoxArray(rtFormat, dsFormat), false);
 	XUSG_N_RETURN(prerayCast(rtFormat, dsFormat), false);
 
@@ -135,26 +191,152 @@ void Voxelizer::UpdateFrame(uint8_t frameIndex, CXMVECTOR eyePt, CXMMATRIX viewP
 	const auto screenToLocal = XMMatrixInverse(nullptr, localToScreen);
 	pCbPerObject->screenToLocal = XMMatrixTranspose(screenToLocal);
 
+	// Select the finest MIP level whose voxels are no smaller than a pixel at the grid center
+	const auto centerPt = XMVector3TransformCoord(XMVectorZero(), localToScreen);
+	const auto pixelPt = XMVector3TransformCoord(centerPt + XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), screenToLocal);
+	const auto pixelSize = XMVectorGetX(XMVector3Length(pixelPt));
+	const auto lod = floor(log2(pixelSize * GRID_SIZE / 2.0f));
+#if	USE_MUTEX
+	m_showMip = 0;	// The grids have no coarser levels
+#else
+	m_showMip = static_cast<uint8_t>((min)((max)(lod, static_cast<float>(SHOW_MIP)), m_numLevels - 1.0f));
+#endif
+	pCbPerObject->mipLevel = m_showMip;
+
 	// Per-frame data
 	const auto pCbPerFrame = reinterpret_cast<CBPerFrame*>(m_cbPerFrame->Map(frameIndex));
 	XMStoreFloat4(&pCbPerFrame->eyePos, eyePt);
 }
 
 void Voxelizer::Render(CommandList* pCommandList, bool solid, Method voxMethod,
-	uint8_t frameIndex, const Descriptor& rtv, const Descriptor& dsv)
+	uint8_t frameIndex, const Descriptor& rtv, const Descriptor& dsv, FillMethod fillMethod,
+	MipMethod mipMethod)
 {
+	// The grid is in the object space of the mesh, which is static, so moving the model
+	// only changes the matrices of the rendering. The grid, and everything derived from
+	// it, is only rebuilt when invalidated or when the settings of voxelization change.
+	if (!m_voteFill) fillMethod = FILL_PARITY_Z;
+	const auto gridKey = static_cast<uint32_t>(solid) | (voxMethod << 1) | ((solid ? fillMethod : mipMethod) << 8);
+	const auto dirty = m_alwaysVoxelize || gridKey != m_gridKey;
+	m_gridKey = gridKey;
+
+	if (m_pendingUpload < FrameCount) copyVertices(pCommandList);
+
 	if (solid)
 	{
-		voxelizeSolid(pCommandList, voxMethod);
+		if (dirty)
+		{
+			voxelizeSolid(pCommandList, voxMethod, fillMethod);
+			{
+				GPUProfileScope scope(m_pProfiler, pCommandList, "GenerateMips");
+				generateMips(pCommandList, USE_EMPTY_SKIP || USE_LIGHT_VOLUME ?
+					ResourceState::ALL_SHADER_RESOURCE : ResourceState::PIXEL_SHADER_RESOURCE);
+			}
+			if (USE_EMPTY_SKIP)
+			{
+				GPUProfileScope scope(m_pProfiler, pCommandList, "EmptyDist");
+				computeEmptyDist(pCommandList);
+			}
+		}
+
+		// The light volume samples the displayed MIP level, which follows the camera
+		if (USE_LIGHT_VOLUME && (dirty || m_lightTransMip != m_showMip))
+		{
+			GPUProfileScope scope(m_pProfiler, pCommandList, "LightTrans");
+			computeLightTrans(pCommandList, frameIndex);
+			m_lightTransMip = m_showMip;
+		}
+		GPUProfileScope scope(m_pProfiler, pCommandList, "RayCast");
 		renderRayCast(pCommandList, frameIndex, rtv, dsv);
 	}
 	else
 	{
-		voxelize(pCommandList, voxMethod, frameIndex);
+		if (dirty)
+		{
+			const auto multiRes = mipMethod == MIP_MULTI_RES;
+			voxelize(pCommandList, voxMethod, false, 0, FILL_PARITY_Z, multiRes);
+			if (!multiRes)
+			{
+				GPUProfileScope scope(m_pProfiler, pCommandList, "GenerateMips");
+				generateMips(pCommandList, ResourceState::NON_PIXEL_SHADER_RESOURCE);
+			}
+		}
+
+		// The box list also depends on the displayed MIP level, which follows the camera
+		if (USE_BOX_LIST && (dirty || m_compactedMip != m_showMip))
+		{
+			GPUProfileScope scope(m_pProfiler, pCommandList, "CompactBoxes");
+			compactBoxes(pCommandList);
+			m_compactedMip = m_showMip;
+		}
+		GPUProfileScope scope(m_pProfiler, pCommandList, "DrawBoxes");
 		renderBoxArray(pCommandList, frameIndex, rtv, dsv);
 	}
 }
 
+void Voxelizer::SetProfiler(GPUProfiler* pProfiler)
+{
+	m_pProfiler = pProfiler;
+}
+
+void Voxelizer::Invalidate()
+{
+	m_gridKey = UINT32_MAX;
+}
+
+void Voxelizer::SetAlwaysVoxelize(bool always)
+{
+	m_alwaysVoxelize = always;
+}
+
+bool Voxelizer::UpdateVertices(uint8_t frameIndex, const uint8_t* pVertices)
+{
+	if (!m_pVertexUploads) return false;
+
+	// Only the positions and the normals are voxelized
+	const auto numVertices = m_vertices.size() / m_vertexStride;
+	auto changed = false;
+	for (size_t i = 0; i < numVertices && !changed; ++i)
+	{
+		const auto offset = m_vertexStride * i;
+		changed = memcmp(&pVertices[offset], &m_vertices[offset], sizeof(float[6])) != 0;
+	}
+	if (!changed) return true;
+
+	// The frame index has been waited for, so its range of the ring is free to write
+	memcpy(m_vertices.data(), pVertices, m_vertices.size());
+	memcpy(&m_pVertexUploads[m_vertices.size() * frameIndex], pVertices, m_vertices.size());
+	m_pendingUpload = frameIndex;
+	Invalidate();
+
+	return true;
+}
+
+const vector<uint8_t>& Voxelizer::GetVertices() const
+{
+	return m_vertices;
+}
+
+uint32_t Voxelizer::GetVertexStride() const
+{
+	return m_vertexStride;
+}
+
+const Texture3D* Voxelizer::GetObjectIDs() const
+{
+	return m_objectIDs.get();
+}
+
+bool Voxelizer::ReadBackGrid(CommandList* pCommandList, Buffer* pReadBuffer, uint32_t* pRowPitch)
+{
+#if	USE_MUTEX
+	return false;
+#else
+	// The grid is returned to its state, so the rendering can go on without rebuilding it
+	return m_grid->ReadBack(pCommandList, pReadBuffer, pRowPitch, 1, 0, 0, m_grid->GetResourceState());
+#endif
+}
+
 bool Voxelizer::createShaders()
 {
 	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::VS, VS_TRI_PROJ, L"VSTriProj.cso"), false);
@@ -170,10 +352,23 @@ bool Voxelizer::createShaders()
 	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::PS, PS_TRI_PROJ_SOLID, L"PSTriProjSolid.cso"), false);
 	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::PS, PS_TRI_PROJ_UNION, L"PSTriProjUnion.cso"), false);
 	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::PS, PS_TRI_PROJ_UNION_SOLID, L"PSTriProjUnionSolid.cso"), false);
+	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::PS, PS_TRI_PROJ_SOLID_VOTE, L"PSTriProjSolidVote.cso"), false);
+	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::PS, PS_TRI_PROJ_UNION_SOLID_VOTE, L"PSTriProjUnionSolidVote.cso"), false);
+	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::PS, PS_TRI_PROJ_MULTI_RES, L"PSTriProjMultiRes.cso"), false);
+	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::PS, PS_TRI_PROJ_UNION_MULTI_RES, L"PSTriProjUnionMultiRes.cso"), false);
+	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::PS, PS_TRI_PROJ_OBJECT_ID, L"PSTriProjObjectID.cso"), false);
+	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::PS, PS_TRI_PROJ_UNION_OBJECT_ID, L"PSTriProjUnionObjectID.cso"), false);
 	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::PS, PS_SIMPLE, L"PSSimple.cso"), false);
 	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::PS, PS_RAY_CAST, L"PSRayCast.cso"), false);
 
 	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::CS, CS_FILL_SOLID, L"CSFillSolid.cso"), false);
+	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::CS, CS_FILL_SOLID_VOTE, L"CSFillSolidVote.cso"), false);
+	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::CS, CS_GEN_MIPS, L"CSGenMips.cso"), false);
+	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::CS, CS_EMPTY_DIST_X, L"CSEmptyDistX.cso"), false);
+	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::CS, CS_EMPTY_DIST_Y, L"CSEmptyDistY.cso"), false);
+	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::CS, CS_EMPTY_DIST_Z, L"CSEmptyDistZ.cso"), false);
+	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::CS, CS_LIGHT_TRANS, L"CSLightTrans.cso"), false);
+	XUSG_N_RETURN(m_shaderLib->CreateShader(Shader::Stage::CS, CS_COMPACT_BOXES, L"CSCompactBoxes.cso"), false);
 
 	return true;
 }
@@ -202,6 +397,38 @@ bool Voxelizer::createIB(CommandList* pCommandList, uint32_t numIndices,
 	return m_indexbuffer->Upload(pCommandList, uploaders.back().get(), pData, byteWidth);
 }
 
+bool Voxelizer::createVertexUploads(const Device* pDevice, uint32_t numVert, uint32_t stride,
+	const uint8_t* pVertices)
+{
+	// Persistently mapped, with the vertices of each frame in flight
+	const auto byteWidth = static_cast<size_t>(stride) * numVert;
+	m_vertexUploads = Buffer::MakeUnique();
+	XUSG_N_RETURN(m_vertexUploads->Create(pDevice, byteWidth * FrameCount, ResourceFlag::NONE,
+		MemoryType::UPLOAD, 0, nullptr, 0, nullptr, MemoryFlag::NONE, L"VertexUploads"), false);
+	XUSG_X_RETURN(m_pVertexUploads, static_cast<uint8_t*>(m_vertexUploads->Map(nullptr)), false);
+
+	m_vertexStride = stride;
+	m_vertices.assign(pVertices, pVertices + byteWidth);
+
+	return true;
+}
+
+void Voxelizer::copyVertices(CommandList* pCommandList)
+{
+	const auto byteWidth = m_vertices.size();
+	ResourceBarrier barrier;
+	auto numBarriers = m_vertexBuffer->SetBarrier(&barrier, ResourceState::COPY_DEST);
+	pCommandList->Barrier(numBarriers, &barrier);
+
+	pCommandList->CopyBufferRegion(m_vertexBuffer.get(), 0, m_vertexUploads.get(), byteWidth * m_pendingUpload, byteWidth);
+
+	// Read by the input assembler, or by vertex pulling in VSTriProj
+	numBarriers = m_vertexBuffer->SetBarrier(&barrier, ResourceState::VERTEX_AND_CONSTANT_BUFFER |
+		ResourceState::NON_PIXEL_SHADER_RESOURCE);
+	pCommandList->Barrier(numBarriers, &barrier);
+	m_pendingUpload = FrameCount;
+}
+
 bool Voxelizer::createCBs(CommandList* pCommandList, vector<Resource::uptr>& uploaders)
 {
 	const auto pDevice = pCommandList->GetDevice();
@@ -230,11 +457,17 @@ bool Voxelizer::createCBs(CommandList* pCommandList, vector<Resource::uptr>& upl
 	{
 		auto& cb = m_cbPerMipLevels[i];
 		cb = ConstantBuffer::MakeUnique();
-		const auto gridSize = static_cast<float>(GRID_SIZE >> i);
-		XUSG_N_RETURN(cb->Create(pDevice, sizeof(XMFLOAT4), 1, nullptr, MemoryType::DEFAULT), false);
+		const CBPerMipLevel perMipLevel =
+		{
+			static_cast<float>(GRID_SIZE >> i),
+			static_cast<float>(i),
+			static_cast<float>(m_numLevels - i),
+			m_objectID
+		};
+		XUSG_N_RETURN(cb->Create(pDevice, sizeof(CBPerMipLevel), 1, nullptr, MemoryType::DEFAULT), false);
 
 		uploaders.emplace_back(Resource::MakeUnique());
-		cb->Upload(pCommandList, uploaders.back().get(), &gridSize, sizeof(float));
+		cb->Upload(pCommandList, uploaders.back().get(), &perMipLevel, sizeof(CBPerMipLevel));
 	}
 
 	return true;
@@ -254,6 +487,38 @@ bool Voxelizer::createInputLayout()
 	return true;
 }
 
+bool Voxelizer::createBoxList(CommandList* pCommandList, vector<Resource::uptr>& uploaders)
+{
+	const auto pDevice = pCommandList->GetDevice();
+
+	// At most 3N^2(N + 1) faces are exposed, as every exposed face is the only one
+	// between an occupied voxel and its empty or outer neighbor
+	const auto maxNumFaces = 3 * GRID_SIZE * GRID_SIZE * (GRID_SIZE + 1);
+	m_boxFaces = StructuredBuffer::MakeUnique();
+	XUSG_N_RETURN(m_boxFaces->Create(pDevice, maxNumFaces, sizeof(uint32_t), ResourceFlag::ALLOW_UNORDERED_ACCESS,
+		MemoryType::DEFAULT, 1, nullptr, 1, nullptr, MemoryFlag::NONE, L"BoxFaces"), false);
+
+	// Draw arguments of the exposed faces, reset to 4 vertices and 0 instances per frame
+	const uint32_t drawArgs[] = { 4, 0, 0, 0 };
+	m_drawArgs = RawBuffer::MakeUnique();
+	XUSG_N_RETURN(m_drawArgs->Create(pDevice, sizeof(drawArgs), ResourceFlag::ALLOW_UNORDERED_ACCESS,
+		MemoryType::DEFAULT, 1, nullptr, 1, nullptr, MemoryFlag::NONE, L"BoxDrawArguments"), false);
+
+	m_drawArgsReset = RawBuffer::MakeUnique();
+	XUSG_N_RETURN(m_drawArgsReset->Create(pDevice, sizeof(drawArgs), ResourceFlag::NONE,
+		MemoryType::DEFAULT, 0, nullptr, 0, nullptr, MemoryFlag::NONE, L"BoxDrawArgumentReset"), false);
+	uploaders.emplace_back(Resource::MakeUnique());
+	XUSG_N_RETURN(m_drawArgsReset->Upload(pCommandList, uploaders.back().get(), drawArgs,
+		sizeof(drawArgs), 0, ResourceState::COPY_SOURCE), false);
+
+	IndirectArgument arg;
+	arg.Type = IndirectArgumentType::DRAW;
+	m_commandLayout = CommandLayout::MakeUnique();
+	XUSG_N_RETURN(m_commandLayout->Create(pDevice, sizeof(drawArgs), 1, &arg), false);
+
+	return true;
+}
+
 bool Voxelizer::prevoxelize(uint8_t mipLevel)
 {
 	// Get CBVs
@@ -278,13 +543,13 @@ bool Voxelizer::prevoxelize(uint8_t mipLevel)
 	{
 		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
 		descriptorTable->SetDescriptors(0, 1, &m_grid[i]->GetUAV());
-		XUSG_X_RETURN(m_uavTables[UAV_TABLE_VOXELIZE + i], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+		XUSG_X_RETURN(m_uavTables[UAV_TABLE_VOXELIZE + i], descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
 	}
 
 	{
 		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
 		descriptorTable->SetDescriptors(0, 1, &m_mutex->GetUAV());
-		XUSG_X_RETURN(m_uavTables[UAV_TABLE_MUTEX], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+		XUSG_X_RETURN(m_uavTables[UAV_TABLE_MUTEX], descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
 	}
 #else
 	{
@@ -300,6 +565,33 @@ bool Voxelizer::prevoxelize(uint8_t mipLevel)
 		XUSG_X_RETURN(m_uavTables[UAV_TABLE_KBUFFER], descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
 	}
 
+#if	!USE_MUTEX
+	// UAVs of all the levels for direct multi-resolution voxelization
+	{
+		vector<Descriptor> uavs(m_numLevels);
+		for (uint8_t i = 0; i < m_numLevels; ++i) uavs[i] = m_grid->GetUAV(i, Format::R32_UINT);
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		descriptorTable->SetDescriptors(0, m_numLevels, uavs.data());
+		XUSG_X_RETURN(m_uavTables[UAV_TABLE_VOXELIZE_MULTI_RES], descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
+	}
+
+	// UAVs of the grid and the object IDs for the voxelization with IDs, and of the IDs alone
+	if (m_objectIDs)
+	{
+		const Descriptor uavs[] = { m_grid->GetUAV(0, Format::R32_UINT), m_objectIDs->GetUAV() };
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(uavs)), uavs);
+		XUSG_X_RETURN(m_uavTables[UAV_TABLE_VOXELIZE_OBJECT_ID], descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
+	}
+
+	if (m_objectIDs)
+	{
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		descriptorTable->SetDescriptors(0, 1, &m_objectIDs->GetUAV());
+		XUSG_X_RETURN(m_uavTables[UAV_TABLE_OBJECT_ID], descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
+	}
+#endif
+
 	// Get SRV
 	{
 		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
@@ -308,7 +600,7 @@ bool Voxelizer::prevoxelize(uint8_t mipLevel)
 	}
 
 	// Get graphics pipeline layouts
-	const auto numUAVs = USE_MUTEX ? 5u : 2u;
+	const auto numUAVs = USE_MUTEX ? 5u : static_cast<uint32_t>(MAX_NUM_LEVELS);
 	{
 		const auto utilPipelineLayout = Util::PipelineLayout::MakeUnique();
 		utilPipelineLayout->SetRange(0, DescriptorType::CBV, 2, 0, 0, DescriptorFlag::DATA_STATIC);
@@ -370,6 +662,15 @@ bool Voxelizer::prevoxelize(uint8_t mipLevel)
 		state->SetShader(Shader::Stage::PS, m_shaderLib->GetShader(Shader::Stage::PS, PS_TRI_PROJ_SOLID));
 		XUSG_X_RETURN(m_pipelines[PASS_VOXELIZE_SOLID], state->GetPipeline(m_graphicsPipelineLib.get(), L"VoxelizationSolid"), false);
 
+		state->SetShader(Shader::Stage::PS, m_shaderLib->GetShader(Shader::Stage::PS, PS_TRI_PROJ_SOLID_VOTE));
+		XUSG_X_RETURN(m_pipelines[PASS_VOXELIZE_SOLID_VOTE], state->GetPipeline(m_graphicsPipelineLib.get(), L"VoxelizationSolidVote"), false);
+
+		state->SetShader(Shader::Stage::PS, m_shaderLib->GetShader(Shader::Stage::PS, PS_TRI_PROJ_MULTI_RES));
+		XUSG_X_RETURN(m_pipelines[PASS_VOXELIZE_MULTI_RES], state->GetPipeline(m_graphicsPipelineLib.get(), L"VoxelizationMultiRes"), false);
+
+		state->SetShader(Shader::Stage::PS, m_shaderLib->GetShader(Shader::Stage::PS, PS_TRI_PROJ_OBJECT_ID));
+		XUSG_X_RETURN(m_pipelines[PASS_VOXELIZE_OBJECT_ID], state->GetPipeline(m_graphicsPipelineLib.get(), L"VoxelizationObjectID"), false);
+
 		state->IASetInputLayout(m_pInputLayout);
 		state->SetPipelineLayout(m_pipelineLayouts[PASS_VOXELIZE_UNION]);
 		state->SetShader(Shader::Stage::VS, m_shaderLib->GetShader(Shader::Stage::VS, VS_TRI_PROJ_UNION));
@@ -379,6 +680,15 @@ bool Voxelizer::prevoxelize(uint8_t mipLevel)
 		state->SetShader(Shader::Stage::PS, m_shaderLib->GetShader(Shader::Stage::PS, PS_TRI_PROJ_UNION_SOLID));
 		XUSG_X_RETURN(m_pipelines[PASS_VOXELIZE_UNION_SOLID], state->GetPipeline(m_graphicsPipelineLib.get(), L"VoxelizationUnionSolid"), false);
 
+		state->SetShader(Shader::Stage::PS, m_shaderLib->GetShader(Shader::Stage::PS, PS_TRI_PROJ_UNION_SOLID_VOTE));
+		XUSG_X_RETURN(m_pipelines[PASS_VOXELIZE_UNION_SOLID_VOTE], state->GetPipeline(m_graphicsPipelineLib.get(), L"VoxelizationUnionSolidVote"), false);
+
+		state->SetShader(Shader::Stage::PS, m_shaderLib->GetShader(Shader::Stage::PS, PS_TRI_PROJ_UNION_MULTI_RES));
+		XUSG_X_RETURN(m_pipelines[PASS_VOXELIZE_UNION_MULTI_RES], state->GetPipeline(m_graphicsPipelineLib.get(), L"VoxelizationUnionMultiRes"), false);
+
+		state->SetShader(Shader::Stage::PS, m_shaderLib->GetShader(Shader::Stage::PS, PS_TRI_PROJ_UNION_OBJECT_ID));
+		XUSG_X_RETURN(m_pipelines[PASS_VOXELIZE_UNION_OBJECT_ID], state->GetPipeline(m_graphicsPipelineLib.get(), L"VoxelizationUnionObjectID"), false);
+
 		state->SetPipelineLayout(m_pipelineLayouts[PASS_VOXELIZE_TESS]);
 		state->SetShader(Shader::Stage::VS, m_shaderLib->GetShader(Shader::Stage::VS, VS_TRI_PROJ_TESS));
 		state->SetShader(Shader::Stage::HS, m_shaderLib->GetShader(Shader::Stage::HS, HS_TRI_PROJ));
@@ -389,6 +699,15 @@ bool Voxelizer::prevoxelize(uint8_t mipLevel)
 
 		state->SetShader(Shader::Stage::PS, m_shaderLib->GetShader(Shader::Stage::PS, PS_TRI_PROJ_SOLID));
 		XUSG_X_RETURN(m_pipelines[PASS_VOXELIZE_TESS_SOLID], state->GetPipeline(m_graphicsPipelineLib.get(), L"VoxelizatioTessSolid"), false);
+
+		state->SetShader(Shader::Stage::PS, m_shaderLib->GetShader(Shader::Stage::PS, PS_TRI_PROJ_SOLID_VOTE));
+		XUSG_X_RETURN(m_pipelines[PASS_VOXELIZE_TESS_SOLID_VOTE], state->GetPipeline(m_graphicsPipelineLib.get(), L"VoxelizationTessSolidVote"), false);
+
+		state->SetShader(Shader::Stage::PS, m_shaderLib->GetShader(Shader::Stage::PS, PS_TRI_PROJ_MULTI_RES));
+		XUSG_X_RETURN(m_pipelines[PASS_VOXELIZE_TESS_MULTI_RES], state->GetPipeline(m_graphicsPipelineLib.get(), L"VoxelizationTessMultiRes"), false);
+
+		state->SetShader(Shader::Stage::PS, m_shaderLib->GetShader(Shader::Stage::PS, PS_TRI_PROJ_OBJECT_ID));
+		XUSG_X_RETURN(m_pipelines[PASS_VOXELIZE_TESS_OBJECT_ID], state->GetPipeline(m_graphicsPipelineLib.get(), L"VoxelizationTessObjectID"), false);
 	}
 
 	// Get compute pipeline layout
@@ -407,11 +726,61 @@ bool Voxelizer::prevoxelize(uint8_t mipLevel)
 		state->SetPipelineLayout(m_pipelineLayouts[PASS_FILL_SOLID]);
 		state->SetShader(m_shaderLib->GetShader(Shader::Stage::CS, CS_FILL_SOLID));
 		XUSG_X_RETURN(m_pipelines[PASS_FILL_SOLID], state->GetPipeline(m_computePipelineLib.get(), L"SolidFill"), false);
+
+		state->SetShader(m_shaderLib->GetShader(Shader::Stage::CS, CS_FILL_SOLID_VOTE));
+		XUSG_X_RETURN(m_pipelines[PASS_FILL_SOLID_VOTE], state->GetPipeline(m_computePipelineLib.get(), L"SolidFillVote"), false);
 	}
 
 	return true;
 }
 
+bool Voxelizer::pregenerateMips()
+{
+#if	USE_MUTEX
+	// The grids of the mutex path have level 0 only, whose SRV the empty distances still read
+	m_srvMipTables.resize(1);
+	{
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		descriptorTable->SetDescriptors(0, 1, &m_grid[0]->GetSRV());
+		XUSG_X_RETURN(m_srvMipTables[0], descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
+	}
+#else
+	m_srvMipTables.resize(m_numLevels);
+	m_uavMipTables.resize(m_numLevels);
+	for (uint8_t i = 0; i < m_numLevels; ++i)
+	{
+		// Get SRV of the source level
+		{
+			const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+			descriptorTable->SetDescriptors(0, 1, &m_grid->GetSRV(i, true));
+			XUSG_X_RETURN(m_srvMipTables[i], descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
+		}
+
+		// Get UAV of the destination level
+		{
+			const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+			descriptorTable->SetDescriptors(0, 1, &m_grid->GetUAV(i, Format::R32_UINT));
+			XUSG_X_RETURN(m_uavMipTables[i], descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
+		}
+	}
+#endif
+
+	// Get pipeline layout
+	const auto utilPipelineLayout = Util::PipelineLayout::MakeUnique();
+	utilPipelineLayout->SetRange(0, DescriptorType::SRV, 1, 0);
+	utilPipelineLayout->SetRange(1, DescriptorType::UAV, 1, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+	XUSG_X_RETURN(m_pipelineLayouts[PASS_GEN_MIPS], utilPipelineLayout->GetPipelineLayout(
+		m_pipelineLayoutLib.get(), PipelineLayoutFlag::NONE, L"MipGenerationPass"), false);
+
+	// Get pipeline
+	const auto state = Compute::State::MakeUnique();
+	state->SetPipelineLayout(m_pipelineLayouts[PASS_GEN_MIPS]);
+	state->SetShader(m_shaderLib->GetShader(Shader::Stage::CS, CS_GEN_MIPS));
+	XUSG_X_RETURN(m_pipelines[PASS_GEN_MIPS], state->GetPipeline(m_computePipelineLib.get(), L"MipGeneration"), false);
+
+	return true;
+}
+
 bool Voxelizer::prerenderBoxArray(Format rtFormat, Format dsFormat)
 {
 	// Get SRV
@@ -425,7 +794,7 @@ bool Voxelizer::prerenderBoxArray(Format rtFormat, Format dsFormat)
 		};
 		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
 		descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
-		XUSG_X_RETURN(m_srvTables[SRV_TABLE_GRID_XYZ], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+		XUSG_X_RETURN(m_srvTables[SRV_TABLE_GRID_XYZ], descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
 	}
 #else
 	if (!m_srvTables[SRV_TABLE_GRID])
@@ -434,6 +803,24 @@ bool Voxelizer::prerenderBoxArray(Format rtFormat, Format dsFormat)
 		descriptorTable->SetDescriptors(0, 1, &m_grid->GetSRV());
 		XUSG_X_RETURN(m_srvTables[SRV_TABLE_GRID], descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
 	}
+
+	// Get SRVs and UAVs of the box list
+	if (USE_BOX_LIST)
+	{
+		{
+			const Descriptor srvs[] = { m_grid->GetSRV(), m_boxFaces->GetSRV() };
+			const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+			descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(srvs)), srvs);
+			XUSG_X_RETURN(m_srvTables[SRV_TABLE_BOX_LIST], descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
+		}
+
+		{
+			const Descriptor uavs[] = { m_boxFaces->GetUAV(), m_drawArgs->GetUAV() };
+			const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+			descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(uavs)), uavs);
+			XUSG_X_RETURN(m_uavTables[UAV_TABLE_COMPACT_BOXES], descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
+		}
+	}
 #endif
 
 	for (uint8_t i = 0; i < FrameCount; ++i)
@@ -444,12 +831,39 @@ bool Voxelizer::prerenderBoxArray(Format rtFormat, Format dsFormat)
 		XUSG_X_RETURN(m_cbvTables[CBV_TABLE_MATRICES + i], descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
 	}
 
+	m_cbvPerMipTables.resize(m_numLevels);
+	for (uint8_t i = 0; i < m_numLevels; ++i)
+	{
+		// Get CBV of the MIP level to show
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		descriptorTable->SetDescriptors(0, 1, &m_cbPerMipLevels[i]->GetCBV());
+		XUSG_X_RETURN(m_cbvPerMipTables[i], descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
+	}
+
+	// Get compute pipeline of the box list compaction
+	if (USE_BOX_LIST)
+	{
+		const auto utilPipelineLayout = Util::PipelineLayout::MakeUnique();
+		utilPipelineLayout->SetRange(0, DescriptorType::CBV, 1, 0, 0, DescriptorFlag::DATA_STATIC);
+		utilPipelineLayout->SetRange(1, DescriptorType::SRV, 1, 0);
+		utilPipelineLayout->SetRange(2, DescriptorType::UAV, 2, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		XUSG_X_RETURN(m_pipelineLayouts[PASS_COMPACT_BOXES], utilPipelineLayout->GetPipelineLayout(
+			m_pipelineLayoutLib.get(), PipelineLayoutFlag::NONE, L"BoxCompactionPass"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[PASS_COMPACT_BOXES]);
+		state->SetShader(m_shaderLib->GetShader(Shader::Stage::CS, CS_COMPACT_BOXES));
+		XUSG_X_RETURN(m_pipelines[PASS_COMPACT_BOXES], state->GetPipeline(m_computePipelineLib.get(), L"BoxCompaction"), false);
+	}
+
 	// Get pipeline layout
 	const auto utilPipelineLayout = Util::PipelineLayout::MakeUnique();
 	utilPipelineLayout->SetRange(0, DescriptorType::CBV, 1, 0, 0, DescriptorFlag::DATA_STATIC);
-	utilPipelineLayout->SetRange(1, DescriptorType::SRV, USE_MUTEX ? 4 : 1, 0);
+	utilPipelineLayout->SetRange(1, DescriptorType::SRV, USE_MUTEX ? 4 : 1 + USE_BOX_LIST, 0);
+	utilPipelineLayout->SetRange(2, DescriptorType::CBV, 1, 1, 0, DescriptorFlag::DATA_STATIC);
 	utilPipelineLayout->SetShaderStage(0, Shader::Stage::VS);
 	utilPipelineLayout->SetShaderStage(1, Shader::Stage::VS);
+	utilPipelineLayout->SetShaderStage(2, Shader::Stage::VS);
 	XUSG_X_RETURN(m_pipelineLayouts[PASS_DRAW_AS_BOX], utilPipelineLayout->GetPipelineLayout(
 		m_pipelineLayoutLib.get(), PipelineLayoutFlag::NONE, L"DrawAsBoxPass"), false);
 
@@ -488,13 +902,79 @@ bool Voxelizer::prerayCast(Format rtFormat, Format dsFormat)
 		XUSG_X_RETURN(m_srvTables[SRV_TABLE_GRID], descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
 	}
 
+	// Get SRVs and UAVs of the empty distances
+	for (uint8_t i = 0; i < 2; ++i)
+	{
+		{
+			const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+			descriptorTable->SetDescriptors(0, 1, &m_emptyDist[i]->GetSRV());
+			XUSG_X_RETURN(m_srvTables[SRV_TABLE_EMPTY_DIST + i], descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
+		}
+
+		{
+			const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+			descriptorTable->SetDescriptors(0, 1, &m_emptyDist[i]->GetUAV());
+			XUSG_X_RETURN(m_uavTables[UAV_TABLE_EMPTY_DIST + i], descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
+		}
+	}
+
+	// Get UAV of the light transmittance
+	{
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		descriptorTable->SetDescriptors(0, 1, &m_lightTrans->GetUAV());
+		XUSG_X_RETURN(m_uavTables[UAV_TABLE_LIGHT_TRANS], descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
+	}
+
+	// Get SRVs for ray casting
+	{
+#if	USE_MUTEX
+		const Descriptor srvs[] = { m_grid[0]->GetSRV(), m_emptyDist[0]->GetSRV(), m_lightTrans->GetSRV() };
+#else
+		const Descriptor srvs[] = { m_grid->GetSRV(), m_emptyDist[0]->GetSRV(), m_lightTrans->GetSRV() };
+#endif
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(srvs)), srvs);
+		XUSG_X_RETURN(m_srvTables[SRV_TABLE_RAY_CAST], descriptorTable->GetCbvSrvUavTable(m_descriptorTableLib.get()), false);
+	}
+
+	// Get compute pipelines of the empty distances, sharing the layout with MIP generation
+	{
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[PASS_GEN_MIPS]);
+		state->SetShader(m_shaderLib->GetShader(Shader::Stage::CS, CS_EMPTY_DIST_X));
+		XUSG_X_RETURN(m_pipelines[PASS_EMPTY_DIST_X], state->GetPipeline(m_computePipelineLib.get(), L"EmptyDistanceX"), false);
+
+		state->SetShader(m_shaderLib->GetShader(Shader::Stage::CS, CS_EMPTY_DIST_Y));
+		XUSG_X_RETURN(m_pipelines[PASS_EMPTY_DIST_Y], state->GetPipeline(m_computePipelineLib.get(), L"EmptyDistanceY"), false);
+
+		state->SetShader(m_shaderLib->GetShader(Shader::Stage::CS, CS_EMPTY_DIST_Z));
+		XUSG_X_RETURN(m_pipelines[PASS_EMPTY_DIST_Z], state->GetPipeline(m_computePipelineLib.get(), L"EmptyDistanceZ"), false);
+	}
+
 	// Create sampler
 	const auto& sampler = m_descriptorTableLib->GetSampler(SamplerPreset::LINEAR_CLAMP);
 
+	// Get compute pipeline of the light transmittance, with the slice index in root constants
+	{
+		const auto utilPipelineLayout = Util::PipelineLayout::MakeUnique();
+		utilPipelineLayout->SetRange(0, DescriptorType::CBV, 1, 0, 0, DescriptorFlag::DATA_STATIC);
+		utilPipelineLayout->SetConstants(1, 1, 1);
+		utilPipelineLayout->SetRange(2, DescriptorType::SRV, 1, 0);
+		utilPipelineLayout->SetRange(3, DescriptorType::UAV, 1, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		utilPipelineLayout->SetStaticSamplers(&sampler, 1, 0);
+		XUSG_X_RETURN(m_pipelineLayouts[PASS_LIGHT_TRANS], utilPipelineLayout->GetPipelineLayout(
+			m_pipelineLayoutLib.get(), PipelineLayoutFlag::NONE, L"LightTransmittancePass"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[PASS_LIGHT_TRANS]);
+		state->SetShader(m_shaderLib->GetShader(Shader::Stage::CS, CS_LIGHT_TRANS));
+		XUSG_X_RETURN(m_pipelines[PASS_LIGHT_TRANS], state->GetPipeline(m_computePipelineLib.get(), L"LightTransmittance"), false);
+	}
+
 	// Get pipeline layout
 	const auto utilPipelineLayout = Util::PipelineLayout::MakeUnique();
 	utilPipelineLayout->SetRange(0, DescriptorType::CBV, 1, 0, 0, DescriptorFlag::DATA_STATIC);
-	utilPipelineLayout->SetRange(1, DescriptorType::SRV, 1, 0);
+	utilPipelineLayout->SetRange(1, DescriptorType::SRV, 3, 0);
 	utilPipelineLayout->SetStaticSamplers(&sampler, 1, 0, 0, Shader::Stage::PS);
 	utilPipelineLayout->SetShaderStage(0, Shader::Stage::PS);
 	utilPipelineLayout->SetShaderStage(1, Shader::Stage::PS);
@@ -514,22 +994,29 @@ bool Voxelizer::prerayCast(Format rtFormat, Format dsFormat)
 	return true;
 }
 
-void Voxelizer::voxelize(CommandList* pCommandList, Method voxMethod, bool depthPeel, uint8_t mipLevel)
+void Voxelizer::voxelize(CommandList* pCommandList, Method voxMethod, bool depthPeel,
+	uint8_t mipLevel, FillMethod fillMethod, bool multiRes)
 {
+	const auto vote = fillMethod == FILL_VOTE_XYZ;
+	multiRes = multiRes && !depthPeel && !USE_MUTEX;
+	const auto objectIDs = m_objectIDs && !depthPeel && !multiRes;
 	auto layoutIdx = PASS_VOXELIZE;
-	auto pipeIdx = depthPeel ? PASS_VOXELIZE_SOLID : PASS_VOXELIZE;
+	auto pipeIdx = depthPeel ? (vote ? PASS_VOXELIZE_SOLID_VOTE : PASS_VOXELIZE_SOLID) :
+		(multiRes ? PASS_VOXELIZE_MULTI_RES : (objectIDs ? PASS_VOXELIZE_OBJECT_ID : PASS_VOXELIZE));
 	auto instanceCount = m_numIndices / 3;
 
 	switch (voxMethod)
 	{
 	case TRI_PROJ_TESS:
 		layoutIdx = PASS_VOXELIZE_TESS;
-		pipeIdx = depthPeel ? PASS_VOXELIZE_TESS_SOLID : PASS_VOXELIZE_TESS;
+		pipeIdx = depthPeel ? (vote ? PASS_VOXELIZE_TESS_SOLID_VOTE : PASS_VOXELIZE_TESS_SOLID) :
+			(multiRes ? PASS_VOXELIZE_TESS_MULTI_RES : (objectIDs ? PASS_VOXELIZE_TESS_OBJECT_ID : PASS_VOXELIZE_TESS));
 		instanceCount = 1;
 		break;
 	case TRI_PROJ_UNION:
 		layoutIdx = PASS_VOXELIZE_UNION;
-		pipeIdx = depthPeel ? PASS_VOXELIZE_UNION_SOLID : PASS_VOXELIZE_UNION;
+		pipeIdx = depthPeel ? (vote ? PASS_VOXELIZE_UNION_SOLID_VOTE : PASS_VOXELIZE_UNION_SOLID) :
+			(multiRes ? PASS_VOXELIZE_UNION_MULTI_RES : (objectIDs ? PASS_VOXELIZE_UNION_OBJECT_ID : PASS_VOXELIZE_UNION));
 		instanceCount = 3;
 		break;
 	}
@@ -541,8 +1028,9 @@ void Voxelizer::voxelize(CommandList* pCommandList, Method voxMethod, bool depth
 	for (uint8_t i = 1; i < 4; ++i)
 		numBarriers = m_grid[i]->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
 #else
-	ResourceBarrier barriers[1];
+	ResourceBarrier barriers[2];
 	auto numBarriers = m_grid->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+	if (m_objectIDs) numBarriers = m_objectIDs->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
 #endif
 	pCommandList->Barrier(numBarriers, barriers);
 	if (depthPeel) m_KBufferDepth->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS); // Implicit state promotion
@@ -551,7 +1039,8 @@ void Voxelizer::voxelize(CommandList* pCommandList, Method voxMethod, bool depth
 	pCommandList->SetGraphicsPipelineLayout(m_pipelineLayouts[layoutIdx]);
 	pCommandList->SetGraphicsDescriptorTable(0, m_cbvTables[CBV_TABLE_VOXELIZE]);
 	pCommandList->SetGraphicsDescriptorTable(1, m_cbvTables[CBV_TABLE_PER_MIP]);
-	pCommandList->SetGraphicsDescriptorTable(2, m_uavTables[UAV_TABLE_VOXELIZE + USE_MUTEX]);
+	pCommandList->SetGraphicsDescriptorTable(2, m_uavTables[multiRes ? UAV_TABLE_VOXELIZE_MULTI_RES :
+		(objectIDs ? UAV_TABLE_VOXELIZE_OBJECT_ID : UAV_TABLE_VOXELIZE + USE_MUTEX)]);
 	switch (voxMethod)
 	{
 	case TRI_PROJ:
@@ -574,15 +1063,27 @@ void Voxelizer::voxelize(CommandList* pCommandList, Method voxMethod, bool depth
 	pCommandList->RSSetScissorRects(1, &scissorRect);
 
 	// Record commands.
+	{
+		GPUProfileScope scope(m_pProfiler, pCommandList, "ClearGrid");
 #if	USE_MUTEX
-	for (uint8_t i = 1; i < 4; ++i)
-		pCommandList->ClearUnorderedAccessViewFloat(m_uavTables[UAV_TABLE_VOXELIZE + i], m_grid[i]->GetUAV(), m_grid[i].get(), XMVECTORF32{ 0.0f }.f);
+		for (uint8_t i = 1; i < 4; ++i)
+			pCommandList->ClearUnorderedAccessViewFloat(m_uavTables[UAV_TABLE_VOXELIZE + i], m_grid[i]->GetUAV(), m_grid[i].get(), XMVECTORF32{ 0.0f }.f);
 #else
-	pCommandList->ClearUnorderedAccessViewUint(m_uavTables[UAV_TABLE_VOXELIZE],
-		m_grid->GetUAV(0, Format::R32_UINT), m_grid.get(), XMVECTORU32{ 0 }.u);
+		pCommandList->ClearUnorderedAccessViewUint(m_uavTables[UAV_TABLE_VOXELIZE],
+			m_grid->GetUAV(0, Format::R32_UINT), m_grid.get(), XMVECTORU32{ 0 }.u);
+		if (multiRes) for (uint8_t i = 1; i < m_numLevels; ++i)
+			pCommandList->ClearUnorderedAccessViewUint(m_uavMipTables[i],
+				m_grid->GetUAV(i, Format::R32_UINT), m_grid.get(), XMVECTORU32{ 0 }.u);
+
+		// Cleared by every voxelization, so the passes without IDs leave none stale
+		if (m_objectIDs) pCommandList->ClearUnorderedAccessViewUint(m_uavTables[UAV_TABLE_OBJECT_ID],
+			m_objectIDs->GetUAV(), m_objectIDs.get(), XMVECTORU32{ NoObjectID }.u);
 #endif
-	if (depthPeel) pCommandList->ClearUnorderedAccessViewUint(m_uavTables[UAV_TABLE_KBUFFER], m_KBufferDepth->GetUAV(),
-		m_KBufferDepth.get(), XMVECTORU32{ UINT32_MAX }.u);
+		if (depthPeel) pCommandList->ClearUnorderedAccessViewUint(m_uavTables[UAV_TABLE_KBUFFER], m_KBufferDepth->GetUAV(),
+			m_KBufferDepth.get(), XMVECTORU32{ UINT32_MAX }.u);
+	}
+
+	GPUProfileScope scope(m_pProfiler, pCommandList, depthPeel ? "DepthPeel" : "Voxelize");
 
 	// Set IA
 	if (voxMethod != TRI_PROJ)
@@ -600,10 +1101,12 @@ void Voxelizer::voxelize(CommandList* pCommandList, Method voxMethod, bool depth
 		pCommandList->DrawIndexed(m_numIndices, instanceCount, 0, 0, 0);
 }
 
-void Voxelizer::voxelizeSolid(CommandList* pCommandList, Method voxMethod, uint8_t mipLevel)
+void Voxelizer::voxelizeSolid(CommandList* pCommandList, Method voxMethod, FillMethod fillMethod, uint8_t mipLevel)
 {
 	// Surface voxelization with depth peeling
-	voxelize(pCommandList, voxMethod, true, mipLevel);
+	voxelize(pCommandList, voxMethod, true, mipLevel, fillMethod);
+
+	GPUProfileScope scope(m_pProfiler, pCommandList, "FillSolid");
 
 	// Set resource barriers
 #if	USE_MUTEX
@@ -630,11 +1133,160 @@ void Voxelizer::voxelizeSolid(CommandList* pCommandList, Method voxMethod, uint8
 	pCommandList->SetComputeDescriptorTable(2, m_uavTables[UAV_TABLE_VOXELIZE]);
 
 	// Set pipeline state
-	pCommandList->SetPipelineState(m_pipelines[PASS_FILL_SOLID]);
+	const auto vote = fillMethod == FILL_VOTE_XYZ;
+	pCommandList->SetPipelineState(m_pipelines[vote ? PASS_FILL_SOLID_VOTE : PASS_FILL_SOLID]);
 
 	// Record commands.
 	const auto numGroups = XUSG_DIV_UP(GRID_SIZE, 4);
+	if (vote) pCommandList->Dispatch(XUSG_DIV_UP(XUSG_DIV_UP(GRID_SIZE, 32), 4), numGroups, numGroups);	// 32 voxels per thread along X
+	else pCommandList->Dispatch(numGroups, numGroups, numGroups);
+}
+
+void Voxelizer::generateMips(CommandList* pCommandList, ResourceState dstState)
+{
+#if	USE_MUTEX
+	// No coarser levels to generate
+	ResourceBarrier barrier;
+	const auto numBarriers = m_grid[0]->SetBarrier(&barrier, dstState);
+	pCommandList->Barrier(numBarriers, &barrier);
+#else
+	// Set pipeline layout and state
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[PASS_GEN_MIPS]);
+	pCommandList->SetPipelineState(m_pipelines[PASS_GEN_MIPS]);
+
+	ResourceBarrier barriers[2];
+	for (uint8_t i = 1; i < m_numLevels; ++i)
+	{
+		// Set resource barriers
+		auto numBarriers = m_grid->SetBarrier(barriers, i - 1, ResourceState::NON_PIXEL_SHADER_RESOURCE);
+		numBarriers = m_grid->SetBarrier(barriers, i, ResourceState::UNORDERED_ACCESS, numBarriers);
+		pCommandList->Barrier(numBarriers, barriers);
+
+		// Set descriptor tables
+		pCommandList->SetComputeDescriptorTable(0, m_srvMipTables[i - 1]);
+		pCommandList->SetComputeDescriptorTable(1, m_uavMipTables[i]);
+
+		// Record commands.
+		const auto numGroups = XUSG_DIV_UP(GRID_SIZE >> i, 4);
+		pCommandList->Dispatch(numGroups, numGroups, numGroups);
+	}
+
+	// Set all the levels to the destination state
+	vector<ResourceBarrier> dstBarriers(m_numLevels);
+	auto numBarriers = 0u;
+	for (uint8_t i = 0; i < m_numLevels; ++i)
+		numBarriers = m_grid->SetBarrier(dstBarriers.data(), i, dstState, numBarriers);
+	pCommandList->Barrier(numBarriers, dstBarriers.data());
+#endif
+}
+
+void Voxelizer::computeEmptyDist(CommandList* pCommandList)
+{
+	// Separable passes along X, Y, and Z, ping-ponging between the 2 distance textures
+	const DescriptorTable srvTables[] =
+	{
+		m_srvMipTables[0],
+		m_srvTables[SRV_TABLE_EMPTY_DIST],
+		m_srvTables[SRV_TABLE_EMPTY_DIST_TMP]
+	};
+
+	const DescriptorTable uavTables[] =
+	{
+		m_uavTables[UAV_TABLE_EMPTY_DIST],
+		m_uavTables[UAV_TABLE_EMPTY_DIST_TMP],
+		m_uavTables[UAV_TABLE_EMPTY_DIST]
+	};
+
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[PASS_GEN_MIPS]);
+
+	ResourceBarrier barriers[2];
+	const auto numGroups = XUSG_DIV_UP(GRID_SIZE, 4);
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		// Set resource barriers
+		const auto& src = m_emptyDist[(i + 1) % 2];
+		const auto& dst = m_emptyDist[i % 2];
+		auto numBarriers = dst->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+		if (i > 0) numBarriers = src->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE, numBarriers);
+		pCommandList->Barrier(numBarriers, barriers);
+
+		// Set descriptor tables
+		pCommandList->SetComputeDescriptorTable(0, srvTables[i]);
+		pCommandList->SetComputeDescriptorTable(1, uavTables[i]);
+
+		// Set pipeline state
+		pCommandList->SetPipelineState(m_pipelines[PASS_EMPTY_DIST_X + i]);
+
+		// Record commands.
+		pCommandList->Dispatch(numGroups, numGroups, numGroups);
+	}
+}
+
+void Voxelizer::computeLightTrans(CommandList* pCommandList, uint8_t frameIndex)
+{
+	// Set resource barriers, where the grid is left for the pixel shader by the ray casting
+	// when the volume is rebuilt for another MIP level
+	ResourceBarrier barriers[2];
+#if	USE_MUTEX
+	auto numBarriers = m_grid[0]->SetBarrier(barriers, ResourceState::ALL_SHADER_RESOURCE);
+#else
+	auto numBarriers = m_grid->SetBarrier(barriers, ResourceState::ALL_SHADER_RESOURCE);
+#endif
+	numBarriers = m_lightTrans->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	// Set descriptor tables
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[PASS_LIGHT_TRANS]);
+	pCommandList->SetComputeDescriptorTable(0, m_cbvTables[CBV_TABLE_PER_OBJ + frameIndex]);
+	pCommandList->SetComputeDescriptorTable(2, m_srvTables[SRV_TABLE_GRID]);
+	pCommandList->SetComputeDescriptorTable(3, m_uavTables[UAV_TABLE_LIGHT_TRANS]);
+
+	// Set pipeline state
+	pCommandList->SetPipelineState(m_pipelines[PASS_LIGHT_TRANS]);
+
+	// Sweep the slices away from the light, where each slice reads the previous one
+	const auto numGroups = XUSG_DIV_UP(GRID_SIZE, 8);
+	for (auto i = 0u; i < GRID_SIZE; ++i)
+	{
+		if (i > 0)
+		{
+			numBarriers = m_lightTrans->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+			pCommandList->Barrier(numBarriers, barriers);
+		}
+
+		pCommandList->SetCompute32BitConstant(1, i);
+		pCommandList->Dispatch(numGroups, numGroups, 1);
+	}
+}
+
+void Voxelizer::compactBoxes(CommandList* pCommandList)
+{
+#if	USE_BOX_LIST
+	// Reset the draw arguments
+	ResourceBarrier barriers[3];
+	auto numBarriers = m_drawArgs->SetBarrier(barriers, ResourceState::COPY_DEST);
+	pCommandList->Barrier(numBarriers, barriers);
+	pCommandList->CopyBufferRegion(m_drawArgs.get(), 0, m_drawArgsReset.get(), 0, sizeof(uint32_t[4]));
+
+	// Set resource barriers
+	numBarriers = m_grid->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE);
+	numBarriers = m_boxFaces->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	numBarriers = m_drawArgs->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	// Set descriptor tables
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[PASS_COMPACT_BOXES]);
+	pCommandList->SetComputeDescriptorTable(0, m_cbvPerMipTables[m_showMip]);
+	pCommandList->SetComputeDescriptorTable(1, m_srvTables[SRV_TABLE_GRID]);
+	pCommandList->SetComputeDescriptorTable(2, m_uavTables[UAV_TABLE_COMPACT_BOXES]);
+
+	// Set pipeline state
+	pCommandList->SetPipelineState(m_pipelines[PASS_COMPACT_BOXES]);
+
+	// Record commands.
+	const auto numGroups = XUSG_DIV_UP(GRID_SIZE >> m_showMip, 4);
 	pCommandList->Dispatch(numGroups, numGroups, numGroups);
+#endif
 }
 
 void Voxelizer::renderBoxArray(CommandList* pCommandList, uint8_t frameIndex, const Descriptor& rtv, const Descriptor& dsv)
@@ -647,22 +1299,32 @@ void Voxelizer::renderBoxArray(CommandList* pCommandList, uint8_t frameIndex, co
 		numBarriers = m_grid[i]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE, numBarriers);
 	pCommandList->Barrier(numBarriers, barriers);
 #else
-	ResourceBarrier barrier;
-	const auto numBarriers = m_grid->SetBarrier(&barrier, ResourceState::NON_PIXEL_SHADER_RESOURCE);
-	pCommandList->Barrier(numBarriers, &barrier);
+	ResourceBarrier barriers[3];
+	auto numBarriers = m_grid->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE);
+	if (USE_BOX_LIST)
+	{
+		numBarriers = m_boxFaces->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE, numBarriers);
+		numBarriers = m_drawArgs->SetBarrier(barriers, ResourceState::INDIRECT_ARGUMENT, numBarriers);
+	}
+	pCommandList->Barrier(numBarriers, barriers);
 #endif
 
 	// Set descriptor tables
 	pCommandList->SetGraphicsPipelineLayout(m_pipelineLayouts[PASS_DRAW_AS_BOX]);
 
 	pCommandList->SetGraphicsDescriptorTable(0, m_cbvTables[CBV_TABLE_MATRICES + frameIndex]);
-	pCommandList->SetGraphicsDescriptorTable(1, m_srvTables[SRV_TABLE_GRID + USE_MUTEX]);
+#if	USE_MUTEX
+	pCommandList->SetGraphicsDescriptorTable(1, m_srvTables[SRV_TABLE_GRID_XYZ]);
+#else
+	pCommandList->SetGraphicsDescriptorTable(1, m_srvTables[USE_BOX_LIST ? SRV_TABLE_BOX_LIST : SRV_TABLE_GRID]);
+#endif
+	pCommandList->SetGraphicsDescriptorTable(2, m_cbvPerMipTables[m_showMip]);
 
 	// Set pipeline state
 	pCommandList->SetPipelineState(m_pipelines[PASS_DRAW_AS_BOX]);
 
 	// Set viewport
-	const auto gridSize = GRID_SIZE >> SHOW_MIP;
+	const auto gridSize = GRID_SIZE >> m_showMip;
 	Viewport viewport(0.0f, 0.0f, m_viewport.x, m_viewport.y);
 	RectRange scissorRect(0, 0, static_cast<long>(m_viewport.x), static_cast<long>(m_viewport.y));
 	pCommandList->RSSetViewports(1, &viewport);
@@ -672,25 +1334,28 @@ void Voxelizer::renderBoxArray(CommandList* pCommandList, uint8_t frameIndex, co
 
 	// Record commands.
 	pCommandList->IASetPrimitiveTopology(PrimitiveTopology::TRIANGLESTRIP);
-	pCommandList->Draw(4, 6 * gridSize * gridSize * gridSize, 0, 0);
+	if (USE_BOX_LIST) pCommandList->ExecuteIndirect(m_commandLayout.get(), 1, m_drawArgs.get());
+	else pCommandList->Draw(4, 6 * gridSize * gridSize * gridSize, 0, 0);
 }
 
 void Voxelizer::renderRayCast(CommandList* pCommandList, uint8_t frameIndex, const Descriptor& rtv, const Descriptor& dsv)
 {
 	// Set resource barriers
-	ResourceBarrier barrier;
+	ResourceBarrier barriers[3];
 #if	USE_MUTEX
-	const auto numBarriers = m_grid[0]->SetBarrier(&barrier, ResourceState::PIXEL_SHADER_RESOURCE);
+	auto numBarriers = m_grid[0]->SetBarrier(barriers, ResourceState::PIXEL_SHADER_RESOURCE);
 #else
-	const auto numBarriers = m_grid->SetBarrier(&barrier, ResourceState::PIXEL_SHADER_RESOURCE);
+	auto numBarriers = m_grid->SetBarrier(barriers, ResourceState::PIXEL_SHADER_RESOURCE);
 #endif
-	pCommandList->Barrier(numBarriers, &barrier);
+	numBarriers = m_emptyDist[0]->SetBarrier(barriers, ResourceState::PIXEL_SHADER_RESOURCE, numBarriers);
+	numBarriers = m_lightTrans->SetBarrier(barriers, ResourceState::PIXEL_SHADER_RESOURCE, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
 
 	// Set descriptor tables
 	pCommandList->SetGraphicsPipelineLayout(m_pipelineLayouts[PASS_RAY_CAST]);
 
 	pCommandList->SetGraphicsDescriptorTable(0, m_cbvTables[CBV_TABLE_PER_OBJ + frameIndex]);
-	pCommandList->SetGraphicsDescriptorTable(1, m_srvTables[SRV_TABLE_GRID]);
+	pCommandList->SetGraphicsDescriptorTable(1, m_srvTables[SRV_TABLE_RAY_CAST]);
 
 	// Set pipeline state
 	pCommandList->SetPipelineState(m_pipelines[PASS_RAY_CAST]);
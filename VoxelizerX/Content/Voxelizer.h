@@ -6,6 +6,7 @@
 
 #include "Core/XUSG.h"
 #include "SharedConst.h"
+#include "GPUProfiler.h"
 
 class Voxelizer
 {
@@ -19,17 +20,67 @@ public:
 		NUM_METHOD
 	};
 
+	enum FillMethod : uint8_t
+	{
+		FILL_PARITY_Z,
+		FILL_VOTE_XYZ,
+
+		NUM_FILL_METHOD
+	};
+
+	enum MipMethod : uint8_t
+	{
+		MIP_REDUCE,
+		MIP_MULTI_RES,
+
+		NUM_MIP_METHOD
+	};
+
 	Voxelizer();
 	virtual ~Voxelizer();
 
 	bool Init(XUSG::CommandList* pCommandList, const XUSG::DescriptorTableLib::sptr& descriptorTableLib,
 		uint32_t width, uint32_t height, XUSG::Format rtFormat, XUSG::Format dsFormat,
-		std::vector<XUSG::Resource::uptr>& uploaders, const char* fileName, const DirectX::XMFLOAT4& posScale);
+		std::vector<XUSG::Resource::uptr>& uploaders, const char* fileName, const DirectX::XMFLOAT4& posScale,
+		bool dynamicMesh = false, uint32_t objectID = NoObjectID, bool voteFill = false);
 	void UpdateFrame(uint8_t frameIndex, DirectX::CXMVECTOR eyePt, DirectX::CXMMATRIX viewProj);
+	// FILL_VOTE_XYZ needs the K-buffer layers of the X and Y columns, which Init only
+	// allocates if voteFill is set, and never with USE_MUTEX, so it falls back to
+	// FILL_PARITY_Z otherwise
 	void Render(XUSG::CommandList* pCommandList, bool solid, Method voxMethod, uint8_t frameIndex,
-		const XUSG::Descriptor& rtv, const XUSG::Descriptor& dsv);
+		const XUSG::Descriptor& rtv, const XUSG::Descriptor& dsv, FillMethod fillMethod = FILL_PARITY_Z,
+		MipMethod mipMethod = MIP_REDUCE);
+
+	// Time the passes of Render with the given profiler, or nullptr for none
+	void SetProfiler(GPUProfiler* pProfiler);
+
+	// Rebuild the grid in the next Render, which otherwise only happens when the settings
+	// change, or in every Render if always is set, e.g. for timing the voxelization
+	void Invalidate();
+	void SetAlwaysVoxelize(bool always);
+
+	// Vertices of a dynamic mesh for the frame, in the layout and count of the loaded mesh
+	// and within its initial bound, written into the upload buffer of the frame and copied
+	// to the vertex buffer by the next Render. The whole grid is rebuilt if the position or
+	// the normal of any vertex changed, as the voxelization passes always draw all the
+	// triangles into a cleared grid.
+	bool UpdateVertices(uint8_t frameIndex, const uint8_t* pVertices);
+
+	// Current vertices of a dynamic mesh and their stride in bytes, empty otherwise
+	const std::vector<uint8_t>& GetVertices() const;
+	uint32_t GetVertexStride() const;
+
+	// R32_UINT ID channel of the grid, with the object ID of the mesh given to Init in the
+	// voxels written by the surface passes other than the multi-resolution ones, and
+	// NoObjectID elsewhere, or nullptr if no object ID was given
+	const XUSG::Texture3D* GetObjectIDs() const;
+
+	// Copy level 0 of the grid into the read-back buffer, in the layout of VoxelGrid with
+	// rows of the returned pitch in bytes, for saving once the command list has completed
+	bool ReadBackGrid(XUSG::CommandList* pCommandList, XUSG::Buffer* pReadBuffer, uint32_t* pRowPitch);
 
 	static const uint8_t FrameCount = FRAME_COUNT;
+	static const uint32_t NoObjectID = UINT32_MAX;
 
 protected:
 	enum RenderPass : uint8_t
@@ -40,7 +91,23 @@ protected:
 		PASS_VOXELIZE_TESS_SOLID,
 		PASS_VOXELIZE_UNION,
 		PASS_VOXELIZE_UNION_SOLID,
+		PASS_VOXELIZE_SOLID_VOTE,
+		PASS_VOXELIZE_TESS_SOLID_VOTE,
+		PASS_VOXELIZE_UNION_SOLID_VOTE,
+		PASS_VOXELIZE_MULTI_RES,
+		PASS_VOXELIZE_TESS_MULTI_RES,
+		PASS_VOXELIZE_UNION_MULTI_RES,
+		PASS_VOXELIZE_OBJECT_ID,
+		PASS_VOXELIZE_TESS_OBJECT_ID,
+		PASS_VOXELIZE_UNION_OBJECT_ID,
 		PASS_FILL_SOLID,
+		PASS_FILL_SOLID_VOTE,
+		PASS_GEN_MIPS,
+		PASS_EMPTY_DIST_X,
+		PASS_EMPTY_DIST_Y,
+		PASS_EMPTY_DIST_Z,
+		PASS_LIGHT_TRANS,
+		PASS_COMPACT_BOXES,
 		PASS_DRAW_AS_BOX,
 		PASS_RAY_CAST,
 
@@ -65,6 +132,10 @@ protected:
 #if	USE_MUTEX
 		SRV_TABLE_GRID_XYZ,
 #endif
+		SRV_TABLE_EMPTY_DIST,
+		SRV_TABLE_EMPTY_DIST_TMP,
+		SRV_TABLE_RAY_CAST,
+		SRV_TABLE_BOX_LIST,
 
 		NUM_SRV_TABLE
 	};
@@ -79,6 +150,13 @@ protected:
 		UAV_TABLE_MUTEX,
 #endif
 		UAV_TABLE_KBUFFER,
+		UAV_TABLE_VOXELIZE_MULTI_RES,
+		UAV_TABLE_VOXELIZE_OBJECT_ID,
+		UAV_TABLE_OBJECT_ID,
+		UAV_TABLE_EMPTY_DIST,
+		UAV_TABLE_EMPTY_DIST_TMP,
+		UAV_TABLE_LIGHT_TRANS,
+		UAV_TABLE_COMPACT_BOXES,
 
 		NUM_UAV_TABLE
 	};
@@ -108,13 +186,26 @@ protected:
 		PS_TRI_PROJ_SOLID,
 		PS_TRI_PROJ_UNION,
 		PS_TRI_PROJ_UNION_SOLID,
+		PS_TRI_PROJ_SOLID_VOTE,
+		PS_TRI_PROJ_UNION_SOLID_VOTE,
+		PS_TRI_PROJ_MULTI_RES,
+		PS_TRI_PROJ_UNION_MULTI_RES,
+		PS_TRI_PROJ_OBJECT_ID,
+		PS_TRI_PROJ_UNION_OBJECT_ID,
 		PS_SIMPLE,
 		PS_RAY_CAST
 	};
 
 	enum ComputeShaderID : uint8_t
 	{
-		CS_FILL_SOLID
+		CS_FILL_SOLID,
+		CS_FILL_SOLID_VOTE,
+		CS_GEN_MIPS,
+		CS_EMPTY_DIST_X,
+		CS_EMPTY_DIST_Y,
+		CS_EMPTY_DIST_Z,
+		CS_LIGHT_TRANS,
+		CS_COMPACT_BOXES
 	};
 
 	bool createShaders();
@@ -122,13 +213,24 @@ protected:
 		const uint8_t* pData, std::vector<XUSG::Resource::uptr>& uploaders);
 	bool createIB(XUSG::CommandList* pCommandList, uint32_t numIndices,
 		const uint32_t* pData, std::vector<XUSG::Resource::uptr>& uploaders);
+	bool createVertexUploads(const XUSG::Device* pDevice, uint32_t numVert, uint32_t stride,
+		const uint8_t* pVertices);
+	void copyVertices(XUSG::CommandList* pCommandList);
 	bool createCBs(XUSG::CommandList* pCommandList, std::vector<XUSG::Resource::uptr>& uploaders);
 	bool createInputLayout();
+	bool createBoxList(XUSG::CommandList* pCommandList, std::vector<XUSG::Resource::uptr>& uploaders);
 	bool prevoxelize(uint8_t mipLevel = 0);
+	bool pregenerateMips();
 	bool prerenderBoxArray(XUSG::Format rtFormat, XUSG::Format dsFormat);
 	bool prerayCast(XUSG::Format rtFormat, XUSG::Format dsFormat);
-	void voxelize(XUSG::CommandList* pCommandList, Method voxMethod, bool depthPeel = false, uint8_t mipLevel = 0);
-	void voxelizeSolid(XUSG::CommandList* pCommandList, Method voxMethod, uint8_t mipLevel = 0);
+	void voxelize(XUSG::CommandList* pCommandList, Method voxMethod, bool depthPeel = false,
+		uint8_t mipLevel = 0, FillMethod fillMethod = FILL_PARITY_Z, bool multiRes = false);
+	void voxelizeSolid(XUSG::CommandList* pCommandList, Method voxMethod,
+		FillMethod fillMethod = FILL_PARITY_Z, uint8_t mipLevel = 0);
+	void generateMips(XUSG::CommandList* pCommandList, XUSG::ResourceState dstState);
+	void computeEmptyDist(XUSG::CommandList* pCommandList);
+	void computeLightTrans(XUSG::CommandList* pCommandList, uint8_t frameIndex);
+	void compactBoxes(XUSG::CommandList* pCommandList);
 	void renderBoxArray(XUSG::CommandList* pCommandList, uint8_t frameIndex,
 		const XUSG::Descriptor& rtv, const XUSG::Descriptor& dsv);
 	void renderRayCast(XUSG::CommandList* pCommandList, uint8_t frameIndex,
@@ -147,10 +249,21 @@ protected:
 	XUSG::DescriptorTable	m_cbvTables[NUM_CBV_TABLE];
 	XUSG::DescriptorTable	m_srvTables[NUM_SRV_TABLE];
 	XUSG::DescriptorTable	m_uavTables[NUM_UAV_TABLE];
+	std::vector<XUSG::DescriptorTable> m_cbvPerMipTables;
+	std::vector<XUSG::DescriptorTable> m_srvMipTables;
+	std::vector<XUSG::DescriptorTable> m_uavMipTables;
 
 	XUSG::VertexBuffer::uptr m_vertexBuffer;
 	XUSG::IndexBuffer::uptr	m_indexbuffer;
 
+	// Dynamic mesh: a ring of the vertices of the frames in flight, and a CPU copy of the
+	// current vertices to detect the changes
+	XUSG::Buffer::uptr		m_vertexUploads;
+	uint8_t*				m_pVertexUploads;
+	std::vector<uint8_t>	m_vertices;
+	uint32_t				m_vertexStride;
+	uint8_t					m_pendingUpload;	// Frame of the vertices to copy, if any
+
 	XUSG::ConstantBuffer::uptr	m_cbMatrices;
 	XUSG::ConstantBuffer::uptr	m_cbPerFrame;
 	XUSG::ConstantBuffer::uptr	m_cbPerObject;
@@ -163,12 +276,30 @@ protected:
 #else
 	XUSG::Texture3D::uptr	m_grid;
 #endif
+	XUSG::Texture3D::uptr	m_objectIDs;
 	XUSG::Texture2D::uptr	m_KBufferDepth;
+	XUSG::Texture3D::uptr	m_emptyDist[2];
+	XUSG::Texture3D::uptr	m_lightTrans;
+
+	XUSG::StructuredBuffer::uptr m_boxFaces;
+	XUSG::RawBuffer::uptr	m_drawArgs;
+	XUSG::RawBuffer::uptr	m_drawArgsReset;
+	XUSG::CommandLayout::uptr m_commandLayout;
 
 	DirectX::XMFLOAT4		m_bound;
 	DirectX::XMFLOAT2		m_viewport;
 	DirectX::XMFLOAT4		m_posScale;
 
 	uint32_t				m_numLevels;
+	uint8_t					m_showMip;
 	uint32_t				m_numIndices;
+	uint32_t				m_objectID;
+
+	uint32_t				m_gridKey;		// Settings of the current grid
+	uint8_t					m_compactedMip;
+	uint8_t					m_lightTransMip;
+	bool					m_alwaysVoxelize;
+	bool					m_voteFill;
+
+	GPUProfiler*			m_pProfiler;
 };
@@ -11,6 +11,7 @@
 
 #include "VoxelizerX.h"
 #include "stb_image_write.h"
+#include "VoxelChunkFile.h"
 
 using namespace std;
 using namespace XUSG;
@@ -22,26 +23,59 @@ const wchar_t* VoxelizerX::VoxMethodDescs[] =
 	L"Union of 3 axis-aligned projection views"
 };
 
+const wchar_t* VoxelizerX::FillMethodDescs[] =
+{
+	L"Solid fill by ray parity along Z",
+	L"Solid fill by majority voting of ray parities along X, Y, and Z"
+};
+
+const wchar_t* VoxelizerX::MipMethodDescs[] =
+{
+	L"MIP reduction after voxelization",
+	L"Direct multi-resolution voxelization"
+};
+
 const wchar_t* VoxelizerX::SolidDescs[] =
 {
 	L"Render surface voxels as box array",
 	L"Render solid voxels with raycasting"
 };
 
+const wchar_t* VoxelizerX::VoxelizeDescs[] =
+{
+	L"Voxelize on change",
+	L"Voxelize every frame"
+};
+
+const wchar_t* VoxelizerX::DeformDescs[] =
+{
+	L"Static mesh",
+	L"Deforming mesh"
+};
+
 VoxelizerX::VoxelizerX(uint32_t width, uint32_t height, std::wstring name) :
 	DXFramework(width, height, name),
 	m_frameIndex(0),
 	m_deviceType(DEVICE_DISCRETE),
 	m_voxMethod(Voxelizer::TRI_PROJ),
+	m_fillMethod(Voxelizer::FILL_PARITY_Z),
+	m_mipMethod(Voxelizer::MIP_REDUCE),
 	m_voxMethodDesc(VoxMethodDescs[m_voxMethod]),
+	m_fillMethodDesc(FillMethodDescs[m_fillMethod]),
+	m_mipMethodDesc(MipMethodDescs[m_mipMethod]),
 	m_solidDesc(SolidDescs[m_solid]),
+	m_voxelizeDesc(VoxelizeDescs[0]),
+	m_deformDesc(DeformDescs[0]),
 	m_solid(false),
+	m_alwaysVoxelize(false),
+	m_deform(false),
 	m_showFPS(true),
 	m_isPaused(false),
 	m_tracking(false),
 	m_meshFileName("Assets/bunny.obj"),
 	m_meshPosScale(0.0f, 0.0f, 0.0f, 1.0f),
-	m_screenShot(0)
+	m_screenShot(0),
+	m_saveGrid(0)
 {
 #if defined (_DEBUG)
 	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
@@ -185,7 +219,34 @@ void VoxelizerX::LoadAssets()
 	if (!m_voxelizer->Init(pCommandList, m_descriptorTableLib, m_width, m_height,
 		static_cast<Format>(m_renderTargets[0]->GetFormat()),
 		static_cast<Format>(m_depth->GetFormat()), uploaders,
-		m_meshFileName.c_str(), m_meshPosScale)) ThrowIfFailed(E_FAIL);
+		m_meshFileName.c_str(), m_meshPosScale, true, Voxelizer::NoObjectID, true)) ThrowIfFailed(E_FAIL);
+
+	// Rest pose of the mesh deformation, toggled by [D], about the center of its bound
+	m_restVertices = m_voxelizer->GetVertices();
+	m_vertices = m_restVertices;
+	{
+		const auto stride = m_voxelizer->GetVertexStride();
+		float lo[3], hi[3];
+		memcpy(lo, m_restVertices.data(), sizeof(lo));
+		memcpy(hi, m_restVertices.data(), sizeof(hi));
+		for (size_t i = stride; i < m_restVertices.size(); i += stride)
+		{
+			float pos[3];
+			memcpy(pos, &m_restVertices[i], sizeof(pos));
+			for (uint8_t j = 0; j < 3; ++j)
+			{
+				lo[j] = (min)(lo[j], pos[j]);
+				hi[j] = (max)(hi[j], pos[j]);
+			}
+		}
+		m_meshCenter = XMFLOAT3((lo[0] + hi[0]) / 2.0f, (lo[1] + hi[1]) / 2.0f, (lo[2] + hi[2]) / 2.0f);
+	}
+
+	// Profiling of the passes, toggled by [P]
+	m_gpuProfiler = make_unique<GPUProfiler>();
+	if (!m_gpuProfiler) ThrowIfFailed(E_FAIL);
+	if (!m_gpuProfiler->Init(m_device.get(), m_commandQueue.get(), Voxelizer::FrameCount)) ThrowIfFailed(E_FAIL);
+	m_voxelizer->SetProfiler(m_gpuProfiler.get());
 
 	// Close the command list and execute it to begin the initial GPU setup.
 	XUSG_N_RETURN(pCommandList->Close(), ThrowIfFailed(E_FAIL));
@@ -239,6 +300,10 @@ void VoxelizerX::OnUpdate()
 	const auto view = XMLoadFloat4x4(&m_view);
 	const auto proj = XMLoadFloat4x4(&m_proj);
 	m_voxelizer->UpdateFrame(m_frameIndex, eyePt, view * proj);
+
+	// Mesh deformation, which only rebuilds the grid while the mesh moves
+	DeformMesh(m_deform ? 0.9f + 0.1f * XMScalarCos(2.0f * static_cast<float>(time)) : 1.0f);
+	m_voxelizer->UpdateVertices(m_frameIndex, m_vertices.data());
 }
 
 // Render the scene.
@@ -279,6 +344,9 @@ void VoxelizerX::OnKeyUp(uint8_t key)
 	case VK_F11:
 		m_screenShot = 1;
 		break;
+	case 'G':
+		m_saveGrid = 1;
+		break;
 	case 'V':
 		m_voxMethod = static_cast<Voxelizer::Method>((m_voxMethod + 1) % Voxelizer::NUM_METHOD);
 		m_voxMethodDesc = VoxMethodDescs[m_voxMethod];
@@ -287,6 +355,30 @@ void VoxelizerX::OnKeyUp(uint8_t key)
 		m_solid = !m_solid;
 		m_solidDesc = SolidDescs[m_solid];
 		break;
+	case 'F':
+		m_fillMethod = static_cast<Voxelizer::FillMethod>((m_fillMethod + 1) % Voxelizer::NUM_FILL_METHOD);
+		m_fillMethodDesc = FillMethodDescs[m_fillMethod];
+		break;
+	case 'M':
+		m_mipMethod = static_cast<Voxelizer::MipMethod>((m_mipMethod + 1) % Voxelizer::NUM_MIP_METHOD);
+		m_mipMethodDesc = MipMethodDescs[m_mipMethod];
+		break;
+	case 'R':
+		m_alwaysVoxelize = !m_alwaysVoxelize;
+		m_voxelizeDesc = VoxelizeDescs[m_alwaysVoxelize];
+		m_voxelizer->SetAlwaysVoxelize(m_alwaysVoxelize);
+		break;
+	case 'D':
+		m_deform = !m_deform;
+		m_deformDesc = DeformDescs[m_deform];
+		break;
+	case 'P':
+		Profiler::GetDefault().SetEnabled(!Profiler::GetDefault().IsEnabled());
+		break;
+	case 'T':
+		if (Profiler::GetDefault().WriteChromeTrace("VoxelizerX_trace.json"))
+			cout << "Profile trace written to VoxelizerX_trace.json" << endl;
+		break;
 	}
 }
 
@@ -401,6 +493,8 @@ void VoxelizerX::ParseCommandLineArgs(wchar_t* argv[], int argc)
 
 void VoxelizerX::PopulateCommandList()
 {
+	PROFILE_SCOPE("PopulateCommandList");
+
 	// Command list allocators can only be reset when the associated 
 	// command lists have finished execution on the GPU; apps should use 
 	// fences to determine GPU execution progress.
@@ -413,6 +507,10 @@ void VoxelizerX::PopulateCommandList()
 	const auto pCommandList = m_commandList.get();
 	XUSG_N_RETURN(pCommandList->Reset(pCommandAllocator, nullptr), ThrowIfFailed(E_FAIL));
 
+	// The fence of this frame index has been waited for, so its timestamps are ready
+	m_gpuProfiler->BeginFrame(m_frameIndex);
+	const auto frameScope = m_gpuProfiler->BeginScope(pCommandList, "Frame");
+
 	// Record commands.
 	// Bind the descriptor heap
 	const auto descriptorHeap = m_descriptorTableLib->GetDescriptorHeap(CBV_SRV_UAV_HEAP);
@@ -425,15 +523,20 @@ void VoxelizerX::PopulateCommandList()
 	auto numBarriers = pRenderTarget->SetBarrier(&barrier, ResourceState::RENDER_TARGET);
 	pCommandList->Barrier(numBarriers, &barrier);
 
-	if (!m_solid)
 	{
-		const float clearColor[] = { CLEAR_COLOR, 0.0f };
-		pCommandList->ClearRenderTargetView(pRenderTarget->GetRTV(), clearColor);
+		GPUProfileScope scope(m_gpuProfiler.get(), pCommandList, "ClearTargets");
+		if (!m_solid)
+		{
+			const float clearColor[] = { CLEAR_COLOR, 0.0f };
+			pCommandList->ClearRenderTargetView(pRenderTarget->GetRTV(), clearColor);
+		}
+		pCommandList->ClearDepthStencilView(m_depth->GetDSV(), ClearFlag::DEPTH, 1.0f);
 	}
-	pCommandList->ClearDepthStencilView(m_depth->GetDSV(), ClearFlag::DEPTH, 1.0f);
 
 	// Voxelizer rendering
-	m_voxelizer->Render(pCommandList, m_solid, m_voxMethod, m_frameIndex, pRenderTarget->GetRTV(), m_depth->GetDSV());
+	m_voxelizer->Render(pCommandList, m_solid, m_voxMethod, m_frameIndex,
+		pRenderTarget->GetRTV(), m_depth->GetDSV(), m_fillMethod, m_mipMethod);
+	m_gpuProfiler->EndScope(pCommandList, frameScope);
 
 	// Indicate that the back buffer will now be used to present.
 	numBarriers = pRenderTarget->SetBarrier(&barrier, ResourceState::PRESENT);
@@ -447,6 +550,14 @@ void VoxelizerX::PopulateCommandList()
 		m_screenShot = 2;
 	}
 
+	// Grid-saving helper
+	if (m_saveGrid == 1)
+	{
+		if (!m_gridReadBuffer) m_gridReadBuffer = Buffer::MakeUnique();
+		m_saveGrid = m_voxelizer->ReadBackGrid(pCommandList, m_gridReadBuffer.get(), &m_gridRowPitch) ? 2 : 0;
+	}
+
+	m_gpuProfiler->EndFrame(pCommandList);
 	XUSG_N_RETURN(pCommandList->Close(), ThrowIfFailed(E_FAIL));
 }
 
@@ -498,6 +609,21 @@ void VoxelizerX::MoveToNextFrame()
 		}
 		else ++m_screenShot;
 	}
+
+	// Grid-saving helper
+	if (m_saveGrid)
+	{
+		if (m_saveGrid > Voxelizer::FrameCount)
+		{
+			char timeStr[15];
+			tm dateTime;
+			const auto now = time(nullptr);
+			if (!localtime_s(&dateTime, &now) && strftime(timeStr, sizeof(timeStr), "%Y%m%d%H%M%S", &dateTime))
+				SaveGrid((string("VoxelizerX_") + timeStr + ".vxgc").c_str(), m_gridReadBuffer.get(), m_gridRowPitch);
+			m_saveGrid = 0;
+		}
+		else ++m_saveGrid;
+	}
 }
 
 void VoxelizerX::SaveImage(char const* fileName, Buffer* pImageBuffer, uint32_t w, uint32_t h, uint32_t rowPitch, uint8_t comp)
@@ -522,6 +648,41 @@ void VoxelizerX::SaveImage(char const* fileName, Buffer* pImageBuffer, uint32_t
 	pImageBuffer->Unmap();
 }
 
+void VoxelizerX::SaveGrid(char const* fileName, Buffer* pGridBuffer, uint32_t rowPitch)
+{
+	const auto pData = static_cast<const uint8_t*>(pGridBuffer->Map(nullptr));
+
+	// The rows are padded to the pitch in the read-back buffer, and the slices are packed
+	VoxelGrid grid;
+	if (grid.Create(GRID_SIZE))
+	{
+		const auto pDst = grid.GetData();
+		for (auto i = 0u; i < GRID_SIZE * GRID_SIZE; ++i)
+			memcpy(&pDst[static_cast<size_t>(GRID_SIZE) * i], &pData[static_cast<size_t>(rowPitch) * i], sizeof(uint32_t) * GRID_SIZE);
+
+		VoxelChunkWriter writer;
+		if (writer.Create(fileName, GRID_SIZE, (min)(GRID_SIZE, 32))) writer.WriteGrid(grid);
+		writer.Close();
+	}
+
+	pGridBuffer->Unmap();
+}
+
+// Scale the rest pose about the center of its bound, which keeps the mesh within its
+// initial bound for scales up to 1, and the normals unchanged
+void VoxelizerX::DeformMesh(float scale)
+{
+	const auto stride = m_voxelizer->GetVertexStride();
+	const float center[] = { m_meshCenter.x, m_meshCenter.y, m_meshCenter.z };
+	for (size_t i = 0; i < m_restVertices.size(); i += stride)
+	{
+		float pos[3];
+		memcpy(pos, &m_restVertices[i], sizeof(pos));
+		for (uint8_t j = 0; j < 3; ++j) pos[j] = center[j] + (pos[j] - center[j]) * scale;
+		memcpy(&m_vertices[i], pos, sizeof(pos));
+	}
+}
+
 double VoxelizerX::CalculateFrameStats(float* pTimeStep)
 {
 	static auto frameCnt = 0u;
@@ -544,7 +705,15 @@ double VoxelizerX::CalculateFrameStats(float* pTimeStep)
 		if (m_showFPS) windowText << setprecision(2) << fixed << fps;
 		else windowText << L"[F1]";
 		windowText << L"    [V] " << m_voxMethodDesc << L"    [S] " << m_solidDesc;
-		windowText << L"    [F11] screen shot";
+		if (m_solid) windowText << L"    [F] " << m_fillMethodDesc;
+		else windowText << L"    [M] " << m_mipMethodDesc;
+		windowText << L"    [R] " << m_voxelizeDesc << L"    [D] " << m_deformDesc;
+
+		ProfileStats stats;
+		if (Profiler::GetDefault().IsEnabled() && Profiler::GetDefault().GetStats("Frame", stats))
+			windowText << L"    [P] GPU " << setprecision(3) << stats.Avg << L" ms (p99 " << stats.P99 << L" ms)    [T] trace";
+		else windowText << L"    [P] profile";
+		windowText << L"    [F11] screen shot    [G] save grid";
 
 		SetCustomWindowText(windowText.str().c_str());
 	}
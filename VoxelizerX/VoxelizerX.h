@@ -63,6 +63,7 @@ private:
 
 	// App resources.
 	std::unique_ptr<Voxelizer>	m_voxelizer;
+	std::unique_ptr<GPUProfiler> m_gpuProfiler;
 	XUSG::DepthStencil::uptr	m_depth;
 	XMFLOAT4X4	m_proj;
 	XMFLOAT4X4	m_view;
@@ -79,9 +80,17 @@ private:
 	DeviceType	m_deviceType;
 	StepTimer	m_timer;
 	Voxelizer::Method m_voxMethod;
+	Voxelizer::FillMethod m_fillMethod;
+	Voxelizer::MipMethod m_mipMethod;
 	std::wstring m_voxMethodDesc;
+	std::wstring m_fillMethodDesc;
+	std::wstring m_mipMethodDesc;
 	std::wstring m_solidDesc;
+	std::wstring m_voxelizeDesc;
+	std::wstring m_deformDesc;
 	bool		m_solid;
+	bool		m_alwaysVoxelize;
+	bool		m_deform;
 	bool		m_showFPS;
 	bool		m_isPaused;
 
@@ -93,11 +102,21 @@ private:
 	std::string m_meshFileName;
 	XMFLOAT4 m_meshPosScale;
 
+	// Mesh deformation: the rest pose, the deformed vertices, and the center of the bound
+	std::vector<uint8_t> m_restVertices;
+	std::vector<uint8_t> m_vertices;
+	XMFLOAT3 m_meshCenter;
+
 	// Screen-shot helpers and state
 	XUSG::Buffer::uptr	m_readBuffer;
 	uint32_t			m_rowPitch;
 	uint8_t				m_screenShot;
 
+	// Grid-saving helpers and state
+	XUSG::Buffer::uptr	m_gridReadBuffer;
+	uint32_t			m_gridRowPitch;
+	uint8_t				m_saveGrid;
+
 	void LoadPipeline();
 	void LoadAssets();
 
@@ -106,8 +125,14 @@ private:
 	void MoveToNextFrame();
 	void SaveImage(char const* fileName, XUSG::Buffer* pImageBuffer,
 		uint32_t w, uint32_t h, uint32_t rowPitch, uint8_t comp = 3);
+	void SaveGrid(char const* fileName, XUSG::Buffer* pGridBuffer, uint32_t rowPitch);
+	void DeformMesh(float scale);
 	double CalculateFrameStats(float* fTimeStep = nullptr);
 
 	static const wchar_t* VoxMethodDescs[];
+	static const wchar_t* FillMethodDescs[];
+	static const wchar_t* MipMethodDescs[];
 	static const wchar_t* SolidDescs[];
+	static const wchar_t* VoxelizeDescs[];
+	static const wchar_t* DeformDescs[];
 };